@@ -0,0 +1,309 @@
+#! /usr/bin/env python3 
+#
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+# @Copyright@
+#
+
+"""
+Times resolving all the attributes of every host on the 7.x schema
+(categories, catindex, resolvechain and the hostselections view) and on
+the rocks8 resolution level schema.
+
+For each cluster size a 7.x database with the tables of
+nodes/database-schema.xml is generated in SQLite, converted with
+migrate7.py, and resolved:
+
+  7.x host      the query of rocks.db.helper, once per host (what
+                getHostAttrs runs without librocks).  It scans the
+                catindex of every host, above SAMPLE hosts only a
+                sample is timed and the time is scaled up (~)
+  7.x all       the tables read once and merged by catindex names, as
+                the librocks AttrResolver of getHostsAttrs does
+  r8 host       AttrResolver.resolve() of one host at a time
+  r8 all        AttrResolver.resolve() of all the hosts at once
+
+The results of the two schemas are compared, a difference is an error.
+
+Usage::
+
+  benchattrs.py [hosts ...]     (default 1000 5000 20000)
+"""
+
+import os
+import sys
+import time
+import random
+import shutil
+import sqlite3
+import tempfile
+
+import migrate7		# puts rocks-pylib on the path
+from rocks.db.resolver import AttrResolver
+
+# the 7.x tables attribute resolution reads, in SQLite
+SCHEMA7 = """
+CREATE TABLE appliances (
+  ID INTEGER PRIMARY KEY, Name varchar(32) NOT NULL COLLATE NOCASE,
+  Graph varchar(64) NOT NULL DEFAULT 'default',
+  Node varchar(64) NOT NULL DEFAULT '', OS varchar(8) DEFAULT 'linux');
+CREATE TABLE memberships (
+  ID INTEGER PRIMARY KEY, Name varchar(64) NOT NULL COLLATE NOCASE,
+  Appliance int DEFAULT 0, Distribution int DEFAULT 1,
+  Public varchar(3) DEFAULT 'no');
+CREATE TABLE nodes (
+  ID INTEGER PRIMARY KEY, Name varchar(128) COLLATE NOCASE,
+  Membership int DEFAULT 2, CPUs int NOT NULL DEFAULT 1, Rack int,
+  Rank int, Arch varchar(32), OS varchar(8) NOT NULL DEFAULT 'linux',
+  RunAction varchar(64) DEFAULT 'os',
+  InstallAction varchar(64) DEFAULT 'install');
+CREATE INDEX nodes_Name ON nodes (Name);
+CREATE TABLE categories (
+  ID INTEGER PRIMARY KEY, Name varchar(64) NOT NULL COLLATE NOCASE,
+  Description varchar(512), UNIQUE (Name));
+CREATE TABLE catindex (
+  ID INTEGER PRIMARY KEY, Name varchar(64) NOT NULL COLLATE NOCASE,
+  Category int NOT NULL, UNIQUE (Name, Category));
+CREATE TABLE resolvechain (
+  ID INTEGER PRIMARY KEY, Name varchar(64) NOT NULL,
+  Category int NOT NULL, Precedence int NOT NULL DEFAULT 10,
+  UNIQUE (Name, Category));
+CREATE TABLE attributes (
+  ID INTEGER PRIMARY KEY, Attr varchar(128) NOT NULL COLLATE NOCASE,
+  Value text, Shadow text, Category int NOT NULL, Catindex int NOT NULL,
+  UNIQUE (Attr, Category, Catindex));
+CREATE INDEX AttrCatindex ON attributes (Category, Catindex, Attr);
+CREATE TABLE sec_global_attributes (
+  Attr varchar(128), Value text, Enc varchar(64), PRIMARY KEY (Attr));
+CREATE TABLE sec_node_attributes (
+  Node int NOT NULL DEFAULT 0, Attr varchar(128), Value text,
+  Enc varchar(64), PRIMARY KEY (Node, Attr));
+CREATE VIEW hostselections AS
+  SELECT n.name as host, c.id as category, ci.id as selection
+  FROM catindex as ci, categories as c, nodes as n, memberships as m,
+    appliances as a
+  WHERE n.membership = m.id and m.appliance = a.id and
+    ( (c.name = 'global' and ci.name = 'global') or
+      (c.name = 'os' and ci.name = n.os) or
+      (c.name = 'appliance' and ci.name = a.name) or
+      (c.name = 'host' and ci.name = n.name)
+    );
+"""
+
+CATEGORIES = [ 'global', 'os', 'appliance', 'rack', 'host' ]
+
+# name, share of the hosts
+APPLIANCES = [ ('compute', 0.90), ('gpu', 0.05), ('login', 0.02),
+    ('nas', 0.02), ('devel-server', 0.01) ]
+
+GLOBALS = 120		# global attributes
+SYSTEM = 10		# linux attributes, half replace a global one
+PER_APPLIANCE = 15	# attributes of each appliance, 8 replace globals
+PER_HOST = 4		# attributes of each host, 1 replaces a global
+
+SAMPLE = 500		# hosts resolved with the 7.x query
+
+
+def build7(conn, hosts):
+    """Fills conn with a 7.x cluster of a frontend and hosts nodes."""
+    rnd = random.Random(hosts)
+    conn.executescript(SCHEMA7)
+    for name in CATEGORIES:
+        conn.execute('INSERT INTO categories(Name) VALUES (?)', (name, ))
+        conn.execute('INSERT INTO resolvechain(Name, Category, Precedence) '
+            'VALUES (?, ?, ?)', ('default', CATEGORIES.index(name) + 1,
+            (CATEGORIES.index(name) + 1) * 10))
+    category = dict([ (n, CATEGORIES.index(n) + 1) for n in CATEGORIES ])
+
+    catindex = {}
+    def index(name, cat):
+        if (name, cat) not in catindex:
+            cursor = conn.execute('INSERT INTO catindex(Name, Category) '
+                'VALUES (?, ?)', (name, category[cat]))
+            catindex[(name, cat)] = cursor.lastrowid
+        return catindex[(name, cat)]
+
+    attrs = []
+    def attr(name, value, cat, idx):
+        attrs.append((name, value, category[cat], index(idx, cat)))
+
+    for i in range(GLOBALS):
+        attr('attr_%03d' % i, 'global %d' % i, 'global', 'global')
+    for i in range(SYSTEM):
+        attr('attr_%03d' % (i * 2), 'linux %d' % i, 'os', 'linux')
+
+    appliances = [ ('frontend', 0) ] + APPLIANCES
+    for (name, share) in appliances:
+        cursor = conn.execute('INSERT INTO appliances(Name, Node) '
+            'VALUES (?, ?)', (name, name))
+        conn.execute('INSERT INTO memberships(Name, Appliance) '
+            'VALUES (?, ?)', (name.capitalize(), cursor.lastrowid))
+        replaced = rnd.sample(range(GLOBALS), 8)
+        for i in range(PER_APPLIANCE):
+            if i < len(replaced):
+                a = 'attr_%03d' % replaced[i]
+            else:
+                a = '%s_%d' % (name, i)
+            attr(a, '%s %d' % (name, i), 'appliance', name)
+
+    nodes = [ ('frontend-0-0', 1, 0, 0) ]
+    rack = {}
+    for i in range(hosts):
+        x = rnd.random()
+        for (membership, (name, share)) in enumerate(APPLIANCES):
+            x = x - share
+            if x < 0:
+                break
+        r = rack.setdefault(name, 0) // 40
+        nodes.append(('%s-%d-%d' % (name, r, rack[name] % 40),
+            membership + 2, r, rack[name] % 40))
+        rack[name] = rack[name] + 1
+    conn.executemany('INSERT INTO nodes(Name, Membership, Rack, Rank) '
+        'VALUES (?, ?, ?, ?)', nodes)
+
+    for (name, membership, r, rank) in nodes:
+        attr('attr_%03d' % rnd.randrange(GLOBALS), name, 'host', name)
+        for i in range(1, PER_HOST):
+            attr('host_%d' % i, '%s %d' % (name, i), 'host', name)
+    conn.executemany('INSERT INTO attributes(Attr, Value, Category, '
+        'Catindex) VALUES (?, ?, ?, ?)', attrs)
+    conn.commit()
+    return len(attrs)
+
+
+def resolve7(source):
+    """
+    {host: {attr: value}} of all the hosts on the 7.x tables, each host
+    selects the catindex of its global, os, appliance and host names.
+    Between equal precedences the higher category ID wins, as in the
+    7.x query.
+    """
+    category = dict([ (name.lower(), id) for (id, name) in
+        source.rows('select id, name from categories') ])
+    precedence = {}
+    for (cat, prec) in source.rows('select category, precedence '
+            'from resolvechain'):
+        precedence[cat] = max(prec, precedence.get(cat, prec))
+    catindex = dict([ ((cat, name.lower()), id) for (id, cat, name) in
+        source.rows('select id, category, name from catindex') ])
+    attrs = {}
+    for (attr, value, cat, idx) in source.rows('select attr, value, '
+            'category, catindex from attributes'):
+        attrs.setdefault(idx, []).append((attr, value))
+
+    resolved = {}
+    for (name, os, appliance) in source.rows('select n.name, n.os, a.name '
+            'from nodes n, memberships m, appliances a '
+            'where n.membership = m.id and m.appliance = a.id'):
+        selected = []
+        for (cat, key) in [ ('global', 'global'), ('os', os),
+                ('appliance', appliance), ('host', name) ]:
+            id = category.get(cat)
+            if id in precedence and (id, key.lower()) in catindex:
+                selected.append((precedence[id], id,
+                    catindex[(id, key.lower())]))
+        selected.sort()
+        values = {}
+        for (prec, cat, idx) in selected:
+            for (attr, value) in attrs.get(idx, ()):
+                values[attr] = value
+        resolved[name] = values
+    return resolved
+
+
+def timed(fn):
+    start = time.time()
+    result = fn()
+    return (time.time() - start, result)
+
+
+def bench(dir, hosts):
+    path7 = os.path.join(dir, 'cluster-%d.db' % hosts)
+    path8 = os.path.join(dir, 'rocks8-%d.db' % hosts)
+    count = build7(sqlite3.connect(path7), hosts)
+
+    source = migrate7.Source(path7)
+    (migrate, n) = timed(lambda: migrate7.create(source, path8))
+    names = source.hostnames()
+
+    sample = names[::max(1, len(names) // SAMPLE)]
+    (host7, sampled) = timed(lambda: dict([ (name, source.resolve(name))
+        for name in sample ]))
+    host7 = host7 * len(names) / len(sample)
+    (all7, resolved7) = timed(lambda: resolve7(source))
+
+    resolver = AttrResolver(sqlite3.connect(path8))
+    (host, resolved8) = timed(lambda: dict([ (name,
+        resolver.resolve([name])[name]) for name in names ]))
+    (all, everything) = timed(lambda: resolver.resolve())
+
+    for name in names:
+        if not sampled.get(name, resolved7[name]) == resolved7[name] == \
+                resolved8[name] == everything[name]:
+            raise ValueError('%s resolves differently' % name)
+
+    print ('%6d %8d %9.2f %8.2f%s %9.2f %9.2f %9.2f' % (len(names), count,
+        migrate, host7, len(sample) < len(names) and '~' or ' ', all7,
+        host, all))
+
+
+if __name__ == "__main__":
+    sizes = [ int(n) for n in sys.argv[1:] ] or [ 1000, 5000, 20000 ]
+    dir = tempfile.mkdtemp(prefix='benchattrs')
+    try:
+        print ('%6s %8s %9s %9s %9s %9s %9s' % ('hosts', 'attrs',
+            'migrate', '7.x host', '7.x all', 'r8 host', 'r8 all'))
+        for hosts in sizes:
+            bench(dir, hosts)
+    finally:
+        shutil.rmtree(dir)
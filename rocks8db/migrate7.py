@@ -0,0 +1,379 @@
+#! /usr/bin/env python3 
+#
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+# @Copyright@
+#
+
+"""
+Converts a Rocks 7 database into a rocks8 (SQLite) database.
+
+The source is the running 7.x database, read as root through
+SQLAlchemy (see MYSQL below), or another database URL.  It
+must have the secure attributes (sec_* tables), so the SQLite snapshot
+(/var/opt/rocks/snapshot/cluster.db) is refused: it leaves them out.
+
+What attribute resolution reads is converted: the appliances, the nodes
+(keeping their IDs) and the attributes.  The 7.x categories map to
+resolution levels:
+
+  global     global
+  os         global, the os attributes of the OS the nodes run replace
+             the global ones as they do in 7.x
+  appliance  appliance
+  host       node
+
+Attributes 7.x does not select for any host (of another OS, of a removed
+node, of the rack category) are left out and counted on stderr.  The
+secure attributes go to a separate database only root can read, next to
+the rocks8 one (rocks8-sec.db for rocks8.db), keyed as the attributes.
+
+With --verify the attributes of every host are resolved on both
+databases and compared.
+
+Usage::
+
+  migrate7.py [-f] [--verify] [--source SOURCE] rocks8.db
+"""
+
+import os
+import sys
+import sqlite3
+import argparse
+import tempfile
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)),
+    'rocks-pylib'))
+from rocks.db.resolver import AttrResolver
+
+MYSQL = 'mysql://root@localhost/cluster?' \
+    'unix_socket=/var/opt/rocks/mysql/mysql.sock&' \
+    'read_default_file=/root/.rocks.my.cnf'
+SECURE_TABLES = [ 'sec_global_attributes', 'sec_node_attributes' ]
+SCHEMA = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+    'new-rocks-schema.sql')
+
+# the secure attributes, in a database of their own
+SECURE_SCHEMA = """
+CREATE TABLE secattrs (
+	ID                   INTEGER NOT NULL  PRIMARY KEY  ,
+	attr                 VARCHAR(128) NOT NULL    ,
+	value                TEXT     ,
+	enc                  VARCHAR(64)     ,
+	reslevel             INTEGER     ,
+	reskey               VARCHAR(512)  DEFAULT 'global'   ,
+	resid                INTEGER
+ );
+CREATE UNIQUE INDEX unq_secattrs ON secattrs ( reslevel, resid, attr );
+"""
+
+# the default resolution levels, as in populate.txt
+RESLEVELS = [ ('global', 0), ('graph', 100), ('appliance', 200),
+    ('rack', 300), ('groups', 300), ('node', 1000) ]
+
+# the 7.x resolution of the attributes of one host, the query of
+# rocks.db.helper (substr is in MySQL and in SQLite).  Between categories
+# of the same precedence the last row wins, the one with the higher
+# category ID.
+sql_attribute_query = """
+select a.attr, a.value, UPPER(substr(c.Name, 1, 1)) as category
+from attributes a, resolvechain r, categories c, hostselections hs,
+  (select attr, max(precedence) as maxprec
+   from attributes a, resolvechain r, hostselections hs
+   where a.category = r.category and a.category = hs.category
+     and a.catindex = hs.selection and hs.host = {mark}
+     group by attr) as sub
+where a.attr = sub.attr and a.category = r.category
+ and sub.maxprec = r.precedence and a.category = hs.category
+ and a.catindex = hs.selection and c.id = hs.category
+ and hs.host = {mark}
+order by r.precedence, a.category
+"""
+
+
+class Source(object):
+    """A DB-API connection to the 7.x database and its parameter mark."""
+
+    def __init__(self, source):
+        if '://' in source:
+            import sqlalchemy
+            engine = sqlalchemy.create_engine(source)
+            self.conn = engine.raw_connection()
+            self.mark = { 'qmark': '?', 'format': '%s',
+                'pyformat': '%s' }[engine.dialect.paramstyle]
+            tables = 'show tables'
+        else:
+            if not os.path.exists(source):
+                raise IOError('%s: no such database' % source)
+            self.conn = sqlite3.connect(source)
+            self.mark = '?'
+            tables = "select name from sqlite_master where type = 'table'"
+        self.tables = [ name.lower() for (name, ) in self.rows(tables) ]
+        for table in SECURE_TABLES:
+            if table not in self.tables:
+                raise ValueError('%s has no %s table, it is not the '
+                    'whole 7.x database (a snapshot?)' % (source, table))
+
+    def rows(self, query, args=()):
+        cursor = self.conn.cursor()
+        cursor.execute(query.format(mark=self.mark), args)
+        rows = cursor.fetchall()
+        cursor.close()
+        return rows
+
+    def resolve(self, name):
+        """{attr: value} of a host, resolved by 7.x."""
+        return dict([ (attr, value) for (attr, value, category) in
+            self.rows(sql_attribute_query, (name, name)) ])
+
+    def hostnames(self):
+        return [ name for (name, ) in self.rows('select name from nodes') ]
+
+
+def warn(msg):
+    sys.stderr.write('migrate7: %s\n' % msg)
+
+
+def convert(source, conn):
+    """
+    Loads the rocks8 database conn (with the schema and no data) from
+    the 7.x source.  Returns the number of attributes converted.
+    """
+    for (resname, level) in RESLEVELS:
+        conn.execute('INSERT INTO reslevels(resname, level) VALUES (?, ?)',
+            (resname, level))
+    reslevel = dict(conn.execute('SELECT resname, ID FROM reslevels'))
+
+    # memberships were the appliance labels, the first one describes it
+    describe = {}
+    for (appliance, name) in source.rows('select appliance, name '
+            'from memberships order by id'):
+        describe.setdefault(appliance, name)
+    appliances = {}
+    for (id, name, graph, node) in source.rows('select id, name, graph, '
+            'node from appliances'):
+        conn.execute('INSERT INTO appliances(ID, name, graphStart, '
+            'description, graph) VALUES (?, ?, ?, ?, ?)',
+            (id, name, node, describe.get(id), graph))
+        appliances[name.lower()] = (id, name)
+
+    nodes = {}
+    systems = set()
+    for (id, name, rack, rank, os, appliance) in source.rows('select n.id, '
+            'n.name, n.rack, n.rank, n.os, m.appliance from nodes n '
+            'left join memberships m on n.membership = m.id'):
+        conn.execute('INSERT INTO nodes(ID, name, rack, rank, appliance) '
+            'VALUES (?, ?, ?, ?, ?)', (id, name, rack or 0, rank or 0,
+            appliance))
+        nodes[name.lower()] = (id, name)
+        systems.add(os)
+
+    if len(systems) > 1:
+        raise ValueError('the nodes run %s, rocks8 has no os level' %
+            ' and '.join(sorted(systems)))
+    system = (systems.pop() if systems else 'linux').lower()
+
+    # (reslevel, resid, reskey) of the 7.x (category, catindex)
+    def key(category, catindex):
+        category = category.lower()
+        if category == 'global':
+            return (reslevel['global'], 0, 'global')
+        if category == 'appliance' and catindex.lower() in appliances:
+            (id, name) = appliances[catindex.lower()]
+            return (reslevel['appliance'], id, name)
+        if category == 'host' and catindex.lower() in nodes:
+            (id, name) = nodes[catindex.lower()]
+            return (reslevel['node'], id, name)
+        return None
+
+    attrs = {}
+    system_attrs = []
+    skipped = {}
+    for (attr, value, shadow, category, catindex) in source.rows('select '
+            'a.attr, a.value, a.shadow, c.name, ci.name '
+            'from attributes a, categories c, catindex ci '
+            'where a.category = c.id and a.catindex = ci.id'):
+        if category.lower() == 'os':
+            if catindex.lower() == system:
+                system_attrs.append((attr, value, shadow))
+            else:
+                skipped[category] = skipped.get(category, 0) + 1
+            continue
+        k = key(category, catindex)
+        if not k:
+            skipped[category] = skipped.get(category, 0) + 1
+            continue
+        attrs[k + (attr.lower(), )] = (attr, value, shadow) + k
+
+    # os sits between global and appliance, it replaces the global value
+    for (attr, value, shadow) in system_attrs:
+        k = key('global', 'global')
+        attrs[k + (attr.lower(), )] = (attr, value, shadow) + k
+
+    conn.executemany('INSERT INTO attrs(attr, value, shadow, reslevel, '
+        'resid, reskey) VALUES (?, ?, ?, ?, ?, ?)', list(attrs.values()))
+
+    secure = []
+    for (attr, value, enc) in source.rows('select attr, value, enc '
+            'from sec_global_attributes'):
+        secure.append((attr, value, enc) + key('global', 'global'))
+    for (attr, value, enc, name) in source.rows('select s.attr, s.value, '
+            's.enc, n.name from sec_node_attributes s, nodes n '
+            'where s.node = n.id'):
+        secure.append((attr, value, enc) + key('host', name))
+
+    for category in sorted(skipped):
+        warn('%d %s attributes apply to no host, not converted' %
+            (skipped[category], category))
+    return (len(attrs), secure)
+
+
+def securePath(path):
+    """The database of the secure attributes of the rocks8 one."""
+    (base, ext) = os.path.splitext(path)
+    return '%s-sec%s' % (base, ext or '.db')
+
+
+def write(path, load):
+    """
+    Writes the database path with load(conn), aside and renamed into
+    place when it is complete, only the owner can read it.
+    """
+    (fd, tmp) = tempfile.mkstemp(prefix='.rocks8',
+        dir=os.path.dirname(os.path.abspath(path)))
+    os.close(fd)
+    try:
+        conn = sqlite3.connect(tmp)
+        conn.execute('PRAGMA foreign_keys = ON')
+        result = load(conn)
+        conn.commit()
+        conn.close()
+        os.rename(tmp, path)
+    except:
+        os.unlink(tmp)
+        raise
+    return result
+
+
+def create(source, path, schema=SCHEMA, force=False):
+    """
+    Writes the rocks8 database converted from source to path, and
+    the secure attributes next to it (see :func:`securePath`).  Returns
+    the number of attributes converted.
+    """
+    if os.path.exists(path) and not force:
+        raise IOError('%s exists, use -f to replace it' % path)
+
+    def load(conn):
+        with open(schema) as f:
+            conn.executescript(f.read())
+        return convert(source, conn)
+
+    def loadSecure(conn):
+        conn.executescript(SECURE_SCHEMA)
+        conn.executemany('INSERT INTO secattrs(attr, value, enc, '
+            'reslevel, resid, reskey) VALUES (?, ?, ?, ?, ?, ?)', secure)
+
+    (count, secure) = write(path, load)
+    write(securePath(path), loadSecure)
+    return count
+
+
+def verify(source, conn):
+    """
+    Resolves the attributes of every host on both databases, prints
+    the differences and returns how many hosts differ.
+    """
+    resolved = AttrResolver(conn).resolve()
+    bad = 0
+    for name in source.hostnames():
+        old = source.resolve(name)
+        new = resolved.get(name, {})
+        if old == new:
+            continue
+        bad = bad + 1
+        for attr in sorted(set(old) | set(new)):
+            if old.get(attr) != new.get(attr):
+                print ('%s: %s: %r (7.x) != %r (rocks8)' % (name, attr,
+                    old.get(attr), new.get(attr)))
+    return bad
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser(description='Convert a Rocks 7 '
+        'database to a rocks8 database.')
+    parser.add_argument('-f', dest='force', action='store_true',
+        help='replace the rocks8 database if it exists')
+    parser.add_argument('--source', default=MYSQL,
+        help='the 7.x database URL or file (%(default)s)')
+    parser.add_argument('--schema', default=SCHEMA,
+        help='the rocks8 schema (%(default)s)')
+    parser.add_argument('--verify', action='store_true',
+        help='compare the attributes of every host on both databases')
+    parser.add_argument('database', help='the rocks8 database to write')
+    args = parser.parse_args()
+
+    try:
+        source = Source(args.source)
+        count = create(source, args.database, args.schema, args.force)
+    except (IOError, ValueError) as e:
+        warn(e)
+        sys.exit(1)
+    print ('%s: %d attributes of %d hosts' % (args.database, count,
+        len(source.hostnames())))
+
+    if args.verify:
+        bad = verify(source, sqlite3.connect(args.database))
+        if bad:
+            warn('%d hosts resolve differently' % bad)
+            sys.exit(1)
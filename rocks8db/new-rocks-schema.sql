@@ -77,10 +77,14 @@ CREATE TABLE attrs (
 	shadow               VARCHAR(512)     ,
 	reslevel             INTEGER     ,
 	reskey               VARCHAR(512)  DEFAULT 'global'   ,
+	resid                INTEGER     ,
 	FOREIGN KEY ( reslevel ) REFERENCES reslevels( ID ) ON DELETE CASCADE ON UPDATE CASCADE
  );
 
-CREATE UNIQUE INDEX unq_attrs ON attrs ( attr, reslevel, reskey );
+-- resid is the ID of what reskey names (node, appliance, nodegroup), the
+-- rack number for rack or 0 for global. Resolution looks attributes up
+-- by (reslevel, resid) with this index.
+CREATE UNIQUE INDEX unq_attrs ON attrs ( reslevel, resid, attr );
 
 CREATE TABLE firewalls ( 
 	ID                   INTEGER NOT NULL  PRIMARY KEY  ,
@@ -294,8 +298,7 @@ AFTER UPDATE on appliances
 WHEN old.name <> new.name OR
    old.reslevel <> new.reslevel
 BEGIN
-  UPDATE attrs set reskey=new.reskey where attrs.reslevel = old.reslevel and attrs.reskey = old.reskey;
-  UPDATE attrs set reslevel=new.reslevel where attrs.reslevel=old.reslevel and attrs.reskey=new.reskey;
+  UPDATE attrs set reskey=new.reskey, reslevel=new.reslevel where attrs.reslevel = old.reslevel and attrs.resid = old.id;
   UPDATE routes set reskey=new.reskey where routes.reslevel = old.reslevel and routes.reskey = old.reskey;
   UPDATE routes set reslevel=new.reslevel where routes.reslevel=old.reslevel and routes.reskey=new.reskey;
   UPDATE firewalls set reskey=new.reskey where firewalls.reslevel = old.reslevel and firewalls.reskey = old.reskey;
@@ -305,7 +308,7 @@ END;
 CREATE TRIGGER trigger_appliance_delete
 BEFORE DELETE on appliances
 BEGIN
-  DELETE FROM attrs where attrs.reslevel=old.reslevel and attrs.reskey=old.reskey;
+  DELETE FROM attrs where attrs.reslevel=old.reslevel and attrs.resid=old.id;
   DELETE FROM routes where routes.reslevel=old.reslevel and routes.reskey=old.reskey;
   DELETE FROM firewalls where firewalls.reslevel=old.reslevel and firewalls.reskey=old.reskey;
 END;
@@ -318,8 +321,16 @@ END;
 
 CREATE TRIGGER trigger_attr_insert
 AFTER  INSERT ON attrs 
+WHEN new.reslevel is NULL OR new.resid is NULL
 BEGIN
-  UPDATE attrs set reslevel = (select id from reslevels r where r.resname='global') where attrs.reslevel is NULL;
+  UPDATE attrs set reslevel = (select id from reslevels r where r.resname='global') where attrs.id = new.id and attrs.reslevel is NULL;
+  UPDATE attrs set resid = CASE (select r.resname from reslevels r where r.id = attrs.reslevel)
+      WHEN 'node' THEN (select n.id from nodes n where n.name = attrs.reskey)
+      WHEN 'appliance' THEN (select ap.id from appliances ap where ap.name = attrs.reskey)
+      WHEN 'groups' THEN (select ng.id from nodegroups ng where ng.name = attrs.reskey)
+      WHEN 'rack' THEN CAST(attrs.reskey AS INTEGER)
+      ELSE 0 END
+    where attrs.id = new.id and attrs.resid is NULL;
 END;
 
 CREATE TRIGGER trigger_ipaddrs_insert
@@ -341,8 +352,7 @@ AFTER UPDATE on nodes
 WHEN old.name <> new.name OR
    old.reslevel <> new.reslevel
 BEGIN
-  UPDATE attrs set reskey=new.name where attrs.reslevel = old.reslevel and attrs.reskey = old.name;
-  UPDATE attrs set reslevel=new.reslevel where attrs.reslevel=old.reslevel and attrs.reskey=new.name;
+  UPDATE attrs set reskey=new.name, reslevel=new.reslevel where attrs.reslevel = old.reslevel and attrs.resid = old.id;
   UPDATE routes set reskey=new.name where routes.reslevel = old.reslevel and routes.reskey = old.name;
   UPDATE routes set reslevel=new.reslevel where routes.reslevel=old.reslevel and routes.reskey=new.name;
   UPDATE firewalls set reskey=new.name where firewalls.reslevel = old.reslevel and firewalls.reskey = old.name;
@@ -352,9 +362,9 @@ END;
 CREATE TRIGGER trigger_node_delete
 BEFORE DELETE on nodes
 BEGIN
-  DELETE FROM attrs where attrs.reslevel=reslevel and attrs.reskey=old.name;
-  DELETE FROM routes where routes.reslevel=reslevel and routes.reskey=old.name;
-  DELETE FROM firewalls where firewalls.reslevel=reslevel and firewalls.reskey=old.name;
+  DELETE FROM attrs where attrs.reslevel=old.reslevel and attrs.resid=old.id;
+  DELETE FROM routes where routes.reslevel=old.reslevel and routes.reskey=old.name;
+  DELETE FROM firewalls where firewalls.reslevel=old.reslevel and firewalls.reskey=old.name;
 END;
 
 CREATE TRIGGER trigger_nodegroups_insert
@@ -112,7 +112,6 @@ class Database(object):
         self.engine = None
 
 
-        self._dbPasswd = passwd
 
     def setDBHostname(self, host):
         self._dbHost = host
@@ -153,8 +152,8 @@ class Database(object):
         data structure
         """
 
-        url = 'sqlite:///' % self.getDBName())
-        if os.environ.has_key('ROCKSDEBUG'):
+        url = 'sqlite:///%s' % self.getDBName()
+        if 'ROCKSDEBUG' in os.environ:
             self.setVerbose(True)
 
         if self.verbose:
@@ -164,7 +163,7 @@ class Database(object):
 
         if self.verbose:
             # TODO move this to the logger
-            print "Database connection URL: ", url
+            print("Database connection URL: ", url)
 
         self.engine = create_engine(url, pool_recycle=3600)
         # TODO: do not keep a connection active here it not needed
@@ -240,7 +239,7 @@ class Database(object):
         """
         if self.conn:
             if '%' in command:
-                command = string.replace(command, '%', '%%')
+                command = command.replace('%', '%%')
             try:
                 self.results = self.conn.execute(command)
             except sqlalchemy.exc.OperationalError as e:
@@ -57,11 +57,14 @@
 
 
 import rocks.db.database
+import rocks.db.resolver
 import rocks
 import rocks.util
 import string
+import socket
 
 from rocks.db.mappings.base import *
+import sqlalchemy
 from sqlalchemy import or_, and_
 
 
@@ -155,10 +158,9 @@ class DatabaseHelper(rocks.db.database.Database):
 
         list = []
         if not names:
-            
-                if managed_only:
-                list = self.getSession().query(Nodesview.node).filter(Nodesview.managed=True)
-                else:
+            if managed_only:
+                list = self.getSession().query(Nodesview.node).filter(Nodesview.managed == True)
+            else:
                 list = self.getSession().query(Nodesview.node)
 
             for i in preload:
@@ -295,11 +297,11 @@ class DatabaseHelper(rocks.db.database.Database):
 
         arghostname = hostname 
 
-        if hostname:
-            matchhost = session.query(Nodes.name).\
-             filters(func.lower(Nodes.name) = '%s' % hostname.lower())
+        if hostname and self.conn:
+            matchhost = self._matchHost('SELECT name FROM nodes '
+                'WHERE lower(name) = :v', hostname.lower())
             if matchhost is not None:
-                return matchhost 
+                return matchhost
 
         if not hostname:                    
             hostname = socket.gethostname().split('.')[0]
@@ -339,28 +341,28 @@ class DatabaseHelper(rocks.db.database.Database):
                 addr = None
 
         if not addr and self.conn:
-            matchhost = session.query(Nodes.name).\
-             filters(func.lower(Nodes.name) = '%s' % hostname.lower())
+            matchhost = self._matchHost('SELECT name FROM nodes '
+                'WHERE lower(name) = :v', hostname.lower())
             if matchhost is not None:
-                return matchhost 
+                return matchhost
 
             #
             # see if this is a MAC address
             # lowercase mac address comparisons
             
-            matchhost = session.query(Netdevsview.node).\
-                    filters(func.lower(Netdevsview.mac) = '%s' % hostname.lower())
+            matchhost = self._matchHost('SELECT node FROM netdevsview '
+                'WHERE lower(mac) = :v', hostname.lower())
             if matchhost is not None:
-                return hostname
+                return matchhost
 
             #
             # see if this is a FQDN. 
             #
             n = hostname.split('.')
-            matchhost = session.query(Netdevsview.node).\
-                    filters(func.lower(Netdevsview.fqdn) = '%s' % hostname.lower())
+            matchhost = self._matchHost('SELECT node FROM netdevsview '
+                'WHERE lower(fqdn) = :v', hostname.lower())
             if matchhost is not None:
-                return hostname
+                return matchhost
 
             # Check if the hostname is a basename
             # and the FQDN is in /etc/hosts but
@@ -419,10 +421,27 @@ class DatabaseHelper(rocks.db.database.Database):
         # hostname is in the networks table.  This last
         # check handles the case where DNS is correct but
         # the IP address used is different.
-        matchhost = session.query(Netdevsview.node).\
-              filters(Netdevsview.addr) = '%s' % hostname)
-        if matchhost is not None:
-               return hostname
+        if self.conn:
+            matchhost = self._matchHost('SELECT node FROM netdevsview '
+                'WHERE addr = :v', addr)
+            if matchhost is None:
+                raise rocks.util.HostnotfoundException(
+                    'host "%s" is not in cluster' % hostname)
+            hostname = matchhost
+
+        return hostname
+
+
+    def _matchHost(self, query, value):
+        """
+        Returns the first column of the first row of query, where
+        :v is value, or None if there is no row.
+        """
+        row = self.conn.execute(sqlalchemy.text(query),
+            { 'v': value }).fetchone()
+        if row is None:
+            return None
+        return row[0]
 
     def checkHostnameValidity(self, hostname):
         """
@@ -507,39 +526,20 @@ class DatabaseHelper(rocks.db.database.Database):
              and the key is the value
         """
 
-        session = self.getSession()
-
-        ### This is a seemingly complicated SELECT
-        ### 1. Expand all global attrs for the node
-        ### 2. Get node-specific attrs
-        ### 3. Get appliance specific 
-        ### 4. Get generic group-level 
-        ### In can be constructed to resolve attribute 
-        ###      "MAX(r.level) as level" with the GROUP BY clause  will get resolved
-        ###      r.level will get all attributes for a node at all levels
-
-        commonSelect = "SELECT n.name AS node, a.attr, a.value, a.shadow, r.resname, r.level FROM "
-        clauseGlobal = "nodes n INNER JOIN attrs a INNER JOIN reslevels r "
-        clauseGlobal += "WHERE a.reslevel=r.id AND r.resname='global' AND n.name='%s' "
-        clauseNode ="nodes n INNER JOIN attrs a ON n.reslevel=a.reslevel "
-        clauseNode +="INNER JOIN reslevels r ON a.reslevel=r.id WHERE n.name = a.reskey AND n.name='%s' "
-        clauseAppliance = "nodes n INNER JOIN appliances ap ON n.appliance=ap.id INNER JOIN attrs a "
-        clauseAppliance += "ON ap.reslevel=a.reslevel INNER JOIN reslevels r ON a.reslevel=r.id "
-        clauseAppliance += "WHERE ap.name = a.reskey AND n.name='%s'"
-        groupSelect = "SELECT r.node,a.attr,a.value,a.shadow,r.resname, r.level FROM "
-        clauseGroup = "groupmembersview r INNER JOIN attrsview a ON r.resname=a.resname "
-        clauseGroup += "WHERE r.reskey = a.reskey and r.node = '%s'"
-
-
         if isinstance(hostname, str):
             nhostname = self.getHostname(hostname)
-        elif isinstance(hostname, Nodes):
+        elif hasattr(hostname, 'name'):
             nhostname = self.getHostname(hostname.name)
         else:
-            assert False, "hostname must be either a string with a hostname or a Nodes"
+            assert False, "hostname must be either a string with a hostname or a node"
 
         # Get a reference to the node we're talking about
-        node = session.query(Nodesview).query(Nodeview.node == '%s' % nhostname).one()
+        node = self.conn.execute(sqlalchemy.text('SELECT rack, rank, '
+            'appliance FROM nodesview WHERE node = :v'),
+            { 'v': nhostname }).fetchone()
+        if node is None:
+            raise rocks.util.HostnotfoundException(
+                'host "%s" is not in cluster' % nhostname)
 
         attrs = {}
         # Get the internal attributes
@@ -555,20 +555,8 @@ class DatabaseHelper(rocks.db.database.Database):
             attrs['rank']        = str(node.rank)
             attrs['appliance']    = node.appliance
 
-        # Construct the query
-       cselect = commonSelect
-       gselect = groupSelect
-
-       allhostattrsQ = " UNION ". join( [cselect + clauseGlobal % nhostname,
-          cselect + clauseNode % nhostname, cselect + clauseAppliance % nhostname, gselect + clauseGroup % nhostname ] )
-       attrquery = "SELECT node,attr,value,shadow,resname,MAX(level) from (%s) GROUP BY node,attr;" % allhostattrsQ
-
-        for (host, attr, value, shadow, restype, level) in self.conn.execute(text(attrquery)):
-                host=hostname):
-            if showsource:
-                attrs[attr]     = (value, restype)
-            else:
-                attrs[attr]     = value
+        resolver = rocks.db.resolver.AttrResolver(self.conn.connection)
+        attrs.update(resolver.resolve([nhostname], showsource)[nhostname])
 
         # TODO cache attributes tables for speed
         # self._cacheAttrs[node.name] = attrs
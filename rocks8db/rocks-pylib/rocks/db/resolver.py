@@ -0,0 +1,227 @@
+#! /opt/rocks/bin/python
+#
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+# @Copyright@
+#
+
+"""
+Attribute resolution on the resolution level schema.
+
+An attribute row says what it applies to with (reslevel, resid): the
+level from the reslevels table and the ID of the node, appliance or
+nodegroup (the rack number for rack, 0 for global).  A host selects
+one key per level, its global, appliance, rack, groups and node
+entries, and the value of a higher level replaces the value of a lower
+one.  Every selection is an integer lookup on the unq_attrs index, no
+names are compared and no view is joined.
+
+Nothing is keyed on a graph yet, so the graph level is not resolved.
+"""
+
+# the levels a host selects, see AttrResolver.selections
+SELECTIONS = [ 'global', 'appliance', 'rack', 'groups', 'node' ]
+
+# above this many hosts the whole attrs table is read once
+BULK = 100
+
+
+class AttrResolver(object):
+    """
+    Resolves the attributes of the hosts in a rocks8 database, conn is
+    a DB-API connection to it (sqlite3, or Database.conn.connection).
+
+    Usage Example::
+
+      resolver = AttrResolver(sqlite3.connect('rocks8.db'))
+      attrs = resolver.resolve(['compute-0-0'])['compute-0-0']
+      cluster = resolver.resolve()
+    """
+
+    def __init__(self, conn):
+        self.conn = conn
+        # resname -> (reslevel, level)
+        self.levels = {}
+        # reslevel -> resname
+        self.names = {}
+        for (id, resname, level) in \
+                self._rows('SELECT ID, resname, level FROM reslevels'):
+            self.levels[resname] = (id, level)
+            self.names[id] = resname
+
+
+    def _rows(self, query, args=()):
+        cursor = self.conn.cursor()
+        cursor.execute(query, args)
+        rows = cursor.fetchall()
+        cursor.close()
+        return rows
+
+
+    def selections(self, id, appliance, rack, groups):
+        """
+        The (reslevel, resid) keys a host selects, lowest level first.
+
+        :type id: int
+        :param id: nodes.ID of the host
+
+        :type groups: list
+        :param groups: the nodegroups.ID of the groups of the host
+        """
+        resids = { 'global': [ 0 ], 'appliance': [ appliance ],
+            'rack': [ rack ], 'groups': groups, 'node': [ id ] }
+        selected = []
+        for resname in SELECTIONS:
+            if resname not in self.levels:
+                continue
+            (reslevel, level) = self.levels[resname]
+            for resid in resids[resname]:
+                if resid is not None:
+                    selected.append((level, reslevel, resid))
+        selected.sort()
+        return [ (reslevel, resid) for (level, reslevel, resid) in selected ]
+
+
+    def _hosts(self, names):
+        """(ID, name, appliance, rack) of the hosts and their groups."""
+        query = 'SELECT ID, name, appliance, rack FROM nodes'
+        if names is not None and len(names) <= BULK:
+            if not names:
+                return ([], {})
+            query += ' WHERE name IN (%s)' % ','.join('?' * len(names))
+            hosts = self._rows(query, names)
+        else:
+            hosts = self._rows(query)
+            if names is not None:
+                wanted = set(names)
+                hosts = [ h for h in hosts if h[1] in wanted ]
+
+        query = 'SELECT nodeid, nodegroup FROM groupmembers'
+        if len(hosts) <= BULK:
+            ids = [ h[0] for h in hosts ]
+            query += ' WHERE nodeid IN (%s)' % ','.join('?' * len(ids))
+            members = self._rows(query, ids)
+        else:
+            members = self._rows(query)
+        groups = {}
+        for (nodeid, nodegroup) in members:
+            groups.setdefault(nodeid, []).append(nodegroup)
+        for g in groups.values():
+            g.sort()
+        return (hosts, groups)
+
+
+    def _table(self):
+        """All the attributes by (reslevel, resid)."""
+        table = {}
+        for (attr, value, reslevel, resid) in \
+                self._rows('SELECT attr, value, reslevel, resid FROM attrs'):
+            table.setdefault((reslevel, resid), []).append((attr, value))
+        return table
+
+
+    def resolve(self, names=None, showsource=False):
+        """
+        Returns a dictionary with the hostname as key and the resolved
+        attributes of the host ({attr: value}) as value.
+
+        :type names: list
+        :param names: the hostnames, all the hosts if None
+
+        :type showsource: bool
+        :param showsource: if true the values are tuples of the value
+                   and the resname of the level it comes from
+        """
+        (hosts, groups) = self._hosts(names)
+
+        if len(hosts) > BULK:
+            table = self._table()
+            lookup = lambda key: table.get(key, ())
+        else:
+            cache = {}
+            def lookup(key):
+                if key not in cache:
+                    cache[key] = self._rows('SELECT attr, value FROM attrs '
+                        'WHERE reslevel = ? AND resid = ?', key)
+                return cache[key]
+
+        node = self.levels.get('node', (None, None))[0]
+        # hosts of an appliance and rack share everything below the
+        # node level, it is merged once for all of them
+        shared = {}
+        result = {}
+        for (id, name, appliance, rack) in hosts:
+            selected = self.selections(id, appliance, rack,
+                groups.get(id, []))
+            i = len(selected)
+            while i > 0 and selected[i - 1][0] == node:
+                i = i - 1
+            prefix = tuple(selected[:i])
+            if prefix not in shared:
+                shared[prefix] = self._merge({}, prefix, lookup,
+                    showsource)
+            result[name] = self._merge(dict(shared[prefix]),
+                selected[i:], lookup, showsource)
+        return result
+
+
+    def _merge(self, attrs, selected, lookup, showsource):
+        for key in selected:
+            if showsource:
+                resname = self.names[key[0]]
+                for (attr, value) in lookup(key):
+                    attrs[attr] = (value, resname)
+            else:
+                for (attr, value) in lookup(key):
+                    attrs[attr] = value
+        return attrs
@@ -1,14 +1,34 @@
-#!/usr/bin/env python
+#! @PYTHON@
 import sys
 import subprocess
 import os.path
+import stat
+
+try:
+	import _librocks
+except ImportError:
+	_librocks = None
 
 isoname=sys.argv[1]
+ignore = ['.','..','TRANS.TBL','.discinfo']
+
+# read the image directly when librocks is there, isoinfo otherwise
+if _librocks:
+	try:
+		image = _librocks.ISOImage(isoname)
+	except OSError, e:
+		sys.stderr.write('%s: %s\n' % (isoname, e.strerror))
+		sys.exit(1)
+	for (path, mode, size, mtime, target) in image.entries():
+		if not stat.S_ISDIR(mode) and \
+			os.path.basename(path) not in ignore:
+			print '/' + path
+	sys.exit(0)
+
 cmd = ['isoinfo','-l','-R','-i', isoname]
 p = subprocess.Popen(cmd,stdout=subprocess.PIPE)
 p.wait
 lines = p.stdout.readlines()
-ignore = ['.','..','TRANS.TBL','.discinfo']
 
 files = []
 curdir = None
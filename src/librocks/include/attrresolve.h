@@ -0,0 +1,115 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#ifndef _ROCKS_ATTRRESOLVE_H_
+#define _ROCKS_ATTRRESOLVE_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * In-memory attribute resolver.
+ *
+ * The categories, resolvechain, catindex and attributes tables are
+ * loaded once (one Add call per row), AttrResolverBuild() indexes them,
+ * and then the attributes of any number of hosts can be resolved
+ * without going back to the database.  Resolution follows the
+ * sql_attribute_query in rocks.db.helper: a host selects the global,
+ * os, appliance and host category indices by name and for every
+ * attribute the value from the category with the highest resolvechain
+ * precedence wins, between equal precedences the one with the higher
+ * categories.ID.  Catindex and attribute names compare as in MySQL,
+ * without case and trailing spaces; a result carries the attribute name
+ * as spelled in the row that won.
+ *
+ * All strings are interned, results refer to them by id.
+ */
+
+typedef struct AttrResolver AttrResolver;
+
+typedef struct {
+	int	attr;		/* string id of the attribute name */
+	int	value;		/* string id of the value, -1 for NULL */
+	int	source;		/* source letter, e.g. 'G' or 'H' */
+} AttrResolved;
+
+	AttrResolver *AttrResolverCreate(void);
+	void	AttrResolverDestroy(AttrResolver *r);
+
+	int	AttrResolverAddCategory(AttrResolver *r, int id, const char *name);
+	int	AttrResolverAddChain(AttrResolver *r, int category, int precedence);
+	int	AttrResolverAddCatindex(AttrResolver *r, int id, int category,
+			const char *name);
+	int	AttrResolverAddAttr(AttrResolver *r, const char *attr,
+			const char *value, int category, int catindex);
+	int	AttrResolverBuild(AttrResolver *r);
+
+	int	AttrResolverResolve(AttrResolver *r, const char *host,
+			const char *os, const char *appliance,
+			const AttrResolved **results);
+
+	const char *AttrResolverString(AttrResolver *r, int id);
+	int	AttrResolverStringCount(AttrResolver *r);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ROCKS_ATTRRESOLVE_H_ */
@@ -0,0 +1,126 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#ifndef _ROCKS_DIRSCAN_H_
+#define _ROCKS_DIRSCAN_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Parallel directory tree scanner.
+ *
+ * Walks a tree with a pool of threads and records, for every directory,
+ * the non-directory entries with their timestamp and size, following
+ * the rules of rocks.file.Tree.build and rocks.file.File.setFile:
+ *
+ *	- real directories are descended into, symbolic links to
+ *	  directories are entries like any other file
+ *	- a symbolic link gets the mtime of its target as read with
+ *	  readlink() (relative targets are relative to the current
+ *	  directory, as os.path.isfile(os.readlink(f)) would see them),
+ *	  or 0/0 if that target is not a regular file
+ *	- unreadable directories are recorded with no entries
+ */
+
+#define DIRSCAN_FILE	0
+#define DIRSCAN_RPM	1	/* *.rpm */
+#define DIRSCAN_ROLL	2	/* roll-*.iso */
+
+typedef struct {
+	const char	*name;
+	int		kind;
+	double		mtime;
+	long long	size;
+} DirScanEntry;
+
+typedef struct {
+	const char	*path;		/* relative to the root, "" for the root */
+	DirScanEntry	*entries;
+	int		nentries;
+} DirScanDir;
+
+typedef struct DirScan DirScan;
+
+	DirScan	*DirScanRun(const char *root, int nthreads);
+	int	DirScanCount(DirScan *scan);
+	const DirScanDir *DirScanGet(DirScan *scan, int i);
+	void	DirScanFree(DirScan *scan);
+
+
+/*
+ * Components of a package file name, name-version-release.arch.rpm,
+ * as offsets and lengths into the name.  ext is the number of trailing
+ * extensions, 1 for RPMs and 2 for roll ISOs (.diskN.iso).
+ */
+typedef struct {
+	int	name, name_len;
+	int	version, version_len;
+	int	release, release_len;
+	int	arch, arch_len;
+} RPMName;
+
+	void	RPMNameParse(const char *filename, int ext, RPMName *out);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ROCKS_DIRSCAN_H_ */
@@ -72,14 +72,43 @@
 #ifndef _ROCKS_HEXDUMP_H_
 #define _ROCKS_HEXDUMP_H_
  
+#include <stdio.h>
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/*
+ * Formatting engines.  HEXDUMP_ENGINE_AUTO picks the fastest engine the
+ * running CPU supports.  All engines produce byte-identical output.
+ */
+#define HEXDUMP_ENGINE_AUTO	0
+#define HEXDUMP_ENGINE_SCALAR	1
+#define HEXDUMP_ENGINE_SSE2	2
+#define HEXDUMP_ENGINE_AVX2	3
+
+/*
+ * Output sink for HexDumpStream.  Called once per formatted block,
+ * returns 0 on success and non-zero to abort the dump.
+ */
+typedef int (*HexDumpWriter)(void *arg, const char *buf, size_t len);
+
 	void  HexDump(const char *label, const char *msg, int len);
 	void  HexDumpToFile(FILE *fout, const char *label, const char *msg, int len);
 	char *HexDumpToString(const char *label, const char *msg, int len);
 
+	size_t HexDumpBufferSize(const char *label, size_t len);
+	size_t HexDumpToBuffer(char *buf, size_t size, const char *label,
+		const char *msg, size_t len);
+	int   HexDumpStream(HexDumpWriter writer, void *arg, const char *label,
+		const char *msg, size_t len);
+	int   HexDumpToFd(int fd, const char *label, const char *msg, size_t len);
+
+	int   HexDumpSetEngine(int engine);
+	int   HexDumpGetEngine(void);
+	const char *HexDumpEngineName(int engine);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,131 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#ifndef _ROCKS_ISOREAD_H_
+#define _ROCKS_ISOREAD_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ISO9660 image reader.
+ *
+ * Reads the directory tree of an ISO image with the Rock Ridge or,
+ * failing that, the Joliet extensions, and copies files out of it
+ * with plain reads so adding a roll does not need a loop mount (or
+ * root).  Names and modes are what a Linux mount of the image shows:
+ * Rock Ridge names and modes when present, Joliet names otherwise,
+ * and lower case ISO9660 names without the ";1" version as a last
+ * resort.  An image with a name that is not a single path component
+ * (empty, ".", ".." or with a "/") is refused with EINVAL.
+ */
+
+#define ISO_ROCKRIDGE	0x01
+#define ISO_JOLIET	0x02
+
+typedef struct {
+	unsigned int	block;		/* 2048 byte logical block */
+	unsigned int	size;
+} ISOExtent;
+
+typedef struct {
+	const char	*path;		/* relative to the root, no leading / */
+	const char	*name;		/* last component of path */
+	int		mode;		/* st_mode, type and permissions */
+	long long	size;
+	long		mtime;
+	const char	*target;	/* symbolic link target or NULL */
+	ISOExtent	*extents;
+	int		nextents;
+} ISOEntry;
+
+typedef struct ISOImage ISOImage;
+
+	ISOImage	*ISOOpen(const char *path);
+	void		ISOClose(ISOImage *iso);
+	int		ISOFlags(const ISOImage *iso);
+	int		ISOEntryCount(const ISOImage *iso);
+	const ISOEntry	*ISOEntryGet(const ISOImage *iso, int i);
+	const ISOEntry	*ISOLookup(const ISOImage *iso, const char *path);
+	long long	ISORead(const ISOImage *iso, const ISOEntry *entry,
+				void *buf, size_t len, long long offset);
+
+/*
+ * Copies the subtree subdir ("" for everything) of an image under
+ * dest, like "cd subdir; find . | cpio -mpud dest" would: existing
+ * files are replaced, modification times are kept and TRANS.TBL files
+ * are skipped.  Directories are also made readable and searchable by
+ * everybody (a+rx).  Nothing under dest is written through a symlink.
+ */
+typedef struct {
+	ISOImage	*image;
+	const char	*subdir;
+	const char	*dest;
+	int		status;		/* 0 or -1 */
+	char		error[256];
+} ISOExtractJob;
+
+	int	ISOExtractMany(ISOExtractJob *jobs, int njobs, int nthreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ROCKS_ISOREAD_H_ */
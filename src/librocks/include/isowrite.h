@@ -0,0 +1,119 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#ifndef _ROCKS_ISOWRITE_H_
+#define _ROCKS_ISOWRITE_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * ISO9660 image writer.
+ *
+ * Lays out a directory tree as an image the way "mkisofs -R -f -T"
+ * does and writes it in one sequential pass: symbolic links are
+ * followed, names are 8.3 ISO9660 names with the real names in Rock
+ * Ridge (and optionally Joliet) records, and every directory gets a
+ * TRANS.TBL.  In the same pass it can
+ *
+ *	- make the image bootable with El Torito, a no emulation BIOS
+ *	  image with a boot info table and an optional EFI image
+ *	  (-b, -c, -boot-load-size, -boot-info-table, -e)
+ *	- write an isohybrid MBR into the system area, from a syslinux
+ *	  isohdpfx.bin template, so the image also boots from a USB disk
+ *	- implant the checksum anaconda verifies, as implantisomd5
+ *	  --supported-iso does
+ *
+ * Directories deeper than ISO9660 allows (8 levels) and files of 4GB
+ * or more are not supported; ISOWrite fails and the caller is
+ * expected to fall back to mkisofs.
+ */
+
+#define ISOWRITE_ROCKRIDGE	0x01	/* -R */
+#define ISOWRITE_RATIONALIZE	0x02	/* -r: 0444/0555 modes, owner root */
+#define ISOWRITE_JOLIET		0x04	/* -J */
+#define ISOWRITE_TRANSTBL	0x08	/* -T */
+#define ISOWRITE_MD5		0x10	/* implantisomd5 --supported-iso */
+#define ISOWRITE_HYBRID		0x20	/* isohybrid, needs boot and mbr */
+
+typedef struct {
+	const char	*root;		/* directory to put on the image */
+	const char	*output;
+	const char	*volume;	/* volume id, at most 32 characters */
+	int		flags;
+	const char	*boot;		/* BIOS boot image, relative to root */
+	const char	*catalog;	/* boot catalog, relative to root */
+	int		load_size;	/* 512 byte sectors, 0 means 4 */
+	int		info_table;
+	const char	*efi;		/* EFI boot image, relative to root */
+	const char	*mbr;		/* isohybrid MBR template */
+	int		status;		/* 0 or -1 */
+	char		error[256];
+	char		md5[33];	/* the implanted checksum */
+} ISOWriteJob;
+
+	int	ISOWrite(ISOWriteJob *job);
+	int	ISOWriteMany(ISOWriteJob *jobs, int njobs, int nthreads);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ROCKS_ISOWRITE_H_ */
@@ -0,0 +1,115 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#ifndef _ROCKS_ROCKSD_H_
+#define _ROCKS_ROCKSD_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * rocksd client and wire protocol.
+ *
+ * rocksd keeps the rocks command line loaded, so a "rocks ..." does
+ * not have to start python, import the commands and connect to the
+ * database every time.  The client hands the daemon its stdin,
+ * stdout and stderr (SCM_RIGHTS), working directory, umask, argv and
+ * environment, then waits for the exit status.  Signals the client
+ * gets while it waits (^C) are passed on as a byte on the socket.
+ *
+ *	request	"RKD1" LE32 length, fds 0-2 attached to the first byte
+ *		cwd \0 umask \0 argc \0 argv... \0 environ... \0
+ *	reply	"RKDX" LE32 status		command ran
+ *		"RKDF" LE32 0			not run, run it yourself
+ *
+ * RocksdCall returns 0 with the exit status of the command,
+ * ROCKSD_FALLBACK when the command did not run (no daemon, or the
+ * daemon wants the caller to run it, e.g. for sudo), and ROCKSD_LOST
+ * when the daemon went away while the command was running.
+ */
+
+#define ROCKSD_SOCKET		"/var/run/rocksd.sock"
+#define ROCKSD_MAGIC		"RKD1"
+#define ROCKSD_STATUS		"RKDX"
+#define ROCKSD_RUNIT		"RKDF"
+#define ROCKSD_HEADER		8
+
+#define ROCKSD_FALLBACK		1
+#define ROCKSD_LOST		-1
+
+	int	RocksdCall(const char *path, int argc, char * const *argv,
+			char * const *envp, int *status);
+
+/*
+ * Messages with file descriptors attached, for the daemon.  RecvFds
+ * returns the number of bytes read (0 at end of file) and closes any
+ * descriptors beyond maxfds.
+ */
+	int	RocksdSendFds(int sock, const void *buf, size_t len,
+			const int *fds, int nfds);
+	ssize_t	RocksdRecvFds(int sock, void *buf, size_t len, int *fds,
+			int maxfds, int *nfds);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ROCKS_ROCKSD_H_ */
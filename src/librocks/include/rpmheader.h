@@ -0,0 +1,146 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#ifndef _ROCKS_RPMHEADER_H_
+#define _ROCKS_RPMHEADER_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * RPM package header reader.
+ *
+ * Reads the lead, the signature header and the main header of a
+ * package file without rpmlib, which is enough to answer the
+ * "rpm -qp --qf" queries the build code makes (name, prefixes,
+ * buildhost, sigmd5, ...) without forking rpm for every package.
+ * Nothing past the header is read; RPMHeaderPayloadOffset() tells
+ * where the compressed payload starts.
+ */
+
+/* main header tags */
+#define RPMTAG_SIGMD5			261
+#define RPMTAG_NAME			1000
+#define RPMTAG_VERSION			1001
+#define RPMTAG_RELEASE			1002
+#define RPMTAG_EPOCH			1003
+#define RPMTAG_SUMMARY			1004
+#define RPMTAG_BUILDTIME		1006
+#define RPMTAG_BUILDHOST		1007
+#define RPMTAG_SIZE			1009
+#define RPMTAG_OS			1021
+#define RPMTAG_ARCH			1022
+#define RPMTAG_PREIN			1023
+#define RPMTAG_POSTIN			1024
+#define RPMTAG_SOURCERPM		1044
+#define RPMTAG_PREFIXES			1098
+#define RPMTAG_PAYLOADFORMAT		1124
+#define RPMTAG_PAYLOADCOMPRESSOR	1125
+#define RPMTAG_PRETRANS			1151
+#define RPMTAG_POSTTRANS		1152
+
+/* signature header tags */
+#define RPMSIGTAG_SIZE			1000
+#define RPMSIGTAG_MD5			1004
+
+/* tag data types */
+#define RPM_NULL_TYPE			0
+#define RPM_CHAR_TYPE			1
+#define RPM_INT8_TYPE			2
+#define RPM_INT16_TYPE			3
+#define RPM_INT32_TYPE			4
+#define RPM_INT64_TYPE			5
+#define RPM_STRING_TYPE			6
+#define RPM_BIN_TYPE			7
+#define RPM_STRING_ARRAY_TYPE		8
+#define RPM_I18NSTRING_TYPE		9
+
+#define RPMHEADER_MAIN			0
+#define RPMHEADER_SIGNATURE		1
+
+typedef struct {
+	int		tag;
+	int		type;
+	int		count;
+	const void	*data;	/* numbers are big endian */
+	size_t		size;	/* bytes of data */
+} RPMTagEntry;
+
+typedef struct RPMHeader RPMHeader;
+
+	RPMHeader	*RPMHeaderRead(const char *path);
+	RPMHeader	*RPMHeaderReadFd(int fd);
+	void		RPMHeaderFree(RPMHeader *h);
+
+	int		RPMHeaderGet(const RPMHeader *h, int which, int tag,
+				RPMTagEntry *entry);
+	const char	*RPMHeaderString(const RPMHeader *h, int tag);
+	int		RPMHeaderStrings(const RPMHeader *h, int tag,
+				const char **strs, int max);
+	long long	RPMHeaderInt(const RPMHeader *h, int tag,
+				long long missing);
+	int		RPMHeaderSigMD5(const RPMHeader *h, char hex[33]);
+	long long	RPMHeaderPayloadOffset(const RPMHeader *h);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* _ROCKS_RPMHEADER_H_ */
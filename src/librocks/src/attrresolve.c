@@ -0,0 +1,679 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include "../include/attrresolve.h"
+
+/*
+ * Hash tables are open addressed with linear probing and are always
+ * kept at most half full.
+ */
+
+struct strtab {
+	char		**strs;
+	unsigned int	*hashes;
+	int		count;
+	int		cap;
+	int		*slots;		/* string id + 1, 0 is empty */
+	unsigned int	nslots;
+	int		fold;		/* compare as MySQL does, see pad_length */
+};
+
+struct intmap {
+	uint64_t	*keys;
+	int		*values;	/* value + 1, 0 is empty */
+	unsigned int	nslots;
+	int		count;
+};
+
+struct category {
+	int	id;
+	int	precedence;
+	int	has_chain;
+	int	source;
+};
+
+struct attrrow {
+	uint64_t	bucket;		/* category << 32 | catindex name */
+	int		key;		/* attribute name, case folded */
+	int		attr;		/* attribute name as spelled in the row */
+	int		value;
+};
+
+/* the categories selected by every host, see the hostselections view */
+enum { SEL_GLOBAL, SEL_OS, SEL_APPLIANCE, SEL_HOST, SEL_COUNT };
+static const char *selectors[SEL_COUNT] = { "global", "os", "appliance", "host" };
+
+struct AttrResolver {
+	struct strtab	strings;	/* attribute names and values */
+	struct strtab	names;		/* catindex names, case folded */
+	struct strtab	keys;		/* attribute names, case folded */
+
+	struct category	*cats;
+	int		ncats;
+	int		capcats;
+	struct intmap	catmap;		/* categories.ID -> cats[] */
+	struct intmap	cimap;		/* catindex.ID -> names id */
+	int		sel[SEL_COUNT];	/* cats[] index or -1 */
+
+	struct attrrow	*rows;
+	int		nrows;
+	int		caprows;
+	struct intmap	buckets;	/* bucket -> first row */
+
+	/* per resolve scratch, indexed by attribute key */
+	unsigned int	*stamp;
+	unsigned int	generation;
+	int		*pos;
+	int		*prec;
+	int		*catid;		/* categories.ID of the current value */
+	AttrResolved	*out;
+	int		built;
+};
+
+
+/*
+ * MySQL compares names in a case insensitive collation that pads with
+ * spaces, "Compute " equals "compute".  Folded strings are hashed and
+ * compared up to their last non space character.
+ */
+static size_t
+pad_length(const char *s, int fold)
+{
+	size_t	n = strlen(s);
+
+	while ( fold && n > 0 && s[n - 1] == ' ' ) {
+		n--;
+	}
+	return n;
+}
+
+static unsigned int
+hash_string(const char *s, int fold)
+{
+	unsigned int	h = 2166136261u;
+	const char	*end = s + pad_length(s, fold);
+
+	for ( ; s < end; s++ ) {
+		unsigned char	c = *s;
+
+		if ( fold && c >= 'A' && c <= 'Z' ) {
+			c += 'a' - 'A';
+		}
+		h = (h ^ c) * 16777619u;
+	}
+	return h;
+}
+
+static unsigned int
+hash_int(uint64_t k)
+{
+	k ^= k >> 33;
+	k *= 0xff51afd7ed558ccdULL;
+	k ^= k >> 33;
+	return (unsigned int)k;
+}
+
+static int
+string_equal(const char *a, const char *b, int fold)
+{
+	size_t	na, nb, i;
+
+	if ( !fold ) {
+		return strcmp(a, b) == 0;
+	}
+	na = pad_length(a, fold);
+	nb = pad_length(b, fold);
+	if ( na != nb ) {
+		return 0;
+	}
+	for ( i = 0; i < na; i++ ) {
+		unsigned char	x = a[i], y = b[i];
+
+		if ( x >= 'A' && x <= 'Z' ) x += 'a' - 'A';
+		if ( y >= 'A' && y <= 'Z' ) y += 'a' - 'A';
+		if ( x != y ) {
+			return 0;
+		}
+	}
+	return 1;
+}
+
+
+static int
+strtab_grow(struct strtab *t)
+{
+	unsigned int	nslots = t->nslots ? t->nslots * 2 : 256;
+	int		*slots;
+	int		i;
+
+	slots = calloc(nslots, sizeof(int));
+	if ( !slots ) {
+		return -1;
+	}
+	for ( i = 0; i < t->count; i++ ) {
+		unsigned int	s = t->hashes[i] & (nslots - 1);
+
+		while ( slots[s] ) {
+			s = (s + 1) & (nslots - 1);
+		}
+		slots[s] = i + 1;
+	}
+	free(t->slots);
+	t->slots  = slots;
+	t->nslots = nslots;
+	return 0;
+}
+
+static int
+strtab_find(struct strtab *t, const char *s, unsigned int h)
+{
+	unsigned int	i;
+
+	if ( !t->nslots ) {
+		return -1;
+	}
+	for ( i = h & (t->nslots - 1); t->slots[i];
+		i = (i + 1) & (t->nslots - 1) ) {
+		int	id = t->slots[i] - 1;
+
+		if ( t->hashes[id] == h && string_equal(t->strs[id], s, t->fold) ) {
+			return id;
+		}
+	}
+	return -1;
+}
+
+static int
+strtab_lookup(struct strtab *t, const char *s)
+{
+	return strtab_find(t, s, hash_string(s, t->fold));
+}
+
+static int
+strtab_intern(struct strtab *t, const char *s)
+{
+	unsigned int	h = hash_string(s, t->fold);
+	unsigned int	i;
+	int		id;
+
+	id = strtab_find(t, s, h);
+	if ( id >= 0 ) {
+		return id;
+	}
+
+	if ( (unsigned int)(t->count + 1) * 2 > t->nslots && strtab_grow(t) ) {
+		return -1;
+	}
+	if ( t->count == t->cap ) {
+		int		cap = t->cap ? t->cap * 2 : 256;
+		char		**strs;
+		unsigned int	*hashes;
+
+		strs = realloc(t->strs, cap * sizeof(char *));
+		if ( !strs ) {
+			return -1;
+		}
+		t->strs = strs;
+		hashes = realloc(t->hashes, cap * sizeof(unsigned int));
+		if ( !hashes ) {
+			return -1;
+		}
+		t->hashes = hashes;
+		t->cap = cap;
+	}
+
+	id = t->count;
+	t->strs[id] = strdup(s);
+	if ( !t->strs[id] ) {
+		return -1;
+	}
+	t->hashes[id] = h;
+	t->count++;
+
+	for ( i = h & (t->nslots - 1); t->slots[i]; i = (i + 1) & (t->nslots - 1) )
+		;
+	t->slots[i] = id + 1;
+	return id;
+}
+
+static void
+strtab_free(struct strtab *t)
+{
+	int	i;
+
+	for ( i = 0; i < t->count; i++ ) {
+		free(t->strs[i]);
+	}
+	free(t->strs);
+	free(t->hashes);
+	free(t->slots);
+}
+
+
+static int
+intmap_get(struct intmap *m, uint64_t key)
+{
+	unsigned int	i;
+
+	if ( !m->nslots ) {
+		return -1;
+	}
+	for ( i = hash_int(key) & (m->nslots - 1); m->values[i];
+		i = (i + 1) & (m->nslots - 1) ) {
+		if ( m->keys[i] == key ) {
+			return m->values[i] - 1;
+		}
+	}
+	return -1;
+}
+
+static int
+intmap_put(struct intmap *m, uint64_t key, int value)
+{
+	unsigned int	i;
+
+	if ( (unsigned int)(m->count + 1) * 2 > m->nslots ) {
+		struct intmap	bigger;
+		unsigned int	j;
+
+		bigger.nslots = m->nslots ? m->nslots * 2 : 64;
+		bigger.count  = 0;
+		bigger.keys   = calloc(bigger.nslots, sizeof(uint64_t));
+		bigger.values = calloc(bigger.nslots, sizeof(int));
+		if ( !bigger.keys || !bigger.values ) {
+			free(bigger.keys);
+			free(bigger.values);
+			return -1;
+		}
+		for ( j = 0; j < m->nslots; j++ ) {
+			if ( m->values[j] ) {
+				intmap_put(&bigger, m->keys[j], m->values[j] - 1);
+			}
+		}
+		free(m->keys);
+		free(m->values);
+		*m = bigger;
+	}
+
+	for ( i = hash_int(key) & (m->nslots - 1); m->values[i];
+		i = (i + 1) & (m->nslots - 1) ) {
+		if ( m->keys[i] == key ) {
+			m->values[i] = value + 1;
+			return 0;
+		}
+	}
+	m->keys[i]   = key;
+	m->values[i] = value + 1;
+	m->count++;
+	return 0;
+}
+
+static void
+intmap_free(struct intmap *m)
+{
+	free(m->keys);
+	free(m->values);
+}
+
+
+AttrResolver *
+AttrResolverCreate(void)
+{
+	AttrResolver	*r;
+	int		i;
+
+	r = calloc(1, sizeof(AttrResolver));
+	if ( !r ) {
+		return NULL;
+	}
+	r->names.fold = 1;
+	r->keys.fold  = 1;
+	for ( i = 0; i < SEL_COUNT; i++ ) {
+		r->sel[i] = -1;
+	}
+	return r;
+} /* AttrResolverCreate */
+
+
+void
+AttrResolverDestroy(AttrResolver *r)
+{
+	if ( !r ) {
+		return;
+	}
+	strtab_free(&r->strings);
+	strtab_free(&r->names);
+	strtab_free(&r->keys);
+	intmap_free(&r->catmap);
+	intmap_free(&r->cimap);
+	intmap_free(&r->buckets);
+	free(r->cats);
+	free(r->rows);
+	free(r->stamp);
+	free(r->pos);
+	free(r->prec);
+	free(r->catid);
+	free(r->out);
+	free(r);
+} /* AttrResolverDestroy */
+
+
+/*
+ * Row loaders, one call per database row.  Categories and catindex rows
+ * must be added before the attributes that refer to them.  All return
+ * 0 on success, -1 when out of memory, and 1 for rows that can never
+ * take part in a resolution (they are dropped, as the SQL join would).
+ */
+
+int
+AttrResolverAddCategory(AttrResolver *r, int id, const char *name)
+{
+	struct category	*c;
+	int		i;
+
+	if ( r->ncats == r->capcats ) {
+		int	cap = r->capcats ? r->capcats * 2 : 16;
+
+		c = realloc(r->cats, cap * sizeof(struct category));
+		if ( !c ) {
+			return -1;
+		}
+		r->cats	   = c;
+		r->capcats = cap;
+	}
+
+	c = &r->cats[r->ncats];
+	c->id	      = id;
+	c->precedence = 0;
+	c->has_chain  = 0;
+	c->source     = (name[0] >= 'a' && name[0] <= 'z') ?
+				name[0] - ('a' - 'A') : name[0];
+	for ( i = 0; i < SEL_COUNT; i++ ) {
+		if ( string_equal(name, selectors[i], 1) ) {
+			r->sel[i] = r->ncats;
+		}
+	}
+	if ( intmap_put(&r->catmap, (uint64_t)(unsigned int)id, r->ncats) ) {
+		return -1;
+	}
+	r->ncats++;
+	return 0;
+} /* AttrResolverAddCategory */
+
+
+/*
+ * The attribute query does not restrict the chain name, so a category
+ * ranks at the highest precedence any chain gives it.
+ */
+int
+AttrResolverAddChain(AttrResolver *r, int category, int precedence)
+{
+	int	c = intmap_get(&r->catmap, (uint64_t)(unsigned int)category);
+
+	if ( c < 0 ) {
+		return 1;
+	}
+	if ( !r->cats[c].has_chain || precedence > r->cats[c].precedence ) {
+		r->cats[c].precedence = precedence;
+	}
+	r->cats[c].has_chain = 1;
+	return 0;
+} /* AttrResolverAddChain */
+
+
+/*
+ * The hostselections view matches category indices by name only, so
+ * the category of the catindex row is not needed to resolve.
+ */
+int
+AttrResolverAddCatindex(AttrResolver *r, int id, int category, const char *name)
+{
+	int	n;
+
+	n = strtab_intern(&r->names, name);
+	if ( n < 0 ) {
+		return -1;
+	}
+	return intmap_put(&r->cimap, (uint64_t)(unsigned int)id, n);
+} /* AttrResolverAddCatindex */
+
+
+int
+AttrResolverAddAttr(AttrResolver *r, const char *attr, const char *value,
+	int category, int catindex)
+{
+	struct attrrow	*row;
+	int		c, n;
+
+	c = intmap_get(&r->catmap, (uint64_t)(unsigned int)category);
+	n = intmap_get(&r->cimap, (uint64_t)(unsigned int)catindex);
+	if ( c < 0 || n < 0 ) {
+		return 1;
+	}
+
+	if ( r->nrows == r->caprows ) {
+		int	cap = r->caprows ? r->caprows * 2 : 1024;
+
+		row = realloc(r->rows, cap * sizeof(struct attrrow));
+		if ( !row ) {
+			return -1;
+		}
+		r->rows	   = row;
+		r->caprows = cap;
+	}
+
+	row = &r->rows[r->nrows];
+	row->bucket = ((uint64_t)c << 32) | (unsigned int)n;
+	row->key    = strtab_intern(&r->keys, attr);
+	row->attr   = strtab_intern(&r->strings, attr);
+	row->value  = value ? strtab_intern(&r->strings, value) : -1;
+	if ( row->key < 0 || row->attr < 0 || (value && row->value < 0) ) {
+		return -1;
+	}
+	r->nrows++;
+	r->built = 0;
+	return 0;
+} /* AttrResolverAddAttr */
+
+
+static int
+cmp_rows(const void *a, const void *b)
+{
+	const struct attrrow	*x = a;
+	const struct attrrow	*y = b;
+
+	if ( x->bucket != y->bucket ) {
+		return x->bucket < y->bucket ? -1 : 1;
+	}
+	return x->key - y->key;
+}
+
+
+/*
+ * Groups the attribute rows by (category, catindex name) so a host
+ * selection is a single lookup followed by a linear scan.
+ */
+int
+AttrResolverBuild(AttrResolver *r)
+{
+	int	n = r->keys.count ? r->keys.count : 1;
+	int	i;
+
+	qsort(r->rows, r->nrows, sizeof(struct attrrow), cmp_rows);
+
+	intmap_free(&r->buckets);
+	memset(&r->buckets, 0, sizeof(r->buckets));
+	for ( i = 0; i < r->nrows; i++ ) {
+		if ( i == 0 || r->rows[i].bucket != r->rows[i - 1].bucket ) {
+			if ( intmap_put(&r->buckets, r->rows[i].bucket, i) ) {
+				return -1;
+			}
+		}
+	}
+
+	free(r->stamp);
+	free(r->pos);
+	free(r->prec);
+	free(r->catid);
+	free(r->out);
+	r->stamp = calloc(n, sizeof(unsigned int));
+	r->pos	 = malloc(n * sizeof(int));
+	r->prec	 = malloc(n * sizeof(int));
+	r->catid = malloc(n * sizeof(int));
+	r->out	 = malloc(n * sizeof(AttrResolved));
+	if ( !r->stamp || !r->pos || !r->prec || !r->catid || !r->out ) {
+		return -1;
+	}
+	r->generation = 0;
+	r->built = 1;
+	return 0;
+} /* AttrResolverBuild */
+
+
+/*
+ * Resolves the attributes of one host.  On success *results points to
+ * an array, owned by the resolver and valid until the next call, and
+ * the number of entries is returned.  Returns -1 if the resolver has
+ * not been built.
+ */
+int
+AttrResolverResolve(AttrResolver *r, const char *host, const char *os,
+	const char *appliance, const AttrResolved **results)
+{
+	const char	*selection[SEL_COUNT];
+	int		count = 0;
+	int		s;
+
+	if ( !r->built ) {
+		return -1;
+	}
+
+	if ( ++r->generation == 0 ) {
+		memset(r->stamp, 0, r->keys.count * sizeof(unsigned int));
+		r->generation = 1;
+	}
+
+	selection[SEL_GLOBAL]	 = "global";
+	selection[SEL_OS]	 = os;
+	selection[SEL_APPLIANCE] = appliance;
+	selection[SEL_HOST]	 = host;
+
+	for ( s = 0; s < SEL_COUNT; s++ ) {
+		struct category	*cat;
+		int		c = r->sel[s];
+		int		name, i;
+
+		if ( c < 0 || !selection[s] || !r->cats[c].has_chain ) {
+			continue;
+		}
+		cat  = &r->cats[c];
+		name = strtab_lookup(&r->names, selection[s]);
+		if ( name < 0 ) {
+			continue;
+		}
+
+		i = intmap_get(&r->buckets, ((uint64_t)c << 32) | (unsigned int)name);
+		if ( i < 0 ) {
+			continue;
+		}
+
+		for ( ; i < r->nrows && r->rows[i].bucket ==
+			(((uint64_t)c << 32) | (unsigned int)name); i++ ) {
+			struct attrrow	*row = &r->rows[i];
+			AttrResolved	*res;
+
+			if ( r->stamp[row->key] != r->generation ) {
+				r->stamp[row->key] = r->generation;
+				r->pos[row->key]   = count++;
+			}
+			else if ( cat->precedence < r->prec[row->key] ||
+				(cat->precedence == r->prec[row->key] &&
+				cat->id < r->catid[row->key]) ) {
+				continue;
+			}
+			r->prec[row->key]  = cat->precedence;
+			r->catid[row->key] = cat->id;
+			res = &r->out[r->pos[row->key]];
+			res->attr   = row->attr;
+			res->value  = row->value;
+			res->source = cat->source;
+		}
+	}
+
+	*results = r->out;
+	return count;
+} /* AttrResolverResolve */
+
+
+const char *
+AttrResolverString(AttrResolver *r, int id)
+{
+	if ( id < 0 || id >= r->strings.count ) {
+		return NULL;
+	}
+	return r->strings.strs[id];
+} /* AttrResolverString */
+
+
+int
+AttrResolverStringCount(AttrResolver *r)
+{
+	return r->strings.count;
+} /* AttrResolverStringCount */
@@ -0,0 +1,171 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "../include/attrresolve.h"
+
+static int failed;
+
+static void
+check(AttrResolver *r, const char *host, const char *os, const char *app,
+	const char *attr, const char *value, int source)
+{
+	const AttrResolved	*res;
+	int			i, n;
+
+	n = AttrResolverResolve(r, host, os, app, &res);
+	for ( i = 0; i < n; i++ ) {
+		const char	*v = AttrResolverString(r, res[i].value);
+
+		if ( strcmp(AttrResolverString(r, res[i].attr), attr) ) {
+			continue;
+		}
+		if ( (value == NULL) != (v == NULL) ||
+			(value && strcmp(value, v)) || res[i].source != source ) {
+			break;
+		}
+		printf("ok   %s %s = %s (%c)\n", host, attr,
+			value ? value : "NULL", source);
+		return;
+	}
+	if ( i == n && !value && !source ) {
+		printf("ok   %s %s unset\n", host, attr);
+		return;
+	}
+	printf("FAIL %s %s\n", host, attr);
+	failed++;
+}
+
+int
+main(int argc, char *argv[])
+{
+	AttrResolver	*r = AttrResolverCreate();
+
+	AttrResolverAddCategory(r, 1, "global");
+	AttrResolverAddCategory(r, 2, "os");
+	AttrResolverAddCategory(r, 3, "appliance");
+	AttrResolverAddCategory(r, 4, "rack");
+	AttrResolverAddCategory(r, 5, "host");
+	AttrResolverAddChain(r, 1, 10);
+	AttrResolverAddChain(r, 2, 20);
+	AttrResolverAddChain(r, 3, 30);
+	AttrResolverAddChain(r, 5, 50);
+
+	AttrResolverAddCatindex(r, 1, 1, "global");
+	AttrResolverAddCatindex(r, 2, 2, "linux");
+	AttrResolverAddCatindex(r, 3, 3, "compute");
+	AttrResolverAddCatindex(r, 4, 4, "rack0");
+	AttrResolverAddCatindex(r, 5, 5, "compute-0-0");
+
+	AttrResolverAddAttr(r, "a", "global", 1, 1);
+	AttrResolverAddAttr(r, "a", "os", 2, 2);
+	AttrResolverAddAttr(r, "a", "host", 5, 5);
+	AttrResolverAddAttr(r, "b", "global", 1, 1);
+	AttrResolverAddAttr(r, "b", "appliance", 3, 3);
+	AttrResolverAddAttr(r, "c", NULL, 3, 3);
+	AttrResolverAddAttr(r, "d", "rack", 4, 4);	/* rack has no chain */
+	AttrResolverAddAttr(r, "e", "dangling", 5, 42);	/* no such catindex */
+	AttrResolverBuild(r);
+
+	check(r, "compute-0-0", "linux", "compute", "a", "host", 'H');
+	check(r, "compute-0-0", "linux", "compute", "b", "appliance", 'A');
+	check(r, "compute-0-0", "linux", "compute", "c", NULL, 'A');
+	check(r, "compute-0-0", "linux", "compute", "d", NULL, 0);
+	check(r, "COMPUTE-0-0", "Linux", "compute", "a", "host", 'H');
+	check(r, "compute-0-1", "linux", "frontend", "a", "os", 'O');
+	check(r, "compute-0-1", "linux", "frontend", "b", "global", 'G');
+	check(r, "compute-0-1", "sunos", "frontend", "a", "global", 'G');
+	check(r, "compute-0-1", NULL, NULL, "c", NULL, 0);
+
+	AttrResolverDestroy(r);
+
+	/*
+	 * MySQL: equal precedences go to the higher categories.ID, names
+	 * compare without case and trailing spaces.
+	 */
+	r = AttrResolverCreate();
+	AttrResolverAddCategory(r, 1, "global");
+	AttrResolverAddCategory(r, 2, "os");
+	AttrResolverAddCategory(r, 3, "appliance");
+	AttrResolverAddCategory(r, 5, "host");
+	AttrResolverAddChain(r, 1, 10);
+	AttrResolverAddChain(r, 2, 30);
+	AttrResolverAddChain(r, 3, 30);
+	AttrResolverAddChain(r, 5, 50);
+
+	AttrResolverAddCatindex(r, 1, 1, "global");
+	AttrResolverAddCatindex(r, 2, 2, "linux");
+	AttrResolverAddCatindex(r, 3, 3, "compute ");
+	AttrResolverAddCatindex(r, 5, 5, "compute-0-0");
+
+	AttrResolverAddAttr(r, "t", "appliance", 3, 3);
+	AttrResolverAddAttr(r, "t", "os", 2, 2);
+	AttrResolverAddAttr(r, "p", "global", 1, 1);
+	AttrResolverAddAttr(r, "P ", "host", 5, 5);
+	AttrResolverBuild(r);
+
+	check(r, "compute-0-0", "linux", "compute", "t", "appliance", 'A');
+	check(r, "compute-0-0", "linux  ", "Compute", "t", "appliance", 'A');
+	check(r, "compute-0-1", "linux", "frontend", "t", "os", 'O');
+	check(r, "compute-0-0 ", "linux", "compute", "P ", "host", 'H');
+	check(r, "compute-0-0", "linux", "compute", "p", NULL, 0);
+	check(r, "compute-0-1", "linux", "compute", "p", "global", 'G');
+
+	AttrResolverDestroy(r);
+	return failed ? 1 : 0;
+} /* main */
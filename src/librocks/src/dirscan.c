@@ -0,0 +1,647 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "../include/dirscan.h"
+
+#define DIRSCAN_MAX_THREADS	32
+#define DIRSCAN_BUFSIZE		65536
+
+struct dirrec {
+	DirScanDir	pub;
+	char		*path;
+	char		*names;		/* all entry names, NUL separated */
+	size_t		names_len;
+	size_t		names_cap;
+	int		cap;
+};
+
+struct DirScan {
+	int		rootfd;
+
+	pthread_mutex_t	lock;
+	pthread_cond_t	cond;
+	char		**queue;	/* directories left to scan */
+	int		nqueue;
+	int		capqueue;
+	int		active;		/* workers scanning a directory */
+	int		failed;		/* out of memory */
+
+	struct dirrec	**dirs;
+	int		ndirs;
+	int		capdirs;
+};
+
+
+/* ------------------------------------------------------------ stat */
+
+struct fileinfo {
+	mode_t		mode;
+	double		mtime;
+	long long	size;
+};
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+static int statx_works = 1;
+#endif
+
+/*
+ * stat relative to a directory, with statx() where the kernel has it so
+ * only the fields we use are fetched.  The mtime is computed the same
+ * way python computes os.stat().st_mtime.
+ */
+static int
+stat_at(int dirfd, const char *name, int flags, struct fileinfo *fi)
+{
+	struct stat	st;
+
+#if defined(__linux__) && defined(STATX_BASIC_STATS)
+	if ( statx_works ) {
+		struct statx	stx;
+
+		if ( statx(dirfd, name, flags | AT_STATX_DONT_SYNC,
+			STATX_TYPE | STATX_MODE | STATX_MTIME | STATX_SIZE,
+			&stx) == 0 ) {
+			fi->mode  = stx.stx_mode;
+			fi->mtime = (double)stx.stx_mtime.tv_sec +
+				1e-9 * stx.stx_mtime.tv_nsec;
+			fi->size  = stx.stx_size;
+			return 0;
+		}
+		if ( errno != ENOSYS ) {
+			return -1;
+		}
+		statx_works = 0;
+	}
+#endif
+	if ( fstatat(dirfd, name, &st, flags) ) {
+		return -1;
+	}
+	fi->mode  = st.st_mode;
+	fi->mtime = (double)st.st_mtim.tv_sec + 1e-9 * st.st_mtim.tv_nsec;
+	fi->size  = st.st_size;
+	return 0;
+}
+
+
+/* ----------------------------------------------------------- names */
+
+/*
+ * Emulates re.match(pattern, name) for '.*\.rpm$' (prefix NULL) and
+ * 'roll-.*\.iso$' (prefix "roll-").  '.' does not match a newline and
+ * '$' also matches before a trailing newline.
+ */
+static int
+name_matches(const char *name, size_t len, const char *prefix,
+	const char *suffix)
+{
+	size_t	plen = prefix ? strlen(prefix) : 0;
+	size_t	slen = strlen(suffix);
+
+	if ( len && name[len - 1] == '\n' ) {
+		len--;
+	}
+	if ( len < plen + slen || memchr(name, '\n', len) ) {
+		return 0;
+	}
+	if ( plen && memcmp(name, prefix, plen) ) {
+		return 0;
+	}
+	return memcmp(name + len - slen, suffix, slen) == 0;
+}
+
+static int
+name_kind(const char *name, size_t len)
+{
+	if ( name_matches(name, len, NULL, ".rpm") ) {
+		return DIRSCAN_RPM;
+	}
+	if ( name_matches(name, len, "roll-", ".iso") ) {
+		return DIRSCAN_ROLL;
+	}
+	return DIRSCAN_FILE;
+}
+
+static int
+rfind(const char *s, int len, char c)
+{
+	while ( --len >= 0 ) {
+		if ( s[len] == c ) {
+			return len;
+		}
+	}
+	return -1;
+}
+
+/*
+ * Splits the name the way RPMBaseFile does, including what its string
+ * slicing does when a separator is missing (filename[:-1]).
+ */
+void
+RPMNameParse(const char *filename, int ext, RPMName *out)
+{
+	int	flen = strlen(filename);
+	int	cut = flen > 0 ? flen - 1 : 0;
+	int	end = flen;
+	int	i, x;
+
+	for ( x = 0; x < ext; x++ ) {
+		i = rfind(filename, end, '.');
+		end = (i >= 0) ? i : cut;
+	}
+
+	i = rfind(filename, end, '.');
+	out->arch     = i + 1;
+	out->arch_len = end - (i + 1);
+	end = (i >= 0) ? i : cut;
+
+	i = rfind(filename, end, '-');
+	out->release	 = i + 1;
+	out->release_len = end - (i + 1);
+	end = (i >= 0) ? i : cut;
+
+	i = rfind(filename, end, '-');
+	out->version	 = i + 1;
+	out->version_len = end - (i + 1);
+
+	out->name     = 0;
+	out->name_len = (i >= 0) ? i : cut;
+} /* RPMNameParse */
+
+
+/* ---------------------------------------------------------- records */
+
+static struct dirrec *
+dirrec_new(const char *path)
+{
+	struct dirrec	*d = calloc(1, sizeof(struct dirrec));
+
+	if ( d ) {
+		d->path = strdup(path);
+		if ( !d->path ) {
+			free(d);
+			return NULL;
+		}
+		d->pub.path = d->path;
+	}
+	return d;
+}
+
+static int
+dirrec_add(struct dirrec *d, const char *name, size_t len, int kind,
+	double mtime, long long size)
+{
+	DirScanEntry	*e;
+
+	if ( d->pub.nentries == d->cap ) {
+		int	cap = d->cap ? d->cap * 2 : 64;
+
+		e = realloc(d->pub.entries, cap * sizeof(DirScanEntry));
+		if ( !e ) {
+			return -1;
+		}
+		d->pub.entries = e;
+		d->cap = cap;
+	}
+	if ( d->names_len + len + 1 > d->names_cap ) {
+		size_t	cap = d->names_cap ? d->names_cap * 2 : 4096;
+		char	*names;
+
+		while ( cap < d->names_len + len + 1 ) {
+			cap *= 2;
+		}
+		names = realloc(d->names, cap);
+		if ( !names ) {
+			return -1;
+		}
+		d->names     = names;
+		d->names_cap = cap;
+	}
+
+	memcpy(d->names + d->names_len, name, len + 1);
+
+	/* the name pointer is an offset until the directory is done */
+	e = &d->pub.entries[d->pub.nentries++];
+	e->name	 = (const char *)(size_t)d->names_len;
+	e->kind	 = kind;
+	e->mtime = mtime;
+	e->size	 = size;
+	d->names_len += len + 1;
+	return 0;
+}
+
+static void
+dirrec_finish(struct dirrec *d)
+{
+	int	i;
+
+	for ( i = 0; i < d->pub.nentries; i++ ) {
+		d->pub.entries[i].name = d->names + (size_t)d->pub.entries[i].name;
+	}
+}
+
+static void
+dirrec_free(struct dirrec *d)
+{
+	free(d->path);
+	free(d->names);
+	free(d->pub.entries);
+	free(d);
+}
+
+
+/* ------------------------------------------------------------ queue */
+
+static int
+queue_push(DirScan *scan, const char *path)
+{
+	char	*copy = strdup(path);
+	int	rc = 0;
+
+	if ( !copy ) {
+		return -1;
+	}
+	pthread_mutex_lock(&scan->lock);
+	if ( scan->nqueue == scan->capqueue ) {
+		int	cap = scan->capqueue ? scan->capqueue * 2 : 256;
+		char	**q = realloc(scan->queue, cap * sizeof(char *));
+
+		if ( q ) {
+			scan->queue    = q;
+			scan->capqueue = cap;
+		}
+	}
+	if ( scan->nqueue < scan->capqueue ) {
+		scan->queue[scan->nqueue++] = copy;
+		pthread_cond_signal(&scan->cond);
+	}
+	else {
+		free(copy);
+		rc = -1;
+	}
+	pthread_mutex_unlock(&scan->lock);
+	return rc;
+}
+
+
+/* ------------------------------------------------------------- scan */
+
+#ifdef __linux__
+struct linux_dirent64 {
+	unsigned long long	d_ino;
+	long long		d_off;
+	unsigned short		d_reclen;
+	unsigned char		d_type;
+	char			d_name[];
+};
+#endif
+
+/*
+ * Records one directory entry, queueing real directories for a worker.
+ */
+static int
+scan_entry(DirScan *scan, struct dirrec *d, int dirfd, const char *name,
+	int type)
+{
+	struct fileinfo	fi;
+	size_t		len = strlen(name);
+
+	if ( name[0] == '.' && (name[1] == '\0' ||
+		(name[1] == '.' && name[2] == '\0')) ) {
+		return 0;
+	}
+
+	if ( type == DT_UNKNOWN || (type != DT_DIR && type != DT_LNK) ) {
+		if ( stat_at(dirfd, name, AT_SYMLINK_NOFOLLOW, &fi) ) {
+			return 0;	/* gone since it was listed */
+		}
+		type = S_ISDIR(fi.mode) ? DT_DIR :
+			S_ISLNK(fi.mode) ? DT_LNK : DT_REG;
+	}
+
+	if ( type == DT_DIR ) {
+		char	*child;
+		int	rc;
+
+		if ( d->path[0] ) {
+			child = malloc(strlen(d->path) + len + 2);
+			if ( !child ) {
+				return -1;
+			}
+			sprintf(child, "%s/%s", d->path, name);
+			rc = queue_push(scan, child);
+			free(child);
+			return rc;
+		}
+		return queue_push(scan, name);
+	}
+
+	if ( type == DT_LNK ) {
+		char		target[4096];
+		struct fileinfo	orig, file;
+		ssize_t		n;
+
+		n = readlinkat(dirfd, name, target, sizeof(target) - 1);
+		if ( n < 0 ) {
+			return 0;
+		}
+		target[n] = '\0';
+		if ( stat_at(AT_FDCWD, target, 0, &orig) == 0 &&
+			S_ISREG(orig.mode) ) {
+			fi.mtime = orig.mtime;
+			fi.size	 = stat_at(dirfd, name, 0, &file) ? 0 : file.size;
+		}
+		else {
+			fi.mtime = 0;
+			fi.size	 = 0;
+		}
+	}
+
+	return dirrec_add(d, name, len, name_kind(name, len), fi.mtime, fi.size);
+}
+
+static struct dirrec *
+scan_dir(DirScan *scan, const char *path, char *buf)
+{
+	struct dirrec	*d;
+	int		fd, rc = 0;
+
+	d = dirrec_new(path);
+	if ( !d ) {
+		return NULL;
+	}
+
+	fd = openat(scan->rootfd, path[0] ? path : ".",
+		O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if ( fd < 0 ) {
+		return d;	/* no permission, an empty directory */
+	}
+
+#ifdef __linux__
+	for ( ;; ) {
+		long	n, off;
+
+		n = syscall(SYS_getdents64, fd, buf, DIRSCAN_BUFSIZE);
+		if ( n <= 0 ) {
+			break;
+		}
+		for ( off = 0; off < n && rc == 0; ) {
+			struct linux_dirent64	*de = (void *)(buf + off);
+
+			rc = scan_entry(scan, d, fd, de->d_name, de->d_type);
+			off += de->d_reclen;
+		}
+	}
+	close(fd);
+#else
+	{
+		DIR		*dir = fdopendir(fd);
+		struct dirent	*de;
+
+		while ( dir && rc == 0 && (de = readdir(dir)) ) {
+			rc = scan_entry(scan, d, fd, de->d_name, de->d_type);
+		}
+		if ( dir ) {
+			closedir(dir);
+		}
+		else {
+			close(fd);
+		}
+	}
+#endif
+
+	if ( rc ) {
+		dirrec_free(d);
+		return NULL;
+	}
+	dirrec_finish(d);
+	return d;
+}
+
+static void *
+worker(void *arg)
+{
+	DirScan	*scan = arg;
+	char	*buf = malloc(DIRSCAN_BUFSIZE);
+
+	pthread_mutex_lock(&scan->lock);
+	if ( !buf ) {
+		scan->failed = 1;
+	}
+	for ( ;; ) {
+		struct dirrec	*d;
+		char		*path;
+
+		while ( !scan->nqueue && scan->active && !scan->failed ) {
+			pthread_cond_wait(&scan->cond, &scan->lock);
+		}
+		if ( scan->failed || (!scan->nqueue && !scan->active) ) {
+			break;
+		}
+
+		path = scan->queue[--scan->nqueue];
+		scan->active++;
+		pthread_mutex_unlock(&scan->lock);
+
+		d = scan_dir(scan, path, buf);
+		free(path);
+
+		pthread_mutex_lock(&scan->lock);
+		scan->active--;
+		if ( d && scan->ndirs == scan->capdirs ) {
+			int		cap = scan->capdirs ? scan->capdirs * 2 : 256;
+			struct dirrec	**dirs;
+
+			dirs = realloc(scan->dirs, cap * sizeof(struct dirrec *));
+			if ( dirs ) {
+				scan->dirs    = dirs;
+				scan->capdirs = cap;
+			}
+		}
+		if ( !d || scan->ndirs == scan->capdirs ) {
+			if ( d ) {
+				dirrec_free(d);
+			}
+			scan->failed = 1;
+		}
+		else {
+			scan->dirs[scan->ndirs++] = d;
+		}
+	}
+	/* wake everybody up, either the work is done or it failed */
+	pthread_cond_broadcast(&scan->cond);
+	pthread_mutex_unlock(&scan->lock);
+
+	free(buf);
+	return NULL;
+}
+
+
+/*
+ * Scans the tree under root with nthreads threads (0 means one per
+ * CPU).  Returns NULL and sets errno if root is not a directory or on
+ * failure.
+ */
+DirScan *
+DirScanRun(const char *root, int nthreads)
+{
+	DirScan		*scan;
+	pthread_t	threads[DIRSCAN_MAX_THREADS];
+	int		i, started = 0;
+
+	if ( nthreads <= 0 ) {
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if ( nthreads < 1 ) {
+		nthreads = 1;
+	}
+	if ( nthreads > DIRSCAN_MAX_THREADS ) {
+		nthreads = DIRSCAN_MAX_THREADS;
+	}
+
+	scan = calloc(1, sizeof(DirScan));
+	if ( !scan ) {
+		return NULL;
+	}
+	scan->rootfd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if ( scan->rootfd < 0 ) {
+		free(scan);
+		return NULL;
+	}
+	pthread_mutex_init(&scan->lock, NULL);
+	pthread_cond_init(&scan->cond, NULL);
+
+	if ( queue_push(scan, "") ) {
+		DirScanFree(scan);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	for ( i = 0; i < nthreads; i++ ) {
+		if ( pthread_create(&threads[i], NULL, worker, scan) == 0 ) {
+			started++;
+		}
+	}
+	if ( !started ) {
+		worker(scan);
+	}
+	for ( i = 0; i < started; i++ ) {
+		pthread_join(threads[i], NULL);
+	}
+
+	if ( scan->failed ) {
+		DirScanFree(scan);
+		errno = ENOMEM;
+		return NULL;
+	}
+	return scan;
+} /* DirScanRun */
+
+
+int
+DirScanCount(DirScan *scan)
+{
+	return scan->ndirs;
+} /* DirScanCount */
+
+
+const DirScanDir *
+DirScanGet(DirScan *scan, int i)
+{
+	if ( i < 0 || i >= scan->ndirs ) {
+		return NULL;
+	}
+	return &scan->dirs[i]->pub;
+} /* DirScanGet */
+
+
+void
+DirScanFree(DirScan *scan)
+{
+	int	i;
+
+	if ( !scan ) {
+		return;
+	}
+	for ( i = 0; i < scan->ndirs; i++ ) {
+		dirrec_free(scan->dirs[i]);
+	}
+	for ( i = 0; i < scan->nqueue; i++ ) {
+		free(scan->queue[i]);
+	}
+	free(scan->dirs);
+	free(scan->queue);
+	if ( scan->rootfd >= 0 ) {
+		close(scan->rootfd);
+	}
+	pthread_mutex_destroy(&scan->lock);
+	pthread_cond_destroy(&scan->cond);
+	free(scan);
+} /* DirScanFree */
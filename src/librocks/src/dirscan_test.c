@@ -0,0 +1,236 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "../include/dirscan.h"
+
+static int failed;
+
+static void
+touch(const char *path, int size)
+{
+	FILE	*f = fopen(path, "w");
+
+	while ( f && size-- > 0 ) {
+		fputc('x', f);
+	}
+	if ( f ) {
+		fclose(f);
+	}
+}
+
+static const DirScanEntry *
+lookup(DirScan *scan, const char *dir, const char *name)
+{
+	int	i, j;
+
+	for ( i = 0; i < DirScanCount(scan); i++ ) {
+		const DirScanDir	*d = DirScanGet(scan, i);
+
+		if ( strcmp(d->path, dir) ) {
+			continue;
+		}
+		for ( j = 0; j < d->nentries; j++ ) {
+			if ( !strcmp(d->entries[j].name, name) ) {
+				return &d->entries[j];
+			}
+		}
+	}
+	return NULL;
+}
+
+static void
+check_entry(DirScan *scan, const char *dir, const char *name, int kind,
+	long long size)
+{
+	const DirScanEntry	*e = lookup(scan, dir, name);
+
+	if ( !e ) {
+		printf("FAIL %s/%s: missing\n", dir, name);
+		failed++;
+	}
+	else if ( e->kind != kind || e->size != size ) {
+		printf("FAIL %s/%s: kind %d size %lld\n", dir, name,
+			e->kind, e->size);
+		failed++;
+	}
+}
+
+static void
+check_name(const char *filename, int ext, const char *name,
+	const char *version, const char *release, const char *arch)
+{
+	RPMName	n;
+	char	buf[1024];
+
+	RPMNameParse(filename, ext, &n);
+	snprintf(buf, sizeof(buf), "%.*s|%.*s|%.*s|%.*s",
+		n.name_len, filename + n.name,
+		n.version_len, filename + n.version,
+		n.release_len, filename + n.release,
+		n.arch_len, filename + n.arch);
+	if ( strlen(buf) != strlen(name) + strlen(version) +
+		strlen(release) + strlen(arch) + 3 ||
+		strncmp(buf, name, strlen(name)) ) {
+		printf("FAIL %s: %s\n", filename, buf);
+		failed++;
+		return;
+	}
+	snprintf(buf + strlen(buf) + 1, sizeof(buf) - strlen(buf) - 1,
+		"%s|%s|%s|%s", name, version, release, arch);
+	if ( strcmp(buf, buf + strlen(buf) + 1) ) {
+		printf("FAIL %s: %s != %s\n", filename, buf,
+			buf + strlen(buf) + 1);
+		failed++;
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char		root[] = "/tmp/dirscan_test.XXXXXX";
+	char		cmd[256];
+	DirScan		*scan;
+	int		dirs, threads;
+	const DirScanEntry *e;
+
+	/*
+	 * Names are split exactly like RPMBaseFile, including its
+	 * handling of names without enough separators.
+	 */
+	check_name("foo-1.0-1.x86_64.rpm", 1, "foo", "1.0", "1", "x86_64");
+	check_name("foo-bar-2.3.4-1.el7.noarch.rpm", 1,
+		"foo-bar", "2.3.4", "1.el7", "noarch");
+	check_name("roll-base-7.0-0.x86_64.disk1.iso", 2,
+		"roll-base", "7.0", "0", "x86_64");
+	check_name("README", 1, "READM", "READM", "READM", "READM");
+	check_name("a.rpm", 1, "a.rp", "a.rp", "a.rp", "a");
+	check_name("x-1.rpm", 1, "x-1.rp", "x", "1.rp", "x-1");
+
+	if ( !mkdtemp(root) || chdir(root) ) {
+		perror(root);
+		return 1;
+	}
+
+	mkdir("a", 0755);
+	mkdir("a/b", 0755);
+	mkdir("a/b/c", 0755);
+	mkdir("empty", 0755);
+	touch("top", 10);
+	touch("a/foo-1.0-1.x86_64.rpm", 20);
+	touch("a/b/roll-base-7.0-0.x86_64.disk1.iso", 30);
+	touch("a/b/c/notroll-base.iso", 40);
+	touch("a/b/c/x.rpm.txt", 5);
+	if ( symlink("a/foo-1.0-1.x86_64.rpm", "link.rpm") ||
+		symlink("nowhere", "dangling") ||
+		symlink("a", "dirlink") ) {
+		perror("symlink");
+		return 1;
+	}
+
+	for ( threads = 1; threads <= 8; threads *= 2 ) {
+		scan = DirScanRun(".", threads);
+		if ( !scan ) {
+			perror("DirScanRun");
+			return 1;
+		}
+
+		dirs = DirScanCount(scan);
+		if ( dirs != 5 ) {
+			printf("FAIL %d threads: %d directories\n", threads,
+				dirs);
+			failed++;
+		}
+		check_entry(scan, "", "top", DIRSCAN_FILE, 10);
+		check_entry(scan, "a", "foo-1.0-1.x86_64.rpm", DIRSCAN_RPM, 20);
+		check_entry(scan, "a/b", "roll-base-7.0-0.x86_64.disk1.iso",
+			DIRSCAN_ROLL, 30);
+		check_entry(scan, "a/b/c", "notroll-base.iso", DIRSCAN_FILE, 40);
+		check_entry(scan, "a/b/c", "x.rpm.txt", DIRSCAN_FILE, 5);
+
+		/* links to files get the size of the target */
+		check_entry(scan, "", "link.rpm", DIRSCAN_RPM, 20);
+		check_entry(scan, "", "dangling", DIRSCAN_FILE, 0);
+		check_entry(scan, "", "dirlink", DIRSCAN_FILE, 0);
+		if ( (e = lookup(scan, "", "dangling")) && e->mtime != 0 ) {
+			printf("FAIL dangling link has a timestamp\n");
+			failed++;
+		}
+		if ( (e = lookup(scan, "", "top")) && e->mtime < 1 ) {
+			printf("FAIL top has no timestamp\n");
+			failed++;
+		}
+		DirScanFree(scan);
+	}
+
+	if ( DirScanRun("top", 0) ) {
+		printf("FAIL scanned a file\n");
+		failed++;
+	}
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", root);
+	if ( chdir("/") || system(cmd) ) {
+		failed++;
+	}
+
+	return failed ? 1 : 0;
+}
@@ -82,8 +82,16 @@
 #include <string.h>
 #include <stdlib.h>
 #include <assert.h>
+#include <errno.h>
+#include <unistd.h>
 #include "../include/hexdump.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HEX_HAVE_X86 1
+#include <emmintrin.h>
+#include <immintrin.h>
+#endif
+
 void
 HexDump(const char *label, const char *msg, int len)
 {
@@ -91,19 +99,54 @@ HexDump(const char *label, const char *msg, int len)
 } /* HexDump */
 
 
+static int
+file_writer(void *arg, const char *buf, size_t len)
+{
+	return fwrite(buf, 1, len, (FILE *)arg) != len;
+}
+
 void
 HexDumpToFile(FILE *fout, const char *label, const char *msg, int len)
 {
-	char *s;
+	assert(msg);
+	assert(len);
 
-	s = HexDumpToString(label, msg, len);
-	if ( s ) {
-		fprintf(fout, "%s\n", s);
-		free(s);
+	if ( HexDumpStream(file_writer, fout, label, msg, len) == 0 ) {
+		fputc('\n', fout);
 	}
 } /* HexDumpToFile */
 
 
+static int
+fd_writer(void *arg, const char *buf, size_t len)
+{
+	int	fd = *(int *)arg;
+	ssize_t	n;
+
+	while ( len > 0 ) {
+		n = write(fd, buf, len);
+		if ( n < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			return -1;
+		}
+		buf += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int
+HexDumpToFd(int fd, const char *label, const char *msg, size_t len)
+{
+	if ( HexDumpStream(fd_writer, &fd, label, msg, len) ) {
+		return -1;
+	}
+	return fd_writer(&fd, "\n", 1);
+} /* HexDumpToFd */
+
+
 /*
  *           1         2         3         4         5         6         7
  * 01234567890123456789012345678901234567890123456789012345678901234567890
@@ -115,6 +158,11 @@ HexDumpToFile(FILE *fout, const char *label, const char *msg, int len)
 #define HEX_LINE_LENGTH 66
 #define HEX_CHARS	16
 #define HEX_ASCII_START	51
+#define HEX_LINE_FULL	(HEX_ASCII_START + HEX_CHARS)
+#define HEX_DASH	24
+
+/* Size of the formatting block used by HexDumpStream */
+#define HEX_BLOCK_SIZE	16384
 
 /*
           1         2         3         4         5         6         7
@@ -122,64 +170,460 @@ HexDumpToFile(FILE *fout, const char *label, const char *msg, int len)
 LABEL: 30 31 32 33 34 35 36 37 - 38 39 20 41 42 43 44 45  0123456789 ABCDE
 */
 
-char *
-HexDumpToString(const char *label, const char *msg, int len)
+static const char hexdigits[] = "0123456789abcdef";
+
+typedef void (*hexline_fn)(char *out, const unsigned char *in);
+
+static int		engine;		/* 0 until first use */
+static hexline_fn	hexline_full;
+
+
+/*
+ * Column of the high nibble of byte j inside a line.
+ */
+static inline int
+hex_column(int j)
 {
-	int	i, j, line_len;
-	char	*buffer;
-	int	buffer_len;
-	char	*p; /* current hex   position */
-	char	*q; /* current ascii position */
+	return j * 3 + (j >= 8 ? 2 : 0);
+}
 
-	assert(msg);
-	assert(len);
 
-	line_len = HEX_LINE_LENGTH;
-	if ( label ) {
-		line_len += strlen(label) + strlen(": ");
+/*
+ * Reference formatter.  Formats n (1 to 16) bytes into one line and
+ * returns the number of characters written.  The hex area is always
+ * padded out to HEX_ASCII_START, the ascii area is not.
+ */
+static size_t
+hexline_scalar_n(char *out, const unsigned char *in, size_t n)
+{
+	size_t	j;
+	char	*p;
+
+	memset(out, ' ', HEX_ASCII_START);
+	for ( j = 0; j < n; j++ ) {
+		unsigned char	byte = in[j];
+
+		p = out + hex_column(j);
+		p[0] = hexdigits[byte >> 4];
+		p[1] = hexdigits[byte & 0x0f];
+		out[HEX_ASCII_START + j] =
+			(byte >= 0x20 && byte < 0x7f) ? byte : '.';
 	}
+	if ( n > 8 ) {
+		out[HEX_DASH] = '-';
+	}
+	return HEX_ASCII_START + n;
+}
 
-	buffer_len = (len + HEX_CHARS - 1) / HEX_CHARS * line_len + 1;
-	buffer = malloc(buffer_len);
-	if ( !buffer ) {
-		return NULL;
+static void
+hexline_scalar(char *out, const unsigned char *in)
+{
+	hexline_scalar_n(out, in, HEX_CHARS);
+}
+
+
+#ifdef HEX_HAVE_X86
+
+/*
+ * SSE2 engine.  Nibbles are converted to hex digits and the printable
+ * mask is computed 16 bytes at a time.  Each digit pair is widened to a
+ * "xx  " word and stored with a 3 byte stride, every store overwriting
+ * the trailing pad of the previous one.
+ */
+static inline __m128i
+nibble_to_hex_sse2(__m128i n)
+{
+	__m128i	alpha = _mm_cmpgt_epi8(n, _mm_set1_epi8(9));
+
+	n = _mm_add_epi8(n, _mm_set1_epi8('0'));
+	return _mm_add_epi8(n, _mm_and_si128(alpha, _mm_set1_epi8('a' - '0' - 10)));
+}
+
+static inline __m128i
+ascii_sse2(__m128i v)
+{
+	__m128i	printable = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8(0x1f)),
+					  _mm_cmplt_epi8(v, _mm_set1_epi8(0x7f)));
+
+	return _mm_or_si128(_mm_and_si128(printable, v),
+			    _mm_andnot_si128(printable, _mm_set1_epi8('.')));
+}
+
+static void
+hexline_sse2(char *out, const unsigned char *in)
+{
+	__m128i		v, lo, hi, pairs[2], spaces;
+	unsigned int	words[16];
+	int		i, j;
+
+	v  = _mm_loadu_si128((const __m128i *)in);
+	lo = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+	hi = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+	lo = nibble_to_hex_sse2(lo);
+	hi = nibble_to_hex_sse2(hi);
+
+	pairs[0] = _mm_unpacklo_epi8(hi, lo);
+	pairs[1] = _mm_unpackhi_epi8(hi, lo);
+	spaces	 = _mm_set1_epi16(0x2020);
+	for ( i = 0; i < 2; i++ ) {
+		_mm_storeu_si128((__m128i *)&words[i * 8],
+			_mm_unpacklo_epi16(pairs[i], spaces));
+		_mm_storeu_si128((__m128i *)&words[i * 8 + 4],
+			_mm_unpackhi_epi16(pairs[i], spaces));
 	}
-	memset(buffer, (int)' ', buffer_len);
 
-	p = buffer;
-	for (i=0; i<len; i+=16, p+= 17) {
-		if ( i > 0 ) {
-			*p++ = '\n';
-		}
-		if ( label ) {
-			p += sprintf(p, "%s: ", label);
-		}
-	  	q = p + HEX_ASCII_START;
-        
-		for (j=0; j<16 && (j+i) < len; j++) {
-			unsigned char	byte = msg[i+j];
+	for ( j = 0; j < HEX_CHARS; j++ ) {
+		memcpy(out + hex_column(j), &words[j], sizeof(words[j]));
+	}
+	out[HEX_DASH]	  = '-';
+	out[HEX_DASH + 1] = ' ';
+	out[HEX_ASCII_START - 1] = ' ';
+
+	_mm_storeu_si128((__m128i *)(out + HEX_ASCII_START), ascii_sse2(v));
+}
 
-			if ( j == 8 ) { 
-				p += sprintf(p, "- ");
+
+/*
+ * AVX2 engine.  Two lines are converted per call, one per 128 bit lane.
+ * The hex area of a line is assembled in four 16 byte chunks, each one
+ * built from two in-lane byte shuffles of the digit pairs and a fill
+ * pattern holding the separators.  The shuffle masks are derived from
+ * hex_column() at startup so they cannot drift from the scalar layout.
+ */
+static unsigned char	avx2_mask[4][2][32] __attribute__((aligned(32)));
+static unsigned char	avx2_fill[4][32]    __attribute__((aligned(32)));
+
+static void
+avx2_init(void)
+{
+	int	map[64];
+	int	i, j, c, k;
+
+	for ( i = 0; i < 64; i++ ) {
+		map[i] = (i < HEX_ASCII_START) ? -1 : -2;
+	}
+	for ( j = 0; j < HEX_CHARS; j++ ) {
+		map[hex_column(j)]     = j * 2;
+		map[hex_column(j) + 1] = j * 2 + 1;
+	}
+
+	for ( c = 0; c < 4; c++ ) {
+		for ( k = 0; k < 16; k++ ) {
+			int	src = map[c * 16 + k];
+			int	lane;
+
+			avx2_mask[c][0][k] = 0x80;
+			avx2_mask[c][1][k] = 0x80;
+			avx2_fill[c][k]	   = 0;
+			if ( src >= 0 ) {
+				avx2_mask[c][src / 16][k] = src % 16;
 			}
-      
-			p += sprintf(p, "%02x ", byte);
-      
-			if ( isprint(byte) ) {
-				*q++ = byte;
+			else if ( src == -1 ) {
+				avx2_fill[c][k] = (c * 16 + k == HEX_DASH) ?
+					'-' : ' ';
 			}
-			else {
-				*q++ = '.';
+			for ( lane = 0; lane < 2; lane++ ) {
+				avx2_mask[c][lane][k + 16] = avx2_mask[c][lane][k];
 			}
+			avx2_fill[c][k + 16] = avx2_fill[c][k];
 		}
+	}
+}
+
+__attribute__((target("avx2")))
+static inline __m256i
+nibble_to_hex_avx2(__m256i n)
+{
+	__m256i	alpha = _mm256_cmpgt_epi8(n, _mm256_set1_epi8(9));
+
+	n = _mm256_add_epi8(n, _mm256_set1_epi8('0'));
+	return _mm256_add_epi8(n,
+		_mm256_and_si256(alpha, _mm256_set1_epi8('a' - '0' - 10)));
+}
 
-		*p = ' ';
+__attribute__((target("avx2")))
+static void
+hexline2_avx2(char *out0, char *out1, const unsigned char *in)
+{
+	__m256i	v, lo, hi, pairs[2], chunk, printable, ascii;
+	int	c;
+
+	v  = _mm256_loadu_si256((const __m256i *)in);
+	lo = _mm256_and_si256(v, _mm256_set1_epi8(0x0f));
+	hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0f));
+	lo = nibble_to_hex_avx2(lo);
+	hi = nibble_to_hex_avx2(hi);
+
+	/* in each lane: digits of bytes 0-7 and of bytes 8-15 */
+	pairs[0] = _mm256_unpacklo_epi8(hi, lo);
+	pairs[1] = _mm256_unpackhi_epi8(hi, lo);
+
+	for ( c = 0; c < 4; c++ ) {
+		chunk = _mm256_or_si256(
+			_mm256_shuffle_epi8(pairs[0],
+				_mm256_load_si256((const __m256i *)avx2_mask[c][0])),
+			_mm256_shuffle_epi8(pairs[1],
+				_mm256_load_si256((const __m256i *)avx2_mask[c][1])));
+		chunk = _mm256_or_si256(chunk,
+			_mm256_load_si256((const __m256i *)avx2_fill[c]));
+		_mm_storeu_si128((__m128i *)(out0 + c * 16),
+			_mm256_castsi256_si128(chunk));
+		_mm_storeu_si128((__m128i *)(out1 + c * 16),
+			_mm256_extracti128_si256(chunk, 1));
 	}
-	*q = '\0';
 
-	return buffer;
+	printable = _mm256_and_si256(
+		_mm256_cmpgt_epi8(v, _mm256_set1_epi8(0x1f)),
+		_mm256_cmpgt_epi8(_mm256_set1_epi8(0x7f), v));
+	ascii = _mm256_or_si256(_mm256_and_si256(printable, v),
+		_mm256_andnot_si256(printable, _mm256_set1_epi8('.')));
+	_mm_storeu_si128((__m128i *)(out0 + HEX_ASCII_START),
+		_mm256_castsi256_si128(ascii));
+	_mm_storeu_si128((__m128i *)(out1 + HEX_ASCII_START),
+		_mm256_extracti128_si256(ascii, 1));
 }
 
+#endif /* HEX_HAVE_X86 */
 
 
+static int
+engine_supported(int e)
+{
+	switch ( e ) {
+	case HEXDUMP_ENGINE_SCALAR:
+		return 1;
+#ifdef HEX_HAVE_X86
+	case HEXDUMP_ENGINE_SSE2:
+		return __builtin_cpu_supports("sse2");
+	case HEXDUMP_ENGINE_AVX2:
+		return __builtin_cpu_supports("avx2");
+#endif
+	default:
+		return 0;
+	}
+}
+
+/*
+ * Selects the formatting engine and returns the one actually in use.
+ * Requests for an engine the CPU cannot run fall back to the next
+ * slower one.  HEXDUMP_ENGINE_AUTO selects the fastest available.
+ */
+int
+HexDumpSetEngine(int e)
+{
+	if ( e == HEXDUMP_ENGINE_AUTO || e > HEXDUMP_ENGINE_AVX2 ) {
+		e = HEXDUMP_ENGINE_AVX2;
+	}
+	while ( e > HEXDUMP_ENGINE_SCALAR && !engine_supported(e) ) {
+		e--;
+	}
+
+	hexline_full = hexline_scalar;
+#ifdef HEX_HAVE_X86
+	if ( e >= HEXDUMP_ENGINE_SSE2 ) {
+		hexline_full = hexline_sse2;
+	}
+	if ( e == HEXDUMP_ENGINE_AVX2 ) {
+		avx2_init();
+	}
+#endif
+	engine = e;
+	return engine;
+} /* HexDumpSetEngine */
+
+int
+HexDumpGetEngine(void)
+{
+	if ( !engine ) {
+		HexDumpSetEngine(HEXDUMP_ENGINE_AUTO);
+	}
+	return engine;
+} /* HexDumpGetEngine */
+
+const char *
+HexDumpEngineName(int e)
+{
+	switch ( e ) {
+	case HEXDUMP_ENGINE_AUTO:	return "auto";
+	case HEXDUMP_ENGINE_SCALAR:	return "scalar";
+	case HEXDUMP_ENGINE_SSE2:	return "sse2";
+	case HEXDUMP_ENGINE_AVX2:	return "avx2";
+	}
+	return "unknown";
+} /* HexDumpEngineName */
+
+
+static size_t
+prefix_length(const char *label)
+{
+	return label ? strlen(label) + strlen(": ") : 0;
+}
+
+static char *
+line_start(char *p, const char *label, size_t prefix_len, int first)
+{
+	if ( !first ) {
+		*p++ = '\n';
+	}
+	if ( label ) {
+		memcpy(p, label, prefix_len - 2);
+		p += prefix_len - 2;
+		*p++ = ':';
+		*p++ = ' ';
+	}
+	return p;
+}
+
+/*
+ * Formats len bytes of input as whole lines starting at p and returns
+ * the end of the output.  Only the last line of a dump may be partial.
+ */
+static char *
+format_lines(char *p, const char *label, size_t prefix_len,
+	const unsigned char *in, size_t len, int first)
+{
+#ifdef HEX_HAVE_X86
+	if ( engine == HEXDUMP_ENGINE_AVX2 ) {
+		char	*l0, *l1;
+
+		while ( len >= 2 * HEX_CHARS ) {
+			l0 = line_start(p, label, prefix_len, first);
+			l1 = line_start(l0 + HEX_LINE_FULL, label, prefix_len, 0);
+			hexline2_avx2(l0, l1, in);
+			p = l1 + HEX_LINE_FULL;
+			in  += 2 * HEX_CHARS;
+			len -= 2 * HEX_CHARS;
+			first = 0;
+		}
+	}
+#endif
+	while ( len >= HEX_CHARS ) {
+		p = line_start(p, label, prefix_len, first);
+		hexline_full(p, in);
+		p += HEX_LINE_FULL;
+		in  += HEX_CHARS;
+		len -= HEX_CHARS;
+		first = 0;
+	}
+	if ( len ) {
+		p = line_start(p, label, prefix_len, first);
+		p += hexline_scalar_n(p, in, len);
+	}
+	return p;
+}
+
+
+/*
+ * Returns the buffer size, including the terminating NUL, needed to
+ * hold the dump of len bytes.
+ */
+size_t
+HexDumpBufferSize(const char *label, size_t len)
+{
+	size_t	prefix_len = prefix_length(label);
+	size_t	lines = (len + HEX_CHARS - 1) / HEX_CHARS;
+	size_t	size;
 
+	if ( !lines ) {
+		return 1;
+	}
+	size = (lines - 1) * (prefix_len + HEX_LINE_FULL + 1);
+	size += prefix_len + HEX_ASCII_START + (len - (lines - 1) * HEX_CHARS);
+	return size + 1;
+} /* HexDumpBufferSize */
+
+
+/*
+ * Formats the dump into a caller supplied buffer.  Returns the length
+ * of the resulting string, or 0 if size is less than
+ * HexDumpBufferSize(label, len).
+ */
+size_t
+HexDumpToBuffer(char *buf, size_t size, const char *label,
+	const char *msg, size_t len)
+{
+	char	*p;
+
+	if ( size < HexDumpBufferSize(label, len) ) {
+		return 0;
+	}
+	HexDumpGetEngine();
+
+	p = format_lines(buf, label, prefix_length(label),
+		(const unsigned char *)msg, len, 1);
+	*p = '\0';
+	return p - buf;
+} /* HexDumpToBuffer */
+
+
+/*
+ * Formats the dump one block at a time and hands each block to the
+ * writer, so only HEX_BLOCK_SIZE bytes of output are ever held in
+ * memory.  No trailing newline is written.  Returns 0 on success, -1
+ * if the writer failed.
+ */
+int
+HexDumpStream(HexDumpWriter writer, void *arg, const char *label,
+	const char *msg, size_t len)
+{
+	char			stack_block[HEX_BLOCK_SIZE];
+	char			*block = stack_block;
+	const unsigned char	*in = (const unsigned char *)msg;
+	size_t			prefix_len = prefix_length(label);
+	size_t			line_len = prefix_len + HEX_LINE_FULL + 1;
+	size_t			chunk;
+	int			first = 1;
+	int			rc = 0;
+
+	HexDumpGetEngine();
+
+	/* absurdly long labels get a block just big enough for one line */
+	if ( line_len > sizeof(stack_block) ) {
+		block = malloc(line_len);
+		if ( !block ) {
+			return -1;
+		}
+		chunk = HEX_CHARS;
+	}
+	else {
+		chunk = sizeof(stack_block) / line_len * HEX_CHARS;
+	}
+
+	while ( len > 0 && rc == 0 ) {
+		size_t	n = len < chunk ? len : chunk;
+		char	*end;
+
+		end = format_lines(block, label, prefix_len, in, n, first);
+		if ( writer(arg, block, end - block) ) {
+			rc = -1;
+		}
+		in  += n;
+		len -= n;
+		first = 0;
+	}
+
+	if ( block != stack_block ) {
+		free(block);
+	}
+	return rc;
+} /* HexDumpStream */
+
+
+char *
+HexDumpToString(const char *label, const char *msg, int len)
+{
+	char	*buffer;
+	size_t	buffer_len;
+
+	assert(msg);
+	assert(len);
+
+	buffer_len = HexDumpBufferSize(label, len);
+	buffer = malloc(buffer_len);
+	if ( !buffer ) {
+		return NULL;
+	}
+	HexDumpToBuffer(buffer, buffer_len, label, msg, len);
+
+	return buffer;
+}
@@ -72,11 +72,142 @@
 #define _GNU_SOURCE
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
 #include <fcntl.h>
 #include <assert.h>
 #include "../include/hexdump.h"
 
 
+/*
+ * The original sprintf based formatter, kept to check that every engine
+ * still produces exactly the same output.  Lines are sized at their real
+ * length of 68 bytes, the original allocated 66 and overran its buffer.
+ */
+static char *
+legacy_hexdump(const char *label, const char *msg, int len)
+{
+	int	i, j, line_len;
+	char	*buffer;
+	int	buffer_len;
+	char	*p;
+	char	*q = NULL;
+
+	line_len = 68;
+	if ( label ) {
+		line_len += strlen(label) + strlen(": ");
+	}
+
+	buffer_len = (len + 15) / 16 * line_len + 1;
+	buffer = malloc(buffer_len);
+	memset(buffer, (int)' ', buffer_len);
+
+	p = buffer;
+	for (i=0; i<len; i+=16, p+= 17) {
+		if ( i > 0 ) {
+			*p++ = '\n';
+		}
+		if ( label ) {
+			p += sprintf(p, "%s: ", label);
+		}
+	  	q = p + 51;
+		for (j=0; j<16 && (j+i) < len; j++) {
+			unsigned char	byte = msg[i+j];
+
+			if ( j == 8 ) { 
+				p += sprintf(p, "- ");
+			}
+			p += sprintf(p, "%02x ", byte);
+			*q++ = isprint(byte) ? byte : '.';
+		}
+		*p = ' ';
+	}
+	*q = '\0';
+
+	return buffer;
+}
+
+
+struct sink {
+	char	*buf;
+	size_t	len;
+	int	calls;
+};
+
+static int
+sink_writer(void *arg, const char *buf, size_t len)
+{
+	struct sink	*s = (struct sink *)arg;
+
+	memcpy(s->buf + s->len, buf, len);
+	s->len += len;
+	s->calls++;
+	return 0;
+}
+
+
+static int
+compare_engines(void)
+{
+	const char	*labels[] = { NULL, "LABEL", "hexdump_test.c" };
+	int		sizes[] = { 100000, 1 << 20 };
+	int		engines[] = { HEXDUMP_ENGINE_SCALAR,
+				      HEXDUMP_ENGINE_SSE2,
+				      HEXDUMP_ENGINE_AVX2 };
+	char		*msg, *want, *got;
+	struct sink	sink;
+	int		e, l, len, i, failed = 0;
+
+	msg = malloc(1 << 20);
+	for ( i = 0; i < (1 << 20); i++ ) {
+		msg[i] = random();
+	}
+
+	for ( e = 0; e < 3; e++ ) {
+		int	used = HexDumpSetEngine(engines[e]);
+
+		for ( l = 0; l < 3; l++ ) {
+			for ( len = 1; len < 300; len++ ) {
+				want = legacy_hexdump(labels[l], msg + len, len);
+				got  = HexDumpToString(labels[l], msg + len, len);
+				if ( strcmp(want, got) ) {
+					printf("FAIL %s len %d label %s\n",
+						HexDumpEngineName(used), len,
+						labels[l] ? labels[l] : "none");
+					failed++;
+				}
+				free(want);
+				free(got);
+			}
+
+			for ( i = 0; i < 2; i++ ) {
+				len  = sizes[i] - l;
+				want = legacy_hexdump(labels[l], msg, len);
+				sink.buf   = malloc(strlen(want) + 1);
+				sink.len   = 0;
+				sink.calls = 0;
+				HexDumpStream(sink_writer, &sink, labels[l],
+					msg, len);
+				if ( sink.len != strlen(want) ||
+					memcmp(sink.buf, want, sink.len) ) {
+					printf("FAIL %s stream len %d\n",
+						HexDumpEngineName(used), len);
+					failed++;
+				}
+				free(sink.buf);
+				free(want);
+			}
+		}
+		printf("%s: %s\n", HexDumpEngineName(used),
+			failed ? "FAIL" : "ok");
+	}
+
+	HexDumpSetEngine(HEXDUMP_ENGINE_AUTO);
+	free(msg);
+	return failed;
+}
+
+
 int
 main(int argc, char *argv[])
 {
@@ -105,5 +236,7 @@ main(int argc, char *argv[])
 	}
 
 	fclose(fin);
-	return 0;
+
+	printf("-- TEST 4 --\n");
+	return compare_engines() ? 1 : 0;
 } /* main */
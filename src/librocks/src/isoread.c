@@ -0,0 +1,1331 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+#include "../include/isoread.h"
+
+#define SECTOR			2048
+#define ISO_MAX_DIRS		(1 << 20)
+#define ISO_MAX_THREADS		32
+#define ISO_COPY_CHUNK		(1 << 20)
+
+struct ISOImage {
+	int		fd;
+	int		flags;
+	int		susp_skip;	/* from the SP entry */
+	ISOEntry	*entries;
+	int		nentries;
+	int		cap;
+	int		*hash;		/* entry index + 1, by path */
+	unsigned int	hsize;
+};
+
+/* Rock Ridge fields of one directory record */
+struct rrinfo {
+	int		mode;
+	long		mtime;
+	int		has_mtime;
+	char		name[1024];
+	int		namelen;
+	int		has_name;
+	char		target[4096];
+	int		has_target;
+	int		sl_continue;
+	int		sl_slash;	/* target ends with the root "/" */
+	int		relocated;	/* RE: shown where its CL points */
+	unsigned int	child;		/* CL: the real directory */
+};
+
+
+/* ------------------------------------------------------------ utils */
+
+static unsigned int
+le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static int
+read_at(int fd, void *buf, size_t len, long long offset)
+{
+	char	*p = buf;
+
+	while ( len ) {
+		ssize_t	n = pread(fd, p, len, offset);
+
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			if ( n == 0 ) {
+				errno = EINVAL;		/* truncated image */
+			}
+			return -1;
+		}
+		p	+= n;
+		len	-= n;
+		offset	+= n;
+	}
+	return 0;
+}
+
+static unsigned int
+hash_string(const char *s)
+{
+	unsigned int	h = 2166136261u;
+
+	while ( *s ) {
+		h = (h ^ (unsigned char)*s++) * 16777619u;
+	}
+	return h;
+}
+
+/*
+ * Directory record dates are 7 bytes: years since 1900, month, day,
+ * hour, minute, second and the offset from GMT in 15 minute units.
+ */
+static long
+short_time(const unsigned char *p)
+{
+	struct tm	tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.tm_year = p[0];
+	tm.tm_mon  = p[1] - 1;
+	tm.tm_mday = p[2];
+	tm.tm_hour = p[3];
+	tm.tm_min  = p[4];
+	tm.tm_sec  = p[5];
+	return (long)timegm(&tm) - (signed char)p[6] * 15 * 60;
+}
+
+/*
+ * Long form dates are "YYYYMMDDHHMMSScc" in ASCII plus the offset.
+ */
+static long
+long_time(const unsigned char *p)
+{
+	struct tm	tm;
+	char		buf[5];
+
+	memset(&tm, 0, sizeof(tm));
+	memcpy(buf, p, 4);
+	buf[4] = '\0';
+	tm.tm_year = atoi(buf) - 1900;
+#define FIELD(f, off) buf[0] = p[off]; buf[1] = p[off + 1]; buf[2] = '\0'; \
+	f = atoi(buf);
+	FIELD(tm.tm_mon, 4);
+	FIELD(tm.tm_mday, 6);
+	FIELD(tm.tm_hour, 8);
+	FIELD(tm.tm_min, 10);
+	FIELD(tm.tm_sec, 12);
+#undef FIELD
+	tm.tm_mon--;
+	return (long)timegm(&tm) - (signed char)p[16] * 15 * 60;
+}
+
+
+/* ------------------------------------------------------- rock ridge */
+
+static void
+sl_append(struct rrinfo *rr, const char *s, int len)
+{
+	int	cur = strlen(rr->target);
+
+	if ( cur + len + 1 < (int)sizeof(rr->target) ) {
+		memcpy(rr->target + cur, s, len);
+		rr->target[cur + len] = '\0';
+	}
+}
+
+static void
+parse_sl(struct rrinfo *rr, const unsigned char *p, int len)
+{
+	int	pos = 0;
+
+	while ( pos + 2 <= len ) {
+		int	flags = p[pos];
+		int	clen  = p[pos + 1];
+
+		if ( pos + 2 + clen > len ) {
+			break;
+		}
+		if ( rr->has_target && !rr->sl_continue && !rr->sl_slash ) {
+			sl_append(rr, "/", 1);
+		}
+		rr->sl_slash = 0;
+		if ( flags & 0x08 ) {
+			rr->target[0] = '\0';
+			sl_append(rr, "/", 1);
+			rr->sl_slash = 1;
+		}
+		else if ( flags & 0x02 ) {
+			sl_append(rr, ".", 1);
+		}
+		else if ( flags & 0x04 ) {
+			sl_append(rr, "..", 2);
+		}
+		else {
+			sl_append(rr, (const char *)p + pos + 2, clen);
+		}
+		rr->has_target	= 1;
+		rr->sl_continue = flags & 0x01;
+		pos += 2 + clen;
+	}
+}
+
+/*
+ * Walks the System Use entries of a directory record, following CE
+ * continuation areas.
+ */
+static void
+parse_susp(ISOImage *iso, const unsigned char *su, int len,
+	struct rrinfo *rr, int depth)
+{
+	unsigned int	ce_block = 0, ce_offset = 0, ce_len = 0;
+	int		pos = 0;
+
+	while ( pos + 4 <= len ) {
+		const unsigned char	*e = su + pos;
+		int			elen = e[2];
+
+		if ( elen < 4 || pos + elen > len ) {
+			break;
+		}
+
+		if ( !memcmp(e, "PX", 2) && elen >= 12 ) {
+			rr->mode = le32(e + 4);
+		}
+		else if ( !memcmp(e, "NM", 2) && elen >= 5 ) {
+			if ( !(e[4] & 0x06) &&
+				rr->namelen + elen - 5 < (int)sizeof(rr->name) ) {
+				memcpy(rr->name + rr->namelen, e + 5, elen - 5);
+				rr->namelen += elen - 5;
+				rr->has_name = 1;
+			}
+		}
+		else if ( !memcmp(e, "SL", 2) && elen >= 5 ) {
+			parse_sl(rr, e + 5, elen - 5);
+		}
+		else if ( !memcmp(e, "TF", 2) && elen >= 5 ) {
+			int	size = (e[4] & 0x80) ? 17 : 7;
+			int	off  = 5 + ((e[4] & 0x01) ? size : 0);
+
+			if ( (e[4] & 0x02) && off + size <= elen ) {
+				rr->mtime = (size == 17) ? long_time(e + off) :
+					short_time(e + off);
+				rr->has_mtime = 1;
+			}
+		}
+		else if ( !memcmp(e, "CE", 2) && elen >= 28 ) {
+			ce_block  = le32(e + 4);
+			ce_offset = le32(e + 12);
+			ce_len	  = le32(e + 20);
+		}
+		else if ( !memcmp(e, "RE", 2) ) {
+			rr->relocated = 1;
+		}
+		else if ( !memcmp(e, "CL", 2) && elen >= 12 ) {
+			rr->child = le32(e + 4);
+		}
+		else if ( !memcmp(e, "ST", 2) ) {
+			break;
+		}
+		pos += elen;
+	}
+
+	if ( ce_len && ce_len <= 65536 && depth < 16 ) {
+		unsigned char	*buf = malloc(ce_len);
+
+		if ( buf && !read_at(iso->fd, buf, ce_len,
+			(long long)ce_block * SECTOR + ce_offset) ) {
+			parse_susp(iso, buf, ce_len, rr, depth + 1);
+		}
+		free(buf);
+	}
+}
+
+
+/* ------------------------------------------------------------- tree */
+
+struct dirqueue {
+	struct {
+		unsigned int	block;
+		unsigned int	size;
+		int		entry;		/* -1 for the root */
+	}		*dirs;
+	int		n;
+	int		cap;
+};
+
+static int
+queue_dir(struct dirqueue *q, unsigned int block, unsigned int size,
+	int entry)
+{
+	if ( q->n == q->cap ) {
+		int	cap = q->cap ? q->cap * 2 : 64;
+		void	*d = realloc(q->dirs, cap * sizeof(q->dirs[0]));
+
+		if ( !d ) {
+			return -1;
+		}
+		q->dirs = d;
+		q->cap	= cap;
+	}
+	q->dirs[q->n].block = block;
+	q->dirs[q->n].size  = size;
+	q->dirs[q->n].entry = entry;
+	q->n++;
+	return 0;
+}
+
+/*
+ * Names come straight from the image (Rock Ridge NM, Joliet), one that
+ * is not a single path component is refused with the whole image.
+ */
+static ISOEntry *
+new_entry(ISOImage *iso, const char *parent, const char *name)
+{
+	ISOEntry	*e;
+	char		*path;
+	size_t		plen = parent ? strlen(parent) : 0;
+
+	if ( !name[0] || !strcmp(name, ".") || !strcmp(name, "..") ||
+		strchr(name, '/') ) {
+		errno = EINVAL;
+		return NULL;
+	}
+	if ( iso->nentries == iso->cap ) {
+		int	cap = iso->cap ? iso->cap * 2 : 256;
+
+		e = realloc(iso->entries, cap * sizeof(ISOEntry));
+		if ( !e ) {
+			return NULL;
+		}
+		iso->entries = e;
+		iso->cap     = cap;
+	}
+	path = malloc(plen + strlen(name) + 2);
+	if ( !path ) {
+		return NULL;
+	}
+	if ( plen ) {
+		sprintf(path, "%s/%s", parent, name);
+	}
+	else {
+		strcpy(path, name);
+	}
+
+	e = &iso->entries[iso->nentries++];
+	memset(e, 0, sizeof(ISOEntry));
+	e->path = path;
+	e->name = path + (plen ? plen + 1 : 0);
+	return e;
+}
+
+static int
+add_extent(ISOEntry *e, unsigned int block, unsigned int size)
+{
+	ISOExtent	*x = realloc(e->extents,
+				(e->nextents + 1) * sizeof(ISOExtent));
+
+	if ( !x ) {
+		return -1;
+	}
+	e->extents = x;
+	e->extents[e->nextents].block = block;
+	e->extents[e->nextents].size  = size;
+	e->nextents++;
+	e->size += size;
+	return 0;
+}
+
+/*
+ * The file name of a record without Rock Ridge: UCS-2 for Joliet,
+ * otherwise lower case with the version and a trailing dot removed.
+ */
+static void
+record_name(const unsigned char *id, int len, int joliet, char *name,
+	size_t size)
+{
+	size_t	n = 0;
+	char	*p;
+	int	i;
+
+	if ( joliet ) {
+		for ( i = 0; i + 1 < len && n + 4 < size; i += 2 ) {
+			unsigned int	c = (id[i] << 8) | id[i + 1];
+
+			if ( c < 0x80 ) {
+				name[n++] = c;
+			}
+			else if ( c < 0x800 ) {
+				name[n++] = 0xc0 | (c >> 6);
+				name[n++] = 0x80 | (c & 0x3f);
+			}
+			else {
+				name[n++] = 0xe0 | (c >> 12);
+				name[n++] = 0x80 | ((c >> 6) & 0x3f);
+				name[n++] = 0x80 | (c & 0x3f);
+			}
+		}
+	}
+	else {
+		for ( i = 0; i < len && n + 1 < size; i++ ) {
+			name[n++] = tolower(id[i]);
+		}
+	}
+	name[n] = '\0';
+
+	if ( (p = strrchr(name, ';')) && strspn(p + 1, "0123456789") ==
+		strlen(p + 1) ) {
+		*p = '\0';
+		n  = p - name;
+	}
+	if ( !joliet && n > 1 && name[n - 1] == '.' ) {
+		name[--n] = '\0';
+	}
+}
+
+static int
+read_dir(ISOImage *iso, struct dirqueue *q, int d, int joliet)
+{
+	unsigned int	block = q->dirs[d].block;
+	unsigned int	size  = q->dirs[d].size;
+	unsigned char	*buf;
+	const char	*parent;
+	char		pname[1024];
+	int		pos = 0, pending = -1;
+
+	if ( size > (1 << 28) ) {
+		errno = EINVAL;
+		return -1;
+	}
+	buf = malloc(size + 1);
+	if ( !buf ) {
+		return -1;
+	}
+	if ( read_at(iso->fd, buf, size, (long long)block * SECTOR) ) {
+		free(buf);
+		return -1;
+	}
+
+	while ( pos < (int)size ) {
+		const unsigned char	*rec = buf + pos;
+		int			len = rec[0], namelen, sulen;
+		const unsigned char	*su;
+		struct rrinfo		rr;
+		char			name[1024];
+		ISOEntry		*e;
+		int			flags;
+
+		if ( len == 0 ) {
+			/* records do not cross sectors */
+			pos = (pos / SECTOR + 1) * SECTOR;
+			continue;
+		}
+		if ( len < 34 || pos + len > (int)size ) {
+			break;
+		}
+		pos    += len;
+		namelen = rec[32];
+		flags	= rec[25];
+		if ( 33 + namelen > len ) {
+			continue;
+		}
+		if ( namelen == 1 && (rec[33] == 0 || rec[33] == 1) ) {
+			continue;		/* . and .. */
+		}
+
+		memset(&rr, 0, sizeof(rr));
+		if ( iso->flags & ISO_ROCKRIDGE ) {
+			su    = rec + 33 + namelen + (namelen % 2 ? 0 : 1) +
+				iso->susp_skip;
+			sulen = len - (su - rec);
+			if ( sulen > 0 ) {
+				parse_susp(iso, su, sulen, &rr, 0);
+			}
+		}
+		if ( rr.relocated ) {
+			continue;
+		}
+		if ( rr.has_name ) {
+			memcpy(name, rr.name, rr.namelen);
+			name[rr.namelen] = '\0';
+		}
+		else {
+			record_name(rec + 33, namelen, joliet, name,
+				sizeof(name));
+		}
+
+		/* the parent path may move when entries grow */
+		parent = NULL;
+		if ( q->dirs[d].entry >= 0 ) {
+			snprintf(pname, sizeof(pname), "%s",
+				iso->entries[q->dirs[d].entry].path);
+			parent = pname;
+		}
+
+		/* more extents of a file bigger than 4GB */
+		if ( pending >= 0 && !strcmp(iso->entries[pending].name, name) ) {
+			if ( add_extent(&iso->entries[pending], le32(rec + 2),
+				le32(rec + 10)) ) {
+				free(buf);
+				return -1;
+			}
+			pending = (flags & 0x80) ? pending : -1;
+			continue;
+		}
+
+		e = new_entry(iso, parent, name);
+		if ( !e ) {
+			free(buf);
+			return -1;
+		}
+		e->mtime = rr.has_mtime ? rr.mtime : short_time(rec + 18);
+
+		if ( (flags & 0x02) || rr.child ) {
+			unsigned int	dblock = le32(rec + 2);
+			unsigned int	dsize  = le32(rec + 10);
+
+			e->mode = S_IFDIR | (rr.mode ? (rr.mode & 07777) : 0555);
+			if ( rr.child ) {
+				unsigned char	dot[SECTOR];
+
+				/* the size is in the . record of the child */
+				if ( read_at(iso->fd, dot, SECTOR,
+					(long long)rr.child * SECTOR) ) {
+					free(buf);
+					return -1;
+				}
+				dblock = rr.child;
+				dsize  = le32(dot + 10);
+			}
+			if ( q->n >= ISO_MAX_DIRS ||
+				queue_dir(q, dblock, dsize, iso->nentries - 1) ) {
+				free(buf);
+				errno = q->n >= ISO_MAX_DIRS ? EINVAL : ENOMEM;
+				return -1;
+			}
+			continue;
+		}
+
+		if ( rr.mode ) {
+			e->mode = rr.mode;
+		}
+		else {
+			e->mode = S_IFREG | 0555;
+		}
+		if ( S_ISLNK(e->mode) ) {
+			e->target = strdup(rr.has_target ? rr.target : "");
+			if ( !e->target ) {
+				free(buf);
+				return -1;
+			}
+		}
+		if ( add_extent(e, le32(rec + 2), le32(rec + 10)) ) {
+			free(buf);
+			return -1;
+		}
+		if ( S_ISLNK(e->mode) ) {
+			e->size = 0;
+		}
+		pending = (flags & 0x80) ? iso->nentries - 1 : -1;
+	}
+
+	free(buf);
+	return 0;
+}
+
+static int
+build_hash(ISOImage *iso)
+{
+	int	i;
+
+	iso->hsize = 64;
+	while ( iso->hsize < (unsigned int)iso->nentries * 2 ) {
+		iso->hsize *= 2;
+	}
+	iso->hash = calloc(iso->hsize, sizeof(int));
+	if ( !iso->hash ) {
+		return -1;
+	}
+	for ( i = 0; i < iso->nentries; i++ ) {
+		unsigned int	h = hash_string(iso->entries[i].path);
+
+		while ( iso->hash[h & (iso->hsize - 1)] ) {
+			h++;
+		}
+		iso->hash[h & (iso->hsize - 1)] = i + 1;
+	}
+	return 0;
+}
+
+
+/*
+ * Opens an image and reads its directory tree.  Returns NULL with
+ * errno set on failure, EINVAL if it is not an ISO9660 image.
+ */
+ISOImage *
+ISOOpen(const char *path)
+{
+	ISOImage		*iso;
+	unsigned char		vd[SECTOR], pvd_root[34], joliet_root[34];
+	unsigned char		*root;
+	struct dirqueue		q;
+	int			i, have_pvd = 0, have_joliet = 0, err;
+
+	iso = calloc(1, sizeof(ISOImage));
+	if ( !iso ) {
+		return NULL;
+	}
+	memset(&q, 0, sizeof(q));
+	iso->fd = open(path, O_RDONLY | O_CLOEXEC);
+	if ( iso->fd < 0 ) {
+		free(iso);
+		return NULL;
+	}
+
+	/* volume descriptors start at sector 16 */
+	for ( i = 16; i < 16 + 64; i++ ) {
+		if ( read_at(iso->fd, vd, SECTOR, (long long)i * SECTOR) ||
+			memcmp(vd + 1, "CD001", 5) ) {
+			break;
+		}
+		if ( vd[0] == 255 ) {
+			break;
+		}
+		if ( vd[0] == 1 && !have_pvd ) {
+			memcpy(pvd_root, vd + 156, 34);
+			have_pvd = 1;
+		}
+		if ( vd[0] == 2 && vd[88] == '%' && vd[89] == '/' &&
+			(vd[90] == '@' || vd[90] == 'C' || vd[90] == 'E') ) {
+			memcpy(joliet_root, vd + 156, 34);
+			have_joliet = 1;
+		}
+	}
+	if ( !have_pvd ) {
+		errno = EINVAL;
+		goto fail;
+	}
+
+	/* Rock Ridge if the root . record starts with SP */
+	{
+		unsigned char	dot[SECTOR];
+		int		len, namelen;
+
+		if ( read_at(iso->fd, dot, SECTOR,
+			(long long)le32(pvd_root + 2) * SECTOR) ) {
+			goto fail;
+		}
+		len	= dot[0];
+		namelen = dot[32];
+		if ( len >= 34 + 7 && 34 + namelen + 7 <= len &&
+			!memcmp(dot + 34, "SP", 2) && dot[38] == 0xbe &&
+			dot[39] == 0xef ) {
+			iso->flags    |= ISO_ROCKRIDGE;
+			iso->susp_skip = dot[40];
+		}
+	}
+	if ( have_joliet ) {
+		iso->flags |= ISO_JOLIET;
+	}
+
+	root = (iso->flags & ISO_ROCKRIDGE || !have_joliet) ? pvd_root :
+		joliet_root;
+	if ( queue_dir(&q, le32(root + 2), le32(root + 10), -1) ) {
+		goto fail;
+	}
+	for ( i = 0; i < q.n; i++ ) {
+		if ( read_dir(iso, &q, i, root == joliet_root) ) {
+			goto fail;
+		}
+	}
+	free(q.dirs);
+	q.dirs = NULL;
+
+	if ( build_hash(iso) ) {
+		goto fail;
+	}
+	return iso;
+
+fail:
+	err = errno;
+	free(q.dirs);
+	ISOClose(iso);
+	errno = err;
+	return NULL;
+} /* ISOOpen */
+
+
+void
+ISOClose(ISOImage *iso)
+{
+	int	i;
+
+	if ( !iso ) {
+		return;
+	}
+	for ( i = 0; i < iso->nentries; i++ ) {
+		free((char *)iso->entries[i].path);
+		free((char *)iso->entries[i].target);
+		free(iso->entries[i].extents);
+	}
+	free(iso->entries);
+	free(iso->hash);
+	if ( iso->fd >= 0 ) {
+		close(iso->fd);
+	}
+	free(iso);
+} /* ISOClose */
+
+
+int
+ISOFlags(const ISOImage *iso)
+{
+	return iso->flags;
+} /* ISOFlags */
+
+
+int
+ISOEntryCount(const ISOImage *iso)
+{
+	return iso->nentries;
+} /* ISOEntryCount */
+
+
+/*
+ * Entries are in breadth first order, a directory always comes before
+ * everything in it.
+ */
+const ISOEntry *
+ISOEntryGet(const ISOImage *iso, int i)
+{
+	if ( i < 0 || i >= iso->nentries ) {
+		return NULL;
+	}
+	return &iso->entries[i];
+} /* ISOEntryGet */
+
+
+const ISOEntry *
+ISOLookup(const ISOImage *iso, const char *path)
+{
+	unsigned int	h;
+	int		i;
+
+	while ( *path == '/' ) {
+		path++;
+	}
+	for ( h = hash_string(path); (i = iso->hash[h & (iso->hsize - 1)]);
+		h++ ) {
+		if ( !strcmp(iso->entries[i - 1].path, path) ) {
+			return &iso->entries[i - 1];
+		}
+	}
+	return NULL;
+} /* ISOLookup */
+
+
+/*
+ * Reads up to len bytes of a file starting at offset.  Returns the
+ * number of bytes read, -1 on error.
+ */
+long long
+ISORead(const ISOImage *iso, const ISOEntry *entry, void *buf, size_t len,
+	long long offset)
+{
+	long long	done = 0, start = 0;
+	int		i;
+
+	for ( i = 0; i < entry->nextents && done < (long long)len; i++ ) {
+		const ISOExtent	*x = &entry->extents[i];
+		long long	skip, n;
+
+		if ( offset >= start + x->size ) {
+			start += x->size;
+			continue;
+		}
+		skip = offset > start ? offset - start : 0;
+		n    = x->size - skip;
+		if ( n > (long long)len - done ) {
+			n = len - done;
+		}
+		if ( read_at(iso->fd, (char *)buf + done, n,
+			(long long)x->block * SECTOR + skip) ) {
+			return -1;
+		}
+		done   += n;
+		offset += n;
+		start  += x->size;
+	}
+	return done;
+} /* ISORead */
+
+
+/* ---------------------------------------------------------- extract */
+
+struct task {
+	int		job;
+	const ISOEntry	*entry;
+	const char	*rel;		/* path under the job destination */
+};
+
+struct pool {
+	ISOExtractJob	*jobs;
+	int		*destfd;	/* per job */
+	struct task	*tasks;
+	int		ntasks;
+	int		next;
+	pthread_mutex_t	lock;
+};
+
+static void
+job_error(struct pool *pool, int job, const char *path, int err)
+{
+	pthread_mutex_lock(&pool->lock);
+	if ( !pool->jobs[job].status ) {
+		pool->jobs[job].status = -1;
+		snprintf(pool->jobs[job].error, sizeof(pool->jobs[job].error),
+			"%s: %s", path, err == ELOOP ?
+			"path goes through a symlink" : strerror(err));
+	}
+	pthread_mutex_unlock(&pool->lock);
+}
+
+/*
+ * Opens the directory that holds path (relative to dirfd), one
+ * component at a time and never through a symlink, so nothing in the
+ * destination can send a copy somewhere else.  Returns the directory
+ * fd and points leaf at the last component, or -1 with errno set.
+ */
+static int
+open_parent(int dirfd, const char *path, const char **leaf)
+{
+	char		name[NAME_MAX + 1];
+	const char	*p = path, *end;
+	int		fd;
+
+	dirfd = openat(dirfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if ( dirfd < 0 ) {
+		return -1;
+	}
+	while ( (end = strchr(p, '/')) ) {
+		if ( end - p > NAME_MAX ) {
+			close(dirfd);
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		memcpy(name, p, end - p);
+		name[end - p] = '\0';
+		fd = openat(dirfd, name,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		close(dirfd);
+		if ( fd < 0 ) {
+			if ( errno == ENOTDIR ) {
+				errno = ELOOP;
+			}
+			return -1;
+		}
+		dirfd = fd;
+		p = end + 1;
+	}
+	*leaf = p;
+	return dirfd;
+}
+
+/* opens the directory path under dirfd */
+static int
+open_dir(int dirfd, const char *path)
+{
+	const char	*leaf;
+	int		fd;
+
+	if ( (dirfd = open_parent(dirfd, path, &leaf)) < 0 ) {
+		return -1;
+	}
+	fd = openat(dirfd, leaf, O_RDONLY | O_DIRECTORY | O_NOFOLLOW |
+		O_CLOEXEC);
+	if ( fd < 0 && errno == ENOTDIR ) {
+		errno = ELOOP;
+	}
+	close(dirfd);
+	return fd;
+}
+
+#if defined(__linux__) && defined(__NR_copy_file_range)
+static int copy_range_works = 1;
+#endif
+
+/*
+ * Copies len bytes at offset of the image to out, in the kernel where
+ * the filesystems allow it.
+ */
+static int
+copy_extent(int in, long long offset, int out, long long len, char **buf)
+{
+#if defined(__linux__) && defined(__NR_copy_file_range)
+	while ( len > 0 && copy_range_works ) {
+		loff_t	off = offset;
+		long	n;
+
+		n = syscall(__NR_copy_file_range, in, &off, out, NULL,
+			(size_t)len, 0);
+		if ( n > 0 ) {
+			offset += n;
+			len    -= n;
+			continue;
+		}
+		if ( n == 0 ) {
+			errno = EINVAL;		/* image shorter than the file */
+			return -1;
+		}
+		if ( errno == EINTR ) {
+			continue;
+		}
+		if ( errno == ENOSYS ) {
+			copy_range_works = 0;
+		}
+		if ( errno != EXDEV && errno != EINVAL && errno != ENOSYS &&
+			errno != EOPNOTSUPP ) {
+			return -1;
+		}
+		break;
+	}
+#endif
+	if ( len > 0 && !*buf ) {
+		*buf = malloc(ISO_COPY_CHUNK);
+		if ( !*buf ) {
+			return -1;
+		}
+	}
+	while ( len > 0 ) {
+		size_t	n = len < ISO_COPY_CHUNK ? len : ISO_COPY_CHUNK;
+		size_t	off = 0;
+
+		if ( read_at(in, *buf, n, offset) ) {
+			return -1;
+		}
+		while ( off < n ) {
+			ssize_t	w = write(out, *buf + off, n - off);
+
+			if ( w < 0 && errno == EINTR ) {
+				continue;
+			}
+			if ( w < 0 ) {
+				return -1;
+			}
+			off += w;
+		}
+		offset += n;
+		len    -= n;
+	}
+	return 0;
+}
+
+static int
+copy_file(int in, int destfd, struct task *t, char **buf)
+{
+	const ISOEntry	*e = t->entry;
+	struct timespec	times[2];
+	long long	left = e->size;
+	const char	*leaf;
+	int		dirfd, fd, i, err;
+
+	if ( (dirfd = open_parent(destfd, t->rel, &leaf)) < 0 ) {
+		return -1;
+	}
+	/* two images may both have the file, the last copy wins */
+	for ( i = 0; ; i++ ) {
+		if ( unlinkat(dirfd, leaf, 0) && errno != ENOENT ) {
+			fd = -1;
+			break;
+		}
+		fd = openat(dirfd, leaf, O_WRONLY | O_CREAT | O_EXCL |
+			O_NOFOLLOW | O_CLOEXEC, 0600);
+		if ( fd >= 0 || errno != EEXIST || i == 8 ) {
+			break;
+		}
+	}
+	err = errno;
+	close(dirfd);
+	if ( fd < 0 ) {
+		errno = err;
+		return -1;
+	}
+	for ( i = 0; i < e->nextents && left > 0; i++ ) {
+		const ISOExtent	*x = &e->extents[i];
+		long long	n = x->size < left ? x->size : left;
+
+		if ( copy_extent(in, (long long)x->block * SECTOR, fd, n,
+			buf) ) {
+			goto fail;
+		}
+		left -= n;
+	}
+
+	times[0].tv_sec  = e->mtime;
+	times[0].tv_nsec = 0;
+	times[1]	 = times[0];
+	if ( fchmod(fd, e->mode & 07777) || futimens(fd, times) ) {
+		goto fail;
+	}
+	return close(fd);
+
+fail:
+	err = errno;
+	close(fd);
+	errno = err;
+	return -1;
+}
+
+static void *
+copy_worker(void *arg)
+{
+	struct pool	*pool = arg;
+	char		*buf = NULL;
+
+	for ( ;; ) {
+		struct task	*t;
+
+		pthread_mutex_lock(&pool->lock);
+		t = (pool->next < pool->ntasks) ? &pool->tasks[pool->next++] :
+			NULL;
+		pthread_mutex_unlock(&pool->lock);
+		if ( !t ) {
+			break;
+		}
+		if ( copy_file(pool->jobs[t->job].image->fd,
+			pool->destfd[t->job], t, &buf) ) {
+			job_error(pool, t->job, t->rel, errno);
+		}
+	}
+	free(buf);
+	return NULL;
+}
+
+/* makes the destination, the caller picked it so it may go through links */
+static int
+make_dirs(const char *path)
+{
+	char	*p, *tmp = strdup(path);
+
+	if ( !tmp ) {
+		return -1;
+	}
+	for ( p = tmp + 1; ; p++ ) {
+		if ( *p == '/' || *p == '\0' ) {
+			char	c = *p;
+
+			*p = '\0';
+			if ( mkdir(tmp, 0755) && errno != EEXIST ) {
+				free(tmp);
+				return -1;
+			}
+			if ( !(*p = c) ) {
+				break;
+			}
+		}
+	}
+	free(tmp);
+	return 0;
+}
+
+/*
+ * Everything but the file contents is done serially: directories and
+ * symbolic links are created here, regular files are queued as tasks.
+ * Paths are relative to the destination directory fd, entries come
+ * after the directory that holds them.
+ */
+static int
+plan_job(struct pool *pool, int j, struct task **tasks, int *ntasks,
+	int *cap, struct task **dirs, int *ndirs, int *dcap)
+{
+	ISOExtractJob	*job = &pool->jobs[j];
+	ISOImage	*iso = job->image;
+	const char	*subdir = job->subdir ? job->subdir : "";
+	size_t		slen;
+	int		i, destfd;
+
+	while ( *subdir == '/' ) {
+		subdir++;
+	}
+	slen = strlen(subdir);
+	if ( slen ) {
+		const ISOEntry	*e = ISOLookup(iso, subdir);
+
+		if ( !e || !S_ISDIR(e->mode) ) {
+			job_error(pool, j, subdir, ENOENT);
+			return -1;
+		}
+	}
+	if ( make_dirs(job->dest) || (destfd = open(job->dest,
+		O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0 ) {
+		job_error(pool, j, job->dest, errno);
+		return -1;
+	}
+	pool->destfd[j] = destfd;
+
+	for ( i = 0; i < iso->nentries; i++ ) {
+		const ISOEntry	*e = &iso->entries[i];
+		const char	*rel = e->path, *leaf;
+		int		dirfd;
+
+		if ( slen ) {
+			if ( strncmp(rel, subdir, slen) || rel[slen] != '/' ) {
+				continue;
+			}
+			rel += slen + 1;
+		}
+		if ( !S_ISDIR(e->mode) && !strcmp(e->name, "TRANS.TBL") ) {
+			continue;
+		}
+		if ( !S_ISDIR(e->mode) && !S_ISREG(e->mode) &&
+			!S_ISLNK(e->mode) ) {
+			continue;		/* devices and fifos */
+		}
+
+		if ( S_ISDIR(e->mode) ) {
+			struct stat	st;
+			int		fd;
+
+			/* writable until everything is in it */
+			if ( (dirfd = open_parent(destfd, rel, &leaf)) < 0 ) {
+				job_error(pool, j, rel, errno);
+				return -1;
+			}
+			if ( mkdirat(dirfd, leaf, 0700) && (errno != EEXIST ||
+				fstatat(dirfd, leaf, &st, AT_SYMLINK_NOFOLLOW) ||
+				!S_ISDIR(st.st_mode)) ) {
+				job_error(pool, j, rel, errno == EEXIST ?
+					(S_ISLNK(st.st_mode) ? ELOOP : EEXIST) :
+					errno);
+				close(dirfd);
+				return -1;
+			}
+			fd = openat(dirfd, leaf, O_RDONLY | O_DIRECTORY |
+				O_NOFOLLOW | O_CLOEXEC);
+			close(dirfd);
+			if ( fd < 0 || fchmod(fd, 0700) ) {
+				job_error(pool, j, rel, errno);
+				if ( fd >= 0 ) {
+					close(fd);
+				}
+				return -1;
+			}
+			close(fd);
+			if ( *ndirs == *dcap ) {
+				int	c = *dcap ? *dcap * 2 : 64;
+				void	*d = realloc(*dirs, c * sizeof(**dirs));
+
+				if ( !d ) {
+					return -1;
+				}
+				*dirs = d;
+				*dcap = c;
+			}
+			(*dirs)[*ndirs].job   = j;
+			(*dirs)[*ndirs].entry = e;
+			(*dirs)[*ndirs].rel   = rel;
+			(*ndirs)++;
+		}
+		else if ( S_ISLNK(e->mode) ) {
+			struct timespec	times[2];
+
+			times[0].tv_sec  = e->mtime;
+			times[0].tv_nsec = 0;
+			times[1]	 = times[0];
+			if ( (dirfd = open_parent(destfd, rel, &leaf)) < 0 ) {
+				job_error(pool, j, rel, errno);
+				return -1;
+			}
+			if ( (unlinkat(dirfd, leaf, 0) && errno != ENOENT) ||
+				symlinkat(e->target, dirfd, leaf) ||
+				utimensat(dirfd, leaf, times,
+				AT_SYMLINK_NOFOLLOW) ) {
+				job_error(pool, j, rel, errno);
+				close(dirfd);
+				return -1;
+			}
+			close(dirfd);
+		}
+		else {
+			if ( *ntasks == *cap ) {
+				int	c = *cap ? *cap * 2 : 256;
+				void	*t = realloc(*tasks, c * sizeof(**tasks));
+
+				if ( !t ) {
+					return -1;
+				}
+				*tasks = t;
+				*cap   = c;
+			}
+			(*tasks)[*ntasks].job	= j;
+			(*tasks)[*ntasks].entry = e;
+			(*tasks)[*ntasks].rel	= rel;
+			(*ntasks)++;
+		}
+	}
+	return 0;
+}
+
+/*
+ * Copies several images (or several subtrees of one) at once.  File
+ * contents are copied by nthreads threads (0 means one per CPU) with
+ * copy_file_range(2) where the kernel supports it.  Returns the number
+ * of jobs that failed, see the status and error of each job.
+ */
+int
+ISOExtractMany(ISOExtractJob *jobs, int njobs, int nthreads)
+{
+	pthread_t	threads[ISO_MAX_THREADS];
+	struct pool	pool;
+	struct task	*dirs = NULL;
+	int		i, started = 0, failed = 0, cap = 0, ndirs = 0, dcap = 0;
+
+	memset(&pool, 0, sizeof(pool));
+	pool.jobs = jobs;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for ( i = 0; i < njobs; i++ ) {
+		jobs[i].status	 = 0;
+		jobs[i].error[0] = '\0';
+	}
+	pool.destfd = malloc((njobs > 0 ? njobs : 1) * sizeof(int));
+	for ( i = 0; i < njobs; i++ ) {
+		if ( !pool.destfd ) {
+			job_error(&pool, i, jobs[i].dest, ENOMEM);
+			continue;
+		}
+		pool.destfd[i] = -1;
+		if ( plan_job(&pool, i, &pool.tasks, &pool.ntasks, &cap,
+			&dirs, &ndirs, &dcap) && !jobs[i].status ) {
+			job_error(&pool, i, jobs[i].dest, ENOMEM);
+		}
+	}
+
+	if ( nthreads <= 0 ) {
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if ( nthreads > pool.ntasks ) {
+		nthreads = pool.ntasks;
+	}
+	if ( nthreads > ISO_MAX_THREADS ) {
+		nthreads = ISO_MAX_THREADS;
+	}
+	for ( i = 1; i < nthreads; i++ ) {
+		if ( pthread_create(&threads[started], NULL, copy_worker,
+			&pool) == 0 ) {
+			started++;
+		}
+	}
+	copy_worker(&pool);
+	for ( i = 0; i < started; i++ ) {
+		pthread_join(threads[i], NULL);
+	}
+
+	/* deepest first so the parent mtime is not disturbed */
+	for ( i = ndirs - 1; i >= 0; i-- ) {
+		const ISOEntry	*e = dirs[i].entry;
+		struct timespec	times[2];
+		int		fd;
+
+		times[0].tv_sec  = e->mtime;
+		times[0].tv_nsec = 0;
+		times[1]	 = times[0];
+		fd = open_dir(pool.destfd[dirs[i].job], dirs[i].rel);
+		if ( fd < 0 || fchmod(fd, (e->mode & 07777) | 0555) ||
+			futimens(fd, times) ) {
+			job_error(&pool, dirs[i].job, dirs[i].rel, errno);
+		}
+		if ( fd >= 0 ) {
+			close(fd);
+		}
+	}
+	free(dirs);
+	free(pool.tasks);
+	for ( i = 0; pool.destfd && i < njobs; i++ ) {
+		if ( pool.destfd[i] >= 0 ) {
+			close(pool.destfd[i]);
+		}
+	}
+	free(pool.destfd);
+	pthread_mutex_destroy(&pool.lock);
+
+	for ( i = 0; i < njobs; i++ ) {
+		if ( jobs[i].status ) {
+			failed++;
+		}
+	}
+	return failed;
+} /* ISOExtractMany */
@@ -0,0 +1,394 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/isoread.h"
+
+#define SECTOR	2048
+
+static int failed;
+
+/* 2001-02-03 04:05:06 GMT */
+static const unsigned char date[7] = { 101, 2, 3, 4, 5, 6, 0 };
+#define MTIME	981173106
+
+static void
+both32(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+	p[4] = v >> 24;
+	p[5] = v >> 16;
+	p[6] = v >> 8;
+	p[7] = v;
+}
+
+static int
+susp(unsigned char *p, const char *sig, const void *data, int len)
+{
+	p[0] = sig[0];
+	p[1] = sig[1];
+	p[2] = len + 4;
+	p[3] = 1;
+	memcpy(p + 4, data, len);
+	return len + 4;
+}
+
+static int
+px(unsigned char *p, unsigned int mode)
+{
+	unsigned char	data[32];
+
+	memset(data, 0, sizeof(data));
+	both32(data, mode);
+	both32(data + 8, 1);
+	return susp(p, "PX", data, sizeof(data));
+}
+
+static int
+nm(unsigned char *p, const char *name)
+{
+	unsigned char	data[256];
+
+	data[0] = 0;
+	memcpy(data + 1, name, strlen(name));
+	return susp(p, "NM", data, strlen(name) + 1);
+}
+
+static int
+tf(unsigned char *p)
+{
+	unsigned char	data[8];
+
+	data[0] = 0x02;				/* modify only */
+	memcpy(data + 1, date, 7);
+	return susp(p, "TF", data, sizeof(data));
+}
+
+/*
+ * Appends a directory record to p, returns its length.
+ */
+static int
+record(unsigned char *p, unsigned int block, unsigned int size, int flags,
+	const char *id, int idlen, const unsigned char *su, int sulen)
+{
+	int	len = 33 + idlen + (idlen % 2 ? 0 : 1) + sulen;
+
+	memset(p, 0, len);
+	p[0] = len;
+	both32(p + 2, block);
+	both32(p + 10, size);
+	memcpy(p + 18, date, 7);
+	p[18] = 105;			/* not the Rock Ridge date */
+	p[25] = flags;
+	p[28] = 1;
+	p[31] = 1;
+	p[32] = idlen;
+	memcpy(p + 33, id, idlen);
+	if ( sulen ) {
+		memcpy(p + len - sulen, su, sulen);
+	}
+	return len;
+}
+
+/*
+ * A 24 sector image:
+ *
+ *	/roll-foo/a.rpm		"rpm", 0600
+ *	/ReadMe.txt		"hello", 0644, 2001-02-03
+ *	/link			-> /etc/hosts
+ *	/TRANS.TBL
+ *	/big			2048 'A's and 5 'B's in two extents
+ *
+ * readme is the Rock Ridge name of ReadMe.txt.
+ */
+static void
+write_image(const char *path, int rr, const char *readme)
+{
+	unsigned char	*img = calloc(24, SECTOR);
+	unsigned char	*pvd = img + 16 * SECTOR;
+	unsigned char	*root = img + 18 * SECTOR;
+	unsigned char	*sub = img + 19 * SECTOR;
+	unsigned char	su[256];
+	int		n, pos;
+	FILE		*f;
+
+	pvd[0] = 1;
+	memcpy(pvd + 1, "CD001", 5);
+	pvd[6] = 1;
+	record(pvd + 156, 18, SECTOR, 0x02, "", 1, NULL, 0);
+	img[17 * SECTOR] = 255;
+	memcpy(img + 17 * SECTOR + 1, "CD001", 5);
+
+	/* root */
+	n = 0;
+	if ( rr ) {
+		unsigned char	sp[3] = { 0xbe, 0xef, 0 };
+
+		n += susp(su, "SP", sp, 3);
+		n += px(su + n, 040755);
+	}
+	pos  = record(root, 18, SECTOR, 0x02, "\0", 1, su, n);
+	pos += record(root + pos, 18, SECTOR, 0x02, "\1", 1, NULL, 0);
+
+	n = rr ? px(su, 040755) : 0;
+	pos += record(root + pos, 19, SECTOR, 0x02, "ROLL_FOO", 8, su, n);
+
+	n = 0;
+	if ( rr ) {
+		n += px(su, 0100644);
+		n += nm(su + n, readme);
+		n += tf(su + n);
+	}
+	pos += record(root + pos, 20, 5, 0, "README.TXT;1", 12, su, n);
+
+	if ( rr ) {
+		unsigned char	sl[] = { 0, 8, 0, 0, 3, 'e', 't', 'c',
+			0, 5, 'h', 'o', 's', 't', 's' };
+
+		n  = px(su, 0120777);
+		n += nm(su + n, "link");
+		n += susp(su + n, "SL", sl, sizeof(sl));
+		pos += record(root + pos, 0, 0, 0, "LINK.;1", 7, su, n);
+	}
+
+	n = rr ? px(su, 0100444) : 0;
+	pos += record(root + pos, 20, 5, 0, "TRANS.TBL;1", 11, su, n);
+
+	n = rr ? px(su, 0100644) : 0;
+	pos += record(root + pos, 21, SECTOR, 0x80, "BIG.;1", 6, su, n);
+	pos += record(root + pos, 22, 5, 0, "BIG.;1", 6, su, n);
+
+	/* roll-foo */
+	n = rr ? px(su, 040755) : 0;
+	pos  = record(sub, 19, SECTOR, 0x02, "\0", 1, su, n);
+	pos += record(sub + pos, 18, SECTOR, 0x02, "\1", 1, NULL, 0);
+	n = rr ? px(su, 0100600) : 0;
+	pos += record(sub + pos, 23, 3, 0, "A.RPM;1", 7, su, n);
+
+	memcpy(img + 20 * SECTOR, "hello", 5);
+	memset(img + 21 * SECTOR, 'A', SECTOR);
+	memcpy(img + 22 * SECTOR, "BBBBB", 5);
+	memcpy(img + 23 * SECTOR, "rpm", 3);
+
+	f = fopen(path, "w");
+	fwrite(img, SECTOR, 24, f);
+	fclose(f);
+	free(img);
+}
+
+static void
+check(int ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if ( !ok ) {
+		failed++;
+	}
+}
+
+static void
+check_file(const char *dir, const char *path, const char *data,
+	unsigned int mode)
+{
+	char		full[1024], buf[4096];
+	struct stat	st;
+	FILE		*f;
+	size_t		n = 0;
+
+	snprintf(full, sizeof(full), "%s/%s", dir, path);
+	if ( lstat(full, &st) ) {
+		check(!data, path);
+		return;
+	}
+	if ( !data ) {
+		check(0, path);
+		return;
+	}
+	if ( (f = fopen(full, "r")) ) {
+		n = fread(buf, 1, sizeof(buf) - 1, f);
+		fclose(f);
+	}
+	buf[n] = '\0';
+	check(!strcmp(buf, data) && (st.st_mode & 07777) == mode, path);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char		dir[] = "/tmp/isoread_test.XXXXXX";
+	char		rr[256], plain[256], out[256], cmd[512], buf[16];
+	char		outside[256];
+	ISOImage	*iso, *iso2;
+	const ISOEntry	*e;
+	ISOExtractJob	jobs[3];
+	struct stat	st;
+
+	if ( !mkdtemp(dir) ) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(rr, sizeof(rr), "%s/rr.iso", dir);
+	snprintf(plain, sizeof(plain), "%s/plain.iso", dir);
+	write_image(rr, 1, "ReadMe.txt");
+	write_image(plain, 0, "ReadMe.txt");
+
+	iso = ISOOpen(rr);
+	if ( !iso ) {
+		perror(rr);
+		return 1;
+	}
+	check(ISOFlags(iso) == ISO_ROCKRIDGE, "rock ridge");
+	check(ISOEntryCount(iso) == 6, "entry count");
+	check(ISOEntryGet(iso, 0) && !strcmp(ISOEntryGet(iso, 0)->path,
+		"roll_foo"), "breadth first");
+
+	e = ISOLookup(iso, "/ReadMe.txt");
+	check(e && e->mode == 0100644 && e->size == 5 && e->mtime == MTIME,
+		"NM, PX and TF");
+	check(e && ISORead(iso, e, buf, 3, 1) == 3 && !memcmp(buf, "ell", 3),
+		"read");
+
+	e = ISOLookup(iso, "link");
+	check(e && S_ISLNK(e->mode) && !strcmp(e->target, "/etc/hosts"), "SL");
+
+	e = ISOLookup(iso, "big");
+	check(e && e->nextents == 2 && e->size == SECTOR + 5, "multi-extent");
+	check(e && ISORead(iso, e, buf, 8, SECTOR - 2) == 7 &&
+		!memcmp(buf, "AABBBBB", 7), "read across extents");
+	check(!ISOLookup(iso, "nope"), "missing lookup");
+
+	iso2 = ISOOpen(plain);
+	if ( !iso2 ) {
+		perror(plain);
+		return 1;
+	}
+	check(ISOFlags(iso2) == 0, "plain");
+	e = ISOLookup(iso2, "readme.txt");
+	check(e && e->mode == 0100555 && e->mtime == 1107403506,
+		"plain name and mode");
+	check(ISOLookup(iso2, "roll_foo/a.rpm") != NULL, "plain subdir");
+
+	/* two images at once, the same directory twice */
+	snprintf(out, sizeof(out), "%s/out", dir);
+	memset(jobs, 0, sizeof(jobs));
+	jobs[0].image  = iso;
+	jobs[0].subdir = "";
+	jobs[0].dest   = out;
+	jobs[1].image  = iso2;
+	jobs[1].subdir = "roll_foo";
+	jobs[1].dest   = out;
+	jobs[2].image  = iso;
+	jobs[2].subdir = "nope";
+	jobs[2].dest   = out;
+	check(ISOExtractMany(jobs, 3, 4) == 1 && !jobs[0].status &&
+		!jobs[1].status && jobs[2].status, "extract statuses");
+	printf("     nope: %s\n", jobs[2].error);
+
+	check_file(out, "ReadMe.txt", "hello", 0644);
+	check_file(out, "roll_foo/a.rpm", "rpm", 0600);
+	check_file(out, "a.rpm", "rpm", 0555);
+	check_file(out, "TRANS.TBL", NULL, 0);
+	snprintf(cmd, sizeof(cmd), "%s/big", out);
+	check(!stat(cmd, &st) && st.st_size == SECTOR + 5, "big size");
+	snprintf(cmd, sizeof(cmd), "%s/ReadMe.txt", out);
+	check(!stat(cmd, &st) && st.st_mtime == MTIME, "mtime");
+	snprintf(cmd, sizeof(cmd), "%s/link", out);
+	check(readlink(cmd, buf, sizeof(buf)) == 10 && !memcmp(buf,
+		"/etc/hosts", 10), "symlink");
+	snprintf(cmd, sizeof(cmd), "%s/roll_foo", out);
+	check(!stat(cmd, &st) && (st.st_mode & 07777) == 0755, "directory");
+
+	/* again, over the top of the first copy */
+	check(ISOExtractMany(jobs, 2, 0) == 0, "extract again");
+
+	/* a symlink in the destination is not followed */
+	snprintf(out, sizeof(out), "%s/out2", dir);
+	snprintf(outside, sizeof(outside), "%s/outside", dir);
+	mkdir(out, 0755);
+	mkdir(outside, 0755);
+	snprintf(cmd, sizeof(cmd), "%s/roll_foo", out);
+	symlink(outside, cmd);
+	jobs[0].dest = out;
+	check(ISOExtractMany(jobs, 1, 0) == 1 && jobs[0].status,
+		"symlink in the destination");
+	printf("     %s\n", jobs[0].error);
+	check_file(outside, "a.rpm", NULL, 0);
+
+	/* names that are not one path component */
+	snprintf(cmd, sizeof(cmd), "%s/bad.iso", dir);
+	write_image(cmd, 1, "../x");
+	check(!ISOOpen(cmd) && errno == EINVAL, "NM with ..");
+	write_image(cmd, 1, "a/b");
+	check(!ISOOpen(cmd) && errno == EINVAL, "NM with /");
+	write_image(cmd, 1, ".");
+	check(!ISOOpen(cmd) && errno == EINVAL, "NM of .");
+
+	ISOClose(iso);
+	ISOClose(iso2);
+	snprintf(cmd, sizeof(cmd), "chmod -R u+w %s; rm -rf %s", dir, dir);
+	if ( system(cmd) ) {
+		failed++;
+	}
+	return failed ? 1 : 0;
+} /* main */
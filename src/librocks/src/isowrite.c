@@ -0,0 +1,2005 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "../include/isowrite.h"
+#include "../include/md5sum.h"
+
+#define SECTOR			2048
+#define ISOWRITE_MAX_THREADS	32
+#define MAX_DEPTH		8	/* root is 1 */
+#define MAX_RECORD		255
+#define PAD_SECTORS		150	/* mkisofs -pad */
+#define SKIP_SECTORS		15	/* not in the implanted checksum */
+#define APPDATA_OFFSET		883
+#define APPDATA_SIZE		512
+#define JOLIET_MAX		64	/* UCS-2 characters */
+#define HYBRID_SIGNATURE	0x7078a0fb
+#define OUT_BUFFER		(1 << 20)
+
+#define RR_PX			0x01
+#define RR_NM			0x08
+#define RR_TF			0x80
+
+#define SIZE_RR			5
+#define SIZE_PX			36
+#define SIZE_TF			26
+#define SIZE_CE			28
+#define SIZE_SP			7
+
+#define ER_ID	"RRIP_1991A"
+#define ER_DES	"THE ROCK RIDGE INTERCHANGE PROTOCOL PROVIDES SUPPORT FOR " \
+		"POSIX FILE SYSTEM SEMANTICS"
+#define ER_SRC	"PLEASE CONTACT DISC PUBLISHER FOR SPECIFICATION SOURCE.  " \
+		"SEE PUBLISHER IDENTIFIER IN PRIMARY VOLUME DESCRIPTOR FOR " \
+		"CONTACT INFORMATION."
+
+enum {
+	NODE_DIR,
+	NODE_FILE,
+	NODE_TRANSTBL,		/* generated, in data */
+	NODE_CATALOG		/* the El Torito boot catalog */
+};
+
+struct node {
+	char		*name;
+	char		*src;		/* path on disk */
+	struct stat	st;
+	int		kind;
+	struct node	*parent;
+	struct node	**kids;		/* in ISO9660 order */
+	struct node	**jkids;	/* in Joliet order */
+	int		nkids;
+	int		cap;
+	char		iso[16];	/* ISO9660 identifier */
+	int		isolen;
+	unsigned char	jname[2 * JOLIET_MAX + 4];
+	int		jlen;
+	unsigned int	block;
+	long long	size;
+	unsigned char	*data;		/* contents of generated files */
+	struct node	*same;		/* hard link to an earlier file */
+	int		ce_offset;	/* NM in the parent's continuation area */
+	int		ce_len;
+	int		subdirs;
+	/* directories */
+	unsigned int	dirblock;
+	unsigned int	dirsize;
+	unsigned char	*ce;		/* Rock Ridge continuation area */
+	int		celen;
+	int		cecap;
+	unsigned int	ceblock;	/* follows the directory */
+	unsigned int	jdirblock;
+	unsigned int	jdirsize;
+	int		num;		/* path table numbers */
+	int		jnum;
+};
+
+struct nodelist {
+	struct node	**nodes;
+	int		n;
+	int		cap;
+};
+
+struct writer {
+	ISOWriteJob	*job;
+	struct node	*root;
+	struct nodelist	dirs;		/* breadth first, ISO9660 order */
+	struct nodelist	jdirs;		/* breadth first, Joliet order */
+	struct nodelist	files;		/* in the order they are written */
+	struct nodelist	all;		/* everything, for cleanup */
+	int		er_offset;	/* in the root continuation area */
+	int		er_len;
+	unsigned int	pathsize;
+	unsigned int	lpath;
+	unsigned int	mpath;
+	unsigned int	jpathsize;
+	unsigned int	jlpath;
+	unsigned int	jmpath;
+	struct node	*boot;
+	struct node	*efi;
+	struct node	*catalog;
+	unsigned int	volsize;	/* sectors */
+	time_t		now;
+
+	/* output */
+	int		fd;
+	unsigned char	*buf;
+	size_t		buflen;
+	long long	written;
+	long long	md5_limit;
+	MD5Sum		md5;
+};
+
+
+/* ------------------------------------------------------------ utils */
+
+static int
+fail(struct writer *w, const char *fmt, ...)
+{
+	va_list	ap;
+
+	if ( !w->job->status ) {
+		va_start(ap, fmt);
+		vsnprintf(w->job->error, sizeof(w->job->error), fmt, ap);
+		va_end(ap);
+		w->job->status = -1;
+	}
+	return -1;
+}
+
+static void
+le16(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+}
+
+static void
+le32(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static void
+be16(unsigned char *p, unsigned int v)
+{
+	p[0] = v >> 8;
+	p[1] = v;
+}
+
+static void
+be32(unsigned char *p, unsigned int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void
+both16(unsigned char *p, unsigned int v)
+{
+	le16(p, v);
+	be16(p + 2, v);
+}
+
+static void
+both32(unsigned char *p, unsigned int v)
+{
+	le32(p, v);
+	be32(p + 4, v);
+}
+
+static unsigned int
+sectors(long long bytes)
+{
+	return (bytes + SECTOR - 1) / SECTOR;
+}
+
+static int
+list_add(struct nodelist *l, struct node *n)
+{
+	if ( l->n == l->cap ) {
+		int	cap = l->cap ? l->cap * 2 : 64;
+		void	*p = realloc(l->nodes, cap * sizeof(struct node *));
+
+		if ( !p ) {
+			return -1;
+		}
+		l->nodes = p;
+		l->cap	 = cap;
+	}
+	l->nodes[l->n++] = n;
+	return 0;
+}
+
+static void
+short_date(unsigned char *p, time_t t)
+{
+	struct tm	tm;
+
+	gmtime_r(&t, &tm);
+	p[0] = tm.tm_year;
+	p[1] = tm.tm_mon + 1;
+	p[2] = tm.tm_mday;
+	p[3] = tm.tm_hour;
+	p[4] = tm.tm_min;
+	p[5] = tm.tm_sec;
+	p[6] = 0;
+}
+
+static void
+long_date(unsigned char *p, time_t t)
+{
+	struct tm	tm;
+	char		buf[20];
+
+	gmtime_r(&t, &tm);
+	strftime(buf, sizeof(buf), "%Y%m%d%H%M%S00", &tm);
+	memcpy(p, buf, 16);
+	p[16] = 0;
+}
+
+static void
+pad_string(unsigned char *p, const char *s, int len)
+{
+	int	n = s ? strlen(s) : 0;
+
+	memset(p, ' ', len);
+	if ( n ) {
+		memcpy(p, s, n < len ? n : len);
+	}
+}
+
+/*
+ * UCS-2 big endian, padded with UCS-2 spaces.
+ */
+static void
+pad_ucs2(unsigned char *p, const char *s, int len)
+{
+	int	i;
+
+	for ( i = 0; i + 1 < len; i += 2 ) {
+		p[i]	 = 0;
+		p[i + 1] = (s && *s) ? (unsigned char)*s++ : ' ';
+	}
+}
+
+
+/* ------------------------------------------------------------ names */
+
+static char
+d_char(int c)
+{
+	c = toupper(c);
+	if ( (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ) {
+		return c;
+	}
+	return '_';
+}
+
+/*
+ * Level 1 names: 8.3 upper case d-characters, ";1" on files, and a
+ * three digit number at the end of the name when two collide.
+ */
+static void
+iso_name(struct node *n, int serial)
+{
+	const char	*dot = n->kind == NODE_DIR ? NULL : strrchr(n->name, '.');
+	char		base[9], ext[4];
+	int		i, blen = 0, elen = 0;
+
+	if ( dot == n->name ) {
+		dot = NULL;		/* .discinfo */
+	}
+	for ( i = 0; n->name[i] && (!dot || n->name + i < dot) && blen < 8;
+		i++ ) {
+		base[blen++] = d_char(n->name[i]);
+	}
+	for ( i = 1; dot && dot[i] && elen < 3; i++ ) {
+		ext[elen++] = d_char(dot[i]);
+	}
+	if ( serial ) {
+		if ( blen > 5 ) {
+			blen = 5;
+		}
+		blen += sprintf(base + blen, "%03d", serial % 1000);
+	}
+	base[blen] = '\0';
+	ext[elen]  = '\0';
+
+	if ( n->kind == NODE_DIR ) {
+		n->isolen = sprintf(n->iso, "%s", base);
+	}
+	else {
+		n->isolen = sprintf(n->iso, "%s.%s;1", base, ext);
+	}
+}
+
+/*
+ * UTF-8 to UCS-2, without the characters Joliet does not allow.
+ */
+static void
+joliet_name(struct node *n)
+{
+	const unsigned char	*s = (const unsigned char *)n->name;
+	int			chars = 0;
+
+	n->jlen = 0;
+	while ( *s && chars < JOLIET_MAX ) {
+		unsigned int	c = *s++;
+
+		if ( c >= 0xe0 && (s[0] & 0xc0) == 0x80 &&
+			(s[1] & 0xc0) == 0x80 ) {
+			c = ((c & 0x0f) << 12) | ((s[0] & 0x3f) << 6) |
+				(s[1] & 0x3f);
+			s += 2;
+		}
+		else if ( c >= 0xc0 && (s[0] & 0xc0) == 0x80 ) {
+			c = ((c & 0x1f) << 6) | (s[0] & 0x3f);
+			s += 1;
+		}
+		else if ( c >= 0x80 ) {
+			c = '_';
+		}
+		if ( c < 0x20 || strchr("*/:;?\\", c) ) {
+			c = '_';
+		}
+		n->jname[n->jlen++] = c >> 8;
+		n->jname[n->jlen++] = c;
+		chars++;
+	}
+	if ( n->kind != NODE_DIR ) {
+		memcpy(n->jname + n->jlen, "\0;\0" "1", 4);
+		n->jlen += 4;
+	}
+}
+
+static int
+cmp_iso(const void *a, const void *b)
+{
+	const struct node	*x = *(struct node * const *)a;
+	const struct node	*y = *(struct node * const *)b;
+
+	int			rc = strcmp(x->iso, y->iso);
+
+	return rc ? rc : strcmp(x->name, y->name);
+}
+
+static int
+cmp_joliet(const void *a, const void *b)
+{
+	const struct node	*x = *(struct node * const *)a;
+	const struct node	*y = *(struct node * const *)b;
+	int			n = x->jlen < y->jlen ? x->jlen : y->jlen;
+	int			rc = memcmp(x->jname, y->jname, n);
+
+	return rc ? rc : x->jlen - y->jlen;
+}
+
+static int
+name_directory(struct writer *w, struct node *d)
+{
+	int	i;
+
+	for ( i = 0; i < d->nkids; i++ ) {
+		iso_name(d->kids[i], 0);
+		joliet_name(d->kids[i]);
+	}
+	qsort(d->kids, d->nkids, sizeof(struct node *), cmp_iso);
+	for ( i = 1; i < d->nkids; i++ ) {
+		int	serial = 0, j;
+
+		/* number the later ones until nothing collides */
+		while ( !strcmp(d->kids[i]->iso, d->kids[i - 1]->iso) ) {
+			iso_name(d->kids[i], ++serial);
+			for ( j = 0; j < d->nkids; j++ ) {
+				if ( j != i &&
+					!strcmp(d->kids[i]->iso, d->kids[j]->iso) ) {
+					break;
+				}
+			}
+			if ( j == d->nkids ) {
+				break;
+			}
+			if ( serial == 999 ) {
+				return fail(w, "%s: too many similar names",
+					d->src);
+			}
+		}
+	}
+	qsort(d->kids, d->nkids, sizeof(struct node *), cmp_iso);
+
+	memcpy(d->jkids, d->kids, d->nkids * sizeof(struct node *));
+	qsort(d->jkids, d->nkids, sizeof(struct node *), cmp_joliet);
+	for ( i = 1; i < d->nkids; i++ ) {
+		if ( !cmp_joliet(&d->jkids[i], &d->jkids[i - 1]) ) {
+			return fail(w, "%s/%s: Joliet name is not unique",
+				d->src, d->jkids[i]->name);
+		}
+	}
+	return 0;
+}
+
+
+/* ------------------------------------------------------------- scan */
+
+static struct node *
+new_node(struct writer *w, struct node *parent, const char *name,
+	const char *src, int kind)
+{
+	struct node	*n = calloc(1, sizeof(struct node));
+
+	if ( !n || list_add(&w->all, n) ) {
+		free(n);
+		return NULL;
+	}
+	n->name	  = strdup(name);
+	n->src	  = src ? strdup(src) : NULL;
+	n->kind	  = kind;
+	n->parent = parent ? parent : n;
+	if ( !n->name || (src && !n->src) ) {
+		return NULL;
+	}
+	if ( parent ) {
+		if ( parent->nkids == parent->cap ) {
+			int	cap = parent->cap ? parent->cap * 2 : 16;
+			void	*k = realloc(parent->kids,
+					cap * sizeof(struct node *));
+			void	*j;
+
+			if ( !k ) {
+				return NULL;
+			}
+			parent->kids = k;
+			j = realloc(parent->jkids, cap * sizeof(struct node *));
+			if ( !j ) {
+				return NULL;
+			}
+			parent->jkids = j;
+			parent->cap   = cap;
+		}
+		parent->kids[parent->nkids++] = n;
+		if ( kind == NODE_DIR ) {
+			parent->subdirs++;
+		}
+	}
+	return n;
+}
+
+static int
+is_ancestor(struct node *d, struct stat *st)
+{
+	for ( ;; d = d->parent ) {
+		if ( d->st.st_dev == st->st_dev && d->st.st_ino == st->st_ino ) {
+			return 1;
+		}
+		if ( d->parent == d ) {
+			return 0;
+		}
+	}
+}
+
+/*
+ * Reads one directory, following symbolic links like mkisofs -f.
+ * Links that point nowhere, devices and loops are left out.
+ */
+static int
+scan_directory(struct writer *w, struct node *d, int depth)
+{
+	DIR		*dir;
+	struct dirent	*e;
+	char		*path;
+	int		rc = 0;
+
+	dir = opendir(d->src);
+	if ( !dir ) {
+		return fail(w, "%s: %s", d->src, strerror(errno));
+	}
+	while ( !rc && (e = readdir(dir)) ) {
+		struct stat	st;
+		struct node	*n;
+
+		if ( !strcmp(e->d_name, ".") || !strcmp(e->d_name, "..") ) {
+			continue;
+		}
+		if ( (w->job->flags & ISOWRITE_TRANSTBL) &&
+			!strcmp(e->d_name, "TRANS.TBL") ) {
+			continue;
+		}
+		if ( asprintf(&path, "%s/%s", d->src, e->d_name) < 0 ) {
+			rc = fail(w, "%s", strerror(ENOMEM));
+			break;
+		}
+		if ( stat(path, &st) ||
+			(!S_ISDIR(st.st_mode) && !S_ISREG(st.st_mode)) ||
+			(S_ISDIR(st.st_mode) && is_ancestor(d, &st)) ) {
+			free(path);
+			continue;
+		}
+		if ( S_ISDIR(st.st_mode) && depth + 1 > MAX_DEPTH ) {
+			rc = fail(w, "%s: more than %d directory levels", path,
+				MAX_DEPTH);
+		}
+		else if ( S_ISREG(st.st_mode) &&
+			st.st_size > 0xffffffffLL - SECTOR ) {
+			rc = fail(w, "%s: 4GB or larger", path);
+		}
+		else if ( !(n = new_node(w, d, e->d_name, path,
+			S_ISDIR(st.st_mode) ? NODE_DIR : NODE_FILE)) ) {
+			rc = fail(w, "%s", strerror(ENOMEM));
+		}
+		else {
+			n->st	= st;
+			n->size = S_ISREG(st.st_mode) ? st.st_size : 0;
+		}
+		free(path);
+	}
+	closedir(dir);
+	return rc;
+}
+
+static struct node *
+find_node(struct node *root, const char *path)
+{
+	struct node	*d = root;
+	const char	*p = path;
+
+	while ( d && *p ) {
+		const char	*slash = strchr(p, '/');
+		size_t		len = slash ? (size_t)(slash - p) : strlen(p);
+		struct node	*next = NULL;
+		int		i;
+
+		if ( len && !(len == 1 && *p == '.') ) {
+			for ( i = 0; i < d->nkids; i++ ) {
+				if ( strlen(d->kids[i]->name) == len &&
+					!strncmp(d->kids[i]->name, p, len) ) {
+					next = d->kids[i];
+					break;
+				}
+			}
+			d = next;
+		}
+		p += len;
+		while ( *p == '/' ) {
+			p++;
+		}
+	}
+	return d;
+}
+
+/*
+ * The boot catalog is a file in the tree whose contents are generated,
+ * it replaces any file of the same name.
+ */
+static int
+add_catalog(struct writer *w)
+{
+	const char	*slash = strrchr(w->job->catalog, '/');
+	struct node	*d = w->root, *n;
+	char		*dir;
+
+	if ( slash ) {
+		dir = strndup(w->job->catalog, slash - w->job->catalog);
+		if ( !dir ) {
+			return fail(w, "%s", strerror(ENOMEM));
+		}
+		d = find_node(w->root, dir);
+		free(dir);
+		slash++;
+	}
+	else {
+		slash = w->job->catalog;
+	}
+	if ( !d || d->kind != NODE_DIR ) {
+		return fail(w, "%s: no such directory", w->job->catalog);
+	}
+	n = find_node(d, slash);
+	if ( n && n->kind != NODE_FILE ) {
+		return fail(w, "%s: not a file", w->job->catalog);
+	}
+	if ( !n && !(n = new_node(w, d, slash, NULL, NODE_CATALOG)) ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	n->kind	  = NODE_CATALOG;
+	n->size	  = SECTOR;
+	n->st	  = w->root->st;
+	n->st.st_mode  = S_IFREG | 0444;
+	n->st.st_mtime = n->st.st_atime = n->st.st_ctime = w->now;
+	w->catalog = n;
+	return 0;
+}
+
+
+/* ------------------------------------------------------- rock ridge */
+
+static int
+susp_header(unsigned char *p, const char *sig, int len)
+{
+	if ( p ) {
+		p[0] = sig[0];
+		p[1] = sig[1];
+		p[2] = len;
+		p[3] = 1;
+	}
+	return len;
+}
+
+/*
+ * RR, PX and TF of a directory record.
+ */
+static int
+rr_fields(struct writer *w, struct node *n, int flags, unsigned char *p)
+{
+	unsigned int	mode, uid, gid, nlink;
+	int		len = 0;
+
+	if ( !p ) {
+		return SIZE_RR + SIZE_PX + SIZE_TF;
+	}
+
+	if ( n->kind == NODE_DIR ) {
+		mode  = S_IFDIR | (n->st.st_mode & 07777);
+		nlink = 2 + n->subdirs;
+	}
+	else {
+		mode  = S_IFREG | (n->st.st_mode & 07777);
+		nlink = 1;
+	}
+	uid = n->st.st_uid;
+	gid = n->st.st_gid;
+	if ( (w->job->flags & ISOWRITE_RATIONALIZE) || n->kind > NODE_FILE ) {
+		uid = gid = 0;
+		if ( n->kind == NODE_DIR ) {
+			mode = S_IFDIR | 0555;
+		}
+		else {
+			mode = S_IFREG | 0444 | ((mode & 0111) ? 0111 : 0);
+		}
+	}
+
+	len += susp_header(p + len, "RR", SIZE_RR);
+	p[len - 1] = RR_PX | RR_TF | flags;
+
+	susp_header(p + len, "PX", SIZE_PX);
+	both32(p + len + 4, mode);
+	both32(p + len + 12, nlink);
+	both32(p + len + 20, uid);
+	both32(p + len + 28, gid);
+	len += SIZE_PX;
+
+	susp_header(p + len, "TF", SIZE_TF);
+	p[len + 4] = 0x0e;		/* modify, access, attributes */
+	short_date(p + len + 5, n->st.st_mtime);
+	short_date(p + len + 12, n->st.st_atime);
+	short_date(p + len + 19, n->st.st_ctime);
+	len += SIZE_TF;
+	return len;
+}
+
+static int
+ce_entry(struct node *d, int offset, int len, unsigned char *p)
+{
+	if ( p ) {
+		susp_header(p, "CE", SIZE_CE);
+		both32(p + 4, d->ceblock + offset / SECTOR);
+		both32(p + 12, offset % SECTOR);
+		both32(p + 20, len);
+	}
+	return SIZE_CE;
+}
+
+/*
+ * Space in the continuation area of directory d, which like mkisofs
+ * we put right after the directory (libarchive insists on that) and
+ * Linux wants within a sector.
+ */
+static int
+ce_alloc(struct node *d, int len)
+{
+	int	offset = d->celen;
+
+	if ( offset % SECTOR + len > SECTOR ) {
+		offset = (offset / SECTOR + 1) * SECTOR;
+	}
+	if ( offset + len > d->cecap ) {
+		int	cap = (offset + len) * 2 + SECTOR;
+		void	*p = realloc(d->ce, cap);
+
+		if ( !p ) {
+			return -1;
+		}
+		memset((unsigned char *)p + d->cecap, 0, cap - d->cecap);
+		d->ce	 = p;
+		d->cecap = cap;
+	}
+	d->celen = offset + len;
+	return offset;
+}
+
+static int
+nm_entries(struct node *n, unsigned char *p)
+{
+	int	len = strlen(n->name), off = 0, out = 0;
+
+	while ( off < len ) {
+		int	chunk = len - off > 250 ? 250 : len - off;
+
+		if ( p ) {
+			susp_header(p + out, "NM", 5 + chunk);
+			p[out + 4] = (off + chunk < len) ? 0x01 : 0;
+			memcpy(p + out + 5, n->name + off, chunk);
+		}
+		out += 5 + chunk;
+		off += chunk;
+	}
+	return out;
+}
+
+static int
+id_length(int idlen)
+{
+	return 33 + idlen + (idlen % 2 ? 0 : 1);
+}
+
+/*
+ * Names that do not fit in the record go to the continuation area.
+ */
+static int
+place_names(struct writer *w)
+{
+	int	i;
+
+	for ( i = 0; i < w->all.n; i++ ) {
+		struct node	*n = w->all.nodes[i];
+		int		len;
+
+		if ( n == w->root ) {
+			continue;
+		}
+		len = nm_entries(n, NULL);
+		if ( id_length(n->isolen) + rr_fields(w, n, 0, NULL) + len <=
+			MAX_RECORD ) {
+			continue;
+		}
+		n->ce_len    = len;
+		n->ce_offset = ce_alloc(n->parent, len);
+		if ( n->ce_offset < 0 ) {
+			return fail(w, "%s", strerror(ENOMEM));
+		}
+		nm_entries(n, n->parent->ce + n->ce_offset);
+	}
+
+	/* ER, pointed to by the root . record */
+	w->er_len    = 8 + strlen(ER_ID) + strlen(ER_DES) + strlen(ER_SRC);
+	w->er_offset = ce_alloc(w->root, w->er_len);
+	if ( w->er_offset < 0 ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	{
+		unsigned char	*p = w->root->ce + w->er_offset;
+
+		susp_header(p, "ER", w->er_len);
+		p[4] = strlen(ER_ID);
+		p[5] = strlen(ER_DES);
+		p[6] = strlen(ER_SRC);
+		p[7] = 1;
+		sprintf((char *)p + 8, "%s%s", ER_ID, ER_DES);
+		memcpy(p + 8 + p[4] + p[5], ER_SRC, p[6]);
+	}
+	return 0;
+}
+
+
+/* ------------------------------------------------------ dir records */
+
+enum {
+	REC_NODE,
+	REC_DOT,
+	REC_DOTDOT
+};
+
+/*
+ * Writes (p != NULL) or sizes the record for n as it appears in
+ * directory d.
+ */
+static int
+record(struct writer *w, struct node *d, struct node *n, int type,
+	int joliet, unsigned char *p)
+{
+	const unsigned char	*id;
+	unsigned char		zero = 0, one = 1;
+	int			idlen, len, rr = !joliet &&
+					(w->job->flags & ISOWRITE_ROCKRIDGE);
+	unsigned int		block, size;
+	time_t			mtime;
+
+	if ( type == REC_DOT ) {
+		id    = &zero;
+		idlen = 1;
+	}
+	else if ( type == REC_DOTDOT ) {
+		id    = &one;
+		idlen = 1;
+	}
+	else if ( joliet ) {
+		id    = n->jname;
+		idlen = n->jlen;
+	}
+	else {
+		id    = (const unsigned char *)n->iso;
+		idlen = n->isolen;
+	}
+
+	len = id_length(idlen);
+	if ( rr ) {
+		if ( type == REC_DOT && d == w->root ) {
+			len += SIZE_SP + SIZE_CE;
+		}
+		len += rr_fields(w, n, 0, NULL);
+		if ( type == REC_NODE ) {
+			len += n->ce_len ? SIZE_CE : nm_entries(n, NULL);
+		}
+	}
+	if ( !p ) {
+		return len;
+	}
+
+	if ( n->kind == NODE_DIR ) {
+		block = joliet ? n->jdirblock : n->dirblock;
+		size  = joliet ? n->jdirsize : n->dirsize;
+	}
+	else {
+		block = n->same ? n->same->block : n->block;
+		size  = n->size;
+	}
+	mtime = n->st.st_mtime;
+
+	memset(p, 0, len);
+	p[0] = len;
+	both32(p + 2, block);
+	both32(p + 10, size);
+	short_date(p + 18, mtime);
+	p[25] = n->kind == NODE_DIR ? 0x02 : 0;
+	both16(p + 28, 1);
+	p[32] = idlen;
+	memcpy(p + 33, id, idlen);
+
+	if ( rr ) {
+		int	pos = id_length(idlen);
+
+		if ( type == REC_DOT && d == w->root ) {
+			susp_header(p + pos, "SP", SIZE_SP);
+			p[pos + 4] = 0xbe;
+			p[pos + 5] = 0xef;
+			p[pos + 6] = 0;
+			pos += SIZE_SP;
+		}
+		pos += rr_fields(w, n, type == REC_NODE ? RR_NM : 0, p + pos);
+		if ( type == REC_DOT && d == w->root ) {
+			pos += ce_entry(d, w->er_offset, w->er_len, p + pos);
+		}
+		if ( type == REC_NODE ) {
+			if ( n->ce_len ) {
+				pos += ce_entry(d, n->ce_offset, n->ce_len,
+					p + pos);
+			}
+			else {
+				pos += nm_entries(n, p + pos);
+			}
+		}
+	}
+	return len;
+}
+
+/*
+ * Lays out (buf == NULL) or writes the records of a directory.
+ * Records do not cross sectors.
+ */
+static unsigned int
+directory(struct writer *w, struct node *d, int joliet, unsigned char *buf)
+{
+	struct node	**kids = joliet ? d->jkids : d->kids;
+	unsigned int	pos = 0;
+	int		i;
+
+	for ( i = -2; i < d->nkids; i++ ) {
+		struct node	*n = i == -2 ? d : i == -1 ? d->parent : kids[i];
+		int		type = i == -2 ? REC_DOT : i == -1 ? REC_DOTDOT :
+					REC_NODE;
+		int		len = record(w, d, n, type, joliet, NULL);
+
+		if ( pos % SECTOR + len > SECTOR ) {
+			pos = (pos / SECTOR + 1) * SECTOR;
+		}
+		if ( buf ) {
+			record(w, d, n, type, joliet, buf + pos);
+		}
+		pos += len;
+	}
+	return sectors(pos) * SECTOR;
+}
+
+/*
+ * mkisofs -T: "F NAME.;1	name" for everything in the directory.
+ */
+static int
+trans_tbl(struct writer *w, struct node *d)
+{
+	struct node	*t;
+	size_t		size = 0, len = 0;
+	int		i;
+
+	for ( i = 0; i < d->nkids; i++ ) {
+		size += 40 + strlen(d->kids[i]->name);
+	}
+	t = new_node(w, d, "TRANS.TBL", NULL, NODE_TRANSTBL);
+	if ( !t || !(t->data = malloc(size + 1)) ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	for ( i = 0; i < d->nkids - 1; i++ ) {
+		struct node	*n = d->kids[i];
+
+		len += sprintf((char *)t->data + len, "%c %-34s%s\n",
+			n->kind == NODE_DIR ? 'D' : 'F', n->iso, n->name);
+	}
+	t->size = len;
+	t->st	= d->st;
+	t->st.st_mode = S_IFREG | 0444;
+	strcpy(t->iso, "TRANS.TBL;1");
+	t->isolen = strlen(t->iso);
+	joliet_name(t);
+
+	/* put it in order */
+	qsort(d->kids, d->nkids, sizeof(struct node *), cmp_iso);
+	memcpy(d->jkids, d->kids, d->nkids * sizeof(struct node *));
+	qsort(d->jkids, d->nkids, sizeof(struct node *), cmp_joliet);
+	return 0;
+}
+
+
+/* ----------------------------------------------------------- layout */
+
+static int
+cmp_ino(const void *a, const void *b)
+{
+	const struct node	*x = *(struct node * const *)a;
+	const struct node	*y = *(struct node * const *)b;
+
+	if ( x->st.st_dev != y->st.st_dev ) {
+		return x->st.st_dev < y->st.st_dev ? -1 : 1;
+	}
+	if ( x->st.st_ino != y->st.st_ino ) {
+		return x->st.st_ino < y->st.st_ino ? -1 : 1;
+	}
+	return x < y ? -1 : x > y;
+}
+
+/*
+ * Files that are the same file on disk (hard links, or symbolic links
+ * to one file) share their data.
+ */
+static int
+link_files(struct writer *w)
+{
+	struct node	**sorted;
+	int		i;
+
+	if ( !w->files.n ) {
+		return 0;
+	}
+	sorted = malloc(w->files.n * sizeof(struct node *));
+	if ( !sorted ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	memcpy(sorted, w->files.nodes, w->files.n * sizeof(struct node *));
+	qsort(sorted, w->files.n, sizeof(struct node *), cmp_ino);
+
+	/* the earliest in write order keeps the data */
+	for ( i = 0; i < w->files.n; ) {
+		struct node	*first = sorted[i];
+		int		j;
+
+		for ( j = i + 1; j < w->files.n &&
+			sorted[j]->kind == NODE_FILE && first->kind == NODE_FILE &&
+			sorted[j]->st.st_dev == first->st.st_dev &&
+			sorted[j]->st.st_ino == first->st.st_ino; j++ ) {
+		}
+		for ( ; i < j; i++ ) {
+			if ( sorted[i] != first ) {
+				sorted[i]->same = first;
+			}
+		}
+	}
+	free(sorted);
+	return 0;
+}
+
+static int
+depth(struct node *d)
+{
+	int	n = 1;
+
+	for ( ; d->parent != d; d = d->parent ) {
+		n++;
+	}
+	return n;
+}
+
+/*
+ * Reads the tree, names everything and numbers the directories in
+ * path table order: breadth first, each level in the order of the
+ * parents.
+ */
+static int
+scan(struct writer *w)
+{
+	struct nodelist	queue;
+	int		i, j, rc = 0;
+
+	if ( stat(w->job->root, &w->root->st) ) {
+		return fail(w, "%s: %s", w->job->root, strerror(errno));
+	}
+	if ( !S_ISDIR(w->root->st.st_mode) ) {
+		return fail(w, "%s: not a directory", w->job->root);
+	}
+
+	memset(&queue, 0, sizeof(queue));
+	if ( list_add(&queue, w->root) ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	for ( i = 0; !rc && i < queue.n; i++ ) {
+		struct node	*d = queue.nodes[i];
+
+		rc = scan_directory(w, d, depth(d));
+		for ( j = 0; !rc && j < d->nkids; j++ ) {
+			if ( d->kids[j]->kind == NODE_DIR &&
+				list_add(&queue, d->kids[j]) ) {
+				rc = fail(w, "%s", strerror(ENOMEM));
+			}
+		}
+	}
+	if ( !rc && w->job->catalog ) {
+		rc = add_catalog(w);
+	}
+	for ( i = 0; !rc && i < queue.n; i++ ) {
+		rc = name_directory(w, queue.nodes[i]);
+		if ( !rc && (w->job->flags & ISOWRITE_TRANSTBL) ) {
+			rc = trans_tbl(w, queue.nodes[i]);
+		}
+	}
+	free(queue.nodes);
+	if ( rc ) {
+		return -1;
+	}
+
+	if ( list_add(&w->dirs, w->root) || list_add(&w->jdirs, w->root) ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	for ( i = 0; i < w->dirs.n; i++ ) {
+		struct node	*d = w->dirs.nodes[i];
+
+		d->num = i + 1;
+		for ( j = 0; j < d->nkids; j++ ) {
+			struct node	*n = d->kids[j];
+
+			if ( (n->kind == NODE_DIR && list_add(&w->dirs, n)) ||
+				(n->kind != NODE_DIR && n->kind != NODE_CATALOG &&
+				list_add(&w->files, n)) ) {
+				return fail(w, "%s", strerror(ENOMEM));
+			}
+		}
+	}
+	for ( i = 0; i < w->jdirs.n; i++ ) {
+		struct node	*d = w->jdirs.nodes[i];
+
+		d->jnum = i + 1;
+		for ( j = 0; j < d->nkids; j++ ) {
+			if ( d->jkids[j]->kind == NODE_DIR &&
+				list_add(&w->jdirs, d->jkids[j]) ) {
+				return fail(w, "%s", strerror(ENOMEM));
+			}
+		}
+	}
+	return link_files(w);
+}
+
+static unsigned int
+path_table(struct nodelist *dirs, int joliet, int msb, unsigned char *p)
+{
+	unsigned int	len = 0;
+	int		i;
+
+	for ( i = 0; i < dirs->n; i++ ) {
+		struct node		*d = dirs->nodes[i];
+		const unsigned char	*id;
+		int			idlen;
+		unsigned int		block = joliet ? d->jdirblock :
+						d->dirblock;
+		unsigned int		parent = joliet ? d->parent->jnum :
+						d->parent->num;
+
+		if ( d == dirs->nodes[0] ) {
+			id    = (const unsigned char *)"";
+			idlen = 1;
+		}
+		else if ( joliet ) {
+			id    = d->jname;
+			idlen = d->jlen;
+		}
+		else {
+			id    = (const unsigned char *)d->iso;
+			idlen = d->isolen;
+		}
+		if ( p ) {
+			p[len]	   = idlen;
+			p[len + 1] = 0;
+			if ( msb ) {
+				be32(p + len + 2, block);
+				be16(p + len + 6, parent);
+			}
+			else {
+				le32(p + len + 2, block);
+				le16(p + len + 6, parent);
+			}
+			memcpy(p + len + 8, id, idlen);
+			if ( idlen % 2 ) {
+				p[len + 8 + idlen] = 0;
+			}
+		}
+		len += 8 + idlen + idlen % 2;
+	}
+	return len;
+}
+
+/*
+ * Gives everything a place on the image, in the order it is written:
+ *
+ *	0-15	system area, the hybrid MBR
+ *	16	primary volume descriptor
+ *		El Torito boot record, Joliet descriptor, terminator
+ *		path tables, ISO9660 then Joliet
+ *		ISO9660 directories, each followed by its Rock
+ *		Ridge continuation area, then Joliet directories
+ *		boot catalog
+ *		file data
+ *		150 sectors of padding
+ */
+static int
+layout(struct writer *w)
+{
+	unsigned int	next = 17;
+	int		i, joliet = w->job->flags & ISOWRITE_JOLIET;
+
+	if ( w->job->boot ) {
+		next++;
+	}
+	if ( joliet ) {
+		next++;
+	}
+	next++;			/* terminator */
+
+	w->pathsize = path_table(&w->dirs, 0, 0, NULL);
+	w->lpath    = next;
+	next	   += sectors(w->pathsize);
+	w->mpath    = next;
+	next	   += sectors(w->pathsize);
+	if ( joliet ) {
+		w->jpathsize = path_table(&w->jdirs, 1, 0, NULL);
+		w->jlpath    = next;
+		next	    += sectors(w->jpathsize);
+		w->jmpath    = next;
+		next	    += sectors(w->jpathsize);
+	}
+
+	if ( (w->job->flags & ISOWRITE_ROCKRIDGE) && place_names(w) ) {
+		return -1;
+	}
+	for ( i = 0; i < w->dirs.n; i++ ) {
+		struct node	*d = w->dirs.nodes[i];
+
+		d->dirsize  = directory(w, d, 0, NULL);
+		d->dirblock = next;
+		next	   += d->dirsize / SECTOR;
+		d->ceblock  = next;
+		next	   += sectors(d->celen);
+	}
+	for ( i = 0; joliet && i < w->jdirs.n; i++ ) {
+		struct node	*d = w->jdirs.nodes[i];
+
+		d->jdirsize  = directory(w, d, 1, NULL);
+		d->jdirblock = next;
+		next	    += d->jdirsize / SECTOR;
+	}
+	if ( w->catalog ) {
+		w->catalog->block = next++;
+	}
+	for ( i = 0; i < w->files.n; i++ ) {
+		struct node	*n = w->files.nodes[i];
+
+		if ( n->same || !n->size ) {
+			continue;
+		}
+		n->block = next;
+		next	+= sectors(n->size);
+	}
+	w->volsize = next + PAD_SECTORS;
+	return 0;
+}
+
+
+/* ----------------------------------------------------------- output */
+
+static int
+flush_output(struct writer *w)
+{
+	size_t	off = 0;
+
+	while ( off < w->buflen ) {
+		ssize_t	n = write(w->fd, w->buf + off, w->buflen - off);
+
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n < 0 ) {
+			return fail(w, "%s: %s", w->job->output,
+				strerror(errno));
+		}
+		off += n;
+	}
+	w->buflen = 0;
+	return 0;
+}
+
+/*
+ * Everything goes through here, so the checksum is computed as the
+ * image is written.
+ */
+static int
+output(struct writer *w, const void *data, size_t len)
+{
+	const unsigned char	*p = data;
+
+	while ( len ) {
+		size_t	n = OUT_BUFFER - w->buflen;
+
+		if ( n > len ) {
+			n = len;
+		}
+		if ( w->written < w->md5_limit ) {
+			long long	m = w->md5_limit - w->written;
+
+			MD5SumUpdate(&w->md5, p, (long long)n < m ? n : (size_t)m);
+		}
+		memcpy(w->buf + w->buflen, p, n);
+		w->buflen  += n;
+		w->written += n;
+		p	   += n;
+		len	   -= n;
+		if ( w->buflen == OUT_BUFFER && flush_output(w) ) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+output_zeros(struct writer *w, size_t len)
+{
+	static const unsigned char	zeros[SECTOR];
+
+	while ( len ) {
+		size_t	n = len < SECTOR ? len : SECTOR;
+
+		if ( output(w, zeros, n) ) {
+			return -1;
+		}
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * Pads to the next sector, or up to sector block when block is not
+ * 0 (and we are not past it).
+ */
+static int
+output_pad(struct writer *w, unsigned int block)
+{
+	long long	to = block ? (long long)block * SECTOR :
+				(long long)sectors(w->written) * SECTOR;
+
+	if ( to < w->written ) {
+		return fail(w, "layout error at sector %u", block);
+	}
+	return output_zeros(w, to - w->written);
+}
+
+static unsigned int
+hybrid_cylinders(struct writer *w)
+{
+	long long	cyl = 64 * 32 * 512;
+
+	return ((long long)w->volsize * SECTOR + cyl - 1) / cyl;
+}
+
+/*
+ * The MBR isohybrid writes: the template's boot code, the address of
+ * the boot image, and one bootable partition over the whole image
+ * (64 heads, 32 sectors) plus an EFI partition over the EFI image.
+ */
+static int
+output_mbr(struct writer *w)
+{
+	unsigned char	mbr[512];
+	unsigned int	c = hybrid_cylinders(w), cc = c > 1024 ? 1024 : c;
+	unsigned char	*p;
+	FILE		*f;
+
+	memset(mbr, 0, sizeof(mbr));
+	f = fopen(w->job->mbr, "r");
+	if ( !f ) {
+		return fail(w, "%s: %s", w->job->mbr, strerror(errno));
+	}
+	if ( fread(mbr, 1, 432, f) != 432 ) {
+		fclose(f);
+		return fail(w, "%s: too short for an MBR", w->job->mbr);
+	}
+	fclose(f);
+
+	le32(mbr + 432, w->boot->block * 4);
+	le32(mbr + 440, (unsigned int)w->now ^ (unsigned int)getpid());
+
+	p    = mbr + 446;
+	p[0] = 0x80;
+	p[1] = 0;			/* head */
+	p[2] = 1;			/* sector */
+	p[3] = 0;			/* cylinder */
+	p[4] = 0x17;
+	p[5] = 63;
+	p[6] = 32 + (((cc - 1) & 0x300) >> 2);
+	p[7] = (cc - 1) & 0xff;
+	le32(p + 8, 0);
+	le32(p + 12, c * 64 * 32);
+
+	if ( w->efi ) {
+		p    = mbr + 462;
+		p[1] = 0xfe;
+		p[2] = 0xff;
+		p[3] = 0xff;
+		p[4] = 0xef;
+		p[5] = 0xfe;
+		p[6] = 0xff;
+		p[7] = 0xff;
+		le32(p + 8, w->efi->block * 4);
+		le32(p + 12, sectors(w->efi->size) * 4);
+	}
+	mbr[510] = 0x55;
+	mbr[511] = 0xaa;
+	return output(w, mbr, sizeof(mbr));
+}
+
+static void
+volume_descriptor(struct writer *w, unsigned char *p, int joliet)
+{
+	unsigned char	root[34];
+	char		date[17];
+
+	memset(p, 0, SECTOR);
+	p[0] = joliet ? 2 : 1;
+	memcpy(p + 1, "CD001", 5);
+	p[6] = 1;
+	if ( joliet ) {
+		char	volume[17];
+
+		snprintf(volume, sizeof(volume), "%s",
+			w->job->volume ? w->job->volume : "");
+		pad_ucs2(p + 8, "LINUX", 32);
+		pad_ucs2(p + 40, volume, 32);
+		p[88] = '%';
+		p[89] = '/';
+		p[90] = 'E';
+		pad_ucs2(p + 190, NULL, 128);
+		pad_ucs2(p + 318, NULL, 128);
+		pad_ucs2(p + 446, NULL, 128);
+		pad_ucs2(p + 574, NULL, 128);
+		pad_ucs2(p + 702, NULL, 36);
+		pad_ucs2(p + 739, NULL, 36);
+		pad_ucs2(p + 776, NULL, 36);
+	}
+	else {
+		pad_string(p + 8, "LINUX", 32);
+		pad_string(p + 40, w->job->volume, 32);
+		pad_string(p + 190, NULL, 128);
+		pad_string(p + 318, NULL, 128);
+		pad_string(p + 446, NULL, 128);
+		pad_string(p + 574, "ROCKS", 128);
+		pad_string(p + 702, NULL, 37);
+		pad_string(p + 739, NULL, 37);
+		pad_string(p + 776, NULL, 37);
+	}
+	both32(p + 80, w->volsize);
+	both16(p + 120, 1);
+	both16(p + 124, 1);
+	both16(p + 128, SECTOR);
+	both32(p + 132, joliet ? w->jpathsize : w->pathsize);
+	le32(p + 140, joliet ? w->jlpath : w->lpath);
+	be32(p + 148, joliet ? w->jmpath : w->mpath);
+
+	memset(root, 0, sizeof(root));
+	root[0] = 34;
+	both32(root + 2, joliet ? w->root->jdirblock : w->root->dirblock);
+	both32(root + 10, joliet ? w->root->jdirsize : w->root->dirsize);
+	short_date(root + 18, w->root->st.st_mtime);
+	root[25] = 0x02;
+	both16(root + 28, 1);
+	root[32] = 1;
+	memcpy(p + 156, root, 34);
+
+	long_date(p + 813, w->now);
+	long_date(p + 830, w->now);
+	memset(date, '0', 16);
+	date[16] = 0;
+	memcpy(p + 847, date, 17);
+	memcpy(p + 864, date, 17);
+	p[881] = 1;
+
+	/* blank for the implanted checksum */
+	memset(p + APPDATA_OFFSET, ' ', APPDATA_SIZE);
+}
+
+static int
+output_descriptors(struct writer *w)
+{
+	unsigned char	vd[SECTOR];
+
+	volume_descriptor(w, vd, 0);
+	if ( output(w, vd, SECTOR) ) {
+		return -1;
+	}
+	if ( w->job->boot ) {
+		memset(vd, 0, SECTOR);
+		memcpy(vd + 1, "CD001", 5);
+		vd[6] = 1;
+		memcpy(vd + 7, "EL TORITO SPECIFICATION", 23);
+		le32(vd + 71, w->catalog->block);
+		if ( output(w, vd, SECTOR) ) {
+			return -1;
+		}
+	}
+	if ( w->job->flags & ISOWRITE_JOLIET ) {
+		volume_descriptor(w, vd, 1);
+		if ( output(w, vd, SECTOR) ) {
+			return -1;
+		}
+	}
+	memset(vd, 0, SECTOR);
+	vd[0] = 255;
+	memcpy(vd + 1, "CD001", 5);
+	vd[6] = 1;
+	return output(w, vd, SECTOR);
+}
+
+static int
+output_path_tables(struct writer *w)
+{
+	unsigned int	size = w->pathsize > w->jpathsize ? w->pathsize :
+				w->jpathsize;
+	unsigned char	*p = malloc(sectors(size) * SECTOR + 1);
+	int		rc = 0;
+
+	if ( !p ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	path_table(&w->dirs, 0, 0, p);
+	rc = output(w, p, w->pathsize) || output_pad(w, w->mpath);
+	if ( !rc ) {
+		path_table(&w->dirs, 0, 1, p);
+		rc = output(w, p, w->pathsize) || output_pad(w, 0);
+	}
+	if ( !rc && (w->job->flags & ISOWRITE_JOLIET) ) {
+		path_table(&w->jdirs, 1, 0, p);
+		rc = output(w, p, w->jpathsize) || output_pad(w, w->jmpath);
+		if ( !rc ) {
+			path_table(&w->jdirs, 1, 1, p);
+			rc = output(w, p, w->jpathsize) || output_pad(w, 0);
+		}
+	}
+	free(p);
+	return rc ? -1 : 0;
+}
+
+static int
+output_directories(struct writer *w, struct nodelist *dirs, int joliet)
+{
+	int	i;
+
+	for ( i = 0; i < dirs->n; i++ ) {
+		struct node	*d = dirs->nodes[i];
+		unsigned int	size = joliet ? d->jdirsize : d->dirsize;
+		unsigned char	*p = calloc(1, size);
+		int		rc;
+
+		if ( !p ) {
+			return fail(w, "%s", strerror(ENOMEM));
+		}
+		directory(w, d, joliet, p);
+		rc = output_pad(w, joliet ? d->jdirblock : d->dirblock) ||
+			output(w, p, size);
+		free(p);
+		if ( !rc && !joliet && d->celen ) {
+			rc = output_pad(w, d->ceblock) ||
+				output(w, d->ce, d->celen);
+		}
+		if ( rc ) {
+			return -1;
+		}
+	}
+	return 0;
+}
+
+/*
+ * A validation entry, the BIOS image as the default entry and the EFI
+ * image in a section of its own.
+ */
+static int
+output_catalog(struct writer *w)
+{
+	unsigned char	cat[SECTOR];
+	unsigned int	sum = 0;
+	int		i;
+
+	memset(cat, 0, sizeof(cat));
+	cat[0]	= 1;
+	cat[30] = 0x55;
+	cat[31] = 0xaa;
+	for ( i = 0; i < 32; i += 2 ) {
+		sum += cat[i] | (cat[i + 1] << 8);
+	}
+	le16(cat + 28, -sum);
+
+	cat[32] = 0x88;
+	le16(cat + 38, w->job->load_size ? w->job->load_size : 4);
+	le32(cat + 40, w->boot->block);
+
+	if ( w->efi ) {
+		unsigned int	count = sectors(w->efi->size) * 4;
+
+		cat[64] = 0x91;
+		cat[65] = 0xef;
+		le16(cat + 66, 1);
+		cat[96] = 0x88;
+		le16(cat + 102, count > 0xffff ? 0xffff : count);
+		le32(cat + 104, w->efi->block);
+	}
+	return output_pad(w, w->catalog->block) || output(w, cat, SECTOR);
+}
+
+static int
+read_full(int fd, unsigned char *p, size_t len)
+{
+	while ( len ) {
+		ssize_t	n = read(fd, p, len);
+
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			if ( n == 0 ) {
+				errno = EIO;	/* shrank under us */
+			}
+			return -1;
+		}
+		p   += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * The boot info table (mkisofs -boot-info-table) goes in the copy on
+ * the image, the file on disk is left alone.
+ */
+static int
+output_boot_image(struct writer *w, struct node *n, int fd)
+{
+	unsigned char	*p = malloc(n->size + 4);
+	unsigned int	sum = 0;
+	long long	i;
+	int		rc;
+
+	if ( !p ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	if ( read_full(fd, p, n->size) ) {
+		free(p);
+		return fail(w, "%s: %s", n->src, strerror(errno));
+	}
+	if ( w->job->info_table ) {
+		if ( n->size < 64 ) {
+			free(p);
+			return fail(w, "%s: too small for a boot info table",
+				n->src);
+		}
+		memset(p + n->size, 0, 4);
+		for ( i = 64; i < n->size; i += 4 ) {
+			sum += p[i] | (p[i + 1] << 8) | (p[i + 2] << 16) |
+				((unsigned int)p[i + 3] << 24);
+		}
+		memset(p + 8, 0, 56);
+		le32(p + 8, 16);
+		le32(p + 12, n->block);
+		le32(p + 16, n->size);
+		le32(p + 20, sum);
+	}
+	if ( (w->job->flags & ISOWRITE_HYBRID) &&
+		(n->size < 68 || (p[64] | (p[65] << 8) | (p[66] << 16) |
+		((unsigned int)p[67] << 24)) != HYBRID_SIGNATURE) ) {
+		free(p);
+		return fail(w, "%s: not an isohybrid capable isolinux.bin",
+			n->src);
+	}
+	rc = output(w, p, n->size);
+	free(p);
+	return rc;
+}
+
+static int
+output_files(struct writer *w)
+{
+	unsigned char	*buf = NULL;
+	int		i;
+
+	for ( i = 0; i < w->files.n; i++ ) {
+		struct node	*n = w->files.nodes[i];
+		long long	left = n->size;
+		int		fd, rc = 0;
+
+		if ( n->same || !n->size ) {
+			continue;
+		}
+		if ( output_pad(w, n->block) ) {
+			break;
+		}
+		if ( n->data ) {
+			if ( output(w, n->data, n->size) ) {
+				break;
+			}
+			continue;
+		}
+
+		fd = open(n->src, O_RDONLY | O_CLOEXEC);
+		if ( fd < 0 ) {
+			fail(w, "%s: %s", n->src, strerror(errno));
+			break;
+		}
+		if ( n == w->boot ) {
+			rc = output_boot_image(w, n, fd);
+			left = 0;
+		}
+		if ( left && !buf && !(buf = malloc(OUT_BUFFER)) ) {
+			rc = fail(w, "%s", strerror(ENOMEM));
+		}
+#ifdef POSIX_FADV_SEQUENTIAL
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+		while ( !rc && left ) {
+			size_t	chunk = left < OUT_BUFFER ? left : OUT_BUFFER;
+
+			if ( read_full(fd, buf, chunk) ) {
+				rc = fail(w, "%s: %s", n->src, strerror(errno));
+				break;
+			}
+			rc    = output(w, buf, chunk);
+			left -= chunk;
+		}
+		close(fd);
+		if ( rc ) {
+			break;
+		}
+	}
+	free(buf);
+	return w->job->status;
+}
+
+/*
+ * The application use area of the primary volume descriptor, as
+ * implantisomd5 --supported-iso writes it (without fragment sums,
+ * checkisomd5 only checks those when they are there).
+ */
+static int
+implant_md5(struct writer *w)
+{
+	unsigned char	digest[16], app[APPDATA_SIZE];
+	char		str[APPDATA_SIZE + 1];
+	int		len;
+
+	MD5SumFinal(&w->md5, digest);
+	MD5SumHex(digest, w->job->md5);
+	len = snprintf(str, sizeof(str), "ISO MD5SUM = %s;SKIPSECTORS = %d;"
+		"RHLISOSTATUS=1;THIS IS NOT THE SAME AS RUNNING MD5SUM ON "
+		"THIS ISO!!", w->job->md5, SKIP_SECTORS);
+	memset(app, ' ', sizeof(app));
+	memcpy(app, str, len);
+	if ( pwrite(w->fd, app, sizeof(app), 16 * SECTOR + APPDATA_OFFSET) !=
+		sizeof(app) ) {
+		return fail(w, "%s: %s", w->job->output, strerror(errno));
+	}
+	return 0;
+}
+
+static int
+write_image(struct writer *w)
+{
+	w->fd = open(w->job->output, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+		0644);
+	if ( w->fd < 0 ) {
+		return fail(w, "%s: %s", w->job->output, strerror(errno));
+	}
+	w->buf = malloc(OUT_BUFFER);
+	if ( !w->buf ) {
+		return fail(w, "%s", strerror(ENOMEM));
+	}
+	MD5SumInit(&w->md5);
+	w->md5_limit = (long long)(w->volsize - SKIP_SECTORS) * SECTOR;
+
+	if ( w->job->flags & ISOWRITE_HYBRID ) {
+		if ( output_mbr(w) ) {
+			return -1;
+		}
+	}
+	if ( output_pad(w, 16) || output_descriptors(w) ||
+		output_pad(w, w->lpath) || output_path_tables(w) ||
+		output_directories(w, &w->dirs, 0) ) {
+		return -1;
+	}
+	if ( (w->job->flags & ISOWRITE_JOLIET) &&
+		output_directories(w, &w->jdirs, 1) ) {
+		return -1;
+	}
+	if ( w->catalog && output_catalog(w) ) {
+		return -1;
+	}
+	if ( output_files(w) || output_pad(w, w->volsize) ) {
+		return -1;
+	}
+
+	/* isohybrid rounds the image up to a cylinder */
+	if ( w->job->flags & ISOWRITE_HYBRID ) {
+		if ( output_pad(w, hybrid_cylinders(w) * 64 * 32 / 4) ) {
+			return -1;
+		}
+	}
+	if ( flush_output(w) ) {
+		return -1;
+	}
+	if ( (w->job->flags & ISOWRITE_MD5) && implant_md5(w) ) {
+		return -1;
+	}
+	if ( fsync(w->fd) ) {
+		return fail(w, "%s: %s", w->job->output, strerror(errno));
+	}
+	return 0;
+}
+
+static int
+find_boot_files(struct writer *w)
+{
+	if ( !w->job->boot ) {
+		if ( w->job->flags & ISOWRITE_HYBRID ) {
+			return fail(w, "isohybrid needs a boot image");
+		}
+		return 0;
+	}
+	if ( !w->catalog ) {
+		return fail(w, "%s: no boot catalog", w->job->boot);
+	}
+	w->boot = find_node(w->root, w->job->boot);
+	if ( !w->boot || w->boot->kind != NODE_FILE ) {
+		return fail(w, "%s: no such boot image", w->job->boot);
+	}
+	if ( !w->boot->size ) {
+		return fail(w, "%s: empty boot image", w->job->boot);
+	}
+	w->boot->same = NULL;		/* a copy of its own, with the table */
+	if ( w->job->efi ) {
+		w->efi = find_node(w->root, w->job->efi);
+		if ( !w->efi || w->efi->kind != NODE_FILE ) {
+			return fail(w, "%s: no such EFI image", w->job->efi);
+		}
+		if ( w->efi->same ) {
+			w->efi = w->efi->same;
+		}
+	}
+	if ( (w->job->flags & ISOWRITE_HYBRID) && !w->job->mbr ) {
+		return fail(w, "isohybrid needs an MBR template");
+	}
+	return 0;
+}
+
+
+/*
+ * Writes one image.  Returns 0, or -1 with the job status and error
+ * set; a partial image is removed.
+ */
+int
+ISOWrite(ISOWriteJob *job)
+{
+	struct writer	w;
+	int		i, rc;
+
+	memset(&w, 0, sizeof(w));
+	w.job	= job;
+	w.fd	= -1;
+	w.now	= time(NULL);
+	job->status   = 0;
+	job->error[0] = '\0';
+	job->md5[0]   = '\0';
+
+	w.root = new_node(&w, NULL, "", job->root, NODE_DIR);
+	if ( !w.root ) {
+		rc = fail(&w, "%s", strerror(ENOMEM));
+	}
+	else {
+		rc = scan(&w);
+	}
+	if ( !rc ) {
+		rc = find_boot_files(&w);
+	}
+	if ( !rc ) {
+		rc = layout(&w);
+	}
+	if ( !rc ) {
+		rc = write_image(&w);
+	}
+	if ( w.fd >= 0 ) {
+		close(w.fd);
+		if ( rc ) {
+			unlink(job->output);
+		}
+	}
+
+	for ( i = 0; i < w.all.n; i++ ) {
+		struct node	*n = w.all.nodes[i];
+
+		free(n->name);
+		free(n->src);
+		free(n->kids);
+		free(n->jkids);
+		free(n->data);
+		free(n->ce);
+		free(n);
+	}
+	free(w.all.nodes);
+	free(w.dirs.nodes);
+	free(w.jdirs.nodes);
+	free(w.files.nodes);
+	free(w.buf);
+	return rc ? -1 : 0;
+} /* ISOWrite */
+
+
+struct pool {
+	ISOWriteJob	*jobs;
+	int		njobs;
+	int		next;
+	pthread_mutex_t	lock;
+};
+
+static void *
+write_worker(void *arg)
+{
+	struct pool	*pool = arg;
+
+	for ( ;; ) {
+		ISOWriteJob	*job;
+
+		pthread_mutex_lock(&pool->lock);
+		job = (pool->next < pool->njobs) ? &pool->jobs[pool->next++] :
+			NULL;
+		pthread_mutex_unlock(&pool->lock);
+		if ( !job ) {
+			return NULL;
+		}
+		ISOWrite(job);
+	}
+}
+
+/*
+ * Writes several images (the disks of a roll) concurrently, nthreads
+ * at a time (0 means one per CPU).  Returns the number that failed,
+ * see the status and error of each job.
+ */
+int
+ISOWriteMany(ISOWriteJob *jobs, int njobs, int nthreads)
+{
+	pthread_t	threads[ISOWRITE_MAX_THREADS];
+	struct pool	pool;
+	int		i, started = 0, failed = 0;
+
+	if ( nthreads <= 0 ) {
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if ( nthreads > njobs ) {
+		nthreads = njobs;
+	}
+	if ( nthreads > ISOWRITE_MAX_THREADS ) {
+		nthreads = ISOWRITE_MAX_THREADS;
+	}
+
+	pool.jobs  = jobs;
+	pool.njobs = njobs;
+	pool.next  = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for ( i = 1; i < nthreads; i++ ) {
+		if ( pthread_create(&threads[started], NULL, write_worker,
+			&pool) == 0 ) {
+			started++;
+		}
+	}
+	write_worker(&pool);
+	for ( i = 0; i < started; i++ ) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+
+	for ( i = 0; i < njobs; i++ ) {
+		if ( jobs[i].status ) {
+			failed++;
+		}
+	}
+	return failed;
+} /* ISOWriteMany */
@@ -0,0 +1,318 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "../include/isowrite.h"
+#include "../include/isoread.h"
+#include "../include/md5sum.h"
+
+#define SECTOR	2048
+
+static int failed;
+
+static void
+check(int ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if ( !ok ) {
+		failed++;
+	}
+}
+
+static void
+put(const char *dir, const char *path, const void *data, size_t len)
+{
+	char	full[1024];
+	FILE	*f;
+
+	snprintf(full, sizeof(full), "%s/%s", dir, path);
+	f = fopen(full, "w");
+	if ( !f || fwrite(data, 1, len, f) != len ) {
+		perror(full);
+		exit(1);
+	}
+	fclose(f);
+}
+
+static unsigned int
+le32(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int)p[3] << 24);
+}
+
+static int
+has(const ISOImage *iso, const char *path, const char *data)
+{
+	const ISOEntry	*e = ISOLookup(iso, path);
+	char		buf[256];
+	size_t		len = strlen(data);
+
+	return e && e->size == (long long)len &&
+		ISORead(iso, e, buf, len, 0) == (long long)len &&
+		!memcmp(buf, data, len);
+}
+
+/*
+ * A small roll: long names that collide in 8.3, a symbolic and a hard
+ * link, nested directories, and isolinux and EFI boot images.
+ */
+static void
+make_tree(const char *root)
+{
+	unsigned char	boot[4096], efi[3000];
+	char		path[1024];
+	int		i;
+
+	snprintf(path, sizeof(path), "mkdir -p %s/isolinux %s/images "
+		"%s/RedHat/RPMS/deep", root, root, root);
+	if ( system(path) ) {
+		exit(1);
+	}
+	put(root, ".discinfo", "disc\n", 5);
+	put(root, "README-with-a-long-name.txt", "hello\n", 6);
+	put(root, "README-with-another.txt", "world\n", 6);
+	put(root, "TRANS.TBL", "stale\n", 6);
+	put(root, "RedHat/RPMS/foo-1.0-1.x86_64.rpm", "rpm\n", 4);
+
+	for ( i = 0; i < (int)sizeof(boot); i++ ) {
+		boot[i] = i * 7;
+	}
+	boot[64] = 0xfb;
+	boot[65] = 0xa0;
+	boot[66] = 0x78;
+	boot[67] = 0x70;
+	put(root, "isolinux/isolinux.bin", boot, sizeof(boot));
+	memset(efi, 'e', sizeof(efi));
+	put(root, "images/efiboot.img", efi, sizeof(efi));
+
+	snprintf(path, sizeof(path), "%s/link.txt", root);
+	if ( symlink("README-with-a-long-name.txt", path) ) {
+		perror(path);
+	}
+	snprintf(path, sizeof(path), "%s/RedHat/RPMS/foo-1.0-1.x86_64.rpm",
+		root);
+	{
+		char	hard[1024];
+
+		snprintf(hard, sizeof(hard), "%s/RedHat/RPMS/deep/hard.rpm",
+			root);
+		if ( link(path, hard) ) {
+			perror(hard);
+		}
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char		dir[] = "/tmp/isowrite_test.XXXXXX";
+	char		root[256], mbr[256], out[256], plain[256], cmd[512];
+	unsigned char	template[432], *image, app[512], digest[16];
+	char		hex[33], buf[4096];
+	ISOWriteJob	jobs[2];
+	ISOImage	*iso;
+	const ISOEntry	*e, *e2;
+	MD5Sum		md5;
+	struct stat	st;
+	unsigned int	volsize, sum, i;
+	FILE		*f;
+
+	if ( !mkdtemp(dir) ) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(root, sizeof(root), "%s/root", dir);
+	snprintf(mbr, sizeof(mbr), "%s/isohdpfx.bin", dir);
+	snprintf(out, sizeof(out), "%s/disk1.iso", dir);
+	snprintf(plain, sizeof(plain), "%s/plain.iso", dir);
+	make_tree(root);
+	memset(template, 0xab, sizeof(template));
+	put(dir, "isohdpfx.bin", template, sizeof(template));
+
+	memset(jobs, 0, sizeof(jobs));
+	jobs[0].root	   = root;
+	jobs[0].output	   = out;
+	jobs[0].volume	   = "rocks-test";
+	jobs[0].flags	   = ISOWRITE_ROCKRIDGE | ISOWRITE_JOLIET |
+		ISOWRITE_TRANSTBL | ISOWRITE_MD5 | ISOWRITE_HYBRID;
+	jobs[0].boot	   = "isolinux/isolinux.bin";
+	jobs[0].catalog	   = "isolinux/boot.cat";
+	jobs[0].info_table = 1;
+	jobs[0].efi	   = "images/efiboot.img";
+	jobs[0].mbr	   = mbr;
+	jobs[1].root	   = root;
+	jobs[1].output	   = plain;
+	jobs[1].volume	   = "plain";
+	check(ISOWriteMany(jobs, 2, 2) == 0 && !jobs[0].status &&
+		!jobs[1].status, "write");
+	if ( jobs[0].status || jobs[1].status ) {
+		printf("     %s%s\n", jobs[0].error, jobs[1].error);
+		return 1;
+	}
+
+	iso = ISOOpen(out);
+	if ( !iso ) {
+		perror(out);
+		return 1;
+	}
+	check(ISOFlags(iso) & ISO_ROCKRIDGE, "rock ridge");
+	check(has(iso, "README-with-a-long-name.txt", "hello\n") &&
+		has(iso, "README-with-another.txt", "world\n") &&
+		has(iso, ".discinfo", "disc\n"), "names");
+	check(has(iso, "RedHat/RPMS/deep/hard.rpm", "rpm\n"), "nested");
+	e  = ISOLookup(iso, "link.txt");
+	e2 = ISOLookup(iso, "README-with-a-long-name.txt");
+	check(e && e2 && S_ISREG(e->mode) &&
+		e->extents[0].block == e2->extents[0].block, "links share data");
+	check(e2 && (e2->mode & 07777) == 0644, "mode");
+
+	e = ISOLookup(iso, "TRANS.TBL");
+	memset(buf, 0, sizeof(buf));
+	check(e && ISORead(iso, e, buf, sizeof(buf) - 1, 0) > 0 &&
+		strstr(buf, "F README_W.TXT;1                    "
+		"README-with-a-long-name.txt\n") &&
+		strstr(buf, "F READM001.TXT;1                    "
+		"README-with-another.txt\n") &&
+		strstr(buf, "D REDHAT                            RedHat\n") &&
+		!strstr(buf, "stale"), "TRANS.TBL");
+
+	/* El Torito */
+	e  = ISOLookup(iso, "isolinux/boot.cat");
+	e2 = ISOLookup(iso, "isolinux/isolinux.bin");
+	check(e && e->size == SECTOR && ISORead(iso, e, buf, SECTOR, 0) ==
+		SECTOR, "boot catalog");
+	for ( i = 0, sum = 0; i < 32; i += 2 ) {
+		sum += (unsigned char)buf[i] | ((unsigned char)buf[i + 1] << 8);
+	}
+	check(buf[0] == 1 && (sum & 0xffff) == 0 &&
+		(unsigned char)buf[30] == 0x55 && (unsigned char)buf[31] == 0xaa,
+		"validation entry");
+	check((unsigned char)buf[32] == 0x88 && buf[38] == 4 && e2 &&
+		le32((unsigned char *)buf + 40) == e2->extents[0].block,
+		"default entry");
+	check((unsigned char)buf[64] == 0x91 && (unsigned char)buf[65] ==
+		0xef && (unsigned char)buf[96] == 0x88 && buf[102] == 8,
+		"EFI entry");
+
+	check(e2 && ISORead(iso, e2, buf, sizeof(buf), 0) == sizeof(buf),
+		"boot image");
+	for ( i = 64, sum = 0; i < sizeof(buf); i += 4 ) {
+		sum += le32((unsigned char *)buf + i);
+	}
+	check(le32((unsigned char *)buf + 8) == 16 &&
+		le32((unsigned char *)buf + 12) == e2->extents[0].block &&
+		le32((unsigned char *)buf + 16) == 4096 &&
+		le32((unsigned char *)buf + 20) == sum, "boot info table");
+	ISOClose(iso);
+
+	/* isohybrid and implantisomd5 */
+	if ( stat(out, &st) || !(image = malloc(st.st_size)) ) {
+		return 1;
+	}
+	f = fopen(out, "r");
+	if ( !f || fread(image, 1, st.st_size, f) != (size_t)st.st_size ) {
+		return 1;
+	}
+	fclose(f);
+	check(st.st_size % (1 << 20) == 0, "cylinder padding");
+	check(!memcmp(image, template, sizeof(template)) &&
+		image[510] == 0x55 && image[511] == 0xaa &&
+		image[446] == 0x80 && image[450] == 0x17 &&
+		image[462] == 0 && image[466] == 0xef, "MBR");
+
+	volsize = le32(image + 16 * SECTOR + 80);
+	memcpy(app, image + 16 * SECTOR + 883, sizeof(app));
+	memset(image + 16 * SECTOR + 883, ' ', sizeof(app));
+	MD5SumInit(&md5);
+	MD5SumUpdate(&md5, image, (long long)(volsize - 15) * SECTOR);
+	MD5SumFinal(&md5, digest);
+	MD5SumHex(digest, hex);
+	snprintf(buf, sizeof(buf), "ISO MD5SUM = %s;SKIPSECTORS = 15;", hex);
+	check(!strcmp(hex, jobs[0].md5) && !memcmp(app, buf, strlen(buf)),
+		"implanted md5");
+	free(image);
+
+	/* no extensions: 8.3 names */
+	iso = ISOOpen(plain);
+	check(iso && ISOFlags(iso) == 0 && has(iso, "readme_w.txt", "hello\n")
+		&& has(iso, "readm001.txt", "world\n") &&
+		has(iso, "redhat/rpms/foo_1_0_.rpm", "rpm\n") &&
+		!ISOLookup(iso, "isolinux/boot.cat"), "plain");
+	if ( iso ) {
+		ISOClose(iso);
+	}
+
+	/* too deep for ISO9660 */
+	unlink(plain);
+	snprintf(cmd, sizeof(cmd), "mkdir -p %s/1/2/3/4/5/6/7/8/9", root);
+	if ( system(cmd) ) {
+		failed++;
+	}
+	check(ISOWrite(&jobs[1]) && strstr(jobs[1].error, "levels") &&
+		stat(plain, &st), "too deep");
+	printf("     %s\n", jobs[1].error);
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	if ( system(cmd) ) {
+		failed++;
+	}
+	return failed ? 1 : 0;
+} /* main */
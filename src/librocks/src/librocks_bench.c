@@ -0,0 +1,1291 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+/*
+ * librocks benchmark driver
+ *
+ * Runs every librocks entry point over a synthetic input, reports
+ * throughput and latency percentiles, optionally hardware counters, and
+ * can compare a run against a saved JSON baseline.
+ *
+ *	librocks_bench [-r reps] [-w warmup] [-s bytes] [-f filter] [-p]
+ *		[-o results.json] [-c baseline.json] [-t threshold%]
+ *
+ * Adding a benchmark means adding a setup/run pair and a line to the
+ * benches[] table below.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <sys/syscall.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+#include "../include/hexdump.h"
+#include "../include/attrresolve.h"
+#include "../include/dirscan.h"
+#include "../include/rpmheader.h"
+#include "../include/rpmextract.h"
+#include "../include/isoread.h"
+#include "../include/isowrite.h"
+#include "../include/rocksd.h"
+#include <zlib.h>
+
+#define MAX_RESULTS	256
+
+struct bench_ctx {
+	char	*input;		/* synthetic input data */
+	size_t	size;		/* size of the input */
+	size_t	bytes;		/* bytes processed per op, set by setup */
+	char	*output;	/* scratch output buffer */
+	size_t	output_size;
+	FILE	*devnull;
+	int	devnull_fd;
+	int	engine;
+	void	*state;		/* benchmark private, freed by cleanup */
+};
+
+struct bench {
+	const char	*name;
+	int		engine;		/* hexdump engine, 0 if unused */
+	int		(*setup)(struct bench_ctx *ctx);
+	void		(*run)(struct bench_ctx *ctx);
+	void		(*cleanup)(struct bench_ctx *ctx);
+};
+
+struct result {
+	char	name[128];
+	char	engine[32];	/* hexdump engine that ran, "" if unused */
+	size_t	bytes;
+	int	reps;
+	double	min_ns;
+	double	median_ns;
+	double	p99_ns;
+	double	mb_per_s;
+	double	cycles;		/* per op, -1 if not measured */
+	double	cache_misses;
+};
+
+
+/* ---------------------------------------------------------------- timing */
+
+static double
+now_ns(void)
+{
+	struct timespec	ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int
+cmp_double(const void *a, const void *b)
+{
+	double	x = *(const double *)a;
+	double	y = *(const double *)b;
+
+	return (x > y) - (x < y);
+}
+
+static double
+percentile(double *sorted, int n, double pct)
+{
+	int	i = (int)(pct / 100.0 * (n - 1) + 0.5);
+
+	return sorted[i < n ? i : n - 1];
+}
+
+
+/* ------------------------------------------------------- perf counters */
+
+struct counters {
+	int	cycles_fd;
+	int	misses_fd;
+};
+
+#ifdef __linux__
+static int
+perf_open(unsigned long long config, int group)
+{
+	struct perf_event_attr	attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size	    = sizeof(attr);
+	attr.type	    = PERF_TYPE_HARDWARE;
+	attr.config	    = config;
+	attr.disabled	    = (group == -1);
+	attr.exclude_kernel = 1;
+	attr.exclude_hv	    = 1;
+	return syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif
+
+static int
+counters_open(struct counters *c)
+{
+	c->cycles_fd = c->misses_fd = -1;
+#ifdef __linux__
+	c->cycles_fd = perf_open(PERF_COUNT_HW_CPU_CYCLES, -1);
+	if ( c->cycles_fd < 0 ) {
+		return -1;
+	}
+	c->misses_fd = perf_open(PERF_COUNT_HW_CACHE_MISSES, c->cycles_fd);
+	if ( c->misses_fd < 0 ) {
+		close(c->cycles_fd);
+		c->cycles_fd = -1;
+		return -1;
+	}
+	return 0;
+#else
+	return -1;
+#endif
+}
+
+static void
+counters_start(struct counters *c)
+{
+#ifdef __linux__
+	if ( c->cycles_fd >= 0 ) {
+		ioctl(c->cycles_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(c->cycles_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#endif
+}
+
+static void
+counters_stop(struct counters *c, double *cycles, double *misses)
+{
+	unsigned long long	value;
+
+	*cycles = *misses = -1;
+#ifdef __linux__
+	if ( c->cycles_fd < 0 ) {
+		return;
+	}
+	ioctl(c->cycles_fd, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+	if ( read(c->cycles_fd, &value, sizeof(value)) == sizeof(value) ) {
+		*cycles = value;
+	}
+	if ( read(c->misses_fd, &value, sizeof(value)) == sizeof(value) ) {
+		*misses = value;
+	}
+#endif
+}
+
+static void
+counters_close(struct counters *c)
+{
+	if ( c->misses_fd >= 0 ) {
+		close(c->misses_fd);
+	}
+	if ( c->cycles_fd >= 0 ) {
+		close(c->cycles_fd);
+	}
+}
+
+
+/* ---------------------------------------------------------- benchmarks */
+
+static int
+setup_hexdump(struct bench_ctx *ctx)
+{
+	HexDumpSetEngine(ctx->engine);
+	ctx->bytes = ctx->size;
+	ctx->output_size = HexDumpBufferSize("LABEL", ctx->size);
+	ctx->output = malloc(ctx->output_size);
+	return ctx->output ? 0 : -1;
+}
+
+static void
+run_hexdump_to_buffer(struct bench_ctx *ctx)
+{
+	HexDumpToBuffer(ctx->output, ctx->output_size, "LABEL",
+		ctx->input, ctx->size);
+}
+
+static void
+run_hexdump_to_string(struct bench_ctx *ctx)
+{
+	free(HexDumpToString("LABEL", ctx->input, ctx->size));
+}
+
+static void
+run_hexdump_to_file(struct bench_ctx *ctx)
+{
+	HexDumpToFile(ctx->devnull, "LABEL", ctx->input, ctx->size);
+}
+
+static void
+run_hexdump_to_fd(struct bench_ctx *ctx)
+{
+	HexDumpToFd(ctx->devnull_fd, "LABEL", ctx->input, ctx->size);
+}
+
+static int
+null_writer(void *arg, const char *buf, size_t len)
+{
+	return 0;
+}
+
+static void
+run_hexdump_stream(struct bench_ctx *ctx)
+{
+	HexDumpStream(null_writer, NULL, "LABEL", ctx->input, ctx->size);
+}
+
+/*
+ * Attribute resolution for a synthetic 4000 host cluster: 300 global
+ * attributes, 20 per appliance and os, 10 per host.
+ */
+#define BENCH_HOSTS	4000
+
+struct resolve_state {
+	AttrResolver	*resolver;
+	char		names[BENCH_HOSTS][32];
+};
+
+static int
+setup_attrresolve(struct bench_ctx *ctx)
+{
+	static const char	*cats[] = { "global", "os", "appliance",
+					    "rack", "host" };
+	static const char	*apps[] = { "compute", "frontend", "nas", "login" };
+	struct resolve_state	*st;
+	char			name[64], value[64];
+	int			i, j, ci = 1;
+
+	st = calloc(1, sizeof(struct resolve_state));
+	if ( !st ) {
+		return -1;
+	}
+	st->resolver = AttrResolverCreate();
+	for ( i = 0; i < 5; i++ ) {
+		AttrResolverAddCategory(st->resolver, i + 1, cats[i]);
+		AttrResolverAddChain(st->resolver, i + 1, (i + 1) * 10);
+	}
+
+	AttrResolverAddCatindex(st->resolver, ci, 1, "global");
+	for ( j = 0; j < 300; j++ ) {
+		snprintf(name, sizeof(name), "Global_Attr_%d", j);
+		snprintf(value, sizeof(value), "global value %d", j);
+		AttrResolverAddAttr(st->resolver, name, value, 1, ci);
+	}
+	ci++;
+	AttrResolverAddCatindex(st->resolver, ci, 2, "linux");
+	for ( j = 0; j < 20; j++ ) {
+		snprintf(name, sizeof(name), "Global_Attr_%d", j * 7);
+		AttrResolverAddAttr(st->resolver, name, "linux", 2, ci);
+	}
+	for ( i = 0; i < 4; i++ ) {
+		ci++;
+		AttrResolverAddCatindex(st->resolver, ci, 3, apps[i]);
+		for ( j = 0; j < 20; j++ ) {
+			snprintf(name, sizeof(name), "Global_Attr_%d", j * 11);
+			AttrResolverAddAttr(st->resolver, name, apps[i], 3, ci);
+		}
+	}
+	for ( i = 0; i < BENCH_HOSTS; i++ ) {
+		ci++;
+		snprintf(st->names[i], sizeof(st->names[i]), "compute-%d-%d",
+			i / 40, i % 40);
+		AttrResolverAddCatindex(st->resolver, ci, 5, st->names[i]);
+		for ( j = 0; j < 10; j++ ) {
+			snprintf(name, sizeof(name), "Host_Attr_%d", j);
+			snprintf(value, sizeof(value), "%d", i * 10 + j);
+			AttrResolverAddAttr(st->resolver, name, value, 5, ci);
+		}
+	}
+	if ( AttrResolverBuild(st->resolver) ) {
+		AttrResolverDestroy(st->resolver);
+		free(st);
+		return -1;
+	}
+	ctx->bytes = 0;
+	ctx->state = st;
+	return 0;
+}
+
+static void
+run_attrresolve(struct bench_ctx *ctx)
+{
+	struct resolve_state	*st = ctx->state;
+	const AttrResolved	*res;
+	int			i;
+
+	for ( i = 0; i < BENCH_HOSTS; i++ ) {
+		AttrResolverResolve(st->resolver, st->names[i], "linux",
+			(i % 40) ? "compute" : "login", &res);
+	}
+}
+
+static void
+cleanup_attrresolve(struct bench_ctx *ctx)
+{
+	struct resolve_state	*st = ctx->state;
+
+	AttrResolverDestroy(st->resolver);
+	free(st);
+}
+
+/*
+ * Tree scan of a synthetic distro: 64 directories of 100 RPMs with a
+ * symbolic link next to every tenth one.
+ */
+#define BENCH_SCAN_DIRS		64
+#define BENCH_SCAN_FILES	100
+
+struct scan_state {
+	char	root[64];
+	int	threads;
+};
+
+static int
+setup_dirscan(struct bench_ctx *ctx, int threads)
+{
+	struct scan_state	*st;
+	char			path[256], link[256];
+	int			i, j, fd;
+
+	st = calloc(1, sizeof(struct scan_state));
+	if ( !st ) {
+		return -1;
+	}
+	strcpy(st->root, "/tmp/librocks_bench.XXXXXX");
+	if ( !mkdtemp(st->root) ) {
+		free(st);
+		return -1;
+	}
+	st->threads = threads;
+	for ( i = 0; i < BENCH_SCAN_DIRS; i++ ) {
+		snprintf(path, sizeof(path), "%s/%d", st->root, i);
+		mkdir(path, 0755);
+		for ( j = 0; j < BENCH_SCAN_FILES; j++ ) {
+			snprintf(path, sizeof(path),
+				"%s/%d/package%d-1.%d-%d.el7.x86_64.rpm",
+				st->root, i, j, i, j);
+			fd = open(path, O_WRONLY | O_CREAT, 0644);
+			if ( fd >= 0 ) {
+				close(fd);
+			}
+			if ( j % 10 == 0 ) {
+				snprintf(link, sizeof(link), "%s/%d/link%d.rpm",
+					st->root, i, j);
+				if ( symlink(path, link) ) {
+					break;
+				}
+			}
+		}
+	}
+	ctx->bytes = 0;
+	ctx->state = st;
+	return 0;
+}
+
+static int
+setup_dirscan_1(struct bench_ctx *ctx)
+{
+	return setup_dirscan(ctx, 1);
+}
+
+static int
+setup_dirscan_auto(struct bench_ctx *ctx)
+{
+	return setup_dirscan(ctx, 0);
+}
+
+static void
+run_dirscan(struct bench_ctx *ctx)
+{
+	struct scan_state	*st = ctx->state;
+
+	DirScanFree(DirScanRun(st->root, st->threads));
+}
+
+static void
+cleanup_dirscan(struct bench_ctx *ctx)
+{
+	struct scan_state	*st = ctx->state;
+	char			cmd[128];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", st->root);
+	if ( system(cmd) ) {
+		fprintf(stderr, "cannot remove %s\n", st->root);
+	}
+	free(st);
+}
+
+/*
+ * Header of a small package with 20 tags, read from the page cache.
+ */
+struct rpm_state {
+	char	path[64];
+};
+
+static void
+be32_put(unsigned char *p, unsigned int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static int
+setup_rpmheader(struct bench_ctx *ctx)
+{
+	unsigned char		lead[96] = { 0xed, 0xab, 0xee, 0xdb, 3, 0 };
+	unsigned char		intro[16] = { 0x8e, 0xad, 0xe8, 0x01 };
+	unsigned char		index[20 * 16], store[20 * 32];
+	struct rpm_state	*st;
+	FILE			*f;
+	int			fd, i, size = 0;
+
+	st = calloc(1, sizeof(struct rpm_state));
+	if ( !st ) {
+		return -1;
+	}
+	strcpy(st->path, "/tmp/librocks_bench.XXXXXX");
+	fd = mkstemp(st->path);
+	if ( fd < 0 || !(f = fdopen(fd, "w")) ) {
+		free(st);
+		return -1;
+	}
+
+	for ( i = 0; i < 20; i++ ) {
+		be32_put(index + i * 16, RPMTAG_NAME + i);
+		be32_put(index + i * 16 + 4, RPM_STRING_TYPE);
+		be32_put(index + i * 16 + 8, size);
+		be32_put(index + i * 16 + 12, 1);
+		size += sprintf((char *)store + size, "value of tag %d",
+			RPMTAG_NAME + i) + 1;
+	}
+
+	fwrite(lead, 1, sizeof(lead), f);
+	fwrite(intro, 1, sizeof(intro), f);		/* empty signature */
+	be32_put(intro + 8, 20);
+	be32_put(intro + 12, size);
+	fwrite(intro, 1, sizeof(intro), f);
+	fwrite(index, 1, sizeof(index), f);
+	fwrite(store, 1, size, f);
+	fclose(f);
+
+	ctx->bytes = 0;
+	ctx->state = st;
+	return 0;
+}
+
+static void
+run_rpmheader(struct bench_ctx *ctx)
+{
+	struct rpm_state	*st = ctx->state;
+	RPMHeader		*h = RPMHeaderRead(st->path);
+	const char		*prefixes[4];
+	char			md5[33];
+
+	if ( h ) {
+		RPMHeaderString(h, RPMTAG_BUILDHOST);
+		RPMHeaderStrings(h, RPMTAG_PREFIXES, prefixes, 4);
+		RPMHeaderSigMD5(h, md5);
+		RPMHeaderFree(h);
+	}
+}
+
+static void
+cleanup_rpmheader(struct bench_ctx *ctx)
+{
+	struct rpm_state	*st = ctx->state;
+
+	unlink(st->path);
+	free(st);
+}
+
+/*
+ * Unpacking a gzip roll kickstart package of 200 4KB XML files.
+ */
+#define BENCH_RPM_FILES	200
+
+struct extract_state {
+	char	dir[64];
+	char	path[96];
+	char	root[96];
+};
+
+static int
+setup_rpmextract(struct bench_ctx *ctx)
+{
+	unsigned char		lead[96] = { 0xed, 0xab, 0xee, 0xdb, 3, 0 };
+	unsigned char		intro[16] = { 0x8e, 0xad, 0xe8, 0x01 };
+	unsigned char		index[16];
+	struct extract_state	*st;
+	char			hdr[111], name[64], data[4096];
+	gzFile			gz;
+	FILE			*f;
+	int			i, n, len = 0;
+
+	st = calloc(1, sizeof(struct extract_state));
+	if ( !st ) {
+		return -1;
+	}
+	strcpy(st->dir, "/tmp/librocks_bench.XXXXXX");
+	if ( !mkdtemp(st->dir) ) {
+		free(st);
+		return -1;
+	}
+	snprintf(st->path, sizeof(st->path), "%s/kickstart.rpm", st->dir);
+	snprintf(st->root, sizeof(st->root), "%s/root", st->dir);
+
+	f = fopen(st->path, "w");
+	if ( !f ) {
+		free(st);
+		return -1;
+	}
+	be32_put(index, RPMTAG_PAYLOADFORMAT);
+	be32_put(index + 4, RPM_STRING_TYPE);
+	be32_put(index + 8, 0);
+	be32_put(index + 12, 1);
+	fwrite(lead, 1, sizeof(lead), f);
+	fwrite(intro, 1, sizeof(intro), f);
+	be32_put(intro + 8, 1);
+	be32_put(intro + 12, 5);
+	fwrite(intro, 1, sizeof(intro), f);
+	fwrite(index, 1, sizeof(index), f);
+	fwrite("cpio", 1, 5, f);
+	fflush(f);
+
+	memset(data, 'x', sizeof(data));
+	gz = gzdopen(dup(fileno(f)), "ab");
+	for ( i = 0; i <= BENCH_RPM_FILES; i++ ) {
+		if ( i < BENCH_RPM_FILES ) {
+			snprintf(name, sizeof(name),
+				"./export/profile/nodes/node%d.xml", i);
+		}
+		else {
+			strcpy(name, "TRAILER!!!");
+		}
+		len = (i < BENCH_RPM_FILES) ? sizeof(data) : 0;
+		n = strlen(name) + 1;
+		snprintf(hdr, sizeof(hdr), "070701%08X%08X%08X%08X%08X%08X"
+			"%08X%08X%08X%08X%08X%08X%08X", i + 1,
+			len ? 0100644 : 0, 0, 0, 1, 0, len, 0, 0, 0, 0, n, 0);
+		gzwrite(gz, hdr, 110);
+		gzwrite(gz, name, n);
+		gzwrite(gz, "\0\0\0", (4 - (110 + n) % 4) % 4);
+		gzwrite(gz, data, len);
+	}
+	gzclose(gz);
+	fclose(f);
+
+	ctx->bytes = BENCH_RPM_FILES * sizeof(data);
+	ctx->state = st;
+	return 0;
+}
+
+static void
+run_rpmextract(struct bench_ctx *ctx)
+{
+	struct extract_state	*st = ctx->state;
+	char			error[256];
+
+	if ( RPMExtract(st->path, st->root, error, sizeof(error)) ) {
+		fprintf(stderr, "%s: %s\n", st->path, error);
+	}
+}
+
+static void
+cleanup_rpmextract(struct bench_ctx *ctx)
+{
+	struct extract_state	*st = ctx->state;
+	char			cmd[128];
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", st->dir);
+	if ( system(cmd) ) {
+		fprintf(stderr, "cannot remove %s\n", st->dir);
+	}
+	free(st);
+}
+
+/*
+ * Opening a plain ISO9660 roll image of 200 4KB files and copying
+ * them out.
+ */
+#define BENCH_ISO_FILES		200
+#define BENCH_ISO_DIRBLOCKS	8
+#define BENCH_ISO_DATA		(18 + BENCH_ISO_DIRBLOCKS)
+
+static void
+both32_put(unsigned char *p, unsigned int v)
+{
+	p[0] = p[7] = v & 0xff;
+	p[1] = p[6] = (v >> 8) & 0xff;
+	p[2] = p[5] = (v >> 16) & 0xff;
+	p[3] = p[4] = v >> 24;
+}
+
+static int
+iso_record(unsigned char *p, unsigned int block, unsigned int size,
+	int flags, const char *id, int idlen)
+{
+	int	len = 33 + idlen + (idlen % 2 ? 0 : 1);
+
+	memset(p, 0, len);
+	p[0] = len;
+	both32_put(p + 2, block);
+	both32_put(p + 10, size);
+	p[18] = 110;
+	p[19] = p[20] = 1;
+	p[25] = flags;
+	p[28] = p[31] = 1;
+	p[32] = idlen;
+	memcpy(p + 33, id, idlen);
+	return len;
+}
+
+static int
+setup_isoextract(struct bench_ctx *ctx)
+{
+	struct extract_state	*st;
+	unsigned char		*img, *dir;
+	size_t			size;
+	char			id[32];
+	int			i, fd, pos, ok;
+
+	st = calloc(1, sizeof(struct extract_state));
+	if ( !st ) {
+		return -1;
+	}
+	strcpy(st->dir, "/tmp/librocks_bench.XXXXXX");
+	if ( !mkdtemp(st->dir) ) {
+		free(st);
+		return -1;
+	}
+	snprintf(st->path, sizeof(st->path), "%s/roll.iso", st->dir);
+	snprintf(st->root, sizeof(st->root), "%s/root", st->dir);
+
+	size = (BENCH_ISO_DATA + BENCH_ISO_FILES * 2) * 2048;
+	img  = calloc(1, size);
+	if ( !img ) {
+		free(st);
+		return -1;
+	}
+	img[16 * 2048] = 1;
+	memcpy(img + 16 * 2048 + 1, "CD001", 5);
+	iso_record(img + 16 * 2048 + 156, 18, BENCH_ISO_DIRBLOCKS * 2048, 0x02,
+		"", 1);
+	img[17 * 2048] = 255;
+	memcpy(img + 17 * 2048 + 1, "CD001", 5);
+
+	dir = img + 18 * 2048;
+	pos = iso_record(dir, 18, BENCH_ISO_DIRBLOCKS * 2048, 0x02, "\0", 1);
+	pos += iso_record(dir + pos, 18, BENCH_ISO_DIRBLOCKS * 2048, 0x02,
+		"\1", 1);
+	for ( i = 0; i < BENCH_ISO_FILES; i++ ) {
+		snprintf(id, sizeof(id), "NODE%d.XML;1", i);
+		if ( pos % 2048 + 33 + strlen(id) + 1 > 2048 ) {
+			pos = (pos / 2048 + 1) * 2048;
+		}
+		pos += iso_record(dir + pos, BENCH_ISO_DATA + i * 2, 4096, 0,
+			id, strlen(id));
+		memset(img + (BENCH_ISO_DATA + i * 2) * 2048, 'x', 4096);
+	}
+
+	fd = open(st->path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	ok = fd >= 0 && write(fd, img, size) == (ssize_t)size;
+	if ( fd >= 0 ) {
+		close(fd);
+	}
+	free(img);
+	if ( !ok ) {
+		free(st);
+		return -1;
+	}
+
+	ctx->bytes = BENCH_ISO_FILES * 4096;
+	ctx->state = st;
+	return 0;
+}
+
+static void
+run_isoextract(struct bench_ctx *ctx)
+{
+	struct extract_state	*st = ctx->state;
+	ISOExtractJob		job;
+
+	memset(&job, 0, sizeof(job));
+	job.image = ISOOpen(st->path);
+	if ( !job.image ) {
+		perror(st->path);
+		return;
+	}
+	job.subdir = "";
+	job.dest   = st->root;
+	if ( ISOExtractMany(&job, 1, 0) ) {
+		fprintf(stderr, "%s: %s\n", st->path, job.error);
+	}
+	ISOClose(job.image);
+}
+
+/*
+ * Writing a Rock Ridge, TRANS.TBL image with the implanted checksum
+ * from a tree of 200 64KB files.
+ */
+#define BENCH_ISOWRITE_FILES	200
+#define BENCH_ISOWRITE_SIZE	(64 * 1024)
+
+static int
+setup_isowrite(struct bench_ctx *ctx)
+{
+	struct extract_state	*st;
+	char			path[160], *data;
+	FILE			*f;
+	int			i;
+
+	st = calloc(1, sizeof(struct extract_state));
+	data = malloc(BENCH_ISOWRITE_SIZE);
+	if ( !st || !data ) {
+		free(st);
+		free(data);
+		return -1;
+	}
+	strcpy(st->dir, "/tmp/librocks_bench.XXXXXX");
+	if ( !mkdtemp(st->dir) ) {
+		free(st);
+		free(data);
+		return -1;
+	}
+	snprintf(st->path, sizeof(st->path), "%s/roll.iso", st->dir);
+	snprintf(st->root, sizeof(st->root), "%s/root", st->dir);
+	mkdir(st->root, 0755);
+
+	memset(data, 'r', BENCH_ISOWRITE_SIZE);
+	for ( i = 0; i < BENCH_ISOWRITE_FILES; i++ ) {
+		snprintf(path, sizeof(path), "%s/package-%03d-1.0-1.x86_64.rpm",
+			st->root, i);
+		f = fopen(path, "w");
+		if ( !f ) {
+			free(data);
+			return -1;
+		}
+		fwrite(data, 1, BENCH_ISOWRITE_SIZE, f);
+		fclose(f);
+	}
+	free(data);
+
+	ctx->bytes = BENCH_ISOWRITE_FILES * BENCH_ISOWRITE_SIZE;
+	ctx->state = st;
+	return 0;
+}
+
+static void
+run_isowrite(struct bench_ctx *ctx)
+{
+	struct extract_state	*st = ctx->state;
+	ISOWriteJob		job;
+
+	memset(&job, 0, sizeof(job));
+	job.root   = st->root;
+	job.output = st->path;
+	job.volume = "bench";
+	job.flags  = ISOWRITE_ROCKRIDGE | ISOWRITE_TRANSTBL | ISOWRITE_MD5;
+	if ( ISOWrite(&job) ) {
+		fprintf(stderr, "%s: %s\n", st->path, job.error);
+	}
+}
+
+/*
+ * A rocks command through rocksd, less the command: connect, pass the
+ * descriptors and the request, and wait for a daemon that answers
+ * right away.
+ */
+struct rocksd_state {
+	char	dir[64];
+	char	path[96];
+	pid_t	pid;
+};
+
+static void
+rocksd_server(int listener)
+{
+	static const unsigned char	reply[ROCKSD_HEADER] = "RKDX";
+	char				buf[65536];
+
+	for ( ;; ) {
+		int	conn = accept(listener, NULL, NULL);
+		int	fds[3], nfds, i;
+
+		if ( conn < 0 ) {
+			continue;
+		}
+		if ( RocksdRecvFds(conn, buf, sizeof(buf), fds, 3, &nfds) > 0 &&
+			write(conn, reply, sizeof(reply)) < 0 ) {
+			perror("rocksd");
+		}
+		for ( i = 0; i < nfds; i++ ) {
+			close(fds[i]);
+		}
+		close(conn);
+	}
+}
+
+static int
+setup_rocksd(struct bench_ctx *ctx)
+{
+	struct rocksd_state	*st;
+	struct sockaddr_un	addr;
+	int			listener;
+
+	st = calloc(1, sizeof(struct rocksd_state));
+	if ( !st ) {
+		return -1;
+	}
+	strcpy(st->dir, "/tmp/librocks_bench.XXXXXX");
+	if ( !mkdtemp(st->dir) ) {
+		free(st);
+		return -1;
+	}
+	snprintf(st->path, sizeof(st->path), "%s/rocksd.sock", st->dir);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, st->path);
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( listener < 0 || bind(listener, (struct sockaddr *)&addr,
+		sizeof(addr)) || listen(listener, 16) ) {
+		free(st);
+		return -1;
+	}
+	fflush(NULL);
+	st->pid = fork();
+	if ( st->pid == 0 ) {
+		rocksd_server(listener);
+	}
+	close(listener);
+
+	ctx->bytes = 0;
+	ctx->state = st;
+	return st->pid < 0 ? -1 : 0;
+}
+
+static void
+run_rocksd(struct bench_ctx *ctx)
+{
+	struct rocksd_state	*st = ctx->state;
+	char * const		args[] = { "list", "host", "interface",
+					"compute-0-0", NULL };
+	char * const		env[] = { "PATH=/usr/bin:/bin", "HOME=/root",
+					"LANG=C", NULL };
+	int			status;
+
+	if ( RocksdCall(st->path, 4, args, env, &status) ) {
+		fprintf(stderr, "%s: no answer\n", st->path);
+	}
+}
+
+static void
+cleanup_rocksd(struct bench_ctx *ctx)
+{
+	struct rocksd_state	*st = ctx->state;
+
+	if ( st->pid > 0 ) {
+		kill(st->pid, SIGKILL);
+		waitpid(st->pid, NULL, 0);
+	}
+	unlink(st->path);
+	rmdir(st->dir);
+	free(st);
+}
+
+static struct bench benches[] = {
+	{ "HexDumpToBuffer/scalar", HEXDUMP_ENGINE_SCALAR,
+		setup_hexdump, run_hexdump_to_buffer },
+	{ "HexDumpToBuffer/sse2",   HEXDUMP_ENGINE_SSE2,
+		setup_hexdump, run_hexdump_to_buffer },
+	{ "HexDumpToBuffer/avx2",   HEXDUMP_ENGINE_AVX2,
+		setup_hexdump, run_hexdump_to_buffer },
+	{ "HexDumpToString",	    HEXDUMP_ENGINE_AUTO,
+		setup_hexdump, run_hexdump_to_string },
+	{ "HexDumpToFile",	    HEXDUMP_ENGINE_AUTO,
+		setup_hexdump, run_hexdump_to_file },
+	{ "HexDumpToFd",	    HEXDUMP_ENGINE_AUTO,
+		setup_hexdump, run_hexdump_to_fd },
+	{ "HexDumpStream",	    HEXDUMP_ENGINE_AUTO,
+		setup_hexdump, run_hexdump_stream },
+	{ "AttrResolverResolve/4000hosts", 0,
+		setup_attrresolve, run_attrresolve, cleanup_attrresolve },
+	{ "DirScanRun/1thread",	    0,
+		setup_dirscan_1, run_dirscan, cleanup_dirscan },
+	{ "DirScanRun/auto",	    0,
+		setup_dirscan_auto, run_dirscan, cleanup_dirscan },
+	{ "RPMHeaderRead",	    0,
+		setup_rpmheader, run_rpmheader, cleanup_rpmheader },
+	{ "RPMExtract/200files",    0,
+		setup_rpmextract, run_rpmextract, cleanup_rpmextract },
+	{ "ISOExtract/200files",    0,
+		setup_isoextract, run_isoextract, cleanup_rpmextract },
+	{ "ISOWrite/200files",      0,
+		setup_isowrite, run_isowrite, cleanup_rpmextract },
+	{ "RocksdCall/roundtrip",   0,
+		setup_rocksd, run_rocksd, cleanup_rocksd },
+	{ NULL }
+};
+
+
+/* ------------------------------------------------------------- driver */
+
+static int
+run_bench(struct bench *b, struct bench_ctx *ctx, int reps, int warmup,
+	int use_counters, struct result *r)
+{
+	struct counters	c;
+	double		*samples, *cycles, *misses, t;
+	int		i;
+
+	ctx->engine = b->engine;
+	ctx->output = NULL;
+	ctx->state  = NULL;
+	if ( b->setup && b->setup(ctx) ) {
+		fprintf(stderr, "%s: setup failed\n", b->name);
+		return -1;
+	}
+
+	samples = calloc(reps, sizeof(double));
+	cycles	= calloc(reps, sizeof(double));
+	misses	= calloc(reps, sizeof(double));
+	if ( !use_counters || counters_open(&c) ) {
+		c.cycles_fd = c.misses_fd = -1;
+	}
+
+	for ( i = 0; i < warmup; i++ ) {
+		b->run(ctx);
+	}
+	for ( i = 0; i < reps; i++ ) {
+		counters_start(&c);
+		t = now_ns();
+		b->run(ctx);
+		samples[i] = now_ns() - t;
+		counters_stop(&c, &cycles[i], &misses[i]);
+	}
+	counters_close(&c);
+
+	qsort(samples, reps, sizeof(double), cmp_double);
+	qsort(cycles,  reps, sizeof(double), cmp_double);
+	qsort(misses,  reps, sizeof(double), cmp_double);
+
+	/*
+	 * The name stays the same for the baseline to match, the engine
+	 * that actually ran (it may have fallen back) is kept aside.
+	 */
+	snprintf(r->name, sizeof(r->name), "%s", b->name);
+	r->engine[0] = '\0';
+	if ( b->setup == setup_hexdump ) {
+		snprintf(r->engine, sizeof(r->engine), "%s",
+			HexDumpEngineName(HexDumpGetEngine()));
+	}
+	r->bytes	= ctx->bytes;
+	r->reps		= reps;
+	r->min_ns	= samples[0];
+	r->median_ns	= percentile(samples, reps, 50);
+	r->p99_ns	= percentile(samples, reps, 99);
+	r->mb_per_s	= r->median_ns > 0 ?
+		(ctx->bytes / 1048576.0) / (r->median_ns / 1e9) : 0;
+	r->cycles	= percentile(cycles, reps, 50);
+	r->cache_misses = percentile(misses, reps, 50);
+
+	free(samples);
+	free(cycles);
+	free(misses);
+	free(ctx->output);
+	if ( b->cleanup ) {
+		b->cleanup(ctx);
+	}
+	HexDumpSetEngine(HEXDUMP_ENGINE_AUTO);
+	return 0;
+}
+
+static void
+print_result(struct result *r)
+{
+	if ( r->bytes ) {
+		printf("%-32s %10.1f MB/s", r->name, r->mb_per_s);
+	}
+	else {
+		printf("%-32s %15s", r->name, "");
+	}
+	printf(" %12.0f ns/op %12.0f p99", r->median_ns, r->p99_ns);
+	if ( r->cycles >= 0 ) {
+		printf(" %12.0f cyc %8.0f miss", r->cycles, r->cache_misses);
+	}
+	if ( r->engine[0] ) {
+		printf(" [%s]", r->engine);
+	}
+	printf("\n");
+}
+
+/*
+ * Results are written one per line so that compare mode can read them
+ * back without a JSON library.
+ */
+static int
+write_json(const char *path, struct result *r, int n)
+{
+	FILE	*fout;
+	int	i;
+
+	fout = fopen(path, "w");
+	if ( !fout ) {
+		perror(path);
+		return -1;
+	}
+	fprintf(fout, "{\n\"results\": [\n");
+	for ( i = 0; i < n; i++ ) {
+		fprintf(fout, "{\"name\": \"%s\", \"bytes\": %zu, "
+			"\"reps\": %d, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+			"\"p99_ns\": %.0f, \"mb_per_s\": %.2f, "
+			"\"cycles\": %.0f, \"cache_misses\": %.0f, "
+			"\"engine\": \"%s\"}%s\n",
+			r[i].name, r[i].bytes, r[i].reps, r[i].min_ns,
+			r[i].median_ns, r[i].p99_ns, r[i].mb_per_s,
+			r[i].cycles, r[i].cache_misses, r[i].engine,
+			i + 1 < n ? "," : "");
+	}
+	fprintf(fout, "]\n}\n");
+	fclose(fout);
+	return 0;
+}
+
+static int
+read_json(const char *path, struct result *r, int max)
+{
+	FILE	*fin;
+	char	line[1024], *engine;
+	int	n = 0;
+
+	fin = fopen(path, "r");
+	if ( !fin ) {
+		perror(path);
+		return -1;
+	}
+	while ( n < max && fgets(line, sizeof(line), fin) ) {
+		memset(&r[n], 0, sizeof(r[n]));
+		if ( sscanf(line, "{\"name\": \"%127[^\"]\", \"bytes\": %zu, "
+			"\"reps\": %d, \"min_ns\": %lf, \"median_ns\": %lf, "
+			"\"p99_ns\": %lf, \"mb_per_s\": %lf",
+			r[n].name, &r[n].bytes, &r[n].reps, &r[n].min_ns,
+			&r[n].median_ns, &r[n].p99_ns, &r[n].mb_per_s) == 7 ) {
+			/* older baselines have no engine */
+			engine = strstr(line, "\"engine\": \"");
+			if ( engine ) {
+				sscanf(engine, "\"engine\": \"%31[^\"]\"",
+					r[n].engine);
+			}
+			n++;
+		}
+	}
+	fclose(fin);
+	return n;
+}
+
+/*
+ * Flags every benchmark whose median time grew by more than threshold
+ * percent over the baseline.  Returns the number of regressions.
+ */
+static int
+compare(struct result *base, int nbase, struct result *cur, int ncur,
+	double threshold)
+{
+	int	i, j, regressions = 0;
+
+	printf("\n%-32s %12s %12s %8s\n", "benchmark", "baseline", "current",
+		"change");
+	for ( i = 0; i < ncur; i++ ) {
+		for ( j = 0; j < nbase; j++ ) {
+			double	delta;
+
+			if ( strcmp(cur[i].name, base[j].name) ||
+				cur[i].bytes != base[j].bytes ||
+				base[j].median_ns <= 0 ) {
+				continue;
+			}
+			delta = (cur[i].median_ns - base[j].median_ns) /
+				base[j].median_ns * 100.0;
+			printf("%-32s %12.0f %12.0f %+7.1f%%%s", cur[i].name,
+				base[j].median_ns, cur[i].median_ns, delta,
+				delta > threshold ? "  REGRESSION" : "");
+			/* a fallback is not a regression of the engine */
+			if ( base[j].engine[0] && cur[i].engine[0] &&
+				strcmp(base[j].engine, cur[i].engine) ) {
+				printf("  (engine %s, was %s)", cur[i].engine,
+					base[j].engine);
+			}
+			printf("\n");
+			if ( delta > threshold ) {
+				regressions++;
+			}
+			break;
+		}
+	}
+	return regressions;
+}
+
+static void
+usage(const char *prog)
+{
+	fprintf(stderr, "usage: %s [-r reps] [-w warmup] [-s bytes] "
+		"[-f filter] [-p] [-o results.json] [-c baseline.json] "
+		"[-t threshold%%]\n", prog);
+	exit(2);
+}
+
+int
+main(int argc, char *argv[])
+{
+	struct bench_ctx	ctx;
+	struct result		results[MAX_RESULTS];
+	struct result		baseline[MAX_RESULTS];
+	const char		*filter = NULL;
+	const char		*outfile = NULL;
+	const char		*basefile = NULL;
+	double			threshold = 10.0;
+	int			reps = 50, warmup = 5, use_counters = 0;
+	int			opt, i, n = 0, nbase;
+	size_t			j;
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.size = 1 << 20;
+
+	while ( (opt = getopt(argc, argv, "r:w:s:f:po:c:t:h")) != -1 ) {
+		switch ( opt ) {
+		case 'r': reps	    = atoi(optarg); break;
+		case 'w': warmup    = atoi(optarg); break;
+		case 's': ctx.size  = strtoul(optarg, NULL, 0); break;
+		case 'f': filter    = optarg; break;
+		case 'p': use_counters = 1; break;
+		case 'o': outfile   = optarg; break;
+		case 'c': basefile  = optarg; break;
+		case 't': threshold = atof(optarg); break;
+		default:  usage(argv[0]);
+		}
+	}
+	if ( reps < 1 || ctx.size < 1 ) {
+		usage(argv[0]);
+	}
+
+	ctx.input = malloc(ctx.size);
+	if ( !ctx.input ) {
+		perror("malloc");
+		return 1;
+	}
+	srandom(42);
+	for ( j = 0; j < ctx.size; j++ ) {
+		ctx.input[j] = random();
+	}
+	ctx.devnull    = fopen("/dev/null", "w");
+	ctx.devnull_fd = open("/dev/null", O_WRONLY);
+
+	if ( use_counters ) {
+		struct counters	c;
+
+		if ( counters_open(&c) ) {
+			fprintf(stderr, "perf_event_open: %s, "
+				"counters disabled\n", strerror(errno));
+			use_counters = 0;
+		}
+		else {
+			counters_close(&c);
+		}
+	}
+
+	for ( i = 0; benches[i].name && n < MAX_RESULTS; i++ ) {
+		if ( filter && !strstr(benches[i].name, filter) ) {
+			continue;
+		}
+		if ( run_bench(&benches[i], &ctx, reps, warmup, use_counters,
+			&results[n]) == 0 ) {
+			print_result(&results[n]);
+			n++;
+		}
+	}
+
+	/* the baseline is read before the results may overwrite it */
+	nbase = 0;
+	if ( basefile ) {
+		nbase = read_json(basefile, baseline, MAX_RESULTS);
+		if ( nbase < 0 ) {
+			return 1;
+		}
+	}
+
+	if ( outfile && write_json(outfile, results, n) ) {
+		return 1;
+	}
+
+	if ( basefile && compare(baseline, nbase, results, n, threshold) ) {
+		return 3;
+	}
+	return 0;
+} /* main */
@@ -0,0 +1,234 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <string.h>
+#include "../include/md5sum.h"
+
+#define F(x, y, z)	(((x) & (y)) | (~(x) & (z)))
+#define G(x, y, z)	(((x) & (z)) | ((y) & ~(z)))
+#define H(x, y, z)	((x) ^ (y) ^ (z))
+#define I(x, y, z)	((y) ^ ((x) | ~(z)))
+
+#define ROTATE(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+#define STEP(f, a, b, c, d, x, s, t) \
+	(a) += f((b), (c), (d)) + (x) + (t); \
+	(a)  = ROTATE((a), (s)) + (b);
+
+static void
+transform(unsigned int state[4], const unsigned char block[64])
+{
+	unsigned int	a = state[0], b = state[1], c = state[2], d = state[3];
+	unsigned int	x[16];
+	int		i;
+
+	for ( i = 0; i < 16; i++ ) {
+		x[i] = block[i * 4] | (block[i * 4 + 1] << 8) |
+			(block[i * 4 + 2] << 16) |
+			((unsigned int)block[i * 4 + 3] << 24);
+	}
+
+	STEP(F, a, b, c, d, x[ 0],  7, 0xd76aa478)
+	STEP(F, d, a, b, c, x[ 1], 12, 0xe8c7b756)
+	STEP(F, c, d, a, b, x[ 2], 17, 0x242070db)
+	STEP(F, b, c, d, a, x[ 3], 22, 0xc1bdceee)
+	STEP(F, a, b, c, d, x[ 4],  7, 0xf57c0faf)
+	STEP(F, d, a, b, c, x[ 5], 12, 0x4787c62a)
+	STEP(F, c, d, a, b, x[ 6], 17, 0xa8304613)
+	STEP(F, b, c, d, a, x[ 7], 22, 0xfd469501)
+	STEP(F, a, b, c, d, x[ 8],  7, 0x698098d8)
+	STEP(F, d, a, b, c, x[ 9], 12, 0x8b44f7af)
+	STEP(F, c, d, a, b, x[10], 17, 0xffff5bb1)
+	STEP(F, b, c, d, a, x[11], 22, 0x895cd7be)
+	STEP(F, a, b, c, d, x[12],  7, 0x6b901122)
+	STEP(F, d, a, b, c, x[13], 12, 0xfd987193)
+	STEP(F, c, d, a, b, x[14], 17, 0xa679438e)
+	STEP(F, b, c, d, a, x[15], 22, 0x49b40821)
+
+	STEP(G, a, b, c, d, x[ 1],  5, 0xf61e2562)
+	STEP(G, d, a, b, c, x[ 6],  9, 0xc040b340)
+	STEP(G, c, d, a, b, x[11], 14, 0x265e5a51)
+	STEP(G, b, c, d, a, x[ 0], 20, 0xe9b6c7aa)
+	STEP(G, a, b, c, d, x[ 5],  5, 0xd62f105d)
+	STEP(G, d, a, b, c, x[10],  9, 0x02441453)
+	STEP(G, c, d, a, b, x[15], 14, 0xd8a1e681)
+	STEP(G, b, c, d, a, x[ 4], 20, 0xe7d3fbc8)
+	STEP(G, a, b, c, d, x[ 9],  5, 0x21e1cde6)
+	STEP(G, d, a, b, c, x[14],  9, 0xc33707d6)
+	STEP(G, c, d, a, b, x[ 3], 14, 0xf4d50d87)
+	STEP(G, b, c, d, a, x[ 8], 20, 0x455a14ed)
+	STEP(G, a, b, c, d, x[13],  5, 0xa9e3e905)
+	STEP(G, d, a, b, c, x[ 2],  9, 0xfcefa3f8)
+	STEP(G, c, d, a, b, x[ 7], 14, 0x676f02d9)
+	STEP(G, b, c, d, a, x[12], 20, 0x8d2a4c8a)
+
+	STEP(H, a, b, c, d, x[ 5],  4, 0xfffa3942)
+	STEP(H, d, a, b, c, x[ 8], 11, 0x8771f681)
+	STEP(H, c, d, a, b, x[11], 16, 0x6d9d6122)
+	STEP(H, b, c, d, a, x[14], 23, 0xfde5380c)
+	STEP(H, a, b, c, d, x[ 1],  4, 0xa4beea44)
+	STEP(H, d, a, b, c, x[ 4], 11, 0x4bdecfa9)
+	STEP(H, c, d, a, b, x[ 7], 16, 0xf6bb4b60)
+	STEP(H, b, c, d, a, x[10], 23, 0xbebfbc70)
+	STEP(H, a, b, c, d, x[13],  4, 0x289b7ec6)
+	STEP(H, d, a, b, c, x[ 0], 11, 0xeaa127fa)
+	STEP(H, c, d, a, b, x[ 3], 16, 0xd4ef3085)
+	STEP(H, b, c, d, a, x[ 6], 23, 0x04881d05)
+	STEP(H, a, b, c, d, x[ 9],  4, 0xd9d4d039)
+	STEP(H, d, a, b, c, x[12], 11, 0xe6db99e5)
+	STEP(H, c, d, a, b, x[15], 16, 0x1fa27cf8)
+	STEP(H, b, c, d, a, x[ 2], 23, 0xc4ac5665)
+
+	STEP(I, a, b, c, d, x[ 0],  6, 0xf4292244)
+	STEP(I, d, a, b, c, x[ 7], 10, 0x432aff97)
+	STEP(I, c, d, a, b, x[14], 15, 0xab9423a7)
+	STEP(I, b, c, d, a, x[ 5], 21, 0xfc93a039)
+	STEP(I, a, b, c, d, x[12],  6, 0x655b59c3)
+	STEP(I, d, a, b, c, x[ 3], 10, 0x8f0ccc92)
+	STEP(I, c, d, a, b, x[10], 15, 0xffeff47d)
+	STEP(I, b, c, d, a, x[ 1], 21, 0x85845dd1)
+	STEP(I, a, b, c, d, x[ 8],  6, 0x6fa87e4f)
+	STEP(I, d, a, b, c, x[15], 10, 0xfe2ce6e0)
+	STEP(I, c, d, a, b, x[ 6], 15, 0xa3014314)
+	STEP(I, b, c, d, a, x[13], 21, 0x4e0811a1)
+	STEP(I, a, b, c, d, x[ 4],  6, 0xf7537e82)
+	STEP(I, d, a, b, c, x[11], 10, 0xbd3af235)
+	STEP(I, c, d, a, b, x[ 2], 15, 0x2ad7d2bb)
+	STEP(I, b, c, d, a, x[ 9], 21, 0xeb86d391)
+
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+}
+
+
+void
+MD5SumInit(MD5Sum *ctx)
+{
+	ctx->state[0] = 0x67452301;
+	ctx->state[1] = 0xefcdab89;
+	ctx->state[2] = 0x98badcfe;
+	ctx->state[3] = 0x10325476;
+	ctx->count    = 0;
+} /* MD5SumInit */
+
+
+void
+MD5SumUpdate(MD5Sum *ctx, const void *data, size_t len)
+{
+	const unsigned char	*p = data;
+	size_t			have = ctx->count % 64;
+
+	ctx->count += len;
+	if ( have ) {
+		size_t	n = 64 - have;
+
+		if ( len < n ) {
+			memcpy(ctx->buffer + have, p, len);
+			return;
+		}
+		memcpy(ctx->buffer + have, p, n);
+		transform(ctx->state, ctx->buffer);
+		p   += n;
+		len -= n;
+	}
+	for ( ; len >= 64; p += 64, len -= 64 ) {
+		transform(ctx->state, p);
+	}
+	if ( len ) {
+		memcpy(ctx->buffer, p, len);
+	}
+} /* MD5SumUpdate */
+
+
+void
+MD5SumFinal(MD5Sum *ctx, unsigned char digest[16])
+{
+	unsigned char		pad[72];
+	unsigned long long	bits = ctx->count * 8;
+	size_t			n = 64 - ctx->count % 64;
+	int			i;
+
+	if ( n < 9 ) {
+		n += 64;
+	}
+	memset(pad, 0, sizeof(pad));
+	pad[0] = 0x80;
+	for ( i = 0; i < 8; i++ ) {
+		pad[n - 8 + i] = bits >> (i * 8);
+	}
+	MD5SumUpdate(ctx, pad, n);
+
+	for ( i = 0; i < 16; i++ ) {
+		digest[i] = ctx->state[i / 4] >> ((i % 4) * 8);
+	}
+} /* MD5SumFinal */
+
+
+void
+MD5SumHex(const unsigned char digest[16], char hex[33])
+{
+	static const char	digits[] = "0123456789abcdef";
+	int			i;
+
+	for ( i = 0; i < 16; i++ ) {
+		hex[i * 2]     = digits[digest[i] >> 4];
+		hex[i * 2 + 1] = digits[digest[i] & 0x0f];
+	}
+	hex[32] = '\0';
+} /* MD5SumHex */
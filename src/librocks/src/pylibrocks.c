@@ -0,0 +1,1641 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+/*
+ * _librocks: Python bindings for librocks.
+ *
+ * Built against the rocks foundation python and installed next to the
+ * rocks package.  Everything in rocks-pylib that uses it falls back to
+ * the pure python code when the module cannot be imported.
+ */
+
+#include <Python.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../include/attrresolve.h"
+#include "../include/dirscan.h"
+#include "../include/rpmheader.h"
+#include "../include/rpmextract.h"
+#include "../include/isoread.h"
+#include "../include/isowrite.h"
+#include "../include/rocksd.h"
+
+#if PY_MAJOR_VERSION >= 3
+#define PyString_FromString	PyUnicode_FromString
+#endif
+
+
+/*
+ * Returns a C string for a str (or unicode) object.  If a temporary
+ * object had to be created it is returned in *tmp and must be released
+ * by the caller once the string is no longer needed.
+ */
+static const char *
+as_cstring(PyObject *o, PyObject **tmp)
+{
+	*tmp = NULL;
+	if ( o == Py_None ) {
+		return NULL;
+	}
+#if PY_MAJOR_VERSION >= 3
+	if ( PyBytes_Check(o) ) {
+		return PyBytes_AsString(o);
+	}
+	return PyUnicode_AsUTF8(o);
+#else
+	if ( PyUnicode_Check(o) ) {
+		*tmp = PyUnicode_AsUTF8String(o);
+		return *tmp ? PyString_AsString(*tmp) : NULL;
+	}
+	return PyString_AsString(o);
+#endif
+}
+
+
+/* ------------------------------------------------------ AttrResolver */
+
+typedef struct {
+	PyObject_HEAD
+	AttrResolver	*resolver;
+	PyObject	**strings;	/* python objects by string id */
+	int		nstrings;
+} PyAttrResolver;
+
+static void
+clear_strings(PyAttrResolver *self)
+{
+	int	i;
+
+	for ( i = 0; i < self->nstrings; i++ ) {
+		Py_XDECREF(self->strings[i]);
+	}
+	PyMem_Free(self->strings);
+	self->strings  = NULL;
+	self->nstrings = 0;
+}
+
+static void
+PyAttrResolver_dealloc(PyAttrResolver *self)
+{
+	clear_strings(self);
+	AttrResolverDestroy(self->resolver);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+/*
+ * Feeds every row of one table to the resolver.  table is the position
+ * of the table in the constructor arguments.
+ */
+static int
+load_rows(PyAttrResolver *self, PyObject *rows, int table)
+{
+	PyObject	*it, *row;
+	int		rc = 0;
+
+	it = PyObject_GetIter(rows);
+	if ( !it ) {
+		return -1;
+	}
+
+	while ( rc >= 0 && (row = PyIter_Next(it)) ) {
+		PyObject	*s1, *s2, *t1 = NULL, *t2 = NULL;
+		const char	*c1 = NULL, *c2 = NULL;
+		int		i1, i2;
+
+		switch ( table ) {
+		case 0:	/* categories: ID, Name */
+			if ( !PyArg_ParseTuple(row, "iO", &i1, &s1) ||
+				!(c1 = as_cstring(s1, &t1)) ) {
+				rc = -1;
+				break;
+			}
+			rc = AttrResolverAddCategory(self->resolver, i1, c1);
+			break;
+		case 1:	/* resolvechain: Category, Precedence */
+			if ( !PyArg_ParseTuple(row, "ii", &i1, &i2) ) {
+				rc = -1;
+				break;
+			}
+			rc = AttrResolverAddChain(self->resolver, i1, i2);
+			break;
+		case 2:	/* catindex: ID, Category, Name */
+			if ( !PyArg_ParseTuple(row, "iiO", &i1, &i2, &s1) ||
+				!(c1 = as_cstring(s1, &t1)) ) {
+				rc = -1;
+				break;
+			}
+			rc = AttrResolverAddCatindex(self->resolver, i1, i2, c1);
+			break;
+		case 3:	/* attributes: Attr, Value, Category, Catindex */
+			if ( !PyArg_ParseTuple(row, "OOii", &s1, &s2, &i1, &i2) ||
+				!(c1 = as_cstring(s1, &t1)) ) {
+				rc = -1;
+				break;
+			}
+			c2 = as_cstring(s2, &t2);
+			if ( !c2 && PyErr_Occurred() ) {
+				rc = -1;
+				break;
+			}
+			rc = AttrResolverAddAttr(self->resolver, c1, c2, i1, i2);
+			break;
+		}
+		if ( rc < 0 && !PyErr_Occurred() ) {
+			PyErr_NoMemory();
+		}
+		Py_XDECREF(t1);
+		Py_XDECREF(t2);
+		Py_DECREF(row);
+	}
+	Py_DECREF(it);
+
+	if ( rc < 0 || PyErr_Occurred() ) {
+		return -1;
+	}
+	return 0;
+}
+
+static int
+PyAttrResolver_init(PyAttrResolver *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "categories", "chains", "catindexes",
+				      "attributes", NULL };
+	PyObject	*tables[4];
+	int		i, n;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "OOOO", kwlist,
+		&tables[0], &tables[1], &tables[2], &tables[3]) ) {
+		return -1;
+	}
+
+	/* __init__ may be called again, drop what the last one loaded */
+	clear_strings(self);
+	AttrResolverDestroy(self->resolver);
+	self->resolver = AttrResolverCreate();
+	if ( !self->resolver ) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	for ( i = 0; i < 4; i++ ) {
+		if ( load_rows(self, tables[i], i) ) {
+			return -1;
+		}
+	}
+	if ( AttrResolverBuild(self->resolver) ) {
+		PyErr_NoMemory();
+		return -1;
+	}
+
+	n = AttrResolverStringCount(self->resolver);
+	self->strings = PyMem_Malloc((n + 1) * sizeof(PyObject *));
+	if ( !self->strings ) {
+		PyErr_NoMemory();
+		return -1;
+	}
+	memset(self->strings, 0, (n + 1) * sizeof(PyObject *));
+	self->nstrings = n;
+	return 0;
+}
+
+/*
+ * Python strings are created the first time a string id is returned and
+ * shared from then on, so equal values across hosts are one object.
+ */
+static PyObject *
+string_object(PyAttrResolver *self, int id)
+{
+	if ( id < 0 ) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	if ( !self->strings[id] ) {
+		self->strings[id] = PyString_FromString(
+			AttrResolverString(self->resolver, id));
+		if ( !self->strings[id] ) {
+			return NULL;
+		}
+	}
+	Py_INCREF(self->strings[id]);
+	return self->strings[id];
+}
+
+static PyObject *
+resolve_host(PyAttrResolver *self, PyObject *host, int showsource)
+{
+	PyObject		*name, *os, *appliance, *dict;
+	PyObject		*t1, *t2, *t3;
+	const char		*c1, *c2, *c3;
+	const AttrResolved	*res;
+	int			i, n;
+
+	if ( !PyArg_ParseTuple(host, "OOO", &name, &os, &appliance) ) {
+		return NULL;
+	}
+	c1 = as_cstring(name, &t1);
+	c2 = as_cstring(os, &t2);
+	c3 = as_cstring(appliance, &t3);
+	if ( PyErr_Occurred() ) {
+		n = -1;
+	}
+	else {
+		n = AttrResolverResolve(self->resolver, c1, c2, c3, &res);
+	}
+	Py_XDECREF(t1);
+	Py_XDECREF(t2);
+	Py_XDECREF(t3);
+	if ( n < 0 ) {
+		return NULL;
+	}
+
+	dict = PyDict_New();
+	if ( !dict ) {
+		return NULL;
+	}
+	for ( i = 0; i < n; i++ ) {
+		PyObject	*key, *value;
+		int		rc;
+
+		key   = string_object(self, res[i].attr);
+		value = string_object(self, res[i].value);
+		if ( value && showsource ) {
+			char	source[2] = { (char)res[i].source, '\0' };
+
+			value = Py_BuildValue("(Ns)", value, source);
+		}
+		if ( !key || !value ) {
+			Py_XDECREF(key);
+			Py_XDECREF(value);
+			Py_DECREF(dict);
+			return NULL;
+		}
+		rc = PyDict_SetItem(dict, key, value);
+		Py_DECREF(key);
+		Py_DECREF(value);
+		if ( rc ) {
+			Py_DECREF(dict);
+			return NULL;
+		}
+	}
+	return dict;
+}
+
+static PyObject *
+PyAttrResolver_resolve(PyAttrResolver *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "hosts", "showsource", NULL };
+	PyObject	*hosts, *it, *host, *list;
+	int		showsource = 0;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "O|i", kwlist,
+		&hosts, &showsource) ) {
+		return NULL;
+	}
+	if ( !self->resolver || !self->strings ) {
+		PyErr_SetString(PyExc_RuntimeError, "resolver not initialized");
+		return NULL;
+	}
+
+	it = PyObject_GetIter(hosts);
+	if ( !it ) {
+		return NULL;
+	}
+	list = PyList_New(0);
+	while ( list && (host = PyIter_Next(it)) ) {
+		PyObject	*dict = resolve_host(self, host, showsource);
+
+		Py_DECREF(host);
+		if ( !dict || PyList_Append(list, dict) ) {
+			Py_XDECREF(dict);
+			Py_CLEAR(list);
+			break;
+		}
+		Py_DECREF(dict);
+	}
+	Py_DECREF(it);
+
+	if ( list && PyErr_Occurred() ) {
+		Py_CLEAR(list);
+	}
+	return list;
+}
+
+static PyMethodDef PyAttrResolver_methods[] = {
+	{ "resolve", (PyCFunction)PyAttrResolver_resolve,
+	  METH_VARARGS | METH_KEYWORDS,
+	  "resolve(hosts, showsource=0) -> list of dicts\n\n"
+	  "Resolve the attributes of every (name, os, appliance) tuple in\n"
+	  "hosts.  With showsource the values are (value, source) tuples." },
+	{ NULL }
+};
+
+static PyTypeObject PyAttrResolverType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_librocks.AttrResolver",		/* tp_name */
+	sizeof(PyAttrResolver),			/* tp_basicsize */
+	0,					/* tp_itemsize */
+	(destructor)PyAttrResolver_dealloc,	/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	0,					/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	0,					/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"AttrResolver(categories, chains, catindexes, attributes)\n\n"
+	"In-memory attribute resolver loaded from rows of the categories\n"
+	"(ID, Name), resolvechain (Category, Precedence), catindex\n"
+	"(ID, Category, Name) and attributes (Attr, Value, Category,\n"
+	"Catindex) tables.",			/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	0,					/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	0,					/* tp_iter */
+	0,					/* tp_iternext */
+	PyAttrResolver_methods,			/* tp_methods */
+	0,					/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+	0,					/* tp_dictoffset */
+	(initproc)PyAttrResolver_init,		/* tp_init */
+	0,					/* tp_alloc */
+	PyType_GenericNew,			/* tp_new */
+};
+
+
+/* -------------------------------------------------------- scantree */
+
+static PyObject *
+bytes_to_str(const char *s, Py_ssize_t len)
+{
+#if PY_MAJOR_VERSION >= 3
+	return PyUnicode_DecodeFSDefaultAndSize(s, len);
+#else
+	return PyString_FromStringAndSize(s, len);
+#endif
+}
+
+static PyObject *
+number_from(const char *s, Py_ssize_t len, int aslong)
+{
+	char		buf[64];
+	PyObject	*str, *n;
+
+	if ( len < (Py_ssize_t)sizeof(buf) ) {
+		memcpy(buf, s, len);
+		buf[len] = '\0';
+#if PY_MAJOR_VERSION >= 3
+		(void)aslong;
+		return PyLong_FromString(buf, NULL, 10);
+#else
+		return aslong ? PyLong_FromString(buf, NULL, 10) :
+			PyInt_FromString(buf, NULL, 10);
+#endif
+	}
+
+	/* silly long version numbers */
+	str = PyBytes_FromStringAndSize(s, len);
+	if ( !str ) {
+		return NULL;
+	}
+	n = PyLong_FromString(PyBytes_AS_STRING(str), NULL, 10);
+	Py_DECREF(str);
+	return n;
+}
+
+/*
+ * One element of RPMBaseFile.versionList(), alternating strings and
+ * numbers.  Numbers followed by text are ints, a trailing one is a
+ * long (string.atoi vs string.atol).
+ */
+static PyObject *
+version_element(const char *s, Py_ssize_t len)
+{
+	PyObject	*l = PyList_New(0);
+	Py_ssize_t	i = 0;
+
+	while ( l && i < len ) {
+		Py_ssize_t	start = i;
+		int		digit = (s[i] >= '0' && s[i] <= '9');
+		PyObject	*o;
+
+		while ( i < len && (s[i] >= '0' && s[i] <= '9') == digit ) {
+			i++;
+		}
+		if ( digit ) {
+			o = number_from(s + start, i - start, i == len);
+		}
+		else {
+			o = bytes_to_str(s + start, i - start);
+		}
+		if ( !o || PyList_Append(l, o) ) {
+			Py_CLEAR(l);
+		}
+		Py_XDECREF(o);
+	}
+	return l;
+}
+
+/*
+ * RPMBaseFile.versionList(), s is split with re.split('\.+|_+', s).
+ */
+static PyObject *
+version_list(const char *s, Py_ssize_t len)
+{
+	PyObject	*list = PyList_New(0);
+	Py_ssize_t	i = 0, start = 0;
+
+	if ( !list ) {
+		return NULL;
+	}
+	for ( ;; ) {
+		PyObject	*e;
+		Py_ssize_t	end;
+
+		while ( i < len && s[i] != '.' && s[i] != '_' ) {
+			i++;
+		}
+		end = i;
+		if ( i < len ) {
+			char	c = s[i];
+
+			while ( i < len && s[i] == c ) {
+				i++;
+			}
+		}
+
+		e = version_element(s + start, end - start);
+		if ( !e || PyList_Append(list, e) ) {
+			Py_XDECREF(e);
+			Py_DECREF(list);
+			return NULL;
+		}
+		Py_DECREF(e);
+
+		if ( end == len ) {
+			break;
+		}
+		start = i;
+	}
+	return list;
+}
+
+/*
+ * (list, version, release) as RPMBaseFile would compute them.
+ */
+static PyObject *
+parse_package(const char *filename, int ext)
+{
+	RPMName		n;
+
+	RPMNameParse(filename, ext, &n);
+	return Py_BuildValue("([NNNN]NN)",
+		bytes_to_str(filename + n.name, n.name_len),
+		version_list(filename + n.version, n.version_len),
+		version_list(filename + n.release, n.release_len),
+		bytes_to_str(filename + n.arch, n.arch_len),
+		bytes_to_str(filename + n.version, n.version_len),
+		bytes_to_str(filename + n.release, n.release_len));
+}
+
+static PyObject *
+scan_entry_tuple(const DirScanEntry *e)
+{
+	PyObject	*parsed;
+
+	switch ( e->kind ) {
+	case DIRSCAN_RPM:
+		parsed = parse_package(e->name, 1);
+		break;
+	case DIRSCAN_ROLL:
+		parsed = parse_package(e->name, 2);
+		break;
+	default:
+		Py_INCREF(Py_None);
+		parsed = Py_None;
+		break;
+	}
+	if ( !parsed ) {
+		return NULL;
+	}
+	return Py_BuildValue("(NidnN)",
+		bytes_to_str(e->name, strlen(e->name)),
+		e->kind, e->mtime, (Py_ssize_t)e->size, parsed);
+}
+
+static PyObject *
+scantree(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "root", "threads", NULL };
+	const char	*root;
+	int		threads = 0;
+	DirScan		*scan;
+	PyObject	*result;
+	int		i, j;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "s|i:scantree", kwlist,
+		&root, &threads) ) {
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	scan = DirScanRun(root, threads);
+	Py_END_ALLOW_THREADS
+
+	if ( !scan ) {
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError,
+			(char *)root);
+	}
+
+	result = PyList_New(DirScanCount(scan));
+	for ( i = 0; result && i < DirScanCount(scan); i++ ) {
+		const DirScanDir	*d = DirScanGet(scan, i);
+		PyObject		*files = PyList_New(d->nentries);
+
+		for ( j = 0; files && j < d->nentries; j++ ) {
+			PyObject	*e = scan_entry_tuple(&d->entries[j]);
+
+			if ( !e ) {
+				Py_CLEAR(files);
+				break;
+			}
+			PyList_SET_ITEM(files, j, e);
+		}
+		if ( !files ) {
+			Py_CLEAR(result);
+			break;
+		}
+		PyList_SET_ITEM(result, i, Py_BuildValue("(NN)",
+			bytes_to_str(d->path, strlen(d->path)), files));
+		if ( !PyList_GET_ITEM(result, i) ) {
+			Py_CLEAR(result);
+		}
+	}
+
+	DirScanFree(scan);
+	return result;
+}
+
+static const char scantree_doc[] =
+"scantree(root, threads=0) -> [(dir, [(name, kind, mtime, size, parsed)])]\n"
+"\n"
+"Scans the tree under root in parallel the way rocks.file.Tree does.\n"
+"dir is relative to root ('' for root itself), kind is 0 for files,\n"
+"1 for RPMs and 2 for roll ISOs, and parsed is None or the\n"
+"(list, version, release) of an RPM or roll.";
+
+
+/* ------------------------------------------------------- rpmheader */
+
+static int
+set_item(PyObject *d, const char *key, PyObject *value)
+{
+	int	rc;
+
+	if ( !value ) {
+		return -1;
+	}
+	rc = PyDict_SetItemString(d, key, value);
+	Py_DECREF(value);
+	return rc;
+}
+
+static PyObject *
+string_or_none(const char *s)
+{
+	if ( !s ) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return bytes_to_str(s, strlen(s));
+}
+
+static PyObject *
+int_or_none(long long v)
+{
+	if ( v < 0 ) {
+		Py_INCREF(Py_None);
+		return Py_None;
+	}
+	return PyLong_FromLongLong(v);
+}
+
+static const struct {
+	const char	*key;
+	int		tag;
+} header_strings[] = {
+	{ "name",		RPMTAG_NAME },
+	{ "version",		RPMTAG_VERSION },
+	{ "release",		RPMTAG_RELEASE },
+	{ "summary",		RPMTAG_SUMMARY },
+	{ "buildhost",		RPMTAG_BUILDHOST },
+	{ "os",			RPMTAG_OS },
+	{ "arch",		RPMTAG_ARCH },
+	{ "sourcerpm",		RPMTAG_SOURCERPM },
+	{ "payloadformat",	RPMTAG_PAYLOADFORMAT },
+	{ "payloadcompressor",	RPMTAG_PAYLOADCOMPRESSOR },
+	{ NULL }
+}, header_ints[] = {
+	{ "epoch",		RPMTAG_EPOCH },
+	{ "buildtime",		RPMTAG_BUILDTIME },
+	{ "size",		RPMTAG_SIZE },
+	{ NULL }
+};
+
+/*
+ * The tags of one package as a dictionary, missing tags are None
+ * (prefixes is an empty list).
+ */
+static PyObject *
+header_dict(RPMHeader *h)
+{
+	PyObject	*d = PyDict_New();
+	PyObject	*prefixes;
+	const char	*strs[64];
+	char		md5[33];
+	int		i, n;
+
+	if ( !d ) {
+		return NULL;
+	}
+	for ( i = 0; header_strings[i].key; i++ ) {
+		if ( set_item(d, header_strings[i].key, string_or_none(
+			RPMHeaderString(h, header_strings[i].tag))) ) {
+			goto fail;
+		}
+	}
+	for ( i = 0; header_ints[i].key; i++ ) {
+		if ( set_item(d, header_ints[i].key, int_or_none(
+			RPMHeaderInt(h, header_ints[i].tag, -1))) ) {
+			goto fail;
+		}
+	}
+
+	n = RPMHeaderStrings(h, RPMTAG_PREFIXES, strs, 64);
+	if ( n > 64 ) {
+		n = 64;
+	}
+	prefixes = PyList_New(n);
+	for ( i = 0; prefixes && i < n; i++ ) {
+		PyList_SET_ITEM(prefixes, i, bytes_to_str(strs[i],
+			strlen(strs[i])));
+	}
+	if ( set_item(d, "prefixes", prefixes) ) {
+		goto fail;
+	}
+
+	if ( set_item(d, "sigmd5", string_or_none(
+		RPMHeaderSigMD5(h, md5) ? NULL : md5)) ||
+		set_item(d, "payloadoffset",
+		PyLong_FromLongLong(RPMHeaderPayloadOffset(h))) ) {
+		goto fail;
+	}
+	return d;
+
+fail:
+	Py_DECREF(d);
+	return NULL;
+}
+
+static PyObject *
+rpmheader(PyObject *self, PyObject *args)
+{
+	const char	*path;
+	RPMHeader	*h;
+	PyObject	*d;
+
+	if ( !PyArg_ParseTuple(args, "s:rpmheader", &path) ) {
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	h = RPMHeaderRead(path);
+	Py_END_ALLOW_THREADS
+
+	if ( !h ) {
+		return PyErr_SetFromErrnoWithFilename(PyExc_OSError,
+			(char *)path);
+	}
+	d = header_dict(h);
+	RPMHeaderFree(h);
+	return d;
+}
+
+static PyObject *
+rpmheaders(PyObject *self, PyObject *args)
+{
+	PyObject	*paths, *it, *o, *result;
+
+	if ( !PyArg_ParseTuple(args, "O:rpmheaders", &paths) ) {
+		return NULL;
+	}
+	it = PyObject_GetIter(paths);
+	if ( !it ) {
+		return NULL;
+	}
+	result = PyList_New(0);
+
+	while ( result && (o = PyIter_Next(it)) ) {
+		PyObject	*tmp, *d = NULL;
+		const char	*path = as_cstring(o, &tmp);
+		RPMHeader	*h = NULL;
+
+		if ( path ) {
+			Py_BEGIN_ALLOW_THREADS
+			h = RPMHeaderRead(path);
+			Py_END_ALLOW_THREADS
+			if ( h ) {
+				d = header_dict(h);
+				RPMHeaderFree(h);
+			}
+			else {
+				Py_INCREF(Py_None);
+				d = Py_None;
+			}
+		}
+		else if ( !PyErr_Occurred() ) {
+			PyErr_SetString(PyExc_TypeError, "paths must be strings");
+		}
+		if ( !d || PyList_Append(result, d) ) {
+			Py_CLEAR(result);
+		}
+		Py_XDECREF(d);
+		Py_XDECREF(tmp);
+		Py_DECREF(o);
+	}
+	Py_DECREF(it);
+	if ( PyErr_Occurred() ) {
+		Py_CLEAR(result);
+	}
+	return result;
+}
+
+static PyObject *
+rpmextract(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "paths", "root", "threads", NULL };
+	PyObject	*paths, *seq, *result = NULL;
+	PyObject	**tmps;
+	RPMExtractJob	*jobs;
+	const char	*root;
+	Py_ssize_t	i, n;
+	int		threads = 0;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "Os|i:rpmextract",
+		kwlist, &paths, &root, &threads) ) {
+		return NULL;
+	}
+	seq = PySequence_Fast(paths, "paths must be a sequence");
+	if ( !seq ) {
+		return NULL;
+	}
+	n    = PySequence_Fast_GET_SIZE(seq);
+	jobs = PyMem_Malloc((n ? n : 1) * sizeof(RPMExtractJob));
+	tmps = PyMem_Malloc((n ? n : 1) * sizeof(PyObject *));
+	if ( !jobs || !tmps ) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	for ( i = 0; i < n; i++ ) {
+		tmps[i] = NULL;
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		jobs[i].path = as_cstring(PySequence_Fast_GET_ITEM(seq, i),
+			&tmps[i]);
+		if ( !jobs[i].path ) {
+			if ( !PyErr_Occurred() ) {
+				PyErr_SetString(PyExc_TypeError,
+					"paths must be strings");
+			}
+			goto done;
+		}
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	RPMExtractMany(jobs, n, root, threads);
+	Py_END_ALLOW_THREADS
+
+	result = PyList_New(n);
+	for ( i = 0; result && i < n; i++ ) {
+		PyObject	*o;
+
+		if ( jobs[i].status ) {
+			o = bytes_to_str(jobs[i].error, strlen(jobs[i].error));
+		}
+		else {
+			Py_INCREF(Py_None);
+			o = Py_None;
+		}
+		if ( !o ) {
+			Py_CLEAR(result);
+			break;
+		}
+		PyList_SET_ITEM(result, i, o);
+	}
+
+done:
+	if ( tmps ) {
+		for ( i = 0; i < n; i++ ) {
+			Py_XDECREF(tmps[i]);
+		}
+	}
+	PyMem_Free(tmps);
+	PyMem_Free(jobs);
+	Py_DECREF(seq);
+	return result;
+}
+
+static const char rpmheader_doc[] =
+"rpmheader(path) -> dict\n"
+"\n"
+"Reads the header of an RPM package.  The keys are name, version,\n"
+"release, epoch, summary, buildtime, buildhost, size, os, arch,\n"
+"sourcerpm, prefixes, payloadformat, payloadcompressor, sigmd5 and\n"
+"payloadoffset.  Missing tags are None, prefixes is a list.  Raises\n"
+"OSError if the file cannot be read or is not a package.";
+
+static const char rpmheaders_doc[] =
+"rpmheaders(paths) -> [dict or None]\n"
+"\n"
+"rpmheader() for a list of packages, None for the ones that cannot\n"
+"be read.";
+
+static const char rpmextract_doc[] =
+"rpmextract(paths, root, threads=0) -> [None or error]\n"
+"\n"
+"Unpacks the payloads of the packages under root, relocated the way\n"
+"applyRPM installs them, with threads workers (0 means one per CPU).\n"
+"Returns None for every package that was unpacked and a message for\n"
+"the ones that were not (install scripts, unsupported compression,\n"
+"I/O errors).";
+
+
+/* ---------------------------------------------------------- ISOImage */
+
+typedef struct {
+	PyObject_HEAD
+	ISOImage	*iso;
+} PyISOImage;
+
+static void
+PyISOImage_dealloc(PyISOImage *self)
+{
+	ISOClose(self->iso);
+	Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static int
+PyISOImage_init(PyISOImage *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "path", NULL };
+	const char	*path;
+	ISOImage	*iso;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "s:ISOImage", kwlist,
+		&path) ) {
+		return -1;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	iso = ISOOpen(path);
+	Py_END_ALLOW_THREADS
+
+	if ( !iso ) {
+		PyErr_SetFromErrnoWithFilename(PyExc_OSError, (char *)path);
+		return -1;
+	}
+	ISOClose(self->iso);
+	self->iso = iso;
+	return 0;
+}
+
+static int
+check_image(PyISOImage *self)
+{
+	if ( !self->iso ) {
+		PyErr_SetString(PyExc_RuntimeError, "image not opened");
+		return -1;
+	}
+	return 0;
+}
+
+static PyObject *
+PyISOImage_entries(PyISOImage *self)
+{
+	PyObject	*list;
+	int		i, n;
+
+	if ( check_image(self) ) {
+		return NULL;
+	}
+	n    = ISOEntryCount(self->iso);
+	list = PyList_New(n);
+	for ( i = 0; list && i < n; i++ ) {
+		const ISOEntry	*e = ISOEntryGet(self->iso, i);
+		PyObject	*path, *target, *o;
+
+		path = bytes_to_str(e->path, strlen(e->path));
+		if ( e->target ) {
+			target = bytes_to_str(e->target, strlen(e->target));
+		}
+		else {
+			Py_INCREF(Py_None);
+			target = Py_None;
+		}
+		o = (path && target) ? Py_BuildValue("(NinlN)", path, e->mode,
+			(Py_ssize_t)e->size, e->mtime, target) : NULL;
+		if ( !o ) {
+			if ( !path || !target ) {
+				Py_XDECREF(path);
+				Py_XDECREF(target);
+			}
+			Py_CLEAR(list);
+			break;
+		}
+		PyList_SET_ITEM(list, i, o);
+	}
+	return list;
+}
+
+static PyObject *
+PyISOImage_read(PyISOImage *self, PyObject *args)
+{
+	const ISOEntry	*e;
+	const char	*path;
+	PyObject	*data;
+	long long	n;
+
+	if ( !PyArg_ParseTuple(args, "s:read", &path) || check_image(self) ) {
+		return NULL;
+	}
+	e = ISOLookup(self->iso, path);
+	if ( !e || !S_ISREG(e->mode) ) {
+		errno = e ? EISDIR : ENOENT;
+		return PyErr_SetFromErrnoWithFilename(PyExc_IOError,
+			(char *)path);
+	}
+	data = PyBytes_FromStringAndSize(NULL, e->size);
+	if ( !data ) {
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	n = ISORead(self->iso, e, PyBytes_AS_STRING(data), e->size, 0);
+	Py_END_ALLOW_THREADS
+
+	if ( n != e->size ) {
+		Py_DECREF(data);
+		if ( n >= 0 ) {
+			errno = EIO;
+		}
+		return PyErr_SetFromErrnoWithFilename(PyExc_IOError,
+			(char *)path);
+	}
+	return data;
+}
+
+static PyObject *
+PyISOImage_flags(PyISOImage *self)
+{
+	if ( check_image(self) ) {
+		return NULL;
+	}
+	return Py_BuildValue("i", ISOFlags(self->iso));
+}
+
+static PyMethodDef PyISOImage_methods[] = {
+	{ "entries", (PyCFunction)PyISOImage_entries, METH_NOARGS,
+	  "entries() -> [(path, mode, size, mtime, target)]\n\n"
+	  "Everything in the image, directories before their contents.\n"
+	  "Paths have no leading /, target is None unless the entry is a\n"
+	  "symbolic link." },
+	{ "read", (PyCFunction)PyISOImage_read, METH_VARARGS,
+	  "read(path) -> bytes\n\n"
+	  "The contents of a file in the image." },
+	{ "flags", (PyCFunction)PyISOImage_flags, METH_NOARGS,
+	  "flags() -> int\n\n"
+	  "ISO_ROCKRIDGE and ISO_JOLIET bits for the extensions found." },
+	{ NULL }
+};
+
+static PyTypeObject PyISOImageType = {
+	PyVarObject_HEAD_INIT(NULL, 0)
+	"_librocks.ISOImage",			/* tp_name */
+	sizeof(PyISOImage),			/* tp_basicsize */
+	0,					/* tp_itemsize */
+	(destructor)PyISOImage_dealloc,		/* tp_dealloc */
+	0,					/* tp_print */
+	0,					/* tp_getattr */
+	0,					/* tp_setattr */
+	0,					/* tp_compare */
+	0,					/* tp_repr */
+	0,					/* tp_as_number */
+	0,					/* tp_as_sequence */
+	0,					/* tp_as_mapping */
+	0,					/* tp_hash */
+	0,					/* tp_call */
+	0,					/* tp_str */
+	0,					/* tp_getattro */
+	0,					/* tp_setattro */
+	0,					/* tp_as_buffer */
+	Py_TPFLAGS_DEFAULT,			/* tp_flags */
+	"ISOImage(path)\n\n"
+	"An ISO9660 image read without mounting it, with the names and\n"
+	"modes a Linux mount would show.  Raises OSError if the file is\n"
+	"not an image.",			/* tp_doc */
+	0,					/* tp_traverse */
+	0,					/* tp_clear */
+	0,					/* tp_richcompare */
+	0,					/* tp_weaklistoffset */
+	0,					/* tp_iter */
+	0,					/* tp_iternext */
+	PyISOImage_methods,			/* tp_methods */
+	0,					/* tp_members */
+	0,					/* tp_getset */
+	0,					/* tp_base */
+	0,					/* tp_dict */
+	0,					/* tp_descr_get */
+	0,					/* tp_descr_set */
+	0,					/* tp_dictoffset */
+	(initproc)PyISOImage_init,		/* tp_init */
+	0,					/* tp_alloc */
+	PyType_GenericNew,			/* tp_new */
+};
+
+static PyObject *
+isoextract(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "jobs", "threads", NULL };
+	PyObject	*list, *seq, *result = NULL;
+	PyObject	**tmps;
+	ISOExtractJob	*jobs;
+	Py_ssize_t	i, n;
+	int		threads = 0;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "O|i:isoextract",
+		kwlist, &list, &threads) ) {
+		return NULL;
+	}
+	seq = PySequence_Fast(list, "jobs must be a sequence");
+	if ( !seq ) {
+		return NULL;
+	}
+	n    = PySequence_Fast_GET_SIZE(seq);
+	jobs = PyMem_Malloc((n ? n : 1) * sizeof(ISOExtractJob));
+	tmps = PyMem_Malloc((n ? n : 1) * 2 * sizeof(PyObject *));
+	if ( !jobs || !tmps ) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	for ( i = 0; i < n * 2; i++ ) {
+		tmps[i] = NULL;
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		PyObject	*job = PySequence_Fast_GET_ITEM(seq, i);
+		PyObject	*image, *subdir, *dest;
+
+		if ( !PyArg_ParseTuple(job, "O!OO:isoextract", &PyISOImageType,
+			&image, &subdir, &dest) || check_image((PyISOImage *)image) ) {
+			goto done;
+		}
+		jobs[i].image  = ((PyISOImage *)image)->iso;
+		jobs[i].subdir = as_cstring(subdir, &tmps[i * 2]);
+		jobs[i].dest   = as_cstring(dest, &tmps[i * 2 + 1]);
+		if ( !jobs[i].subdir || !jobs[i].dest ) {
+			if ( !PyErr_Occurred() ) {
+				PyErr_SetString(PyExc_TypeError,
+					"subdir and dest must be strings");
+			}
+			goto done;
+		}
+	}
+
+	/* seq holds the images until we are done */
+	Py_BEGIN_ALLOW_THREADS
+	ISOExtractMany(jobs, n, threads);
+	Py_END_ALLOW_THREADS
+
+	result = PyList_New(n);
+	for ( i = 0; result && i < n; i++ ) {
+		PyObject	*o;
+
+		if ( jobs[i].status ) {
+			o = bytes_to_str(jobs[i].error, strlen(jobs[i].error));
+		}
+		else {
+			Py_INCREF(Py_None);
+			o = Py_None;
+		}
+		if ( !o ) {
+			Py_CLEAR(result);
+			break;
+		}
+		PyList_SET_ITEM(result, i, o);
+	}
+
+done:
+	if ( tmps ) {
+		for ( i = 0; i < n * 2; i++ ) {
+			Py_XDECREF(tmps[i]);
+		}
+	}
+	PyMem_Free(tmps);
+	PyMem_Free(jobs);
+	Py_DECREF(seq);
+	return result;
+}
+
+static const char isoextract_doc[] =
+"isoextract(jobs, threads=0) -> [None or error]\n"
+"\n"
+"Copies the subdir of an image to dest for every (image, subdir,\n"
+"dest) tuple in jobs, all of them at once with threads workers (0\n"
+"means one per CPU).  Like \"find . | cpio -mpud dest\" but without a\n"
+"mount: modification times are kept, TRANS.TBL files are skipped\n"
+"and directories are made a+rx.  Returns None for every job that\n"
+"was copied and a message for the ones that were not.";
+
+
+
+/* --------------------------------------------------------- isowrite */
+
+#define ISOWRITE_STRINGS	7
+
+/*
+ * An optional string from a job dictionary, NULL if it is missing or
+ * None, NULL with an exception if it is not a string.
+ */
+static const char *
+job_string(PyObject *job, const char *key, PyObject **tmp)
+{
+	PyObject	*o = PyDict_GetItemString(job, key);
+	const char	*s;
+
+	*tmp = NULL;
+	if ( !o || o == Py_None ) {
+		return NULL;
+	}
+	s = as_cstring(o, tmp);
+	if ( !s && !PyErr_Occurred() ) {
+		PyErr_Format(PyExc_TypeError, "%s must be a string", key);
+	}
+	return s;
+}
+
+static int
+job_int(PyObject *job, const char *key, int *value)
+{
+	PyObject	*o = PyDict_GetItemString(job, key);
+
+	if ( !o || o == Py_None ) {
+		return 0;
+	}
+	*value = PyLong_AsLong(o);
+	return (*value == -1 && PyErr_Occurred()) ? -1 : 0;
+}
+
+static PyObject *
+isowrite(PyObject *self, PyObject *args, PyObject *kwds)
+{
+	static char	*kwlist[] = { "jobs", "threads", NULL };
+	static const char	*keys[ISOWRITE_STRINGS] = { "root", "output",
+				"volume", "boot", "catalog", "efi", "mbr" };
+	PyObject	*list, *seq, *result = NULL;
+	PyObject	**tmps;
+	ISOWriteJob	*jobs;
+	Py_ssize_t	i, n;
+	int		threads = 0, k;
+
+	if ( !PyArg_ParseTupleAndKeywords(args, kwds, "O|i:isowrite",
+		kwlist, &list, &threads) ) {
+		return NULL;
+	}
+	seq = PySequence_Fast(list, "jobs must be a sequence");
+	if ( !seq ) {
+		return NULL;
+	}
+	n    = PySequence_Fast_GET_SIZE(seq);
+	jobs = PyMem_Malloc((n ? n : 1) * sizeof(ISOWriteJob));
+	tmps = PyMem_Malloc((n ? n : 1) * ISOWRITE_STRINGS * sizeof(PyObject *));
+	if ( !jobs || !tmps ) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	memset(jobs, 0, (n ? n : 1) * sizeof(ISOWriteJob));
+	for ( i = 0; i < n * ISOWRITE_STRINGS; i++ ) {
+		tmps[i] = NULL;
+	}
+
+	for ( i = 0; i < n; i++ ) {
+		PyObject	*job = PySequence_Fast_GET_ITEM(seq, i);
+		PyObject	**tmp = tmps + i * ISOWRITE_STRINGS;
+		const char	*v[ISOWRITE_STRINGS];
+
+		if ( !PyDict_Check(job) ) {
+			PyErr_SetString(PyExc_TypeError,
+				"isowrite jobs must be dictionaries");
+			goto done;
+		}
+		for ( k = 0; k < ISOWRITE_STRINGS; k++ ) {
+			v[k] = job_string(job, keys[k], &tmp[k]);
+			if ( PyErr_Occurred() ) {
+				goto done;
+			}
+		}
+		if ( !v[0] || !v[1] ) {
+			PyErr_SetString(PyExc_ValueError,
+				"isowrite jobs need a root and an output");
+			goto done;
+		}
+		jobs[i].root	= v[0];
+		jobs[i].output	= v[1];
+		jobs[i].volume	= v[2];
+		jobs[i].boot	= v[3];
+		jobs[i].catalog	= v[4];
+		jobs[i].efi	= v[5];
+		jobs[i].mbr	= v[6];
+		if ( job_int(job, "flags", &jobs[i].flags) ||
+			job_int(job, "loadsize", &jobs[i].load_size) ||
+			job_int(job, "infotable", &jobs[i].info_table) ) {
+			goto done;
+		}
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	ISOWriteMany(jobs, n, threads);
+	Py_END_ALLOW_THREADS
+
+	result = PyList_New(n);
+	for ( i = 0; result && i < n; i++ ) {
+		PyObject	*o;
+
+		if ( jobs[i].status ) {
+			o = bytes_to_str(jobs[i].error, strlen(jobs[i].error));
+		}
+		else {
+			Py_INCREF(Py_None);
+			o = Py_None;
+		}
+		if ( !o ) {
+			Py_CLEAR(result);
+			break;
+		}
+		PyList_SET_ITEM(result, i, o);
+	}
+
+done:
+	if ( tmps ) {
+		for ( i = 0; i < n * ISOWRITE_STRINGS; i++ ) {
+			Py_XDECREF(tmps[i]);
+		}
+	}
+	PyMem_Free(tmps);
+	PyMem_Free(jobs);
+	Py_DECREF(seq);
+	return result;
+}
+
+static const char isowrite_doc[] =
+"isowrite(jobs, threads=0) -> [None or error]\n"
+"\n"
+"Writes an ISO image for every job, all of them at once with threads\n"
+"workers (0 means one per CPU).  A job is a dictionary with the root\n"
+"directory and output file, and optionally the volume id, flags (the\n"
+"ISOWRITE_ constants), and for a bootable image the boot image,\n"
+"catalog, loadsize, infotable and efi image (relative to root, as for\n"
+"mkisofs) and the isohybrid mbr template.  Returns None for every\n"
+"image that was written and a message for the ones that were not.";
+
+
+
+/* ----------------------------------------------------------- rocksd */
+
+extern char	**environ;
+
+static PyObject *
+rocksdcall(PyObject *self, PyObject *args)
+{
+	PyObject	*list, *seq, *result = NULL;
+	PyObject	**tmps;
+	const char	*path;
+	char		**argv;
+	Py_ssize_t	i, n;
+	int		rc = ROCKSD_FALLBACK, status = 0;
+
+	if ( !PyArg_ParseTuple(args, "sO:rocksdcall", &path, &list) ) {
+		return NULL;
+	}
+	seq = PySequence_Fast(list, "argv must be a sequence");
+	if ( !seq ) {
+		return NULL;
+	}
+	n    = PySequence_Fast_GET_SIZE(seq);
+	argv = PyMem_Malloc((n + 1) * sizeof(char *));
+	tmps = PyMem_Malloc((n + 1) * sizeof(PyObject *));
+	if ( !argv || !tmps ) {
+		PyErr_NoMemory();
+		goto done;
+	}
+	for ( i = 0; i < n; i++ ) {
+		tmps[i] = NULL;
+	}
+	for ( i = 0; i < n; i++ ) {
+		argv[i] = (char *)as_cstring(PySequence_Fast_GET_ITEM(seq, i),
+			&tmps[i]);
+		if ( !argv[i] ) {
+			if ( !PyErr_Occurred() ) {
+				PyErr_SetString(PyExc_TypeError,
+					"argv must be strings");
+			}
+			goto done;
+		}
+	}
+	argv[n] = NULL;
+
+	Py_BEGIN_ALLOW_THREADS
+	rc = RocksdCall(path, n, argv, environ, &status);
+	Py_END_ALLOW_THREADS
+
+	if ( rc == ROCKSD_LOST ) {
+		PyErr_SetString(PyExc_IOError,
+			"lost the connection to rocksd");
+	}
+	else if ( rc == ROCKSD_FALLBACK ) {
+		Py_INCREF(Py_None);
+		result = Py_None;
+	}
+	else {
+		result = PyLong_FromLong(status);
+	}
+
+done:
+	if ( tmps ) {
+		for ( i = 0; i < n; i++ ) {
+			Py_XDECREF(tmps[i]);
+		}
+	}
+	PyMem_Free(tmps);
+	PyMem_Free(argv);
+	Py_DECREF(seq);
+	return result;
+}
+
+static const char rocksdcall_doc[] =
+"rocksdcall(path, argv) -> status or None\n"
+"\n"
+"Runs the rocks command argv (without the \"rocks\") in the rocksd\n"
+"listening at path, with our stdin, stdout, stderr, directory, umask\n"
+"and environment.  Returns the exit status of the command, or None if\n"
+"it did not run and the caller has to run it itself.  Raises IOError\n"
+"if the daemon went away while the command was running.";
+
+static PyObject *
+sendfds(PyObject *self, PyObject *args)
+{
+	PyObject	*list, *seq;
+	Py_buffer	data;
+	Py_ssize_t	i, n;
+	int		sock, fds[3], rc;
+
+	if ( !PyArg_ParseTuple(args, "is*O:sendfds", &sock, &data, &list) ) {
+		return NULL;
+	}
+	seq = PySequence_Fast(list, "fds must be a sequence");
+	if ( !seq ) {
+		PyBuffer_Release(&data);
+		return NULL;
+	}
+	n = PySequence_Fast_GET_SIZE(seq);
+	if ( n > 3 || !data.len ) {
+		Py_DECREF(seq);
+		PyBuffer_Release(&data);
+		PyErr_SetString(PyExc_ValueError,
+			"sendfds sends some data and at most 3 fds");
+		return NULL;
+	}
+	for ( i = 0; i < n; i++ ) {
+		fds[i] = PyLong_AsLong(PySequence_Fast_GET_ITEM(seq, i));
+	}
+	Py_DECREF(seq);
+	if ( PyErr_Occurred() ) {
+		PyBuffer_Release(&data);
+		return NULL;
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	rc = RocksdSendFds(sock, data.buf, data.len, fds, n);
+	Py_END_ALLOW_THREADS
+	PyBuffer_Release(&data);
+
+	if ( rc ) {
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	Py_RETURN_NONE;
+}
+
+static const char sendfds_doc[] =
+"sendfds(sock, data, fds)\n"
+"\n"
+"Sends data on the unix socket sock with the (at most 3) file\n"
+"descriptors fds attached.";
+
+static PyObject *
+recvfds(PyObject *self, PyObject *args)
+{
+	PyObject	*data, *fds;
+	char		*buf;
+	ssize_t		n;
+	int		sock, size, got[3], nfds, i;
+
+	if ( !PyArg_ParseTuple(args, "ii:recvfds", &sock, &size) ) {
+		return NULL;
+	}
+	if ( size <= 0 ) {
+		PyErr_SetString(PyExc_ValueError, "recvfds size must be > 0");
+		return NULL;
+	}
+	buf = PyMem_Malloc(size);
+	if ( !buf ) {
+		return PyErr_NoMemory();
+	}
+
+	Py_BEGIN_ALLOW_THREADS
+	n = RocksdRecvFds(sock, buf, size, got, 3, &nfds);
+	Py_END_ALLOW_THREADS
+
+	if ( n < 0 ) {
+		PyMem_Free(buf);
+		return PyErr_SetFromErrno(PyExc_OSError);
+	}
+	data = PyBytes_FromStringAndSize(buf, n);
+	PyMem_Free(buf);
+	fds = PyList_New(nfds);
+	for ( i = 0; fds && i < nfds; i++ ) {
+		PyList_SET_ITEM(fds, i, PyLong_FromLong(got[i]));
+	}
+	if ( !data || !fds ) {
+		for ( i = 0; i < nfds; i++ ) {
+			close(got[i]);
+		}
+		Py_XDECREF(data);
+		Py_XDECREF(fds);
+		return NULL;
+	}
+	return Py_BuildValue("(NN)", data, fds);
+}
+
+static const char recvfds_doc[] =
+"recvfds(sock, size) -> (data, fds)\n"
+"\n"
+"Reads up to size bytes from the unix socket sock, and the (at most\n"
+"3) file descriptors that came with them.  The descriptors are\n"
+"close-on-exec and belong to the caller.  data is empty at end of\n"
+"file.";
+
+/* ------------------------------------------------------------ module */
+
+static PyMethodDef module_methods[] = {
+	{ "scantree", (PyCFunction)scantree, METH_VARARGS | METH_KEYWORDS,
+	  scantree_doc },
+	{ "rpmheader", rpmheader, METH_VARARGS, rpmheader_doc },
+	{ "rpmheaders", rpmheaders, METH_VARARGS, rpmheaders_doc },
+	{ "rpmextract", (PyCFunction)rpmextract, METH_VARARGS | METH_KEYWORDS,
+	  rpmextract_doc },
+	{ "isoextract", (PyCFunction)isoextract, METH_VARARGS | METH_KEYWORDS,
+	  isoextract_doc },
+	{ "isowrite", (PyCFunction)isowrite, METH_VARARGS | METH_KEYWORDS,
+	  isowrite_doc },
+	{ "rocksdcall", rocksdcall, METH_VARARGS, rocksdcall_doc },
+	{ "sendfds", sendfds, METH_VARARGS, sendfds_doc },
+	{ "recvfds", recvfds, METH_VARARGS, recvfds_doc },
+	{ NULL }
+};
+
+static const char module_doc[] = "Native helpers for the rocks python library.";
+
+static int
+add_types(PyObject *m)
+{
+	if ( PyType_Ready(&PyAttrResolverType) < 0 ||
+		PyType_Ready(&PyISOImageType) < 0 ) {
+		return -1;
+	}
+	Py_INCREF(&PyAttrResolverType);
+	Py_INCREF(&PyISOImageType);
+	if ( PyModule_AddObject(m, "AttrResolver",
+		(PyObject *)&PyAttrResolverType) ||
+		PyModule_AddObject(m, "ISOImage", (PyObject *)&PyISOImageType) ) {
+		return -1;
+	}
+	return PyModule_AddIntConstant(m, "ISO_ROCKRIDGE", ISO_ROCKRIDGE) ||
+		PyModule_AddIntConstant(m, "ISO_JOLIET", ISO_JOLIET) ||
+		PyModule_AddIntConstant(m, "ISOWRITE_ROCKRIDGE",
+			ISOWRITE_ROCKRIDGE) ||
+		PyModule_AddIntConstant(m, "ISOWRITE_RATIONALIZE",
+			ISOWRITE_RATIONALIZE) ||
+		PyModule_AddIntConstant(m, "ISOWRITE_JOLIET", ISOWRITE_JOLIET) ||
+		PyModule_AddIntConstant(m, "ISOWRITE_TRANSTBL",
+			ISOWRITE_TRANSTBL) ||
+		PyModule_AddIntConstant(m, "ISOWRITE_MD5", ISOWRITE_MD5) ||
+		PyModule_AddIntConstant(m, "ISOWRITE_HYBRID", ISOWRITE_HYBRID) ||
+		PyModule_AddStringConstant(m, "ROCKSD_SOCKET", ROCKSD_SOCKET);
+}
+
+#if PY_MAJOR_VERSION >= 3
+
+static struct PyModuleDef moduledef = {
+	PyModuleDef_HEAD_INIT, "_librocks", module_doc, -1, module_methods
+};
+
+PyMODINIT_FUNC
+PyInit__librocks(void)
+{
+	PyObject	*m = PyModule_Create(&moduledef);
+
+	if ( m && add_types(m) ) {
+		Py_CLEAR(m);
+	}
+	return m;
+}
+
+#else
+
+PyMODINIT_FUNC
+init_librocks(void)
+{
+	PyObject	*m = Py_InitModule3("_librocks", module_methods, module_doc);
+
+	if ( m ) {
+		add_types(m);
+	}
+}
+
+#endif
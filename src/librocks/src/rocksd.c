@@ -0,0 +1,376 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <limits.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include "../include/rocksd.h"
+
+#define MAX_FDS		8
+
+static volatile sig_atomic_t	call_fd = -1;
+static const int		forwarded[] = { SIGINT, SIGQUIT, SIGTERM, SIGHUP };
+#define NFORWARDED		(int)(sizeof(forwarded) / sizeof(forwarded[0]))
+
+struct buffer {
+	char	*data;
+	size_t	len;
+	size_t	cap;
+};
+
+static int
+buffer_add(struct buffer *b, const char *s)
+{
+	size_t	n = strlen(s) + 1;
+
+	if ( b->len + n > b->cap ) {
+		size_t	cap = (b->len + n) * 2 + 4096;
+		char	*p = realloc(b->data, cap);
+
+		if ( !p ) {
+			return -1;
+		}
+		b->data = p;
+		b->cap	= cap;
+	}
+	memcpy(b->data + b->len, s, n);
+	b->len += n;
+	return 0;
+}
+
+static void
+le32_put(unsigned char *p, unsigned int v)
+{
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static int
+write_all(int fd, const void *buf, size_t len)
+{
+	const char	*p = buf;
+
+	while ( len ) {
+		ssize_t	n = write(fd, p, len);
+
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			return -1;
+		}
+		p   += n;
+		len -= n;
+	}
+	return 0;
+}
+
+int
+RocksdSendFds(int sock, const void *buf, size_t len, const int *fds, int nfds)
+{
+	union {
+		struct cmsghdr	hdr;
+		char		space[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+	} control;
+	struct msghdr	msg;
+	struct iovec	iov;
+	ssize_t		n;
+
+	if ( nfds > MAX_FDS || !len ) {
+		errno = EINVAL;
+		return -1;
+	}
+	memset(&msg, 0, sizeof(msg));
+	memset(&control, 0, sizeof(control));
+	iov.iov_base	= (void *)buf;
+	iov.iov_len	= len;
+	msg.msg_iov	= &iov;
+	msg.msg_iovlen	= 1;
+	if ( nfds > 0 ) {
+		struct cmsghdr	*cmsg;
+
+		msg.msg_control	   = control.space;
+		msg.msg_controllen = CMSG_SPACE(sizeof(int) * nfds);
+		cmsg		   = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level   = SOL_SOCKET;
+		cmsg->cmsg_type	   = SCM_RIGHTS;
+		cmsg->cmsg_len	   = CMSG_LEN(sizeof(int) * nfds);
+		memcpy(CMSG_DATA(cmsg), fds, sizeof(int) * nfds);
+	}
+
+	do {
+		n = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	} while ( n < 0 && errno == EINTR );
+	if ( n < 0 ) {
+		return -1;
+	}
+
+	/* the descriptors went with the first byte */
+	return write_all(sock, (const char *)buf + n, len - n);
+} /* RocksdSendFds */
+
+ssize_t
+RocksdRecvFds(int sock, void *buf, size_t len, int *fds, int maxfds,
+	int *nfds)
+{
+	union {
+		struct cmsghdr	hdr;
+		char		space[CMSG_SPACE(sizeof(int) * MAX_FDS)];
+	} control;
+	struct msghdr	msg;
+	struct iovec	iov;
+	struct cmsghdr	*cmsg;
+	ssize_t		n;
+
+	*nfds = 0;
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base	   = buf;
+	iov.iov_len	   = len;
+	msg.msg_iov	   = &iov;
+	msg.msg_iovlen	   = 1;
+	msg.msg_control	   = control.space;
+	msg.msg_controllen = sizeof(control.space);
+
+	do {
+		n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+	} while ( n < 0 && errno == EINTR );
+	if ( n < 0 ) {
+		return -1;
+	}
+
+	for ( cmsg = CMSG_FIRSTHDR(&msg); cmsg;
+		cmsg = CMSG_NXTHDR(&msg, cmsg) ) {
+		int	*p = (int *)CMSG_DATA(cmsg);
+		int	i, count;
+
+		if ( cmsg->cmsg_level != SOL_SOCKET ||
+			cmsg->cmsg_type != SCM_RIGHTS ) {
+			continue;
+		}
+		count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+		for ( i = 0; i < count; i++ ) {
+			if ( *nfds < maxfds ) {
+				fds[(*nfds)++] = p[i];
+			}
+			else {
+				close(p[i]);
+			}
+		}
+	}
+	return n;
+} /* RocksdRecvFds */
+
+
+static void
+forward_signal(int sig)
+{
+	unsigned char	c = sig;
+	int		saved = errno;
+
+	if ( call_fd >= 0 && write(call_fd, &c, 1) < 0 ) {
+		/* the reply read will see the daemon is gone */
+	}
+	errno = saved;
+}
+
+static int
+request(int argc, char * const *argv, char * const *envp, struct buffer *b)
+{
+	char	cwd[PATH_MAX], num[32];
+	mode_t	mask;
+	int	i;
+
+	if ( !getcwd(cwd, sizeof(cwd)) ) {
+		return -1;
+	}
+	mask = umask(0);
+	umask(mask);
+	snprintf(num, sizeof(num), "%04o", (unsigned int)mask);
+
+	b->cap	= 4096;
+	b->data	= malloc(b->cap);
+	b->len	= ROCKSD_HEADER;		/* filled in below */
+	if ( !b->data || buffer_add(b, cwd) || buffer_add(b, num) ) {
+		return -1;
+	}
+	snprintf(num, sizeof(num), "%d", argc);
+	if ( buffer_add(b, num) ) {
+		return -1;
+	}
+	for ( i = 0; i < argc; i++ ) {
+		if ( buffer_add(b, argv[i]) ) {
+			return -1;
+		}
+	}
+	for ( i = 0; envp && envp[i]; i++ ) {
+		if ( buffer_add(b, envp[i]) ) {
+			return -1;
+		}
+	}
+	memcpy(b->data, ROCKSD_MAGIC, 4);
+	le32_put((unsigned char *)b->data + 4, b->len - ROCKSD_HEADER);
+	return 0;
+}
+
+/*
+ * Runs argv (without the "rocks") in the daemon at path.
+ */
+int
+RocksdCall(const char *path, int argc, char * const *argv,
+	char * const *envp, int *status)
+{
+	static const int	fds[3] = { 0, 1, 2 };
+	struct sockaddr_un	addr;
+	struct sigaction	sa, saved[NFORWARDED], savedpipe;
+	sigset_t		block, mask;
+	struct buffer		b;
+	unsigned char		reply[ROCKSD_HEADER];
+	size_t			got = 0;
+	int			sock, i, rc;
+
+	memset(&b, 0, sizeof(b));
+	if ( strlen(path) >= sizeof(addr.sun_path) ) {
+		return ROCKSD_FALLBACK;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+
+	sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+	if ( sock < 0 ) {
+		return ROCKSD_FALLBACK;
+	}
+
+	/*
+	 * ^C and friends go to the command, as they would in a
+	 * terminal.  They wait until the request is out so they are
+	 * not mixed up with it.
+	 */
+	sigemptyset(&block);
+	for ( i = 0; i < NFORWARDED; i++ ) {
+		sigaddset(&block, forwarded[i]);
+	}
+	sigprocmask(SIG_BLOCK, &block, &mask);
+
+	if ( connect(sock, (struct sockaddr *)&addr, sizeof(addr)) ||
+		request(argc, argv, envp, &b) ||
+		RocksdSendFds(sock, b.data, b.len, fds, 3) ) {
+		free(b.data);
+		close(sock);
+		sigprocmask(SIG_SETMASK, &mask, NULL);
+		return ROCKSD_FALLBACK;
+	}
+	free(b.data);
+
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = forward_signal;
+	sigemptyset(&sa.sa_mask);
+	call_fd = sock;
+	for ( i = 0; i < NFORWARDED; i++ ) {
+		sigaction(forwarded[i], &sa, &saved[i]);
+	}
+	sa.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &sa, &savedpipe);
+	sigprocmask(SIG_SETMASK, &mask, NULL);
+
+	while ( got < sizeof(reply) ) {
+		ssize_t	n = read(sock, reply + got, sizeof(reply) - got);
+
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			break;
+		}
+		got += n;
+	}
+
+	sigprocmask(SIG_BLOCK, &block, NULL);
+	call_fd = -1;
+	for ( i = 0; i < NFORWARDED; i++ ) {
+		sigaction(forwarded[i], &saved[i], NULL);
+	}
+	sigaction(SIGPIPE, &savedpipe, NULL);
+	sigprocmask(SIG_SETMASK, &mask, NULL);
+	close(sock);
+
+	if ( got < sizeof(reply) ) {
+		return ROCKSD_LOST;
+	}
+	if ( !memcmp(reply, ROCKSD_RUNIT, 4) ) {
+		return ROCKSD_FALLBACK;
+	}
+	if ( memcmp(reply, ROCKSD_STATUS, 4) ) {
+		return ROCKSD_LOST;
+	}
+	rc = reply[4] | (reply[5] << 8) | (reply[6] << 16) |
+		((unsigned int)reply[7] << 24);
+	*status = rc;
+	return 0;
+} /* RocksdCall */
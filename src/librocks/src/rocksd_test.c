@@ -0,0 +1,249 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include "../include/rocksd.h"
+
+static int failed;
+
+static void
+check(int ok, const char *what)
+{
+	printf("%s %s\n", ok ? "ok  " : "FAIL", what);
+	if ( !ok ) {
+		failed++;
+	}
+}
+
+static void
+reply(int conn, const char *magic, int status)
+{
+	unsigned char	buf[ROCKSD_HEADER];
+
+	memcpy(buf, magic, 4);
+	buf[4] = status;
+	buf[5] = status >> 8;
+	buf[6] = status >> 16;
+	buf[7] = status >> 24;
+	if ( write(conn, buf, sizeof(buf)) != sizeof(buf) ) {
+		exit(2);
+	}
+}
+
+/*
+ * Reads a request, returns the body and checks what we can here.
+ */
+static char *
+read_request(int conn, int *fds, int *nfds, size_t *len)
+{
+	unsigned char	hdr[ROCKSD_HEADER];
+	char		*body;
+	size_t		got = 0;
+
+	if ( RocksdRecvFds(conn, hdr, sizeof(hdr), fds, 3, nfds) !=
+		sizeof(hdr) || memcmp(hdr, ROCKSD_MAGIC, 4) ) {
+		exit(3);
+	}
+	*len = hdr[4] | (hdr[5] << 8) | (hdr[6] << 16) | (hdr[7] << 24);
+	body = malloc(*len);
+	while ( body && got < *len ) {
+		ssize_t	n = read(conn, body + got, *len - got);
+
+		if ( n <= 0 ) {
+			exit(4);
+		}
+		got += n;
+	}
+	return body;
+}
+
+/*
+ * A daemon that answers four calls: runs the first (checking the
+ * request and writing to the client's stdout), sends the second back,
+ * passes on the signal of the third, and drops the fourth.
+ */
+static void
+server(int listener)
+{
+	int	i;
+
+	for ( i = 0; i < 4; i++ ) {
+		int	conn = accept(listener, NULL, NULL);
+		int	fds[3], nfds, ok;
+		size_t	len;
+		char	*body, *p, c;
+
+		if ( conn < 0 ) {
+			exit(5);
+		}
+		body = read_request(conn, fds, &nfds, &len);
+		switch ( i ) {
+		case 0:
+			p  = body;
+			ok = nfds == 3 && p[0] == '/';
+			p += strlen(p) + 1;
+			ok = ok && !strcmp(p, "0022");
+			p += strlen(p) + 1;
+			ok = ok && !strcmp(p, "2");
+			p += strlen(p) + 1;
+			ok = ok && !strcmp(p, "list");
+			p += strlen(p) + 1;
+			ok = ok && !strcmp(p, "host");
+			p += strlen(p) + 1;
+			ok = ok && !strcmp(p, "ROCKSD_TEST=yes") &&
+				p + strlen(p) + 1 == body + len;
+			if ( write(fds[1], "hello\n", 6) != 6 ) {
+				ok = 0;
+			}
+			reply(conn, ROCKSD_STATUS, ok ? 3 : 99);
+			break;
+		case 1:
+			reply(conn, ROCKSD_RUNIT, 0);
+			break;
+		case 2:
+			kill(getppid(), SIGINT);
+			if ( read(conn, &c, 1) != 1 ) {
+				c = 0;
+			}
+			reply(conn, ROCKSD_STATUS, 128 + c);
+			break;
+		}
+		while ( nfds ) {
+			close(fds[--nfds]);
+		}
+		free(body);
+		close(conn);
+	}
+	exit(0);
+}
+
+int
+main(int argc, char *argv[])
+{
+	char			dir[] = "/tmp/rocksd_test.XXXXXX";
+	char			path[128], out[128], buf[16];
+	char * const		args[] = { "list", "host", NULL };
+	char * const		env[] = { "ROCKSD_TEST=yes", NULL };
+	struct sockaddr_un	addr;
+	int			listener, status = -1, saved, fd, rc;
+	pid_t			pid;
+
+	if ( !mkdtemp(dir) ) {
+		perror(dir);
+		return 1;
+	}
+	snprintf(path, sizeof(path), "%s/rocksd.sock", dir);
+	snprintf(out, sizeof(out), "%s/stdout", dir);
+
+	check(RocksdCall(path, 2, args, env, &status) == ROCKSD_FALLBACK,
+		"no daemon");
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	if ( listener < 0 || bind(listener, (struct sockaddr *)&addr,
+		sizeof(addr)) || listen(listener, 4) ) {
+		perror(path);
+		return 1;
+	}
+	fflush(stdout);
+	pid = fork();
+	if ( pid == 0 ) {
+		server(listener);
+	}
+	close(listener);
+	umask(022);
+
+	/* stdout is where the daemon writes */
+	saved = dup(1);
+	fd    = open(out, O_RDWR | O_CREAT | O_TRUNC, 0644);
+	dup2(fd, 1);
+	rc = RocksdCall(path, 2, args, env, &status);
+	dup2(saved, 1);
+	close(saved);
+	check(rc == 0 && status == 3, "request and status");
+	memset(buf, 0, sizeof(buf));
+	check(pread(fd, buf, sizeof(buf) - 1, 0) == 6 && !strcmp(buf,
+		"hello\n"), "stdout passed");
+	close(fd);
+
+	check(RocksdCall(path, 2, args, env, &status) == ROCKSD_FALLBACK,
+		"run it yourself");
+	status = -1;
+	check(RocksdCall(path, 2, args, env, &status) == 0 &&
+		status == 128 + SIGINT, "signal forwarded");
+	check(signal(SIGINT, SIG_DFL) == SIG_DFL, "handler restored");
+	check(RocksdCall(path, 2, args, env, &status) == ROCKSD_LOST, "lost");
+
+	check(waitpid(pid, &status, 0) == pid && WIFEXITED(status) &&
+		WEXITSTATUS(status) == 0, "server");
+	unlink(out);
+	unlink(path);
+	rmdir(dir);
+	return failed ? 1 : 0;
+} /* main */
@@ -0,0 +1,1103 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <lzma.h>
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#include "../include/rpmheader.h"
+#include "../include/rpmextract.h"
+
+#define RPMEXTRACT_MAX_THREADS	32
+#define CHUNK			65536
+
+/* ---------------------------------------------------------- payload */
+
+enum {
+	PAYLOAD_GZIP,
+	PAYLOAD_XZ,
+	PAYLOAD_LZMA,
+	PAYLOAD_ZSTD
+};
+
+struct payload {
+	int		fd;
+	int		kind;
+	int		eof;		/* decompressor is done */
+	int		ineof;		/* no more compressed input */
+	unsigned char	in[CHUNK];
+	size_t		inlen;
+	size_t		inpos;
+	z_stream	z;
+	lzma_stream	x;
+#ifdef HAVE_ZSTD
+	ZSTD_DStream	*zs;
+#endif
+};
+
+static int
+payload_fill(struct payload *p)
+{
+	ssize_t	n;
+
+	if ( p->inpos < p->inlen || p->ineof ) {
+		return 0;
+	}
+	do {
+		n = read(p->fd, p->in, sizeof(p->in));
+	} while ( n < 0 && errno == EINTR );
+	if ( n < 0 ) {
+		return -1;
+	}
+	p->inlen = n;
+	p->inpos = 0;
+	p->ineof = (n == 0);
+	return 0;
+}
+
+/*
+ * Picks the decompressor from the first bytes of the payload, the
+ * payloadcompressor tag is only needed to tell old lzma from gzip.
+ */
+static int
+payload_open(struct payload *p, int fd, const char *compressor,
+	char *error, size_t errlen)
+{
+	static const unsigned char	xz[] = { 0xfd, '7', 'z', 'X', 'Z', 0 };
+	static const unsigned char	zstd[] = { 0x28, 0xb5, 0x2f, 0xfd };
+	int				rc;
+
+	memset(p, 0, sizeof(struct payload));
+	p->fd = fd;
+	if ( payload_fill(p) ) {
+		snprintf(error, errlen, "read: %s", strerror(errno));
+		return -1;
+	}
+
+	if ( p->inlen >= 2 && p->in[0] == 0x1f && p->in[1] == 0x8b ) {
+		p->kind = PAYLOAD_GZIP;
+		rc = inflateInit2(&p->z, 15 + 16);
+		if ( rc != Z_OK ) {
+			snprintf(error, errlen, "inflateInit2: %d", rc);
+			return -1;
+		}
+		return 0;
+	}
+	if ( p->inlen >= sizeof(xz) && !memcmp(p->in, xz, sizeof(xz)) ) {
+		lzma_stream	init = LZMA_STREAM_INIT;
+
+		p->kind = PAYLOAD_XZ;
+		p->x	= init;
+		rc = lzma_stream_decoder(&p->x, UINT64_MAX, LZMA_CONCATENATED);
+		if ( rc != LZMA_OK ) {
+			snprintf(error, errlen, "lzma_stream_decoder: %d", rc);
+			return -1;
+		}
+		return 0;
+	}
+	if ( p->inlen >= sizeof(zstd) && !memcmp(p->in, zstd, sizeof(zstd)) ) {
+#ifdef HAVE_ZSTD
+		p->kind = PAYLOAD_ZSTD;
+		p->zs	= ZSTD_createDStream();
+		if ( !p->zs || ZSTD_isError(ZSTD_initDStream(p->zs)) ) {
+			snprintf(error, errlen, "ZSTD_initDStream failed");
+			return -1;
+		}
+		return 0;
+#else
+		snprintf(error, errlen, "zstd payloads are not supported");
+		return -1;
+#endif
+	}
+	if ( compressor && !strcmp(compressor, "lzma") ) {
+		lzma_stream	init = LZMA_STREAM_INIT;
+
+		p->kind = PAYLOAD_LZMA;
+		p->x	= init;
+		rc = lzma_alone_decoder(&p->x, UINT64_MAX);
+		if ( rc != LZMA_OK ) {
+			snprintf(error, errlen, "lzma_alone_decoder: %d", rc);
+			return -1;
+		}
+		return 0;
+	}
+
+	snprintf(error, errlen, "unsupported payload compressor %s",
+		compressor ? compressor : "(none)");
+	return -1;
+}
+
+static void
+payload_close(struct payload *p)
+{
+	switch ( p->kind ) {
+	case PAYLOAD_GZIP:
+		inflateEnd(&p->z);
+		break;
+	case PAYLOAD_XZ:
+	case PAYLOAD_LZMA:
+		lzma_end(&p->x);
+		break;
+#ifdef HAVE_ZSTD
+	case PAYLOAD_ZSTD:
+		ZSTD_freeDStream(p->zs);
+		break;
+#endif
+	}
+}
+
+/*
+ * Reads exactly len bytes of the uncompressed payload.
+ */
+static int
+payload_read(struct payload *p, void *buf, size_t len, char *error,
+	size_t errlen)
+{
+	unsigned char	*out = buf;
+	size_t		done = 0;
+
+	while ( done < len ) {
+		size_t	before = done;
+		int	rc;
+
+		if ( p->eof ) {
+			snprintf(error, errlen, "truncated payload");
+			return -1;
+		}
+		if ( payload_fill(p) ) {
+			snprintf(error, errlen, "read: %s", strerror(errno));
+			return -1;
+		}
+
+		switch ( p->kind ) {
+		case PAYLOAD_GZIP:
+			p->z.next_in   = p->in + p->inpos;
+			p->z.avail_in  = p->inlen - p->inpos;
+			p->z.next_out  = out + done;
+			p->z.avail_out = len - done;
+			rc = inflate(&p->z, Z_NO_FLUSH);
+			p->inpos = p->inlen - p->z.avail_in;
+			done	 = len - p->z.avail_out;
+			if ( rc == Z_STREAM_END ) {
+				p->eof = 1;
+			}
+			else if ( rc != Z_OK && rc != Z_BUF_ERROR ) {
+				snprintf(error, errlen, "inflate: %d", rc);
+				return -1;
+			}
+			break;
+		case PAYLOAD_XZ:
+		case PAYLOAD_LZMA:
+			p->x.next_in   = p->in + p->inpos;
+			p->x.avail_in  = p->inlen - p->inpos;
+			p->x.next_out  = out + done;
+			p->x.avail_out = len - done;
+			rc = lzma_code(&p->x, p->ineof ? LZMA_FINISH : LZMA_RUN);
+			p->inpos = p->inlen - p->x.avail_in;
+			done	 = len - p->x.avail_out;
+			if ( rc == LZMA_STREAM_END ) {
+				p->eof = 1;
+			}
+			else if ( rc != LZMA_OK && rc != LZMA_BUF_ERROR ) {
+				snprintf(error, errlen, "lzma_code: %d", rc);
+				return -1;
+			}
+			break;
+#ifdef HAVE_ZSTD
+		case PAYLOAD_ZSTD: {
+			ZSTD_inBuffer	zin = { p->in, p->inlen, p->inpos };
+			ZSTD_outBuffer	zout = { out, len, done };
+			size_t		zrc;
+
+			zrc = ZSTD_decompressStream(p->zs, &zout, &zin);
+			p->inpos = zin.pos;
+			done	 = zout.pos;
+			if ( ZSTD_isError(zrc) ) {
+				snprintf(error, errlen, "zstd: %s",
+					ZSTD_getErrorName(zrc));
+				return -1;
+			}
+			if ( zrc == 0 && p->ineof && p->inpos == p->inlen ) {
+				p->eof = 1;
+			}
+			break;
+		}
+#endif
+		}
+
+		/* no progress and nothing left to feed it */
+		if ( done == before && p->ineof && p->inpos == p->inlen &&
+			!p->eof ) {
+			snprintf(error, errlen, "truncated payload");
+			return -1;
+		}
+	}
+	return 0;
+}
+
+static int
+payload_skip(struct payload *p, size_t len, char *error, size_t errlen)
+{
+	unsigned char	buf[4096];
+
+	while ( len ) {
+		size_t	n = len < sizeof(buf) ? len : sizeof(buf);
+
+		if ( payload_read(p, buf, n, error, errlen) ) {
+			return -1;
+		}
+		len -= n;
+	}
+	return 0;
+}
+
+
+/* ------------------------------------------------------------- cpio */
+
+struct cpio_entry {
+	unsigned long	ino;
+	unsigned long	mode;
+	unsigned long	uid;
+	unsigned long	gid;
+	unsigned long	nlink;
+	unsigned long	mtime;
+	unsigned long	size;
+	unsigned long	namesize;
+};
+
+/* hard link group member written before the data arrived */
+struct link {
+	unsigned long	ino;
+	char		*path;
+	struct link	*next;
+};
+
+/*
+ * Directory attributes are set once everything has been unpacked, a
+ * read-only directory would otherwise stop its own contents from being
+ * written and every new entry would bump the mtime.
+ */
+struct dirattr {
+	char		*path;
+	unsigned long	mode;
+	unsigned long	uid;
+	unsigned long	gid;
+	unsigned long	mtime;
+	int		depth;
+	int		job;
+	int		entry;
+	struct dirattr	*next;
+};
+
+struct extract {
+	struct payload	payload;
+	int		rootfd;
+	const char	*prefix;	/* first prefix of relocatable packages */
+	size_t		prefixlen;
+	int		chown;
+	struct link	*links;
+	struct dirattr	*dirs;
+	int		ndirs;
+	char		*error;
+	size_t		errlen;
+};
+
+static unsigned long
+hex8(const char *p)
+{
+	unsigned long	v = 0;
+	int		i;
+
+	for ( i = 0; i < 8; i++ ) {
+		int	c = p[i];
+
+		v <<= 4;
+		if ( c >= '0' && c <= '9' ) {
+			v |= c - '0';
+		}
+		else if ( c >= 'a' && c <= 'f' ) {
+			v |= c - 'a' + 10;
+		}
+		else if ( c >= 'A' && c <= 'F' ) {
+			v |= c - 'A' + 10;
+		}
+	}
+	return v;
+}
+
+static int
+fail(struct extract *x, const char *fmt, ...)
+{
+	va_list	ap;
+
+	va_start(ap, fmt);
+	vsnprintf(x->error, x->errlen, fmt, ap);
+	va_end(ap);
+	return -1;
+}
+
+static int
+fail_errno(struct extract *x, const char *path)
+{
+	if ( errno == ELOOP || errno == ENOTDIR ) {
+		return fail(x, "%s: path goes through a symlink", path);
+	}
+	return fail(x, "%s: %s", path, strerror(errno));
+}
+
+/*
+ * Returns the destination of a payload path ("./usr/bin/foo") relative
+ * to the root.  Paths with ".." components are refused.
+ */
+static const char *
+destination(struct extract *x, const char *name)
+{
+	const char	*path, *p;
+
+	if ( name[0] == '.' && name[1] == '/' ) {
+		name++;
+	}
+	path = name;
+	for ( p = path; *p; ) {
+		while ( *p == '/' ) {
+			p++;
+		}
+		if ( p[0] == '.' && p[1] == '.' && (p[2] == '/' || !p[2]) ) {
+			fail(x, "%s: path leaves the root", name);
+			return NULL;
+		}
+		while ( *p && *p != '/' ) {
+			p++;
+		}
+	}
+
+	if ( x->prefix && !strncmp(path, x->prefix, x->prefixlen) &&
+		(path[x->prefixlen] == '/' || !path[x->prefixlen]) ) {
+		path += x->prefixlen;
+	}
+	while ( *path == '/' ) {
+		path++;
+	}
+	return path;
+}
+
+/*
+ * Opens the directory that holds path (relative to rootfd), one
+ * component at a time and never through a symlink, since an earlier
+ * entry of this or another package could have put one anywhere.
+ * Missing components are created when asked to.  Returns the directory
+ * fd and points leaf at the last component, or -1 with errno set.
+ */
+static int
+open_parent(int rootfd, const char *path, int create, const char **leaf)
+{
+	char		name[NAME_MAX + 1];
+	const char	*p = path, *end;
+	int		dirfd, fd;
+
+	dirfd = openat(rootfd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if ( dirfd < 0 ) {
+		return -1;
+	}
+	for ( ;; ) {
+		size_t	len;
+
+		while ( *p == '/' ) {
+			p++;
+		}
+		if ( !(end = strchr(p, '/')) ) {
+			*leaf = p;
+			return dirfd;
+		}
+		if ( (len = end - p) > NAME_MAX ) {
+			close(dirfd);
+			errno = ENAMETOOLONG;
+			return -1;
+		}
+		memcpy(name, p, len);
+		name[len] = '\0';
+		if ( create && mkdirat(dirfd, name, 0755) && errno != EEXIST ) {
+			close(dirfd);
+			return -1;
+		}
+		fd = openat(dirfd, name,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		close(dirfd);
+		if ( fd < 0 ) {
+			return -1;
+		}
+		dirfd = fd;
+		p = end;
+	}
+} /* open_parent */
+
+/* makes root and its parents, the caller picked it so they may be links */
+static int
+mkdirs(const char *root)
+{
+	char	path[4096], *p;
+
+	if ( snprintf(path, sizeof(path), "%s/", root) >= (int)sizeof(path) ) {
+		errno = ENAMETOOLONG;
+		return -1;
+	}
+	for ( p = path + 1; *p; p++ ) {
+		if ( *p != '/' ) {
+			continue;
+		}
+		*p = '\0';
+		if ( mkdir(path, 0755) && errno != EEXIST ) {
+			return -1;
+		}
+		*p = '/';
+	}
+	return 0;
+}
+
+static void
+set_times(struct timespec times[2], struct cpio_entry *e)
+{
+	times[0].tv_sec	 = e->mtime;
+	times[0].tv_nsec = 0;
+	times[1]	 = times[0];
+}
+
+static int
+write_file(struct extract *x, int dirfd, const char *leaf, const char *path,
+	struct cpio_entry *e)
+{
+	unsigned char	buf[CHUNK];
+	struct timespec	times[2];
+	unsigned long	left = e->size;
+	int		fd;
+
+	if ( unlinkat(dirfd, leaf, 0) && errno != ENOENT ) {
+		return fail(x, "%s: %s", path, strerror(errno));
+	}
+	fd = openat(dirfd, leaf,
+		O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+	if ( fd < 0 ) {
+		return fail(x, "%s: %s", path, strerror(errno));
+	}
+	while ( left ) {
+		size_t	n = left < sizeof(buf) ? left : sizeof(buf);
+		size_t	off = 0;
+
+		if ( payload_read(&x->payload, buf, n, x->error, x->errlen) ) {
+			close(fd);
+			return -1;
+		}
+		while ( off < n ) {
+			ssize_t	w = write(fd, buf + off, n - off);
+
+			if ( w < 0 && errno == EINTR ) {
+				continue;
+			}
+			if ( w < 0 ) {
+				close(fd);
+				return fail(x, "%s: %s", path, strerror(errno));
+			}
+			off += w;
+		}
+		left -= n;
+	}
+
+	if ( x->chown && fchown(fd, e->uid, e->gid) ) {
+		/* not fatal, rpm complains and keeps going too */
+	}
+	fchmod(fd, e->mode & 07777);
+	set_times(times, e);
+	futimens(fd, times);
+	if ( close(fd) ) {
+		return fail(x, "%s: %s", path, strerror(errno));
+	}
+	return 0;
+}
+
+static int
+remember_dir(struct extract *x, const char *path, struct cpio_entry *e)
+{
+	struct dirattr	*d = malloc(sizeof(struct dirattr));
+	const char	*p;
+
+	if ( !d || !(d->path = strdup(path)) ) {
+		free(d);
+		return fail(x, "out of memory");
+	}
+	d->mode	 = e->mode;
+	d->uid	 = e->uid;
+	d->gid	 = e->gid;
+	d->mtime = e->mtime;
+	d->depth = 0;
+	for ( p = path; *p; p++ ) {
+		d->depth += (*p == '/');
+	}
+	d->job	 = 0;
+	d->entry = x->ndirs++;
+	d->next	 = x->dirs;
+	x->dirs	 = d;
+	return 0;
+}
+
+/*
+ * In a newc archive only the last member of a hard link group has the
+ * data.  The earlier ones are created empty and remembered, then
+ * replaced by links once the data has been written.
+ */
+static int
+remember_link(struct extract *x, unsigned long ino, const char *path)
+{
+	struct link	*l = malloc(sizeof(struct link));
+
+	if ( !l || !(l->path = strdup(path)) ) {
+		free(l);
+		return fail(x, "out of memory");
+	}
+	l->ino	 = ino;
+	l->next	 = x->links;
+	x->links = l;
+	return 0;
+}
+
+static int
+resolve_links(struct extract *x, unsigned long ino, int dirfd,
+	const char *leaf)
+{
+	struct link	*l;
+
+	for ( l = x->links; l; l = l->next ) {
+		const char	*lleaf;
+		int		ldirfd, rc;
+
+		if ( l->ino != ino || !l->path[0] ) {
+			continue;
+		}
+		ldirfd = open_parent(x->rootfd, l->path, 0, &lleaf);
+		if ( ldirfd < 0 ) {
+			return fail_errno(x, l->path);
+		}
+		if ( unlinkat(ldirfd, lleaf, 0) && errno != ENOENT ) {
+			close(ldirfd);
+			return fail(x, "%s: %s", l->path, strerror(errno));
+		}
+		rc = linkat(dirfd, leaf, ldirfd, lleaf, 0);
+		close(ldirfd);
+		if ( rc ) {
+			return fail(x, "%s: %s", l->path, strerror(errno));
+		}
+		l->path[0] = '\0';
+	}
+	return 0;
+}
+
+static int
+extract_entry(struct extract *x, struct cpio_entry *e, const char *name)
+{
+	const char	*path, *leaf;
+	int		dirfd, rc = -1;
+
+	if ( !(path = destination(x, name)) ) {
+		return -1;
+	}
+	if ( !path[0] ) {
+		/* the root itself, it belongs to the caller */
+		if ( S_ISDIR(e->mode) ) {
+			return payload_skip(&x->payload, e->size, x->error,
+				x->errlen);
+		}
+		return fail(x, "%s: not a directory", name);
+	}
+	if ( (dirfd = open_parent(x->rootfd, path, 1, &leaf)) < 0 ) {
+		return fail_errno(x, path);
+	}
+
+	if ( S_ISDIR(e->mode) ) {
+		struct stat	st;
+
+		if ( mkdirat(dirfd, leaf, 0755) && (errno != EEXIST ||
+			fstatat(dirfd, leaf, &st, AT_SYMLINK_NOFOLLOW) ||
+			!S_ISDIR(st.st_mode)) ) {
+			if ( errno == EEXIST ) {
+				errno = ENOTDIR;
+			}
+			fail_errno(x, path);
+		}
+		else if ( remember_dir(x, path, e) == 0 ) {
+			rc = payload_skip(&x->payload, e->size, x->error,
+				x->errlen);
+		}
+	}
+	else if ( S_ISLNK(e->mode) ) {
+		char		target[4096];
+		struct timespec	times[2];
+
+		if ( e->size >= sizeof(target) ) {
+			fail(x, "%s: link target too long", path);
+		}
+		else if ( payload_read(&x->payload, target, e->size, x->error,
+			x->errlen) == 0 ) {
+			target[e->size] = '\0';
+			if ( unlinkat(dirfd, leaf, 0) && errno != ENOENT ) {
+				fail(x, "%s: %s", path, strerror(errno));
+			}
+			else if ( symlinkat(target, dirfd, leaf) ) {
+				fail(x, "%s: %s", path, strerror(errno));
+			}
+			else {
+				if ( x->chown && fchownat(dirfd, leaf, e->uid,
+					e->gid, AT_SYMLINK_NOFOLLOW) ) {
+					/* not fatal */
+				}
+				set_times(times, e);
+				utimensat(dirfd, leaf, times,
+					AT_SYMLINK_NOFOLLOW);
+				rc = 0;
+			}
+		}
+	}
+	else if ( S_ISREG(e->mode) ) {
+		rc = write_file(x, dirfd, leaf, path, e);
+		if ( rc == 0 && e->nlink > 1 ) {
+			rc = (e->size == 0) ? remember_link(x, e->ino, path) :
+				resolve_links(x, e->ino, dirfd, leaf);
+		}
+	}
+	else {
+		/* devices, fifos and sockets are not needed in a build tree */
+		rc = payload_skip(&x->payload, e->size, x->error, x->errlen);
+	}
+
+	close(dirfd);
+	return rc;
+} /* extract_entry */
+
+static int
+extract_payload(struct extract *x)
+{
+	char	hdr[110], name[4096];
+
+	for ( ;; ) {
+		struct cpio_entry	e;
+		size_t			n;
+
+		if ( payload_read(&x->payload, hdr, sizeof(hdr), x->error,
+			x->errlen) ) {
+			return -1;
+		}
+		if ( memcmp(hdr, "07070", 5) || (hdr[5] != '1' && hdr[5] != '2') ) {
+			return fail(x, "bad cpio header");
+		}
+		e.ino	   = hex8(hdr + 6);
+		e.mode	   = hex8(hdr + 14);
+		e.uid	   = hex8(hdr + 22);
+		e.gid	   = hex8(hdr + 30);
+		e.nlink	   = hex8(hdr + 38);
+		e.mtime	   = hex8(hdr + 46);
+		e.size	   = hex8(hdr + 54);
+		e.namesize = hex8(hdr + 94);
+
+		/* the name is padded so the data starts on 4 bytes */
+		n = e.namesize + (4 - (sizeof(hdr) + e.namesize) % 4) % 4;
+		if ( e.namesize == 0 || n > sizeof(name) ) {
+			return fail(x, "bad cpio name size %lu", e.namesize);
+		}
+		if ( payload_read(&x->payload, name, n, x->error, x->errlen) ) {
+			return -1;
+		}
+		name[e.namesize - 1] = '\0';
+		if ( !strcmp(name, "TRAILER!!!") ) {
+			return 0;
+		}
+
+		if ( extract_entry(x, &e, name) ) {
+			return -1;
+		}
+		n = (4 - e.size % 4) % 4;
+		if ( payload_skip(&x->payload, n, x->error, x->errlen) ) {
+			return -1;
+		}
+	}
+} /* extract_payload */
+
+
+static void
+free_dirs(struct dirattr *d)
+{
+	while ( d ) {
+		struct dirattr	*next = d->next;
+
+		free(d->path);
+		free(d);
+		d = next;
+	}
+}
+
+/* deepest first, then in the order the packages listed them */
+static int
+dir_order(const void *a, const void *b)
+{
+	const struct dirattr	*x = *(struct dirattr * const *)a;
+	const struct dirattr	*y = *(struct dirattr * const *)b;
+
+	if ( x->depth != y->depth ) {
+		return y->depth - x->depth;
+	}
+	if ( x->job != y->job ) {
+		return x->job - y->job;
+	}
+	return x->entry - y->entry;
+}
+
+/*
+ * The final pass over the directories, children before parents so a
+ * parent that ends up read-only is not walked into afterwards.  Like
+ * the owners of files this is best effort.
+ */
+static void
+apply_dirs(int rootfd, struct dirattr *dirs)
+{
+	struct dirattr	**v, *d;
+	size_t		i, n = 0;
+	int		chown = (geteuid() == 0);
+
+	for ( d = dirs; d; d = d->next ) {
+		n++;
+	}
+	if ( !n || !(v = malloc(n * sizeof(struct dirattr *))) ) {
+		return;
+	}
+	for ( i = 0, d = dirs; d; d = d->next ) {
+		v[i++] = d;
+	}
+	qsort(v, n, sizeof(struct dirattr *), dir_order);
+
+	for ( i = 0; i < n; i++ ) {
+		struct timespec	times[2];
+		const char	*leaf;
+		int		dirfd, fd;
+
+		d = v[i];
+		if ( (dirfd = open_parent(rootfd, d->path, 0, &leaf)) < 0 ) {
+			continue;
+		}
+		fd = openat(dirfd, leaf,
+			O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+		close(dirfd);
+		if ( fd < 0 ) {
+			continue;
+		}
+		if ( chown && fchown(fd, d->uid, d->gid) ) {
+			/* not fatal */
+		}
+		fchmod(fd, d->mode & 07777);
+		times[0].tv_sec	 = d->mtime;
+		times[0].tv_nsec = 0;
+		times[1]	 = times[0];
+		futimens(fd, times);
+		close(fd);
+	}
+	free(v);
+} /* apply_dirs */
+
+static int
+open_root(const char *root, char *error, size_t errlen)
+{
+	int	fd;
+
+	if ( mkdirs(root) ||
+		(fd = open(root, O_RDONLY | O_DIRECTORY | O_CLOEXEC)) < 0 ) {
+		snprintf(error, errlen, "%s: %s", root, strerror(errno));
+		return -1;
+	}
+	return fd;
+}
+
+/*
+ * Unpacks one package under the root directory fd and adds the
+ * directories it holds to dirs, leaving their attributes to the caller.
+ */
+static int
+extract_package(const char *path, int rootfd, struct dirattr **dirs,
+	char *error, size_t errlen)
+{
+	static const int	scripts[] = { RPMTAG_PREIN, RPMTAG_POSTIN,
+					      RPMTAG_PRETRANS, RPMTAG_POSTTRANS,
+					      0 };
+	struct extract		*x;
+	RPMHeader		*h;
+	RPMTagEntry		entry;
+	const char		*format, *prefixes[1];
+	int			fd, i, rc = -1;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if ( fd < 0 ) {
+		snprintf(error, errlen, "%s", strerror(errno));
+		return -1;
+	}
+	h = RPMHeaderReadFd(fd);
+	if ( !h ) {
+		snprintf(error, errlen, "%s", errno == EINVAL ?
+			"not an RPM package" : strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	format = RPMHeaderString(h, RPMTAG_PAYLOADFORMAT);
+	if ( format && strcmp(format, "cpio") ) {
+		snprintf(error, errlen, "unsupported payload format %s",
+			format);
+		goto done;
+	}
+	for ( i = 0; scripts[i]; i++ ) {
+		if ( !RPMHeaderGet(h, RPMHEADER_MAIN, scripts[i], &entry) ) {
+			snprintf(error, errlen, "has install scripts");
+			goto done;
+		}
+	}
+
+	x = calloc(1, sizeof(struct extract));
+	if ( !x ) {
+		snprintf(error, errlen, "out of memory");
+		goto done;
+	}
+	x->rootfd = rootfd;
+	x->chown  = (geteuid() == 0);
+	x->dirs	  = *dirs;
+	x->error  = error;
+	x->errlen = errlen;
+	if ( RPMHeaderStrings(h, RPMTAG_PREFIXES, prefixes, 1) > 0 ) {
+		x->prefix    = prefixes[0];
+		x->prefixlen = strlen(prefixes[0]);
+		while ( x->prefixlen > 1 && x->prefix[x->prefixlen - 1] == '/' ) {
+			x->prefixlen--;
+		}
+	}
+
+	if ( payload_open(&x->payload, fd,
+		RPMHeaderString(h, RPMTAG_PAYLOADCOMPRESSOR), error, errlen) == 0 ) {
+		rc = extract_payload(x);
+		payload_close(&x->payload);
+	}
+	while ( x->links ) {
+		struct link	*l = x->links;
+
+		x->links = l->next;
+		free(l->path);
+		free(l);
+	}
+	*dirs = x->dirs;
+	free(x);
+
+done:
+	RPMHeaderFree(h);
+	close(fd);
+	return rc;
+} /* extract_package */
+
+
+/*
+ * Unpacks one package under root.  Returns 0, or -1 with a message in
+ * error (which does not repeat the package path).
+ */
+int
+RPMExtract(const char *path, const char *root, char *error, size_t errlen)
+{
+	struct dirattr	*dirs = NULL;
+	int		rootfd, rc;
+
+	if ( (rootfd = open_root(root, error, errlen)) < 0 ) {
+		return -1;
+	}
+	rc = extract_package(path, rootfd, &dirs, error, errlen);
+	apply_dirs(rootfd, dirs);
+	free_dirs(dirs);
+	close(rootfd);
+	return rc;
+}
+
+
+struct pool {
+	RPMExtractJob	*jobs;
+	int		njobs;
+	int		next;
+	int		rootfd;
+	struct dirattr	**dirs;		/* per job */
+	pthread_mutex_t	lock;
+};
+
+static void *
+extract_worker(void *arg)
+{
+	struct pool	*pool = arg;
+
+	for ( ;; ) {
+		struct dirattr	*d;
+		int		i;
+
+		pthread_mutex_lock(&pool->lock);
+		i = (pool->next < pool->njobs) ? pool->next++ : -1;
+		pthread_mutex_unlock(&pool->lock);
+		if ( i < 0 ) {
+			return NULL;
+		}
+		pool->jobs[i].error[0] = '\0';
+		pool->jobs[i].status = extract_package(pool->jobs[i].path,
+			pool->rootfd, &pool->dirs[i], pool->jobs[i].error,
+			sizeof(pool->jobs[i].error));
+		for ( d = pool->dirs[i]; d; d = d->next ) {
+			d->job = i;
+		}
+	}
+}
+
+/*
+ * Unpacks packages concurrently, nthreads at a time (0 means one per
+ * CPU).  Directory attributes are only set once every job is done.
+ * Returns the number that failed, see the status and error of each job.
+ */
+int
+RPMExtractMany(RPMExtractJob *jobs, int njobs, const char *root,
+	int nthreads)
+{
+	pthread_t	threads[RPMEXTRACT_MAX_THREADS];
+	struct pool	pool;
+	struct dirattr	*dirs = NULL;
+	char		error[256];
+	int		i, started = 0, failed = 0;
+
+	if ( njobs <= 0 ) {
+		return 0;
+	}
+	pool.dirs = calloc(njobs, sizeof(struct dirattr *));
+	pool.rootfd = open_root(root, error, sizeof(error));
+	if ( !pool.dirs || pool.rootfd < 0 ) {
+		for ( i = 0; i < njobs; i++ ) {
+			jobs[i].status = -1;
+			snprintf(jobs[i].error, sizeof(jobs[i].error), "%s",
+				pool.dirs ? error : "out of memory");
+		}
+		if ( pool.rootfd >= 0 ) {
+			close(pool.rootfd);
+		}
+		free(pool.dirs);
+		return njobs;
+	}
+
+	if ( nthreads <= 0 ) {
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	}
+	if ( nthreads > njobs ) {
+		nthreads = njobs;
+	}
+	if ( nthreads > RPMEXTRACT_MAX_THREADS ) {
+		nthreads = RPMEXTRACT_MAX_THREADS;
+	}
+
+	pool.jobs  = jobs;
+	pool.njobs = njobs;
+	pool.next  = 0;
+	pthread_mutex_init(&pool.lock, NULL);
+
+	for ( i = 1; i < nthreads; i++ ) {
+		if ( pthread_create(&threads[started], NULL, extract_worker,
+			&pool) == 0 ) {
+			started++;
+		}
+	}
+	extract_worker(&pool);
+	for ( i = 0; i < started; i++ ) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.lock);
+
+	/* one list for the final pass */
+	for ( i = njobs - 1; i >= 0; i-- ) {
+		struct dirattr	*d = pool.dirs[i];
+
+		while ( d ) {
+			struct dirattr	*next = d->next;
+
+			d->next = dirs;
+			dirs	= d;
+			d	= next;
+		}
+	}
+	apply_dirs(pool.rootfd, dirs);
+	free_dirs(dirs);
+	free(pool.dirs);
+	close(pool.rootfd);
+
+	for ( i = 0; i < njobs; i++ ) {
+		if ( jobs[i].status ) {
+			failed++;
+		}
+	}
+	return failed;
+} /* RPMExtractMany */
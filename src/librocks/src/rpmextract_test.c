@@ -0,0 +1,361 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <lzma.h>
+#include "../include/rpmheader.h"
+#include "../include/rpmextract.h"
+
+static int failed;
+
+struct buf {
+	unsigned char	*data;
+	size_t		len;
+	size_t		cap;
+};
+
+static void
+append(struct buf *b, const void *data, size_t len)
+{
+	if ( !len ) {
+		return;
+	}
+	if ( b->len + len > b->cap ) {
+		b->cap	= (b->len + len) * 2;
+		b->data = realloc(b->data, b->cap);
+	}
+	memcpy(b->data + b->len, data, len);
+	b->len += len;
+}
+
+static void
+cpio_add(struct buf *b, const char *name, unsigned int mode,
+	unsigned int ino, unsigned int nlink, const char *data)
+{
+	char	hdr[111];
+	size_t	size = data ? strlen(data) : 0;
+
+	snprintf(hdr, sizeof(hdr), "070701%08X%08X%08X%08X%08X%08X%08X"
+		"%08X%08X%08X%08X%08X%08X", ino, mode, 0, 0, nlink,
+		1500000000, (unsigned int)size, 0, 0, 0, 0,
+		(unsigned int)strlen(name) + 1, 0);
+	append(b, hdr, 110);
+	append(b, name, strlen(name) + 1);
+	while ( b->len % 4 ) {
+		append(b, "", 1);
+	}
+	append(b, data, size);
+	while ( b->len % 4 ) {
+		append(b, "", 1);
+	}
+}
+
+static void
+put32(unsigned char *p, unsigned int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void
+add_tag(unsigned char *index, char *store, int *ntags, int *size, int tag,
+	const char *value)
+{
+	put32(index + *ntags * 16, tag);
+	put32(index + *ntags * 16 + 4, RPM_STRING_TYPE);
+	put32(index + *ntags * 16 + 8, *size);
+	put32(index + *ntags * 16 + 12, 1);
+	(*ntags)++;
+	*size += sprintf(store + *size, "%s", value) + 1;
+}
+
+/*
+ * A package with only the tags the extractor looks at.
+ */
+static void
+write_package(const char *path, const char *prefix, int script,
+	const char *compressor, struct buf *payload)
+{
+	unsigned char	lead[96] = { 0xed, 0xab, 0xee, 0xdb, 3, 0 };
+	unsigned char	intro[16] = { 0x8e, 0xad, 0xe8, 0x01 };
+	unsigned char	index[4 * 16];
+	char		store[256];
+	int		ntags = 0, size = 0;
+	FILE		*f = fopen(path, "w");
+
+	add_tag(index, store, &ntags, &size, RPMTAG_PAYLOADFORMAT, "cpio");
+	add_tag(index, store, &ntags, &size, RPMTAG_PAYLOADCOMPRESSOR, compressor);
+	if ( prefix ) {
+		add_tag(index, store, &ntags, &size, RPMTAG_PREFIXES, prefix);
+	}
+	if ( script ) {
+		add_tag(index, store, &ntags, &size, RPMTAG_POSTIN, "echo hi");
+	}
+
+	fwrite(lead, 1, sizeof(lead), f);
+	fwrite(intro, 1, sizeof(intro), f);		/* empty signature */
+	put32(intro + 8, ntags);
+	put32(intro + 12, size);
+	fwrite(intro, 1, sizeof(intro), f);
+	fwrite(index, 16, ntags, f);
+	fwrite(store, 1, size, f);
+	fwrite(payload->data, 1, payload->len, f);
+	fclose(f);
+}
+
+static void
+gzip(struct buf *in, struct buf *out)
+{
+	z_stream	z;
+
+	memset(&z, 0, sizeof(z));
+	deflateInit2(&z, 6, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY);
+	out->cap  = deflateBound(&z, in->len) + 64;
+	out->data = malloc(out->cap);
+	z.next_in   = in->data;
+	z.avail_in  = in->len;
+	z.next_out  = out->data;
+	z.avail_out = out->cap;
+	deflate(&z, Z_FINISH);
+	out->len = out->cap - z.avail_out;
+	deflateEnd(&z);
+}
+
+static void
+xz(struct buf *in, struct buf *out)
+{
+	out->cap  = lzma_stream_buffer_bound(in->len);
+	out->data = malloc(out->cap);
+	out->len  = 0;
+	lzma_easy_buffer_encode(6, LZMA_CHECK_CRC64, NULL, in->data, in->len,
+		out->data, &out->len, out->cap);
+}
+
+static void
+check_file(const char *root, const char *path, const char *data, int mode)
+{
+	char		full[1024], buf[256];
+	struct stat	st;
+	FILE		*f;
+	size_t		n = 0;
+
+	snprintf(full, sizeof(full), "%s/%s", root, path);
+	if ( lstat(full, &st) ) {
+		if ( data ) {
+			printf("FAIL %s: missing\n", path);
+			failed++;
+		}
+		return;
+	}
+	if ( !data ) {
+		printf("FAIL %s: should not exist\n", path);
+		failed++;
+		return;
+	}
+	if ( (f = fopen(full, "r")) ) {
+		n = fread(buf, 1, sizeof(buf) - 1, f);
+		fclose(f);
+	}
+	buf[n] = '\0';
+	if ( strcmp(buf, data) || (mode && (st.st_mode & 07777) != mode) ||
+		st.st_mtime != 1500000000 ) {
+		printf("FAIL %s: '%s' %o\n", path, buf, st.st_mode & 07777);
+		failed++;
+	}
+	else {
+		printf("ok   %s\n", path);
+	}
+}
+
+static void
+check_dir(const char *root, const char *path, int mode)
+{
+	char		full[1024];
+	struct stat	st;
+
+	snprintf(full, sizeof(full), "%s/%s", root, path);
+	if ( lstat(full, &st) || !S_ISDIR(st.st_mode) ||
+		(st.st_mode & 07777) != mode || st.st_mtime != 1500000000 ) {
+		printf("FAIL %s/\n", path);
+		failed++;
+	}
+	else {
+		printf("ok   %s/\n", path);
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char		dir[] = "/tmp/rpmextract_test.XXXXXX";
+	char		root[256], pkgs[7][256], cmd[512];
+	struct buf	cpio, evil, gz, x, evilgz, ro, rogz, esc, escgz;
+	RPMExtractJob	jobs[7];
+	struct stat	st1, st2;
+	int		i;
+
+	if ( !mkdtemp(dir) ) {
+		perror(dir);
+		return 1;
+	}
+
+	memset(&cpio, 0, sizeof(cpio));
+	cpio_add(&cpio, "./opt/rocks/share", 040755, 1, 2, NULL);
+	cpio_add(&cpio, "./opt/rocks/share/a.xml", 0100640, 2, 1, "<kickstart/>");
+	cpio_add(&cpio, "./opt/rocks/share/link", 0120777, 3, 1, "a.xml");
+	cpio_add(&cpio, "./opt/rocks/share/b", 0100644, 4, 2, NULL);
+	cpio_add(&cpio, "./opt/rocks/share/c", 0100644, 4, 2, "linked");
+	cpio_add(&cpio, "./etc/x.conf", 0100600, 5, 1, "x=1");
+	cpio_add(&cpio, "TRAILER!!!", 0, 0, 1, NULL);
+	gzip(&cpio, &gz);
+	xz(&cpio, &x);
+
+	memset(&evil, 0, sizeof(evil));
+	cpio_add(&evil, "./opt/../../evil", 0100644, 1, 1, "x");
+	cpio_add(&evil, "TRAILER!!!", 0, 0, 1, NULL);
+	gzip(&evil, &evilgz);
+
+	/* a read-only directory is filled in before its mode is set */
+	memset(&ro, 0, sizeof(ro));
+	cpio_add(&ro, "./srv/ro", 040555, 1, 2, NULL);
+	cpio_add(&ro, "./srv/ro/f", 0100644, 2, 1, "ro");
+	cpio_add(&ro, "TRAILER!!!", 0, 0, 1, NULL);
+	gzip(&ro, &rogz);
+
+	/* a link made by an earlier entry is not followed out of the root */
+	snprintf(cmd, sizeof(cmd), "%s/outside", dir);
+	mkdir(cmd, 0755);
+	memset(&esc, 0, sizeof(esc));
+	cpio_add(&esc, "./esc", 0120777, 1, 1, cmd);
+	cpio_add(&esc, "./esc/pwned", 0100644, 2, 1, "x");
+	cpio_add(&esc, "TRAILER!!!", 0, 0, 1, NULL);
+	gzip(&esc, &escgz);
+
+	for ( i = 0; i < 7; i++ ) {
+		snprintf(pkgs[i], sizeof(pkgs[i]), "%s/%d.rpm", dir, i);
+		jobs[i].path = pkgs[i];
+	}
+	write_package(pkgs[0], "/opt/rocks", 0, "gzip", &gz);
+	write_package(pkgs[1], NULL, 0, "xz", &x);
+	write_package(pkgs[2], NULL, 1, "xz", &x);
+	gz.len /= 2;
+	write_package(pkgs[3], NULL, 0, "gzip", &gz);
+	write_package(pkgs[4], NULL, 0, "gzip", &evilgz);
+	write_package(pkgs[5], NULL, 0, "gzip", &rogz);
+	write_package(pkgs[6], NULL, 0, "gzip", &escgz);
+
+	snprintf(root, sizeof(root), "%s/root", dir);
+	if ( RPMExtractMany(jobs, 7, root, 0) != 4 || jobs[0].status ||
+		jobs[1].status || !jobs[2].status || !jobs[3].status ||
+		!jobs[4].status || jobs[5].status || !jobs[6].status ) {
+		printf("FAIL statuses %d %d %d %d %d %d %d\n", jobs[0].status,
+			jobs[1].status, jobs[2].status, jobs[3].status,
+			jobs[4].status, jobs[5].status, jobs[6].status);
+		failed++;
+	}
+	for ( i = 0; i < 7; i++ ) {
+		printf("     %d.rpm: %s\n", i,
+			jobs[i].status ? jobs[i].error : "ok");
+	}
+
+	/* relocated, --prefix */
+	check_file(root, "share/a.xml", "<kickstart/>", 0640);
+	check_file(root, "share/link", "<kickstart/>", 0);
+	check_file(root, "share/c", "linked", 0644);
+	check_file(root, "share/b", "linked", 0644);
+
+	/* everything else, --relocate /= */
+	check_file(root, "etc/x.conf", "x=1", 0600);
+	check_file(root, "opt/rocks/share/a.xml", "<kickstart/>", 0640);
+	check_file(root, "opt/rocks/share/c", "linked", 0644);
+	check_file(dir, "evil", NULL, 0);
+	check_dir(root, "opt/rocks/share", 0755);
+	check_file(root, "srv/ro/f", "ro", 0644);
+	check_dir(root, "srv/ro", 0555);
+	check_file(dir, "outside/pwned", NULL, 0);
+
+	snprintf(cmd, sizeof(cmd), "%s/share/b", root);
+	stat(cmd, &st1);
+	snprintf(cmd, sizeof(cmd), "%s/share/c", root);
+	stat(cmd, &st2);
+	if ( st1.st_ino != st2.st_ino ) {
+		printf("FAIL share/b is not a hard link\n");
+		failed++;
+	}
+
+	snprintf(cmd, sizeof(cmd), "rm -rf %s", dir);
+	if ( system(cmd) ) {
+		failed++;
+	}
+	free(cpio.data);
+	free(evil.data);
+	free(evilgz.data);
+	free(ro.data);
+	free(rogz.data);
+	free(esc.data);
+	free(escgz.data);
+	free(gz.data);
+	free(x.data);
+	return failed ? 1 : 0;
+} /* main */
@@ -0,0 +1,411 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "../include/rpmheader.h"
+
+#define RPMLEAD_SIZE	96
+#define HEADER_MAX_TAGS	0x10000		/* sanity limits from rpmlib */
+#define HEADER_MAX_DATA	0x10000000
+
+static const unsigned char lead_magic[]	  = { 0xed, 0xab, 0xee, 0xdb };
+static const unsigned char header_magic[] = { 0x8e, 0xad, 0xe8, 0x01 };
+
+struct section {
+	unsigned char	*index;		/* 16 bytes per entry */
+	unsigned char	*store;
+	unsigned int	ntags;
+	unsigned int	size;
+};
+
+struct RPMHeader {
+	struct section	sig;
+	struct section	main;
+	long long	payload;
+};
+
+static unsigned int
+be32(const unsigned char *p)
+{
+	return ((unsigned int)p[0] << 24) | ((unsigned int)p[1] << 16) |
+		((unsigned int)p[2] << 8) | p[3];
+}
+
+static int
+read_full(int fd, void *buf, size_t len)
+{
+	char	*p = buf;
+
+	while ( len ) {
+		ssize_t	n = read(fd, p, len);
+
+		if ( n < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( n <= 0 ) {
+			if ( n == 0 ) {
+				errno = EINVAL;	/* truncated package */
+			}
+			return -1;
+		}
+		p   += n;
+		len -= n;
+	}
+	return 0;
+}
+
+/*
+ * Reads one header structure: magic, entry count, data size, the index
+ * and the data store.  Returns the number of bytes consumed.
+ */
+static long long
+read_section(int fd, struct section *s)
+{
+	unsigned char	intro[16];
+
+	if ( read_full(fd, intro, sizeof(intro)) ) {
+		return -1;
+	}
+	if ( memcmp(intro, header_magic, sizeof(header_magic)) ) {
+		errno = EINVAL;
+		return -1;
+	}
+	s->ntags = be32(intro + 8);
+	s->size	 = be32(intro + 12);
+	if ( s->ntags > HEADER_MAX_TAGS || s->size > HEADER_MAX_DATA ) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	/* one allocation for both, the store is NUL terminated */
+	s->index = malloc(s->ntags * 16 + s->size + 1);
+	if ( !s->index ) {
+		return -1;
+	}
+	s->store = s->index + s->ntags * 16;
+	if ( read_full(fd, s->index, s->ntags * 16 + s->size) ) {
+		return -1;
+	}
+	s->store[s->size] = '\0';
+	return sizeof(intro) + s->ntags * 16 + s->size;
+}
+
+
+/*
+ * Reads the headers of the package open on fd, which must be at the
+ * start of the file.  Returns NULL with errno set on failure, EINVAL
+ * if it is not a package.
+ */
+RPMHeader *
+RPMHeaderReadFd(int fd)
+{
+	RPMHeader	*h;
+	unsigned char	lead[RPMLEAD_SIZE], pad[8];
+	long long	sig, main;
+	int		padding;
+
+	if ( read_full(fd, lead, sizeof(lead)) ) {
+		return NULL;
+	}
+	if ( memcmp(lead, lead_magic, sizeof(lead_magic)) ) {
+		errno = EINVAL;
+		return NULL;
+	}
+
+	h = calloc(1, sizeof(RPMHeader));
+	if ( !h ) {
+		return NULL;
+	}
+
+	/* the signature is padded to a multiple of 8 bytes */
+	sig = read_section(fd, &h->sig);
+	if ( sig < 0 ) {
+		goto fail;
+	}
+	padding = (8 - (h->sig.size % 8)) % 8;
+	if ( padding && read_full(fd, pad, padding) ) {
+		goto fail;
+	}
+
+	main = read_section(fd, &h->main);
+	if ( main < 0 ) {
+		goto fail;
+	}
+
+	h->payload = RPMLEAD_SIZE + sig + padding + main;
+	return h;
+
+fail:
+	RPMHeaderFree(h);
+	return NULL;
+} /* RPMHeaderReadFd */
+
+
+RPMHeader *
+RPMHeaderRead(const char *path)
+{
+	RPMHeader	*h;
+	int		fd, err;
+
+	fd = open(path, O_RDONLY | O_CLOEXEC);
+	if ( fd < 0 ) {
+		return NULL;
+	}
+	h = RPMHeaderReadFd(fd);
+	err = errno;
+	close(fd);
+	errno = err;
+	return h;
+} /* RPMHeaderRead */
+
+
+void
+RPMHeaderFree(RPMHeader *h)
+{
+	if ( h ) {
+		free(h->sig.index);
+		free(h->main.index);
+		free(h);
+	}
+} /* RPMHeaderFree */
+
+
+/*
+ * Looks up a tag in the main header or the signature.  Returns 0 and
+ * fills in entry if the tag is there and its data fits in the store,
+ * -1 otherwise.
+ */
+int
+RPMHeaderGet(const RPMHeader *h, int which, int tag, RPMTagEntry *entry)
+{
+	const struct section	*s = (which == RPMHEADER_SIGNATURE) ?
+					&h->sig : &h->main;
+	unsigned int		i;
+
+	for ( i = 0; i < s->ntags; i++ ) {
+		const unsigned char	*e = s->index + i * 16;
+		unsigned int		offset, count, n;
+		size_t			size;
+
+		if ( be32(e) != (unsigned int)tag ) {
+			continue;
+		}
+		entry->tag   = tag;
+		entry->type  = be32(e + 4);
+		offset	     = be32(e + 8);
+		count	     = be32(e + 12);
+		entry->count = count;
+		if ( offset > s->size ) {
+			return -1;
+		}
+
+		switch ( entry->type ) {
+		case RPM_CHAR_TYPE:
+		case RPM_INT8_TYPE:
+		case RPM_BIN_TYPE:
+			size = count;
+			break;
+		case RPM_INT16_TYPE:
+			size = (size_t)count * 2;
+			break;
+		case RPM_INT32_TYPE:
+			size = (size_t)count * 4;
+			break;
+		case RPM_INT64_TYPE:
+			size = (size_t)count * 8;
+			break;
+		case RPM_STRING_TYPE:
+		case RPM_STRING_ARRAY_TYPE:
+		case RPM_I18NSTRING_TYPE:
+			/* every string has to end inside the store */
+			size = 0;
+			for ( n = 0; n < count; n++ ) {
+				const char	*str = (char *)s->store + offset + size;
+
+				if ( offset + size >= s->size ) {
+					return -1;
+				}
+				size += strlen(str) + 1;
+			}
+			if ( offset + size > s->size ) {
+				return -1;
+			}
+			break;
+		default:
+			size = 0;
+			break;
+		}
+		if ( size > s->size - offset ) {
+			return -1;
+		}
+		entry->data = s->store + offset;
+		entry->size = size;
+		return 0;
+	}
+	return -1;
+} /* RPMHeaderGet */
+
+
+/*
+ * The value of a string tag of the main header, the first string for
+ * arrays and i18n strings.  NULL if the tag is not there.
+ */
+const char *
+RPMHeaderString(const RPMHeader *h, int tag)
+{
+	RPMTagEntry	e;
+
+	if ( RPMHeaderGet(h, RPMHEADER_MAIN, tag, &e) || !e.count ||
+		(e.type != RPM_STRING_TYPE &&
+		e.type != RPM_STRING_ARRAY_TYPE &&
+		e.type != RPM_I18NSTRING_TYPE) ) {
+		return NULL;
+	}
+	return e.data;
+} /* RPMHeaderString */
+
+
+/*
+ * Stores up to max strings of a string array tag in strs and returns
+ * how many the tag has (0 if it is not there).
+ */
+int
+RPMHeaderStrings(const RPMHeader *h, int tag, const char **strs, int max)
+{
+	RPMTagEntry	e;
+	const char	*p;
+	int		i;
+
+	if ( RPMHeaderGet(h, RPMHEADER_MAIN, tag, &e) ||
+		(e.type != RPM_STRING_TYPE &&
+		e.type != RPM_STRING_ARRAY_TYPE &&
+		e.type != RPM_I18NSTRING_TYPE) ) {
+		return 0;
+	}
+	for ( i = 0, p = e.data; i < e.count && i < max; i++ ) {
+		strs[i] = p;
+		p += strlen(p) + 1;
+	}
+	return e.count;
+} /* RPMHeaderStrings */
+
+
+/*
+ * The first value of an integer tag of the main header, or missing.
+ */
+long long
+RPMHeaderInt(const RPMHeader *h, int tag, long long missing)
+{
+	RPMTagEntry		e;
+	const unsigned char	*p;
+
+	if ( RPMHeaderGet(h, RPMHEADER_MAIN, tag, &e) || !e.count ) {
+		return missing;
+	}
+	p = e.data;
+	switch ( e.type ) {
+	case RPM_CHAR_TYPE:
+	case RPM_INT8_TYPE:
+		return p[0];
+	case RPM_INT16_TYPE:
+		return (p[0] << 8) | p[1];
+	case RPM_INT32_TYPE:
+		return be32(p);
+	case RPM_INT64_TYPE:
+		return ((long long)be32(p) << 32) | be32(p + 4);
+	}
+	return missing;
+} /* RPMHeaderInt */
+
+
+/*
+ * The %{sigmd5} of the package in hex.  Returns -1 if it has none.
+ */
+int
+RPMHeaderSigMD5(const RPMHeader *h, char hex[33])
+{
+	static const char	digits[] = "0123456789abcdef";
+	RPMTagEntry		e;
+	const unsigned char	*p;
+	int			i;
+
+	if ( (RPMHeaderGet(h, RPMHEADER_MAIN, RPMTAG_SIGMD5, &e) &&
+		RPMHeaderGet(h, RPMHEADER_SIGNATURE, RPMSIGTAG_MD5, &e)) ||
+		e.type != RPM_BIN_TYPE || e.count != 16 ) {
+		return -1;
+	}
+	for ( i = 0, p = e.data; i < 16; i++ ) {
+		hex[i * 2]     = digits[p[i] >> 4];
+		hex[i * 2 + 1] = digits[p[i] & 0xf];
+	}
+	hex[32] = '\0';
+	return 0;
+} /* RPMHeaderSigMD5 */
+
+
+/*
+ * File offset of the (compressed) cpio payload.
+ */
+long long
+RPMHeaderPayloadOffset(const RPMHeader *h)
+{
+	return h->payload;
+} /* RPMHeaderPayloadOffset */
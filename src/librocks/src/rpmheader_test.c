@@ -0,0 +1,271 @@
+/* $Id$
+ *
+ * @Copyright@
+ * 
+ * 				Rocks(r)
+ * 		         www.rocksclusters.org
+ * 		         version 6.2 (SideWinder)
+ * 		         version 7.0 (Manzanita)
+ * 
+ * Copyright (c) 2000 - 2017 The Regents of the University of California.
+ * All rights reserved.	
+ * 
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ * 
+ * 1. Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ * 
+ * 2. Redistributions in binary form must reproduce the above copyright
+ * notice unmodified and in its entirety, this list of conditions and the
+ * following disclaimer in the documentation and/or other materials provided 
+ * with the distribution.
+ * 
+ * 3. All advertising and press materials, printed or electronic, mentioning
+ * features or use of this software must display the following acknowledgement: 
+ * 
+ * 	"This product includes software developed by the Rocks(r)
+ * 	Cluster Group at the San Diego Supercomputer Center at the
+ * 	University of California, San Diego and its contributors."
+ * 
+ * 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+ * neither the name or logo of this software nor the names of its
+ * authors may be used to endorse or promote products derived from this
+ * software without specific prior written permission.  The name of the
+ * software includes the following terms, and any derivatives thereof:
+ * "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+ * the associated name, interested parties should contact Technology 
+ * Transfer & Intellectual Property Services, University of California, 
+ * San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+ * Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+ * 
+ * THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+ * PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+ * BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+ * BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+ * OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+ * IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ * 
+ * @Copyright@
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "../include/rpmheader.h"
+
+static int failed;
+
+/*
+ * Builds header structures the way rpmbuild lays them out, enough to
+ * write test packages.
+ */
+struct hdrbuf {
+	unsigned char	index[64 * 16];
+	unsigned char	store[4096];
+	int		ntags;
+	int		size;
+};
+
+static void
+put32(unsigned char *p, unsigned int v)
+{
+	p[0] = v >> 24;
+	p[1] = v >> 16;
+	p[2] = v >> 8;
+	p[3] = v;
+}
+
+static void
+add_tag(struct hdrbuf *h, int tag, int type, int count, const void *data,
+	int size)
+{
+	unsigned char	*e = h->index + h->ntags++ * 16;
+
+	if ( type == RPM_INT32_TYPE ) {
+		while ( h->size % 4 ) {
+			h->store[h->size++] = 0;
+		}
+	}
+	put32(e, tag);
+	put32(e + 4, type);
+	put32(e + 8, h->size);
+	put32(e + 12, count);
+	memcpy(h->store + h->size, data, size);
+	h->size += size;
+}
+
+static void
+add_string(struct hdrbuf *h, int tag, const char *s)
+{
+	add_tag(h, tag, RPM_STRING_TYPE, 1, s, strlen(s) + 1);
+}
+
+static void
+add_int32(struct hdrbuf *h, int tag, unsigned int v)
+{
+	unsigned char	b[4];
+
+	put32(b, v);
+	add_tag(h, tag, RPM_INT32_TYPE, 1, b, 4);
+}
+
+static void
+write_section(FILE *f, struct hdrbuf *h, int pad)
+{
+	unsigned char	intro[16] = { 0x8e, 0xad, 0xe8, 0x01 };
+
+	put32(intro + 8, h->ntags);
+	put32(intro + 12, h->size);
+	fwrite(intro, 1, 16, f);
+	fwrite(h->index, 16, h->ntags, f);
+	fwrite(h->store, 1, h->size, f);
+	while ( pad && h->size++ % 8 ) {
+		fputc(0, f);
+	}
+}
+
+static void
+write_package(const char *path, int relocatable, int corrupt)
+{
+	static const unsigned char	md5[16] = {
+		0x01, 0x23, 0x45, 0x67, 0x89, 0xab, 0xcd, 0xef,
+		0xfe, 0xdc, 0xba, 0x98, 0x76, 0x54, 0x32, 0x10 };
+	unsigned char	lead[96] = { 0xed, 0xab, 0xee, 0xdb, 3, 0 };
+	struct hdrbuf	sig, main;
+	FILE		*f = fopen(path, "w");
+
+	memset(&sig, 0, sizeof(sig));
+	memset(&main, 0, sizeof(main));
+
+	add_int32(&sig, RPMSIGTAG_SIZE, 1234);
+	add_tag(&sig, RPMSIGTAG_MD5, RPM_BIN_TYPE, 16, md5, 16);
+	add_string(&sig, 1999, "odd");		/* forces padding */
+
+	add_string(&main, RPMTAG_NAME, "rocks-pylib");
+	add_string(&main, RPMTAG_VERSION, "7.0");
+	add_string(&main, RPMTAG_RELEASE, "1.el7");
+	add_tag(&main, RPMTAG_SUMMARY, RPM_I18NSTRING_TYPE, 1,
+		"Rocks python library", 21);
+	add_int32(&main, RPMTAG_BUILDTIME, 1500000000);
+	add_string(&main, RPMTAG_BUILDHOST, "frontend.local");
+	add_string(&main, RPMTAG_ARCH, "x86_64");
+	if ( relocatable ) {
+		add_tag(&main, RPMTAG_PREFIXES, RPM_STRING_ARRAY_TYPE, 2,
+			"/opt/rocks\0/etc", 16);
+	}
+	add_string(&main, RPMTAG_PAYLOADFORMAT, "cpio");
+	if ( corrupt ) {
+		/* a string running off the end of the store */
+		add_tag(&main, RPMTAG_PAYLOADCOMPRESSOR, RPM_STRING_TYPE, 1,
+			"xz", 2);
+	}
+	else {
+		add_string(&main, RPMTAG_PAYLOADCOMPRESSOR, "xz");
+	}
+
+	fwrite(lead, 1, sizeof(lead), f);
+	write_section(f, &sig, 1);
+	write_section(f, &main, 0);
+	fputs("PAYLOAD", f);
+	fclose(f);
+}
+
+static void
+check_string(RPMHeader *h, int tag, const char *value)
+{
+	const char	*s = RPMHeaderString(h, tag);
+
+	if ( (s == NULL) != (value == NULL) || (s && strcmp(s, value)) ) {
+		printf("FAIL tag %d = %s\n", tag, s ? s : "NULL");
+		failed++;
+	}
+	else {
+		printf("ok   tag %d = %s\n", tag, s ? s : "NULL");
+	}
+}
+
+int
+main(int argc, char *argv[])
+{
+	char		path[] = "/tmp/rpmheader_test.XXXXXX";
+	const char	*prefixes[4];
+	char		md5[33];
+	RPMHeader	*h;
+	FILE		*f;
+	int		fd;
+
+	fd = mkstemp(path);
+	if ( fd < 0 ) {
+		perror(path);
+		return 1;
+	}
+	close(fd);
+
+	write_package(path, 1, 0);
+	h = RPMHeaderRead(path);
+	if ( !h ) {
+		perror(path);
+		return 1;
+	}
+	check_string(h, RPMTAG_NAME, "rocks-pylib");
+	check_string(h, RPMTAG_VERSION, "7.0");
+	check_string(h, RPMTAG_RELEASE, "1.el7");
+	check_string(h, RPMTAG_SUMMARY, "Rocks python library");
+	check_string(h, RPMTAG_BUILDHOST, "frontend.local");
+	check_string(h, RPMTAG_ARCH, "x86_64");
+	check_string(h, RPMTAG_PAYLOADCOMPRESSOR, "xz");
+	check_string(h, RPMTAG_SOURCERPM, NULL);
+	if ( RPMHeaderInt(h, RPMTAG_BUILDTIME, -1) != 1500000000 ||
+		RPMHeaderInt(h, RPMTAG_EPOCH, -1) != -1 ) {
+		printf("FAIL integer tags\n");
+		failed++;
+	}
+	if ( RPMHeaderStrings(h, RPMTAG_PREFIXES, prefixes, 4) != 2 ||
+		strcmp(prefixes[0], "/opt/rocks") ||
+		strcmp(prefixes[1], "/etc") ) {
+		printf("FAIL prefixes\n");
+		failed++;
+	}
+	if ( RPMHeaderSigMD5(h, md5) ||
+		strcmp(md5, "0123456789abcdeffedcba9876543210") ) {
+		printf("FAIL sigmd5\n");
+		failed++;
+	}
+
+	/* the payload follows the header */
+	f = fopen(path, "r");
+	if ( !f || fseek(f, RPMHeaderPayloadOffset(h), SEEK_SET) ||
+		fgetc(f) != 'P' ) {
+		printf("FAIL payload offset %lld\n", RPMHeaderPayloadOffset(h));
+		failed++;
+	}
+	if ( f ) {
+		fclose(f);
+	}
+	RPMHeaderFree(h);
+
+	write_package(path, 0, 1);
+	h = RPMHeaderRead(path);
+	if ( !h || RPMHeaderStrings(h, RPMTAG_PREFIXES, prefixes, 4) ||
+		RPMHeaderString(h, RPMTAG_PAYLOADCOMPRESSOR) ) {
+		printf("FAIL unterminated string or prefixes\n");
+		failed++;
+	}
+	RPMHeaderFree(h);
+
+	if ( RPMHeaderRead("/etc/passwd") || RPMHeaderRead("/nonexistent") ) {
+		printf("FAIL read a non package\n");
+		failed++;
+	}
+
+	unlink(path);
+	return failed ? 1 : 0;
+} /* main */
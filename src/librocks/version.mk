@@ -1,3 +1,4 @@
 NAME = librocks
 RELEASE = 0
 RPM.FILES="/opt/rocks/include/rocks\\n/opt/rocks/lib/*"
+RPM.SCRIPTLETS.FILE = scriptlets
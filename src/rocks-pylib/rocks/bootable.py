@@ -247,8 +247,8 @@ class Bootable:
 		dbdir = os.path.join(root, 'var', 'lib', 'rpm')
 
 		os.makedirs(os.path.join(root, dbdir))
-		reloc = os.system("rpm -q --queryformat '%{prefixes}\n' -p " +
-			rpm.getFullName() + "| grep none > /dev/null")
+		header = rpm.getHeader()
+		reloc = not header or header['prefixes']
 
 		cmd = 'rpm -i --nomd5 --force --nodeps --ignorearch ' + \
 			'--dbpath %s ' % (dbdir)
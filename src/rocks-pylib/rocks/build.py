@@ -893,6 +893,11 @@ import rocks.file
 import rocks.util
 import rocks
 
+try:
+	import _librocks
+except ImportError:
+	_librocks = None
+
 
 class BuildError(Exception):
 	pass
@@ -1283,6 +1288,7 @@ class DistributionBuilder(Builder):
 
 	build   = self.dist.getBuildPath()
 
+	rolls = []
 	for rpm in self.dist.getRPMS():
 		tok = rpm.getBaseName().split('-')
 		if tok[0] != 'roll':
@@ -1292,8 +1298,35 @@ class DistributionBuilder(Builder):
 			rollname = '-'.join(tok[1:k])
 		except ValueError:
 			continue
-			
+		rolls.append((rollname, self.getApplyRPM(rpm.getBaseName())))
+
+	# Unpack all the profile packages at once, one worker per CPU.
+	# Anything librocks cannot do (e.g. packages with scripts) is
+	# installed with rpm.
+
+	# Several rolls can share a package, each one is only unpacked
+	# once.  Like applyRPM nothing under var is kept.
+
+	rpms = []
+	for (rollname, rpm) in rolls:
+		if rpm.getFullName() not in rpms:
+			rpms.append(rpm.getFullName())
+
+	errors = {}
+	if _librocks and rpms:
+		errors = dict(zip(rpms, _librocks.rpmextract(rpms, build)))
+		if os.path.isdir(os.path.join(build, 'var')):
+			shutil.rmtree(os.path.join(build, 'var'))
+
+	for (rollname, rpm) in rolls:
 		print '    installing "%s" profiles...' % rollname
+		error = errors.get(rpm.getFullName(), 'no librocks')
+		if not error:
+			continue
+		errors[rpm.getFullName()] = None
+		if self.debug > 0:
+			sys.stderr.write('build.buildKickstart: %s: %s\n' %
+				(rpm.getFullName(), error))
 		self.applyRPM(rpm.getBaseName(), build)
 
 	# Copy local profiles into the distribution.
@@ -1311,13 +1344,11 @@ class DistributionBuilder(Builder):
 				file.chmod(0664)
 
 
-    def applyRPM(self, name, root, flags=''):
-        """Used to 'patch' the new distribution with RPMs from the
-        distribution.  We use this to always get the correct
-        genhdlist, and to apply eKV to Rocks distributions.
-        
-        Throws a ValueError if it cannot find the specified RPM, and
-        BuildError if the RPM was found but could not be installed."""
+    def getApplyRPM(self, name):
+        """Returns the RPM applyRPM installs for name, the one for
+        the distribution architecture if there are several.
+
+        Throws a ValueError if it cannot find the specified RPM."""
 
 	rpm = None
 	try:
@@ -1331,12 +1362,28 @@ class DistributionBuilder(Builder):
         if not rpm:
             raise ValueError, "could not find %s" % name
 
+        return rpm
+
+
+    def applyRPM(self, name, root, flags=''):
+        """Used to 'patch' the new distribution with RPMs from the
+        distribution.  We use this to always get the correct
+        genhdlist, and to apply eKV to Rocks distributions.
+        
+        Throws a ValueError if it cannot find the specified RPM, and
+        BuildError if the RPM was found but could not be installed."""
+
+        rpm = self.getApplyRPM(name)
+
         dbdir = os.path.join(root, 'var', 'lib', 'rpm')
         if not os.path.isdir(dbdir):
             os.makedirs(dbdir)
 
-        reloc = subprocess.call("rpm -q --queryformat '%{prefixes}\n' -p " +
-                        rpm.getFullName() + "| grep none > /dev/null", shell=True)
+        # Relocatable packages (ones with prefixes) get --prefix,
+        # unreadable ones are treated the same way rpm -q | grep did.
+
+        header = rpm.getHeader()
+        reloc = not header or header['prefixes']
 
 	cmd = 'rpm -i --ignoresize --nomd5 --force --nodeps --ignorearch '
 	cmd += '--dbpath %s ' % dbdir
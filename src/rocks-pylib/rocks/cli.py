@@ -0,0 +1,198 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+The rocks command line.  This is what bin/rocks runs, as a library so
+that rocksd (see :mod:`rocks.rocksd`) can run commands the same way
+without starting a new python every time.
+"""
+
+import os
+import sys
+import string
+import rocks	# need this so we can load the rocks.commands.* modules
+import rocks.util
+import rocks.trace
+import rocks.registry
+
+# returned by run() in a daemon for a command the client has to run itself
+FALLBACK = None
+
+
+def connect():
+	"""
+	Returns a :class:`rocks.db.helper.DatabaseHelper` that connects to
+	the database when a command first uses it, or None without the
+	database modules.
+
+	Several Commands are run in the installation environment before the
+	cluster database is created.  To enable this a connection that
+	fails is not considered an error, the helper just has no connection.
+	"""
+	try:
+		import rocks.db.helper
+	except ImportError:
+		return None
+
+	database = rocks.db.helper.DatabaseHelper()
+	database.connect(lazy=True)
+	return database
+
+
+def lookup(args):
+	"""
+	Returns the (module, name, i) of the command in args, where args[i:]
+	are its arguments, or None if args is not a rocks command.
+
+	The command registry usually knows.  If it does not the command
+	may have been quoted ("rocks 'list host'"), otherwise we treat the
+	entire command line as if it were a python command module and keep
+	popping arguments off the end until we get a match.
+	"""
+	found = rocks.registry.lookup(args)
+	if found:
+		(s, i) = found
+		try:
+			__import__(s)
+			return (sys.modules[s], s, i)
+		except ImportError:
+			pass
+
+	cmd = args[0].split()
+	if len(cmd) > 1:
+		s = 'rocks.commands.%s' % string.join(cmd, '.')
+		try:
+			__import__(s)
+			return (sys.modules[s], s, 1)
+		except:
+			pass
+
+	for i in range(len(args), 0, -1):
+		s = 'rocks.commands.%s' % string.join(args[:i], '.')
+		try:
+			__import__(s)
+		except ImportError:
+			continue
+		module = sys.modules.get(s)
+		if module:
+			return (module, s, i)
+	return None
+
+
+def run(database, argv, daemon=False):
+	"""
+	Runs the rocks command line argv (without the "rocks") and returns
+	the exit status.
+
+	In a daemon (rocksd) commands that would have to go through sudo
+	are not run and FALLBACK is returned instead, the client runs them
+	the classic way.
+	"""
+
+	# If the command line is empty treat as if the user typed "rocks help"
+
+	if not argv:
+		args = [ 'list', 'help' ]
+	else:
+		args = argv
+
+	found = lookup(args)
+	if not found:
+		print 'error - invalid rocks command "%s"' % args[0]
+		return -1
+	(module, s, i) = found
+
+	name = string.join(string.split(s, '.')[2:], ' ')
+
+	# If we can load the command object then fall through and invoke
+	# the run() method.  Otherwise the user did not give a complete
+	# command line and we call the help command based on the partial
+	# command given.
+
+	try:	
+		command = getattr(module, 'Command')(database)
+	except AttributeError:
+		from rocks.commands.list.help import Command as Help
+		help = Help(database)
+		fullmodpath = s.split('.')
+		submodpath  = string.join(fullmodpath[2:], '/')
+		help.run({'subdir': submodpath}, [])
+		print help.getText()
+		return -1
+	rocks.trace.mark('lookup')
+
+	if command.MustBeRoot and \
+		not (command.isRootUser() or command.isApacheUser()):
+		if daemon:
+			return FALLBACK
+		os.system('sudo %s' % string.join(sys.argv,' '))
+		return 0
+
+	try:
+		command.stream = sys.stdout
+		command.runWrapper(name, args[i:])
+		rocks.trace.mark('run')
+		text = command.getText()
+		if len(text) > 0:
+			print text,
+			if text[len(text)-1] != '\n':
+				print
+	except rocks.util.CommandError, e:
+		print "Error:", e
+		print command.usage()
+		return 1
+	rocks.trace.mark('output')
+	return 0
@@ -508,10 +508,14 @@ import pwd
 import types
 import sys
 import sqlalchemy.engine.result
+import threading
 import traceback
 
 import rocks
+import rocks.db.audit
 import rocks.graph
+import rocks.perf
+import rocks.registry
 import xml
 from xml.sax import saxutils
 from xml.sax import handler
@@ -569,7 +573,7 @@ class MembershipArgumentProcessor:
 			args = [ '%' ] # find all memberships
 		for arg in args:
 			rows = self.db.execute("""select name from memberships 
-				where name like '%s'""" % arg)
+				where name like %s""", (arg, ))
 			if rows == 0 and arg == '%': # empty table is OK
 				continue
 			if rows < 1:
@@ -596,7 +600,7 @@ class DistributionArgumentProcessor:
 
 		for arg in args:
 			rows = self.db.execute("""select name from
-				distributions where name like '%s'""" % arg)
+				distributions where name like %s""", (arg, ))
 			if rows == 0 and arg == '%': # empty table is OK
 				continue
 			if rows < 1:
@@ -629,7 +633,7 @@ class NetworkArgumentProcessor:
 			args = [ '%' ] # find all networks
 		for arg in args:
 			rows = self.db.execute("""select name from subnets
-				where name like '%s'""" % arg)
+				where name like %s""", (arg, ))
 			if rows == 0 and arg == '%': # empty table is OK
 				continue
 			if rows < 1:
@@ -646,7 +650,7 @@ class NetworkArgumentProcessor:
 			return ''
 
 		rows = self.db.execute("""select name from subnets where
-			id = %s""" % netid)
+			id = %s""", (netid, ))
 
 		if rows > 0:
 			netname, = self.db.fetchone()
@@ -679,8 +683,8 @@ class RollArgumentProcessor:
 			args = [ '%' ] # find all roll names
 		for arg in args:
 			rows = self.db.execute("""select distinct name,version
-				from rolls where name like '%s' and 
-				version like '%s'""" % (arg, version))
+				from rolls where name like %s and 
+				version like %s""", (arg, version))
 			if rows == 0 and arg == '%': # empty table is OK
 				continue
 			if rows < 1:
@@ -729,10 +733,10 @@ class HostArgumentProcessor:
 			# If we're looking for managed nodes only, filter out
 			# the unmanaged ones using host attributes
 			if managed_only:
+				attrs = self.db.database.getHostsAttrs(list)
 				managed_list = []
 				for hostname in list:
-					if self.db.getHostAttr(hostname, 
-						'managed') == 'true':
+					if attrs[hostname].get('managed') == 'true':
 						managed_list.append(hostname)
 				return managed_list
 			return list
@@ -747,24 +751,20 @@ class HostArgumentProcessor:
 		self.db.execute('select min(rack), max(rack) from nodes')
 		min,max = self.db.fetchone()
 		for i in range(min, max+1): # racks
-			self.db.execute("""select n.name from 
-				nodes n, memberships m, appliances a where
-				n.membership=m.id and m.appliance=a.id and
-				a.name!="frontend" and n.rack=%d""" % i)
-			l = []
-			for node, in self.db.fetchall():
-				l.append(node)
-			groups['rack%d' % i] = l
+			groups['rack%d' % i] = []
+		appliances = {}
 		self.db.execute('select name from appliances')
 		for name, in self.db.fetchall(): # appliances
-			self.db.execute("""select n.name from 
-				nodes n, memberships m, appliances a where
-				n.membership=m.id and m.appliance=a.id and
-				a.name="%s" """ % name)
-			l = []
-			for node, in self.db.fetchall():
-				l.append(node)
-			groups[name] = l
+			appliances[name] = []
+		self.db.execute("""select n.name, n.rack, a.name from 
+			nodes n, memberships m, appliances a where
+			n.membership=m.id and m.appliance=a.id""")
+		for (node, rack, appliance) in self.db.fetchall():
+			rack = 'rack%s' % rack
+			if appliance != 'frontend' and groups.has_key(rack):
+				groups[rack].append(node)
+			appliances[appliance].append(node)
+		groups.update(appliances)
 		
 		# Iterate through the list and expand all names to a list of
 		# host names.  Also handle any names that start with 'select'
@@ -783,7 +783,7 @@ class HostArgumentProcessor:
 					dict[host] = 1
 			elif name.find('%') >= 0:	# SQL % pattern
 				self.db.execute("""select name from nodes where
-					name like '%s'""" % name)
+					name like %s""", (name, ))
 				for h, in self.db.fetchall():
 					dict[h] = 1
 			elif groups.has_key(name):	# group name
@@ -835,7 +835,7 @@ class CategoryArgumentProcessor(HostArgumentProcessor):
 			self.abort('Cannot have a Null index for category:%s' % category)
 		# Check of category is valid
 		rows = self.db.execute("""SELECT ID FROM categories 
-				WHERE name='%s'""" % category)
+				WHERE name=%s""", (category, ))
 		if rows < 1:
 			self.abort('unknown category "%s"' % category)
 
@@ -850,14 +850,14 @@ class CategoryArgumentProcessor(HostArgumentProcessor):
 				print "checking for host" ,index
 
 				rows = self.db.execute("""SELECT ID FROM vcatindex 
-				WHERE catindex='%s' and category='%s'""" % (index,category))
+				WHERE catindex=%s and category=%s""", (index,category))
 				if rows < 1:
 					self.abort('Unknown index "%s" of category "%s"' % (index,category))
 				indexList.append((category,index))
 
 		else:
 			rows = self.db.execute("""SELECT ID FROM vcatindex 
-				WHERE catindex='%s' and category='%s'""" % (index,category))
+				WHERE catindex=%s and category=%s""", (index,category))
 			if rows < 1:
 				self.abort('Unknown index "%s" of category "%s"' % (index,category))
 			indexList.append((category,index))
@@ -1167,14 +1167,27 @@ class DatabaseConnection:
 				is assumed.  All methods that use this
 				also also the value to be passed as an
 				argument.
+
+	ROCKS_QUERY_AUDIT	- If defined the SQL statements are
+				counted per command and the ones
+				repeated most (N+1 queries) are
+				reported when the command is done,
+				see rocks.db.audit.
+
+	ROCKS_SNAPSHOT		- The local snapshot of the database the
+				read-only commands use, a path or "no",
+				see rocks.db.snapshot.
 	"""
 	
 	def __init__(self, db):
 		# self.database : is a rocks.db.database.Database object
 		self.database = db
 		
-	def execute(self, command):
-		return self.database.execute(command)
+	def execute(self, command, params=None):
+		return self.database.execute(command, params)
+
+	def executemany(self, command, paramsList):
+		return self.database.executemany(command, paramsList)
 
 	def fetchone(self):
 		return self.database.fetchone()
@@ -1190,21 +1203,33 @@ class DatabaseConnection:
 
 		host = self.getHostname(host)
 		routes = {}
+
+		# A route with a subnet goes through the device of the
+		# host on that subnet, looked up once per subnet.
+		devices = {}
+		def gateway(subnet, g):
+			if not subnet:
+				return g
+			if not devices.has_key(subnet):
+				rows = self.execute("""select net.device from
+					subnets s, networks net, nodes n where
+					s.id = %s and s.id = net.subnet and
+					net.node = n.id and n.name = %s
+					and net.device not like 'vlan%%' """,
+					(subnet, host))
+				if rows == 1:
+					devices[subnet], = self.fetchone()
+				else:
+					devices[subnet] = None
+			if devices[subnet] is None:
+				return g
+			return devices[subnet]
 		
 		# global
 		self.execute("""select network, netmask, gateway, subnet from
 			global_routes""")
 		for (n, m, g, s) in self.fetchall():
-			if s:
-				rows = self.execute("""select net.device from
-					subnets s, networks net, nodes n where
-					s.id = %s and s.id = net.subnet and
-					net.node = n.id and n.name = '%s'
-					and net.device not like 'vlan%%' """
-					% (s, host))
-				if rows == 1:
-					g, = self.fetchone()
-			
+			g = gateway(s, g)
 			if showsource:
 				routes[n] = (m, g, 'G')
 			else:
@@ -1213,18 +1238,9 @@ class DatabaseConnection:
 		# os
 		self.execute("""select r.network, r.netmask, r.gateway,
 			r.subnet from os_routes r, nodes n where
-			r.os=n.os and n.name='%s'"""  % host)
+			r.os=n.os and n.name=%s""", (host, ))
 		for (n, m, g, s) in self.fetchall():
-			if s:
-				rows = self.execute("""select net.device from
-					subnets s, networks net, nodes n where
-					s.id = %s and s.id = net.subnet and
-					net.node = n.id and n.name = '%s' 
-					and net.device not like 'vlan%%' """
-					% (s, host))
-				if rows == 1:
-					g, = self.fetchone()
-
+			g = gateway(s, g)
 			if showsource:
 				routes[n] = (m, g, 'O')
 			else:
@@ -1238,18 +1254,9 @@ class DatabaseConnection:
 			memberships m,
 			appliances app where
 			n.membership=m.id and m.appliance=app.id and 
-			r.appliance=app.id and n.name='%s'""" % host)
+			r.appliance=app.id and n.name=%s""", (host, ))
 		for (n, m, g, s) in self.fetchall():
-			if s:
-				rows = self.execute("""select net.device from
-					subnets s, networks net, nodes n where
-					s.id = %s and s.id = net.subnet and
-					net.node = n.id and n.name = '%s' 
-					and net.device not like 'vlan%%' """
-					% (s, host))
-				if rows == 1:
-					g, = self.fetchone()
-
+			g = gateway(s, g)
 			if showsource:
 				routes[n] = (m, g, 'A')
 			else:
@@ -1258,18 +1265,9 @@ class DatabaseConnection:
 		# host				
 		self.execute("""select r.network, r.netmask, r.gateway,
 			r.subnet from node_routes r, nodes n where
-			n.name='%s' and n.id=r.node""" % host)
+			n.name=%s and n.id=r.node""", (host, ))
 		for (n, m, g, s) in self.fetchall():
-			if s:
-				rows = self.execute("""select net.device from
-					subnets s, networks net, nodes n where
-					s.id = %s and s.id = net.subnet and
-					net.node = n.id and n.name = '%s'
-					and net.device not like 'vlan%%' """
-					% (s, host))
-				if rows == 1:
-					g, = self.fetchone()
-
+			g = gateway(s, g)
 			if showsource:
 				routes[n] = (m, g, 'H')
 			else:
@@ -1366,6 +1364,22 @@ class Command:
 
 	MustBeRoot = 1
 
+	# How many plugins runPlugins may run at once, plugins that do
+	# not require or precede each other run in parallel.  The
+	# ROCKS_PLUGIN_THREADS environment variable overrides it.
+	PluginThreads = 1
+
+	# Set Pure = 1 for commands that only read the database, so
+	# their output depends on nothing but the arguments and the
+	# database.  Command.command() then runs them once per set of
+	# arguments until the next write (see rocks.db.database).
+	Pure = 0
+
+	# Set ReadOnly = 1 for commands that never write to the database
+	# (list, report and dump do), they read the local snapshot of
+	# the database when there is one (see rocks.db.snapshot).
+	ReadOnly = 0
+
 	def __init__(self, database):
 		"""Creates a DatabaseConnection for the RocksCommand to use.
 		This is called for all commands, including those that do not
@@ -1394,6 +1408,24 @@ class Command:
 
 		self.json = False
 
+		# With output-format=tsv (or stream=yes) the rows of
+		# addOutput are written as they come, to the stream when
+		# the command runs from the command line (see rocks.cli)
+		# and to the text otherwise.
+		self.tsv = False
+		self.stream = None
+		self.outputHeader = None
+		self.outputRows = 0
+
+		# json=stream writes one JSON object per owner as soon as
+		# the rows of the next owner start, see addGroupRow
+		self.jsonStream = False
+		self.jsonGroup = []
+
+		# see loadPlugins and runPlugins
+		self._plugins = None
+		self._pluginThread = None
+
 
 	def debug(self):
 		"""return true if we are in debug mode"""
@@ -1535,35 +1567,80 @@ class Command:
 		mod = eval(modpath)
 
 		try:
-			o = getattr(mod, 'Command')(self.newdb)
+			cls = getattr(mod, 'Command')
 			name = string.join(string.split(command, '.'), ' ')
 		except AttributeError:
 			return ''
 
-		# flash to the DB and expire any ORM object to avoid reading 
-		# cached values in future DB query
-		self.newdb.commit()
-
-		o.runWrapper(name, args)
-		return o.getText()
+		# the sub-command runs in the same transaction, its SQL
+		# has to see what is still pending in the session
+		self.newdb.flush()
+
+		# Pure commands give the same text for the same arguments
+		# until something is written to the database.
+		key = (command, tuple(args))
+		profile = rocks.perf.active()
+		if profile:
+			entry = profile.enter(string.join([ name ] + list(args)))
+		if cls.Pure and key in self.newdb.memo:
+			if profile:
+				profile.leave(entry, memoized=True)
+			return self.newdb.memo[key]
+
+		o = cls(self.newdb)
+		try:
+			o.runWrapper(name, args)
+		finally:
+			if profile:
+				profile.leave(entry)
+		text = o.getText()
+		if cls.Pure:
+			self.newdb.memo[key] = text
+		return text
 
 
 	def loadPlugins(self):
+		"""Returns the plugins of the command in the order they
+		run.  The order is kept in the plugin manifest (see
+		rocks.registry) as long as the plugin files do not change,
+		and the plugins are made once per command object."""
+
+		if getattr(self, '_plugins', None) is not None:
+			return self._plugins
+
+		dir   = eval('%s.__path__[0]' % self.__module__)
+		files = rocks.registry.pluginFiles(dir)
+		order = rocks.registry.pluginOrder(self.__module__, files)
+		if order is None:
+			(list, order) = self.sortPlugins(files)
+			rocks.registry.savePluginOrder(self.__module__, files,
+				order)
+		else:
+			list = []
+			for module in order:
+				__import__(module)
+				list.append(sys.modules[module].Plugin(self))
+
+		self._plugins = list
+		return list
+
+
+	def sortPlugins(self, files):
+		"""Makes the plugins in files and sorts them by their
+		requires() and precedes().  Returns the plugins and the
+		names of their modules."""
+
 		dict	= {}
 		graph	= rocks.graph.Graph()
 		
-		dir = eval('%s.__path__[0]' % self.__module__)
-		for file in os.listdir(dir):
-			if file.split('_')[0] != 'plugin':
-				continue
-			if os.path.splitext(file)[1] != '.py':
-				continue
+		names = files.keys()
+		names.sort()
+		for file in names:
 			module = '%s.%s' % (self.__module__,
 				os.path.splitext(file)[0])
 			__import__(module)
-			module = eval(module)
 			try:
-				o = getattr(module, 'Plugin')(self)
+				o = getattr(sys.modules[module], 'Plugin')(self)
 			except AttributeError:
 				continue
 			
@@ -1575,7 +1652,7 @@ class Command:
 				plugin = graph.getNode(o.provides())
 			else:
 				plugin = rocks.graph.Node(o.provides())
-			dict[plugin] = o
+			dict[plugin] = (o, module)
 
 			if graph.hasNode('TAIL'):
 				tail = graph.getNode('TAIL')
@@ -1597,21 +1674,46 @@ class Command:
 					head = rocks.graph.Node(req)
 				graph.addEdge(rocks.graph.Edge(head, plugin))
 			
-		list = []
+		list  = []
+		order = []
 		for node in PluginOrderIterator(graph).run():
 			if dict.has_key(node):
-				list.append(dict[node])
-		return list
+				list.append(dict[node][0])
+				order.append(dict[node][1])
+		return (list, order)
 
 		
 	def runPlugins(self, args='', plugins=None):
 		if not plugins:
 			plugins = self.loadPlugins()
+
+		threads = self.PluginThreads
+		if os.environ.has_key('ROCKS_PLUGIN_THREADS'):
+			try:
+				threads = int(os.environ['ROCKS_PLUGIN_THREADS'])
+			except ValueError:
+				pass
+		# the plugin threads share the connection and transaction
+		# of the command, plugins of a plugin run one after the other
+		if self.newdb is not None and self.newdb.sharing():
+			threads = 1
+		if threads > 1 and len(plugins) > 1:
+			PluginScheduler(self, plugins, threads).run(args)
+			return
+
 		for plugin in plugins:
                         syslog.syslog(syslog.LOG_INFO, 'run %s' % plugin)
 			plugin.run(args)
 
 
+	def pluginBuffer(self):
+		"""Returns the list the output of the plugin running in
+		this thread goes to (see PluginScheduler), or None."""
+		if not getattr(self, '_pluginThread', None):
+			return None
+		return getattr(self._pluginThread, 'buffer', None)
+
+
 	def isRootUser(self):
 		"""Returns TRUE if running as the root account."""
 		if os.geteuid() == 0:
@@ -1668,20 +1770,38 @@ class Command:
 	def addText(self, s):
 		"""Append a string to the output text buffer."""
 		if s:
-			self.text += s
+			buffer = self.pluginBuffer()
+			if buffer is not None:
+				buffer.append((self.addText, (s, )))
+			elif (self.tsv or self.jsonStream) and self.stream:
+				self.stream.write(s)
+			else:
+				self.text += s
 		
 	def getText(self):
 		"""Returns the output text buffer."""
 		return self.text	
 
-	def beginOutput(self):
-		"""Reset the output list buffer."""
+	def beginOutput(self, header=None):
+		"""Reset the output list buffer.  Commands that list many
+		rows give the header here instead of to endOutput, which
+		lets the streaming mode print the rows as they come.  The
+		rows of the other commands are kept and written by
+		endOutput, in the same tab separated format."""
 		self.output = []
+		self.outputHeader = header
+		self.outputRows = 0
+		self.jsonGroup = []
 
 
 	def addOutput(self, owner, vals):
 		"""Append a list to the output list buffer."""
 
+		buffer = self.pluginBuffer()
+		if buffer is not None:
+			buffer.append((self.addOutput, (owner, vals)))
+			return
+
 		# VALS can be a list, tuple, or primitive type.
 		list = [ '%s:' % owner ]
 
@@ -1693,72 +1813,134 @@ class Command:
 				list.append(e)
 		else:
 			list.append(vals)
-			
-		self.output.append(list)
+
+		if self.jsonStream and self.outputHeader:
+			self.addGroupRow(list)
+		elif self.tsv and not self.json and self.outputHeader:
+			self.addRow(list)
+		else:
+			self.output.append(list)
+
+
+	def addGroupRow(self, list):
+		"""Keeps the rows of one owner for json=stream and writes
+		them out when a row of another owner comes."""
+
+		if self.jsonGroup and self.jsonGroup[0][0] != list[0]:
+			self.JSONOutput(self.outputHeader, self.jsonGroup)
+			self.jsonGroup = []
+		self.jsonGroup.append(list)
+
+
+	def addRow(self, list):
+		"""Writes one row of the output list buffer in the
+		streaming mode: tab separated, the owner always shown and
+		nothing kept."""
+
+		if not self.outputRows:
+			self.startOfLine = 0
+			header = self.outputHeader
+			if self.outputColumns(header) and header:
+				self.addText('%s\n' % self.outputRow(
+					map(string.upper, header), '\t'))
+		self.outputRows += 1
+
+		row = [ list[0][:-1] ] # owner without the ':'
+		for val in list[1:]:
+			if val == None:
+				val = ''
+			else:
+				val = str(val)
+			for c in '\t\n':
+				if c in val:
+					val = val.replace(c, ' ')
+			row.append(val)
+		self.addText('%s\n' % self.outputRow(row, '\t'))
 		
 		
-	def JSONOutput(self,header):
-		"""Do JSON output for various reports, header contains """
+	def JSONGroup(self, header, owner, rows):
+		"""Returns the JSON object for the rows of one owner."""
 		what = self.__module__.split('.')[-1]
-		jsonOutput = []
 		ownerKey = header[0]
 		if ownerKey == what:
 			what = self.__module__.split('.')[-2]
-		currentOwner = None
-		ownerDict = None
-		for kk in self.output:
-			tmpOwner = kk[0].replace(":","")
-			if tmpOwner != currentOwner:
-				if currentOwner is not None:
-					jsonOutput.append(ownerDict)
-				currentOwner = tmpOwner
-				ownerDict={}
-				ownerDict[ownerKey] = currentOwner
-				ownerDict[what]=[]
+		ownerDict = {}
+		ownerDict[ownerKey] = owner
+		ownerDict[what] = []
+		for kk in rows:
 			dict = {}
 			for k,v in zip(header[1:],kk[1:]):
 				dict[k] = v
 			ownerDict[what].append(dict)
+		return ownerDict
 
-		if currentOwner is not None:
-			jsonOutput.append(ownerDict)
 
-		jsonText = json.dumps(jsonOutput,indent=4)
-		self.addText(jsonText)
+	def JSONOutput(self, header, output=None):
+		"""Do JSON output for various reports, header contains
+		the keys.  With json=stream every owner is one compact
+		JSON object on its own line."""
+		if output is None:
+			output = self.output
+		jsonOutput = []
+		currentOwner = None
+		rows = []
+		for kk in output + [ None ]: # None ends the last owner
+			if kk is None:
+				tmpOwner = None
+			else:
+				tmpOwner = kk[0].replace(":","")
+			if rows and tmpOwner != currentOwner:
+				ownerDict = self.JSONGroup(header,
+					currentOwner, rows)
+				if self.jsonStream:
+					self.addText('%s\n' % json.dumps(ownerDict,
+						separators=(',', ':')))
+				else:
+					jsonOutput.append(ownerDict)
+				rows = []
+			currentOwner = tmpOwner
+			if kk is not None:
+				rows.append(kk)
+
+		if not self.jsonStream:
+			jsonText = json.dumps(jsonOutput,indent=4)
+			self.addText(jsonText)
 			
-		
+
 
 	def endOutput(self, header=[], padChar='-', trimOwner=1,linesep='\n'):
 		"""Pretty prints the output list buffer."""
 
 		# Handle the simple case of no output, and bail out
 		# early.  We do this to avoid printing out nothing
-		# but a header w/o any rows.
+		# but a header w/o any rows.  In the streaming mode
+		# the rows are already out.
 		
+		if self.jsonGroup:
+			self.JSONOutput(self.outputHeader, self.jsonGroup)
+			self.jsonGroup = []
+
 		if not self.output:
 			return
 
-		# check if the user has selected output-header=flase to
-		# disable output of the header
-		# or output-col to disable output of some column
+		if not header and self.outputHeader:
+			header = self.outputHeader
 
 		# Check if JSON output
 		if self.json:
 			self.JSONOutput(header)
 			return
-		
-		showHeader      = True
-		if 'output-header' in self._params:
-			showHeader = self.str2bool(self._params['output-header'])
 
-		self.outputCols = []
-		if 'output-col' in self._params:
-			showCols = self._params['output-col'].split(',')
-			for i in header:
-				if i.lower() in showCols:
-					self.outputCols.append(True)
-				else:
-					self.outputCols.append(False)
+		# tab separated, for the commands that did not give their
+		# header to beginOutput
+		if self.tsv:
+			self.outputHeader = header
+			for list in self.output:
+				self.addRow(list)
+			self.output = []
+			return
+		
+		showHeader = self.outputColumns(header)
 			
 		# Loop over the output and check if there is more than
 		# one owner (usually a hostname).  We have only one owner
@@ -1825,15 +2007,37 @@ class Command:
 			self.addText('%s%s' % (self.outputRow(list),linesep))
 
 
-	def outputRow(self, list):
+	def outputColumns(self, header):
+		"""Checks if the user has selected output-header=false to
+		disable output of the header or output-col to disable
+		output of some column.  Returns whether to show the
+		header."""
+
+		showHeader = True
+		if 'output-header' in self._params:
+			showHeader = self.str2bool(self._params['output-header'])
+
+		self.outputCols = []
+		if 'output-col' in self._params:
+			showCols = self._params['output-col'].split(',')
+			for i in header or []:
+				if i.lower() in showCols:
+					self.outputCols.append(True)
+				else:
+					self.outputCols.append(False)
+
+		return showHeader
+
+
+	def outputRow(self, list, sep=' '):
 		if self.outputCols:
 			l = []
 			for i in range(0, len(list)):
 				if self.outputCols[i + self.startOfLine]:
 					l.append(list[i])
-			return string.join(l, ' ')
+			return string.join(l, sep)
 		else:
-			return string.join(list, ' ')
+			return string.join(list, sep)
 
 
 
@@ -1926,9 +2130,16 @@ class Command:
 				list.append(arg)
 
 		if  "json" in dict.keys():
-			if self.str2bool(dict['json']):
+			if dict['json'].lower() == 'stream':
+				self.json = True
+				self.jsonStream = True
+			elif self.str2bool(dict['json']):
 				self.json=True
 
+		if dict.get('output-format', '').lower() == 'tsv' or \
+			self.str2bool(dict.get('stream')):
+			self.tsv = True
+
 		if list and list[0] == 'help':
 			self.help(name, dict)
 		else:
@@ -1938,9 +2149,25 @@ class Command:
 			else:
 				self._args   = list
 				self._params = dict
+
+				# profile=yes, see rocks.perf
+				profile = None
+				if self.str2bool(dict.get('profile')) and \
+					not rocks.perf.active():
+					profile = rocks.perf.Profile(command)
+					profile.start()
+
+				# one transaction for the command and the
+				# commands it runs, see Database.begin
+				scoped = self.newdb is not None and \
+					self.newdb.begin(self.ReadOnly)
+
+				# ROCKS_QUERY_AUDIT, see rocks.db.audit
+				rocks.db.audit.enter(name)
+
 				try:
 					self.run(self._params, self._args)
-					if self.newdb is not None:
+					if scoped:
 						self.newdb.commit()
 				except rocks.util.HostnotfoundException as e:
 					if self.debug():
@@ -1950,6 +2177,15 @@ class Command:
 					if self.debug():
 						traceback.print_exc()
 					self.abort("Dabase error: " + str(e))
+				finally:
+					rocks.db.audit.leave()
+					if scoped:
+						self.newdb.end()
+					if profile:
+						profile.stop()
+						profile.report(dict.get(
+							'profile-format'),
+							dict.get('profile-file'))
 
 
 
@@ -1999,6 +2235,149 @@ class Plugin:
 		pass
 
 
+class PluginScheduler:
+	"""Runs the plugins of a command with up to threads of them at
+	once.  A plugin starts when the plugins it requires, and the ones
+	that precede it, are done.  What the plugins add to the output of
+	the command is kept aside and added in the order the plugins
+	would have run one after the other, so the output does not depend
+	on which plugin finished first.  If plugins fail the first one (in
+	that order) is raised once the running plugins are done.  The
+	plugins use the connection and transaction of the command (see
+	Database.share), the ones that use the database take turns and
+	nothing is committed before the command commits."""
+
+	def __init__(self, owner, plugins, threads):
+		self.owner	= owner
+		self.plugins	= plugins
+		self.threads	= min(threads, len(plugins))
+		self.lock	= threading.Condition()
+		self.buffers	= [ [] for plugin in plugins ]
+		self.failed	= [ None for plugin in plugins ]
+		self.state	= [ 'wait' for plugin in plugins ]
+		self.running	= 0
+		self.after	= self.dependencies(plugins)
+
+	def dependencies(self, plugins):
+		"""Returns, for every plugin, the indexes of the plugins it
+		waits for: the ones before it in plugins (the order of
+		sortPlugins) that reach it in the graph of sortPlugins,
+		TAIL and names no plugin provides included.  A plugin that
+		requires TAIL waits for all of them."""
+
+		# name -> names with an edge to it
+		edges = {}
+		for plugin in plugins:
+			name = plugin.provides()
+			edges.setdefault('TAIL', []).append(name)
+			for pre in plugin.precedes():
+				edges.setdefault(pre, []).append(name)
+			for req in plugin.requires():
+				edges.setdefault(name, []).append(req)
+
+		index = {}
+		for i in range(0, len(plugins)):
+			index[plugins[i].provides()] = i
+
+		after = []
+		for i in range(0, len(plugins)):
+			seen  = {}
+			queue = [ plugins[i].provides() ]
+			while queue:
+				for name in edges.get(queue.pop(), []):
+					if not seen.has_key(name):
+						seen[name] = True
+						queue.append(name)
+			after.append([ index[name] for name in seen.keys()
+				if index.get(name, i) < i ])
+		return after
+
+	def next(self):
+		"""Returns the index of the next plugin that can run, None
+		when there is none left, -1 if it has to wait.  Called with
+		the lock held."""
+
+		if [ f for f in self.failed if f ]:
+			return None
+		waiting = [ i for i in range(0, len(self.plugins))
+			if self.state[i] == 'wait' ]
+		for i in waiting:
+			if not [ j for j in self.after[i]
+				if self.state[j] != 'done' ]:
+				return i
+		if not waiting:
+			return None
+		if not self.running:
+			# plugins that wait for each other, the serial
+			# order decides
+			return waiting[0]
+		return -1
+
+	def work(self, args):
+		local = self.owner._pluginThread
+		db    = self.owner.newdb
+		while True:
+			self.lock.acquire()
+			try:
+				i = self.next()
+				while i == -1:
+					self.lock.wait()
+					i = self.next()
+				if i is None:
+					self.lock.notifyAll()
+					break
+				self.state[i] = 'run'
+				self.running += 1
+			finally:
+				self.lock.release()
+
+			plugin = self.plugins[i]
+			syslog.syslog(syslog.LOG_INFO, 'run %s' % plugin)
+			local.buffer = self.buffers[i]
+			try:
+				try:
+					plugin.run(args)
+				except:
+					self.failed[i] = sys.exc_info()
+			finally:
+				if db is not None:
+					db.release()
+			local.buffer = None
+
+			self.lock.acquire()
+			self.state[i] = 'done'
+			self.running -= 1
+			self.lock.notifyAll()
+			self.lock.release()
+
+	def run(self, args):
+		db = self.owner.newdb
+		self.owner._pluginThread = threading.local()
+		workers = []
+		if db is not None:
+			db.share()
+		try:
+			for n in range(0, self.threads):
+				t = threading.Thread(target=self.work, args=(args, ))
+				t.setDaemon(True)
+				t.start()
+				workers.append(t)
+			for t in workers:
+				while t.isAlive():
+					t.join(1)
+		finally:
+			self.owner._pluginThread = None
+			if db is not None:
+				db.unshare()
+
+		for i in range(0, len(self.plugins)):
+			for (method, vals) in self.buffers[i]:
+				method(*vals)
+			if self.failed[i]:
+				(type, value, tb) = self.failed[i]
+				raise type, value, tb
+
+
 class PluginOrderIterator(rocks.graph.GraphIterator):
 	"""Iterator for Partial Ordering of Plugins"""
 
@@ -261,6 +261,13 @@ import rocks.commands
 import rocks.file
 import subprocess
 import re
+import shutil
+import tempfile
+
+try:
+	import _librocks
+except ImportError:
+	_librocks = None
 
 class RollHandler:
 	def __init__(self, arch, host_os, db):
@@ -280,7 +287,30 @@ class RollHandler:
 			os.makedirs(self.cdrom_mount)
 		
 		self.roll_info = {}
+
+		# ISO images read without mounting them, and the copies
+		# out of them that are done all at once by copy_images
+		self.image = None
+		self.image_path = None
+		self.copies = []
 		
+	def open_iso(self, iso):
+		"""Open the ISO image given without mounting it. Returns
+		False if it has to be mounted instead"""
+		self.image = None
+		if not _librocks or self.host_os != 'linux':
+			return False
+		try:
+			self.image = _librocks.ISOImage(iso)
+		except OSError:
+			return False
+		self.image_path = iso
+		return True
+
+	def close_iso(self):
+		self.image = None
+		self.image_path = None
+
 	def mount_iso(self, iso):
 		"""Mount the ISO image given. Calls the Host OS specific
 		mount function"""
@@ -352,7 +382,14 @@ class RollHandler:
 		# Linux or Solaris. In any case it's a foreign CD, and should
 		# be treated as such.
 		if len(self.roll_info) == 0:
-			self.copy_foreign_cd(clean)
+			if self.image:
+				# OS discs are still copied from the mount
+				self.image = None
+				self.mount_iso(self.image_path)
+				self.copy_foreign_cd(clean)
+				self.umount_iso()
+			else:
+				self.copy_foreign_cd(clean)
 			return
 		
 		# If we've come this far that means the disc has rolls on it.
@@ -397,21 +434,18 @@ class RollHandler:
 				self.clean_dir(specific_roll_dir)
 			os.makedirs(specific_roll_dir)
 
-		# Finally copy the roll to the HD
-		sys.stdout.write('Copying %s to Rolls.....' % roll_name)
-		sys.stdout.flush()
-		cwd = os.getcwd()
-		os.chdir(os.path.join(self.cdrom_mount,roll_name))
-		subprocess.call('find . ! -name TRANS.TBL -print'
-						' | cpio -mpud %s'
-						% roll_dir, shell=True)
+		# Finally copy the roll to the HD, it only goes in the
+		# database once it is there
+		def done():
+			self.add_linux_roll(roll_name, roll_vers, roll_arch,
+				roll_os)
+		self.copy_tree(roll_name, roll_dir,
+			'Copying %s to Rolls.....' % roll_name, done)
 
-		# after copying the roll, make sure everyone (apache included)
-		# can traverse the directories
-		subprocess.call('find %s -type d -exec chmod a+rx {} \;' % roll_dir, shell=True)
+	def add_linux_roll(self, roll_name, roll_vers, roll_arch, roll_os):
+		"""Insert the roll information into the database. Insert
+		into the database only in case it already doesn't exist"""
 
-		# Insert the roll information into the database. Insert
-		# into the database only in case it already doesn't exist
 		rows = self.db.execute('select * from rolls where'	\
 				' name="%s" and version="%s" and arch="%s"' \
 				' and os="%s"'
@@ -421,8 +455,6 @@ class RollHandler:
 				' values("%s", "%s", "%s", "no")'	\
 				% (roll_name, roll_vers, roll_arch)
 			self.db.execute(db_cmd)
-		
-		os.chdir(cwd)
 	
 	def copy_sunos_roll(self, clean, roll_info):
 		"""This function copies a Solaris Roll on to disk"""
@@ -454,17 +486,17 @@ class RollHandler:
 		if not os.path.exists(roll_dir):
 			os.makedirs(roll_dir)
 
-		# Navigate to the Roll directory <cdrom>/<roll_name>
-		# and just copy everything into the media directory
-		cwd = os.getcwd()
-		os.chdir(os.path.join(self.cdrom_mount, roll_name))
-		print 'Copying SunOS: %s to %s' % (roll_name, roll_dir) 
-		subprocess.call('find . ! -name TRANS.TBL'
-				' | cpio -mpud %s' % roll_dir, shell=True)
+		# Copy everything in <cdrom>/<roll_name> into the
+		# media directory
+		def done():
+			self.add_sunos_roll(roll_name, roll_vers, roll_arch,
+				roll_os)
+		self.copy_tree(roll_name, roll_dir,
+			'Copying SunOS: %s to %s\n' % (roll_name, roll_dir), done)
 
-		# after copying the roll, make sure everyone (apache included)
-		# can traverse the directories
-		subprocess.call('find %s -type d -exec chmod a+rx {} \;' % roll_dir, shell=True)
+	def add_sunos_roll(self, roll_name, roll_vers, roll_arch, roll_os):
+		"""Insert the Solaris roll into the database unless it is
+		already there"""
 
 		rows = self.db.execute(
 				"select * from rolls where"
@@ -476,12 +508,60 @@ class RollHandler:
 			self.db.execute("insert into rolls (name, arch, os, version)"
 					" values ('%s','%s','%s', '%s')" %
 					(roll_name, roll_arch, roll_os, roll_vers))
+
+	def copy_tree(self, src, dest, message, done):
+		"""Copy the directory src of the CD into dest, leaving out
+		the TRANS.TBL files, and make sure everyone (apache included)
+		can traverse the directories.  The message is printed when
+		the copy starts and done is called once it has succeeded.
+		Copies out of an unmounted image are only queued, see
+		copy_images"""
+
+		if self.image:
+			self.copies.append((self.image, src, dest, message,
+				done))
+			return
+
+		sys.stdout.write(message)
+		sys.stdout.flush()
+		cwd = os.getcwd()
+		os.chdir(os.path.join(self.cdrom_mount, src))
+		subprocess.call('find . ! -name TRANS.TBL -print'
+						' | cpio -mpud %s'
+						% dest, shell=True)
 		os.chdir(cwd)
 
+		subprocess.call('find %s -type d -exec chmod a+rx {} \;' % dest, shell=True)
+		done()
+
+	def copy_images(self):
+		"""Copy everything queued by copy_tree, from all the
+		images at once.  Returns a list of errors"""
+
+		if not self.copies:
+			return []
+		for (image, src, dest, message, done) in self.copies:
+			print message.rstrip('\n')
+		status = _librocks.isoextract(map(lambda x: x[:3],
+			self.copies))
+		errors = []
+		for ((image, src, dest, message, done), error) in \
+				zip(self.copies, status):
+			if error:
+				errors.append('%s: %s' % (src, error))
+			else:
+				done()
+		self.copies = []
+		return errors
+
 	def read_cd(self):
 		"""This function reads the CD and populates
 		information about the rolls that are on the CD"""
 
+		if self.image:
+			self.read_image()
+			return
+
 		# Check to see if roll-<name>.xml files are present
 		cmd = 'find %s -type f -name roll-\*.xml' % self.cdrom_mount
 		p = subprocess.Popen(cmd, shell=True, 
@@ -494,6 +574,27 @@ class RollHandler:
 			roll = rocks.file.RollInfoFile(i.strip())
 			self.roll_info[roll.getRollName()] = roll
 
+	def read_image(self):
+		"""read_cd for an image that is not mounted"""
+
+		tmp = tempfile.mkdtemp()
+		try:
+			for (path, mode, size, mtime, target) in \
+					self.image.entries():
+				name = os.path.basename(path)
+				if not stat.S_ISREG(mode) or \
+					not name.startswith('roll-') or \
+					not name.endswith('.xml'):
+					continue
+				xml = os.path.join(tmp, name)
+				file = open(xml, 'w')
+				file.write(self.image.read(path))
+				file.close()
+				roll = rocks.file.RollInfoFile(xml)
+				self.roll_info[roll.getRollName()] = roll
+		finally:
+			shutil.rmtree(tmp)
+
 	def copy_foreign_cd(self, clean):
 		"""Copy a CD which is not the Standard Rocks Roll CD"""
 
@@ -740,7 +841,17 @@ class Command(rocks.commands.add.command):
 				self.abort('CDROM not mounted')
 		else:
 			for i in iso_list:
+				if roll_handler.open_iso(i):
+					roll_handler.copy_cd(self.clean)
+					roll_handler.close_iso()
+					continue
 				roll_handler.mount_iso(i)
 				roll_handler.copy_cd(self.clean)
 				roll_handler.umount_iso()
 
+			# the rolls of every image are copied together
+			errors = roll_handler.copy_images()
+			if errors:
+				self.abort('cannot copy rolls\n%s' %
+					'\n'.join(errors))
+
@@ -221,6 +221,7 @@ import shutil
 import subprocess
 import pexpect
 import socket
+import shlex
 import rocks
 import rocks.commands
 import rocks.dist
@@ -228,6 +229,14 @@ import rocks.file
 import rocks.roll
 import rocks.util
 
+try:
+	import _librocks
+except ImportError:
+	_librocks = None
+
+# boot code isohybrid puts in the MBR
+ISOHYBRID_MBR = '/usr/share/syslinux/isohdpfx.bin'
+
 
 class Builder:
 
@@ -235,6 +244,7 @@ class Builder:
 		self.config = None
 		self.tempdir = os.getcwd()
 		self.versionMajor = int(rocks.version_major)
+		self.isojobs = []
 
 	def mktemp(self):
 		return tempfile.mktemp(dir=self.tempdir)
@@ -242,7 +252,13 @@ class Builder:
 	def makeBootable(self, name):
 		pass
 				
-	def mkisofs(self, isoName, rollName, diskName, rollDir, volname=None):
+	def mkisofs(self, isoName, rollName, diskName, rollDir, volname=None,
+			hybrid=False):
+		"""Makes the image of rollDir, and for hybrid images also
+		the isohybrid MBR and the implanted checksum.  When the
+		native writer can do it the image is only queued, and
+		written by writeISOs() along with the other disks."""
+
 		print 'Building ISO image for %s ...' % diskName
 
 		if self.config.isBootable():
@@ -264,11 +280,123 @@ class Builder:
 				(volname, extraflags, os.path.join(cwd, isoName))
 
 
+		output = os.path.join(cwd, isoName)
+		rationalize = self.versionMajor < 7
+		job = self.isoJob(rollDir, output, volname, extraflags,
+			rationalize, hybrid)
+		if job:
+			self.isojobs.append((job, cmd, rollDir, hybrid))
+		else:
+			self.runMkisofs(cmd, rollDir, output, hybrid)
+
+	def runMkisofs(self, cmd, rollDir, isoName, hybrid):
+		cwd = os.getcwd()
 		os.chdir(rollDir)
 		print "mkisofs: %s" % cmd
 		rocks.util.system(cmd, 'spinner')
 		os.chdir(cwd)
 
+		if hybrid:
+			self.makeHybrid(isoName)
+			self.implantMD5(isoName)
+
+	def isoJob(self, rollDir, output, volname, extraflags, rationalize,
+			hybrid):
+		"""Returns the _librocks.isowrite job for a mkisofs of
+		rollDir with extraflags, or None if the native writer
+		does not do everything the flags ask for."""
+
+		if not _librocks:
+			return None
+		if hybrid and not os.path.exists(ISOHYBRID_MBR):
+			return None
+
+		flags = _librocks.ISOWRITE_ROCKRIDGE | \
+			_librocks.ISOWRITE_TRANSTBL
+		if rationalize:
+			flags |= _librocks.ISOWRITE_RATIONALIZE
+		job = {
+			'root'	: os.path.abspath(rollDir),
+			'output': output,
+			'volume': volname
+			}
+
+		# El Torito options before -eltorito-alt-boot are for
+		# the BIOS image, the only one after it is the EFI image
+
+		try:
+			args = shlex.split(extraflags)
+		except ValueError:
+			return None
+		alt = False
+		noemul = False
+		while args:
+			arg = args.pop(0)
+			if arg in [ '-b', '-c', '-e', '-boot-load-size' ]:
+				if not args:
+					return None
+				value = args.pop(0)
+				if arg == '-b' and not alt:
+					job['boot'] = value
+				elif arg == '-c':
+					job['catalog'] = value
+				elif arg == '-e' and alt:
+					job['efi'] = value
+				elif arg == '-boot-load-size' and not alt:
+					try:
+						job['loadsize'] = int(value)
+					except ValueError:
+						return None
+				else:
+					return None
+			elif arg == '-boot-info-table' and not alt:
+				job['infotable'] = 1
+			elif arg == '-no-emul-boot':
+				noemul = noemul or not alt
+			elif arg == '-eltorito-alt-boot' and not alt:
+				alt = True
+			elif arg == '-J':
+				flags |= _librocks.ISOWRITE_JOLIET
+			elif arg == '-r':
+				flags |= _librocks.ISOWRITE_RATIONALIZE
+			elif arg in [ '-R', '-T', '-f' ]:
+				pass
+			else:
+				return None
+
+		if job.has_key('boot') != job.has_key('catalog'):
+			return None
+		if job.has_key('boot') and not noemul:
+			return None		# floppy emulation
+		if hybrid:
+			if not job.has_key('boot'):
+				return None
+			job['mbr'] = ISOHYBRID_MBR
+			flags |= _librocks.ISOWRITE_HYBRID | _librocks.ISOWRITE_MD5
+
+		job['flags'] = flags
+		return job
+
+	def writeISOs(self):
+		"""Writes the images mkisofs queued, all the disks at
+		once.  An image the native writer fails on is made again
+		with mkisofs."""
+
+		jobs = self.isojobs
+		self.isojobs = []
+		if not jobs:
+			return
+
+		errors = _librocks.isowrite([ job for (job, cmd, rollDir,
+			hybrid) in jobs ])
+		for (job, cmd, rollDir, hybrid), error in zip(jobs, errors):
+			if error:
+				print 'isowrite: %s, using mkisofs' % error
+				self.runMkisofs(cmd, rollDir, job['output'],
+					hybrid)
+			else:
+				print 'wrote %s' % os.path.basename(job['output'])
+
 	def implantMD5(self,isoname):
 		cwd = os.getcwd()
 		cmd = 'implantisomd5 --supported-iso %s' % (os.path.join(cwd, isoname))
@@ -328,8 +456,10 @@ class RollBuilder_linux(Builder, rocks.dist.Arch):
 		self.setArch(self.config.getRollArch())
 		self.command = command
 		self.CDlabel = "%s %s %s" % ("Rocks",rocks.version,self.getArch())
-	def mkisofs(self, isoName, rollName, diskName, volname=None):
-		Builder.mkisofs(self, isoName, rollName, diskName, diskName, volname=volname)
+	def mkisofs(self, isoName, rollName, diskName, volname=None,
+			hybrid=False):
+		Builder.mkisofs(self, isoName, rollName, diskName, diskName,
+			volname=volname, hybrid=hybrid)
 		
 	def signRPM(self, rpm):
 	
@@ -337,11 +467,10 @@ class RollBuilder_linux(Builder, rocks.dist.Arch):
 		# allows Rolls to include 3rd party RPMs that will
 		# not be signed by the Roll builder.
 		
-		cmd = "rpm -q --qf '%%{BUILDHOST}' -p %s" % rpm.getFullName()
-		buildhost = subprocess.Popen(cmd, shell=True, stdout=subprocess.PIPE).stdout.readline()
+		header	  = rpm.getHeader()
 		hostname  = socket.gethostname()
 		
-		if buildhost == hostname:
+		if header and header['buildhost'] == hostname:
 			cmd = 'rpm --resign %s' % rpm.getFullName()
 			try:		
 				child = pexpect.spawn(cmd)
@@ -351,10 +480,15 @@ class RollBuilder_linux(Builder, rocks.dist.Arch):
 				child.close()
 			except:
 				pass
-			subprocess.call("rpm -qp %s --qf " 
-				"'%%{name}-%%{version}-%%{release}: "
-				"%%{sigmd5}\n'"
-				% rpm.getFullName(), shell=True)
+
+			# The signature changed, read the header again.
+			
+			header = rocks.file.getRPMHeader(rpm.getFullName())
+			rpm.header = header
+			if header:
+				print '%s-%s-%s: %s' % (header['name'],
+					header['version'], header['release'],
+					header['sigmd5'])
 		
 
 	def getRPMS(self, path):
@@ -641,6 +775,7 @@ class RollBuilder_linux(Builder, rocks.dist.Arch):
 			list.extend(self.getRPMS('RPMS'))
 		if self.config.hasSRPMS():
 			list.extend(self.getRPMS('SRPMS'))
+		rocks.file.readRPMHeaders(list)
 		for rpm in list:
 			self.signRPM(rpm)
 
@@ -724,15 +859,17 @@ class RollBuilder_linux(Builder, rocks.dist.Arch):
 				name)
 				
 			volname = None
+			hybrid = False
 			if id == 1 and self.config.isBootable() == 1:
 				self.makeBootable(name)
 				volname = self.CDlabel
+				hybrid = True
 			
-			self.mkisofs(isoname, self.config.getRollName(), name, volname=volname)
+			self.mkisofs(isoname, self.config.getRollName(), name,
+				volname=volname, hybrid=hybrid)
 
-			if id == 1 and self.config.isBootable() == 1:
-				self.makeHybrid(isoname)
-				self.implantMD5(isoname)
+		# all the disks at once
+		self.writeISOs()
 		
 class MetaRollBuilder(Builder):
 
@@ -813,6 +950,7 @@ class MetaRollBuilder(Builder):
 			
 		self.stampDisk(tmp, rollName, arch)
 		self.mkisofs(isoname, rollName, 'disk1', tmp)
+		self.writeISOs()
 
 		shutil.rmtree(tmp)
 
@@ -872,6 +1010,7 @@ class ReArchBuilder(Builder, rocks.dist.Arch):
 			roll.getRollDiskID())
 		self.mkisofs(isoname, roll.getRollName(), 
 			'disk%d' % roll.getRollDiskID(), tmp)
+		self.writeISOs()
 
 		shutil.rmtree(tmp)
 		     
@@ -934,6 +1073,7 @@ class RollBuilder_sunos(Builder, rocks.dist.Arch):
 			self.config.getRollOS())
 			
 		self.mkisofs(isoname, self.config.getRollName(), self.config.getRollName(), self.disc_dir)
+		self.writeISOs()
 
 	def stampDisk(self):
 		#Builder.stampDisk(self, self.disc_dir, 
@@ -158,6 +158,7 @@ import rocks.commands
 
 class command(rocks.commands.Command):
 	MustBeRoot = 0
+	ReadOnly = 1
 
 	safe_chars = [
 		'@', '%', '^', '-', '_', '=', '+', 
@@ -128,5 +128,6 @@ import rocks.commands
 
 class command(rocks.commands.Command):
 	MustBeRoot = 0
+	ReadOnly = 1
 
 
@@ -134,8 +134,8 @@
 import os
 import sys
 import string
-import rocks.file
 import rocks.commands
+import rocks.registry
 
 
 class Command(rocks.commands.list.command):
@@ -168,36 +168,27 @@ class Command(rocks.commands.list.command):
 						 params)
 		
 		if subdir:
-			filepath = os.path.join(rocks.commands.__path__[0],
-				subdir)
-			modpath  = 'rocks.commands.%s' % \
-				string.join(subdir.split(os.sep), '.')
+			prefix = tuple(subdir.split(os.sep))
 		else:
-			filepath = rocks.commands.__path__[0]
-			modpath  = 'rocks.commands'
-		
-		tree = rocks.file.Tree(filepath)
-		dirs = tree.getDirs()
-		dirs.sort()
+			prefix = ()
 
 		if os.environ.has_key('COLUMNS'):
 			cols = os.environ['COLUMNS']
-			
+
+		registry = rocks.registry.commands()
+		dirs = []
+		for words in registry.keys():
+			if len(words) > len(prefix) and \
+				words[:len(prefix)] == prefix:
+				dirs.append(string.join(words[len(prefix):], os.sep))
+		dirs.sort()
+
 		for dir in dirs:
-			if not dir:
-				continue
-				
-			module = '%s.%s' % \
-				(modpath, string.join(dir.split(os.sep),'.'))
-			__import__(module)
-			module = eval(module)
-			
-			try:
-				o = getattr(module, 'Command')(None)
-			except AttributeError:
+			entry = registry[prefix + tuple(dir.split(os.sep))]
+			if not entry['command']:
 				continue
 		
-			if o.MustBeRoot and not self.isRootUser():
+			if entry['root'] and not self.isRootUser():
 				continue
 
 			# Format the brief usage to fit within the
@@ -206,7 +197,7 @@ class Command(rocks.commands.list.command):
 			cmd = string.join(dir.split(os.sep),' ')
 			l   = len(cmd) + 1
 			s   = ''
-			for arg in o.usage().split():
+			for arg in entry['usage'].split():
 				if l + len(arg) < cols or cols == 0:
 					s += '%s ' % arg
 					l += len(arg) + 1 # space
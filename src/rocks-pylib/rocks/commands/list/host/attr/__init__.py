@@ -124,16 +124,14 @@ class Command(rocks.commands.list.host.command):
 
 	def run(self, params, args):
 
-		self.beginOutput()
+		self.beginOutput(header=['host', 'attr', 'value', 'source' ])
 		
-		for host in self.newdb.getNodesfromNames(args):
-			attrs = self.newdb.getHostAttrs(host, 1)
-			
+		hosts = self.newdb.getNodesfromNames(args)
+		for (host, attrs) in self.newdb.iterHostsAttrs(hosts, 1):
 			for key in sorted(attrs.keys()):
-				self.addOutput(host.name, 
+				self.addOutput(host, 
 					(key, attrs[key][0], attrs[key][1]))
 
-		self.endOutput(header=['host', 'attr', 'value', 'source' ],
-			trimOwner=0)
+		self.endOutput(trimOwner=0)
 
 
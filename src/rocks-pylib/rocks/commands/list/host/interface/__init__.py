@@ -197,7 +197,9 @@ class Command(rocks.commands.list.host.command):
 
 	def run(self, params, args):
 		reg = re.compile('vlan.*')
-		self.beginOutput()
+		self.beginOutput(header=['host', 'subnet', 'iface', 'mac',
+			'ip', 'netmask', 'module', 'name', 'vlan',
+			'options', 'channel'])
 		for host in self.getHostnames(args):
 			self.db.execute(""" SELECT s.name, n.Device, n.Mac, 
 			n.ip, s.netmask, n.Module, n.Name, n.Vlanid, n.options, 
@@ -216,7 +218,5 @@ class Command(rocks.commands.list.host.command):
 				else:
 					self.addOutput(host, row)
 	
-		self.endOutput(header=['host', 'subnet', 'iface', 'mac', 
-			'ip', 'netmask', 'module', 'name', 'vlan',
-			'options', 'channel'])
+		self.endOutput()
 
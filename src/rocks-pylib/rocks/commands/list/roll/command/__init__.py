@@ -126,8 +126,8 @@ import stat
 import time
 import sys
 import string
-import rocks.file
 import rocks.commands
+import rocks.registry
 
 
 class Command(rocks.commands.RollArgumentProcessor,
@@ -148,29 +148,16 @@ class Command(rocks.commands.RollArgumentProcessor,
 
 	def run(self, params, args):
 
-		tree = rocks.file.Tree(rocks.commands.__path__[0])
-		dirs = tree.getDirs()
-		dirs.sort()
-
 		dict = {}		
-		for dir in dirs:
-			if not dir:
-				continue
-			modpath = 'rocks.commands.%s' % \
-				string.join(dir.split(os.sep),'.')
-			__import__(modpath)
-			module = eval(modpath)
-			try:
-				o = getattr(module, 'Command')
-			except AttributeError:
-				continue
-			try:
-				o = getattr(module, 'RollName')
-			except AttributeError:
+		for (words, entry) in rocks.registry.commands().items():
+			if not entry['command'] or entry['roll'] is None:
 				continue
+			o = entry['roll']
 			if not dict.has_key(o):
 				dict[o] = []
-			dict[o].append(string.join(dir.split(os.sep), ' '))
+			dict[o].append(string.join(words, ' '))
+		for o in dict.keys():
+			dict[o].sort()
 
 		try:
 			rolls = self.getRollNames(args, params)
@@ -0,0 +1,169 @@
+# $Id$
+#
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+# @Copyright@
+#
+
+import os
+import rocks.commands
+
+# The indexes for the columns hosts are looked up by (getHostname, the
+# DHCP and PXE code, run host) and for the attribute resolution.  They
+# are also in nodes/database-schema.xml for new databases.
+INDEXES = [
+	( 'nodes',	'Name',			[ 'Name' ] ),
+	( 'networks',	'NetworkMAC',		[ 'MAC' ] ),
+	( 'networks',	'NetworkIP',		[ 'IP' ] ),
+	( 'networks',	'NetworkName',		[ 'Name' ] ),
+	( 'aliases',	'AliasName',		[ 'Name' ] ),
+	( 'subnets',	'name',			[ 'name' ] ),
+	( 'attributes',	'AttrCatindex',		[ 'Category', 'Catindex',
+						  'Attr' ] ),
+	]
+
+# The tables added since, also in nodes/database-schema.xml.
+TABLES = [
+	( 'snapshot', [
+		"""create table snapshot (
+			ID		int(11) NOT NULL auto_increment,
+			Generation	bigint(20) NOT NULL default '0',
+			PRIMARY KEY (ID)
+		)""",
+		'insert into snapshot (Generation) values (0)' ] ),
+	]
+
+
+class Command(rocks.commands.migrate.command):
+	"""
+	Brings the schema of the database up to date with the tables
+	added since it was made and the indexes the hot queries need.  A
+	table or an index that is already there (under any name) is left
+	alone, so it is safe to run the command any number of times.  The
+	indexes are added online, the tables can be used while they are
+	built.
+
+	<param type='bool' name='dryrun'>
+	If set, only list what would be done.  Default is no.
+	</param>
+
+	<example cmd='migrate schema'>
+	Adds the missing tables and indexes.
+	</example>
+
+	<example cmd='migrate schema dryrun=yes'>
+	Lists the tables and indexes and whether they are there.
+	</example>
+	"""
+
+	def getIndexes(self, table):
+		"""Returns the columns of every index of table, in order."""
+
+		indexes = {}
+		self.db.execute('show index from %s' % table)
+		for row in self.db.fetchall():
+			(name, seq, column) = (row[2], row[3], row[4])
+			indexes.setdefault(name, []).append((seq, column.lower()))
+		for name in indexes.keys():
+			indexes[name].sort()
+			indexes[name] = [ column for (seq, column) in indexes[name] ]
+		return indexes
+
+
+	def run(self, params, args):
+		if args:
+			self.abort('command does not take arguments')
+
+		(dryrun, ) = self.fillParams([ ('dryrun', 'no') ])
+		dryrun = self.str2bool(dryrun)
+
+		self.beginOutput()
+		added = False
+		for (table, statements) in TABLES:
+			if self.db.execute("show tables like '%s'" % table):
+				status = 'present'
+			elif dryrun:
+				status = 'missing'
+			else:
+				for statement in statements:
+					self.db.execute(statement)
+				status = 'added'
+				added = True
+			self.addOutput(table, ('', '', status))
+
+		# the grants of the new tables
+		if added:
+			os.system('/opt/rocks/sbin/rocks-db-perms')
+
+		for (table, name, columns) in INDEXES:
+			wanted = [ column.lower() for column in columns ]
+			found = None
+			for (key, keycolumns) in self.getIndexes(table).items():
+				if keycolumns[:len(wanted)] == wanted:
+					found = key
+					break
+
+			if found:
+				status = 'present (%s)' % found
+			elif dryrun:
+				status = 'missing'
+			else:
+				self.db.execute('alter table %s add index %s (%s), '
+					'algorithm=inplace, lock=none' %
+					(table, name, ', '.join(columns)))
+				status = 'added'
+			self.addOutput(table, (name, ','.join(columns), status))
+
+		self.endOutput(header=['table', 'index', 'columns', 'status'],
+			trimOwner=0)
+
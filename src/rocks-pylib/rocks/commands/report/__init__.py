@@ -103,6 +103,7 @@ import rocks.commands
 
 class command(rocks.commands.Command):
 	MustBeRoot = 0
+	ReadOnly = 1
 
 	def getNetworks(self):
 		networks = []
@@ -94,6 +94,8 @@ class Command(rocks.commands.report.command):
 	</example>
 	"""
 
+	Pure = 1
+
 	def run(self, params, args):
 		distrodir = self.db.getHostAttr('localhost', 'Kickstart_DistroDir')
 		if distrodir == None:
@@ -99,6 +99,8 @@ class Command(rocks.commands.report.command):
 	</example>
 	"""
 
+	Pure = 1
+
 	def run(self, params, args):
 		
 		self.major, = self.fillParams([
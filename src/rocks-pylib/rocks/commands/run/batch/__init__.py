@@ -0,0 +1,251 @@
+# $Id$
+#
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+# @Copyright@
+#
+
+import sys
+import shlex
+import string
+import traceback
+import rocks.cli
+import rocks.util
+import rocks.commands
+
+
+class Command(rocks.commands.run.command):
+	"""
+	Runs rocks commands, one command line per line, read from files
+	or the standard input.  All the commands run in this process on
+	one database connection.  A line may start with "rocks" or
+	"/opt/rocks/bin/rocks", so the output of "rocks dump" can be
+	given as it is.  Empty lines and lines starting with # are
+	skipped.
+
+	<arg optional='1' type='string' name='file' repeat='1'>
+	The files to read the command lines from, - is the standard
+	input.  Default is the standard input.
+	</arg>
+
+	<param type='bool' name='transaction'>
+	If set, the database changes of all the commands are made in one
+	transaction, and nothing is changed if any command fails.  Other
+	programs (e.g., those run by the sync commands) do not see the
+	changes until all the commands are done.  Default is no.
+	</param>
+
+	<param type='bool' name='continue'>
+	If set, a failed command is reported and the commands after it
+	still run.  Default is no.
+	</param>
+
+	<example cmd='run batch restore.sh'>
+	Runs the commands in restore.sh, as made by "rocks dump".
+	</example>
+
+	<example cmd='run batch transaction=yes continue=yes hosts.txt'>
+	Runs all the commands in hosts.txt, reports every one that fails
+	and only changes the database if none did.
+	</example>
+	"""
+
+	MustBeRoot = 0
+
+	def parse(self, file):
+		"""Yields (line, words, error) for every command line in file,
+		line is the number of its first line and words the command
+		without the leading rocks.  A command goes on over the next
+		lines while it ends in a backslash or has an open quote,
+		which is how "rocks dump" writes values with newlines in
+		them (e.g., host keys).  An escaped newline stays in the
+		value, as dump meant it, unless it stands alone between
+		words."""
+
+		n     = 0
+		first = 0
+		text  = ''
+		for line in file:
+			n += 1
+			if not text:
+				first = n
+				if not line.strip() or \
+					line.strip()[0] == '#':
+					continue
+			text += line
+
+			end = text[:-1]
+			if (len(end) - len(end.rstrip('\\'))) % 2:
+				continue
+			try:
+				words = self.split(text)
+			except ValueError:
+				continue
+			text = ''
+			if words:
+				yield (first, words, None)
+
+		if text:
+			try:
+				words = self.split(text)
+			except ValueError, e:
+				yield (first, None, str(e))
+			else:
+				if words:
+					yield (first, words, None)
+
+
+	def split(self, text):
+		words = filter(lambda x: x != '\n', shlex.split(text))
+		if words and words[0] in [ 'rocks', '/opt/rocks/bin/rocks' ]:
+			words = words[1:]
+		return words
+
+
+	def runLine(self, argv):
+		"""Runs one command line, returns None or the error."""
+
+		found = rocks.cli.lookup(argv)
+		if not found:
+			return 'invalid rocks command "%s"' % argv[0]
+		(module, s, i) = found
+		try:
+			cls = getattr(module, 'Command')
+		except AttributeError:
+			return 'incomplete rocks command "%s"' % \
+				string.join(argv)
+		name = string.join(string.split(s, '.')[2:], ' ')
+
+		command = cls(self.newdb)
+		if command.MustBeRoot and \
+			not (command.isRootUser() or command.isApacheUser()):
+			return 'must be root to run "%s"' % name
+		try:
+			command.runWrapper(name, argv[i:])
+			self.newdb.commit()
+		except rocks.util.CommandError, e:
+			return str(e)
+		except Exception, e:
+			if self.debug():
+				traceback.print_exc()
+			return '%s: %s' % (e.__class__.__name__, e)
+
+		# straight out when run from the command line, a later
+		# failure aborts the batch
+		if self.stream:
+			self.stream.write(command.getText())
+		else:
+			self.addText(command.getText())
+		return None
+
+
+	def run(self, params, args):
+		(transaction, keepGoing) = self.fillParams([
+			('transaction', 'no'),
+			('continue', 'no')
+			])
+		transaction = self.str2bool(transaction)
+		keepGoing   = self.str2bool(keepGoing)
+
+		if not args:
+			args = [ '-' ]
+
+		count  = 0
+		errors = 0
+		done   = False
+		if transaction:
+			self.newdb.beginTransaction()
+		try:
+			for filename in args:
+				if filename == '-':
+					file = sys.stdin
+					filename = 'stdin'
+				else:
+					try:
+						file = open(filename)
+					except IOError, e:
+						self.abort(str(e))
+
+				for (n, argv, error) in self.parse(file):
+					count += 1
+					if argv:
+						error = self.runLine(argv)
+					if not error:
+						continue
+
+					errors += 1
+					sys.stderr.write('%s:%d: %s\n' %
+						(filename, n, error))
+					if not transaction:
+						self.newdb.rollback()
+					if not keepGoing:
+						break
+
+				if file != sys.stdin:
+					file.close()
+				if errors and not keepGoing:
+					break
+			done = True
+		finally:
+			if transaction:
+				self.newdb.endTransaction(
+					commit=(done and not errors))
+
+		if errors:
+			if transaction:
+				self.abort('%d of %d commands failed, '
+					'nothing was changed' % (errors, count))
+			else:
+				self.abort('%d of %d commands failed' %
+					(errors, count))
+
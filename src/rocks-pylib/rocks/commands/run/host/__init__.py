@@ -363,6 +363,23 @@ class Command(command):
 		if numthreads <= 0:
 			numthreads = len(hosts)
 
+		# the address of every host on its primary network, looked
+		# up once for all the hosts
+		addresses = {}
+		try:
+			attrs = self.newdb.getHostsAttrs(hosts)
+			self.db.execute("""select n.name, s.name, net.ip from
+				networks net, nodes n, subnets s where
+				net.node=n.id and net.subnet=s.id""")
+			ips = {}
+			for (name, subnet, ip) in self.db.fetchall():
+				ips[(name, subnet)] = ip
+			for host in hosts:
+				addresses[host] = ips.get((host,
+					attrs[host].get('primary_net')))
+		except:
+			pass
+
 		threads = []
 
 		i = 0
@@ -375,13 +392,9 @@ class Command(command):
 				runlocal = (localhost == host.split('.')[0])
 				i += 1	
 
-				try:
-					hnet=self.db.getHostAttr(host,'primary_net')
-					query="select net.ip from networks net, nodes n, subnets s where net.node=n.id and net.subnet=s.id and n.name='%s' and s.name='%s'" % (host,hnet)
-					self.db.execute(query)
-					hostif,=self.db.fetchone()
-				except:
-					hostif=host
+				hostif = addresses.get(host)
+				if not hostif:
+					hostif = host
 				#
 				# first test if the node is up and responding
 				# to ssh
@@ -110,6 +110,9 @@ class Command(rocks.commands.sync.command):
 	</example>
 	"""
 
+	# the plugins mostly wait for make and service restarts
+	PluginThreads = 4
+
 	def run(self, params, args):
 		#
 		# don't call insert-ethers if insert-ethers is already
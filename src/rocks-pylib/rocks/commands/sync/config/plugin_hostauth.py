@@ -86,6 +86,10 @@ import subprocess
 class Plugin(rocks.commands.Plugin):
 	def provides(self):
 		return 'hostauth'
+
+	def requires(self):
+		# make -C /var/411 below reads the four11putrc it writes
+		return [ '411' ]
 		
 	def run(self, args):
 		""" if rocks_autogen_user_keys is true, then touch 
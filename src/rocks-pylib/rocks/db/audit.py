@@ -0,0 +1,253 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+The query audit, for finding the commands that run the same statement
+over and over (one query per host, per interface, per route...).
+
+With ROCKS_QUERY_AUDIT set in the environment every SQL statement is
+reduced to a fingerprint (the literals and bind parameters become ?)
+and counted for the command that ran it.  When the outermost command
+is done the statements repeated most are printed on stderr, each with
+the stack of the first repeat to show where the loop is.  The variable
+is looked up when a command starts, so this works the same under
+rocksd, with the environment and stderr of its client.  If the value of
+ROCKS_QUERY_AUDIT is a path (it starts with /) the report is appended
+to that file as one line of JSON per statement instead.
+
+	ROCKS_QUERY_AUDIT=1 rocks report host dhcpd
+"""
+
+import os
+import re
+import sys
+import json
+import threading
+import traceback
+import sqlalchemy.event
+
+TOP	= 10	# statements in the report
+REPEATS	= 2	# times a statement has to run to be reported
+FRAMES	= 8	# frames in a stack sample
+
+_lock	= threading.Lock()
+_audit	= None	# the Audit of the running command, if on
+_depth	= 0	# the commands running, in all threads
+_local	= threading.local()
+
+_literals = [
+	(re.compile(r"'(?:[^'\\]|\\.)*'"), '?'),
+	(re.compile(r'"(?:[^"\\]|\\.)*"'), '?'),
+	(re.compile(r'%\(\w+\)s|%s'), '?'),
+	(re.compile(r'\b\d+(?:\.\d+)?\b'), '?'),
+	(re.compile(r'\s+'), ' '),
+	(re.compile(r'\(\s*\?(?:\s*,\s*\?)*\s*\)'), '(?+)'),
+	(re.compile(r'\(\?\+\)(?:\s*,\s*\(\?\+\))+'), '(?+)...'),
+	]
+
+
+def fingerprint(statement):
+	"""
+	Returns statement with the literals replaced by ?, a list of
+	values by (?+) and the white space collapsed, so the statements
+	of a loop all have the same fingerprint.
+	"""
+	for (regex, repl) in _literals:
+		statement = regex.sub(repl, statement)
+	return statement.strip().lower()
+
+
+def install(engine):
+	"""Audits the statements run on engine while auditing is on."""
+
+	def before(conn, cursor, statement, parameters, context, many):
+		audit = _audit
+		if audit:
+			audit.query(statement)
+
+	sqlalchemy.event.listen(engine, 'before_cursor_execute', before)
+
+
+def commands():
+	"""The commands running in this thread, innermost last."""
+	if not hasattr(_local, 'commands'):
+		_local.commands = []
+	return _local.commands
+
+
+def enter(name):
+	"""
+	Called when a command starts.  The outermost one turns auditing
+	on if ROCKS_QUERY_AUDIT is set.
+	"""
+	global _audit, _depth
+
+	_lock.acquire()
+	if not _depth:
+		value = os.environ.get('ROCKS_QUERY_AUDIT')
+		if value:
+			_audit = Audit(value, name)
+	_depth += 1
+	_lock.release()
+	commands().append(name)
+
+def leave():
+	"""
+	Called when a command is done.  The outermost one writes the
+	report.
+	"""
+	global _audit, _depth
+
+	if commands():
+		commands().pop()
+	_lock.acquire()
+	_depth -= 1
+	audit = None
+	if not _depth:
+		(audit, _audit) = (_audit, None)
+	_lock.release()
+	if audit:
+		audit.report()
+
+
+class Audit:
+
+	def __init__(self, value, name):
+		self.file	= None
+		if value.startswith(os.sep):
+			self.file = value
+		self.name	= name	# the outermost command
+		self.lock	= threading.Lock()
+		self.counts	= {}	# (command, fingerprint) -> count
+		self.stacks	= {}	# (command, fingerprint) -> stack
+
+	def query(self, statement):
+		# a plugin thread counts for the outermost command
+		running = commands()
+		if running:
+			command = running[-1]
+		else:
+			command = self.name
+		key = (command, fingerprint(statement))
+
+		self.lock.acquire()
+		count = self.counts.get(key, 0) + 1
+		self.counts[key] = count
+		self.lock.release()
+
+		if count == REPEATS:
+			self.stacks[key] = self.sample()
+
+	def sample(self):
+		"""
+		The innermost frames of the caller, without the frames of
+		SQLAlchemy and of this module.
+		"""
+		me = os.path.splitext(__file__)[0]
+		stack = []
+		for (file, line, func, text) in traceback.extract_stack():
+			if os.path.splitext(file)[0] == me or \
+				os.sep + 'sqlalchemy' + os.sep in file:
+				continue
+			stack.append((file, line, func, text))
+		return stack[-FRAMES:]
+
+	def worst(self):
+		"""Returns [ (count, command, fingerprint) ], worst first."""
+		worst = []
+		for ((command, statement), count) in self.counts.items():
+			if count >= REPEATS:
+				worst.append((count, command, statement))
+		worst.sort(lambda a, b: cmp(b[0], a[0]))
+		return worst[:TOP]
+
+	def report(self):
+		worst = self.worst()
+		if not worst:
+			return
+
+		if self.file:
+			try:
+				f = open(self.file, 'a')
+				for (count, command, statement) in worst:
+					stack = self.stacks.get((command,
+						statement), [])
+					f.write('%s\n' % json.dumps({
+						'command': command,
+						'count': count,
+						'statement': statement,
+						'stack': [ '%s:%d %s' % s[:3]
+							for s in stack ] },
+						separators=(',', ':')))
+				f.close()
+			except IOError, e:
+				sys.stderr.write('query audit: %s\n' % e)
+			return
+
+		lines = [ 'query audit: statements run %d times or more:' %
+			REPEATS ]
+		for (count, command, statement) in worst:
+			lines.append('')
+			lines.append('%6dx  %s' % (count, command))
+			lines.append('\t%s' % statement)
+			for (file, line, func, text) in \
+				self.stacks.get((command, statement), []):
+				lines.append('\t  %s:%d in %s' %
+					(file, line, func))
+				if text:
+					lines.append('\t    %s' % text)
+		sys.stderr.write('\n'.join(lines) + '\n')
+		sys.stderr.flush()
@@ -63,15 +63,42 @@ import getopt
 import types
 import subprocess
 import threading
+import time
 
 from sqlalchemy import create_engine
 import sqlalchemy
 import sqlalchemy.exc
+import sqlalchemy.event
 
 import rocks
+import rocks.trace
+import rocks.db.audit
+import rocks.db.snapshot
 from rocks.db.mappings.base import *
 
-threadlocal = threading.local()
+# the SQL statements that do not change the database
+READS = [ 'select', 'show', 'describe', 'desc', 'explain' ]
+
+# the socket of mysqld when it runs on this host
+SOCKET = '/var/opt/rocks/mysql/mysql.sock'
+
+
+class ThreadState(object):
+	"""
+	The connection, session, transaction and the results of the last
+	query.  Every thread has its own, except that the threads running
+	the plugins of a command share the one of the command (see
+	:meth:`Database.share`).
+	"""
+	def __init__(self):
+		self.conn	 = None
+		self.session	 = None
+		self.results	 = False
+		self.transaction = None	 # the transaction open on conn
+		self.scoped	 = False # see Database.begin
+		self.hold	 = False # see Database.beginTransaction
+		self.snapshot	 = None	 # the connection to the snapshot
+		self.readonly	 = False # the statements go to the snapshot
 
 
 class Database(object):
@@ -85,14 +112,19 @@ class Database(object):
 	- connection: this is used by the execute statement, so every time
 		      you use pure sql
 
-	These two objects have two separate DB connections, which means
-	that DB status can be different when queried through them.
+	The session is bound to the connection, so both see the same DB
+	status and a process needs one DB connection (one per thread).
+	Between :meth:`begin` and :meth:`end` (the run of a command) all
+	the statements are in one transaction, which :meth:`commit` ends.
 	
 	Usage Example::
 
 	  db = Database()
 	  db.setVerbose()
 	  db.connect()
+
+	With connect(lazy=True) nothing happens until the connection
+	(:attr:`conn`) or the engine is first used.
 	"""
 
 	def __init__(self):
@@ -104,9 +136,30 @@ class Database(object):
 		self._dbName = None
 		self.verbose = False
 		#temporary holds results from self.conn.execute(sql)
-		self.results = False
-		self.conn = None
-		self.engine = None
+		#and the connection, see ThreadState
+		self._local = threading.local()
+		# see share
+		self._shared  = None
+		self._owner   = None
+		self._lock    = threading.RLock()
+		self._holding = threading.local()
+		self._engine = None
+		# connect() was called, the lazy connection failed
+		self._wanted = False
+		self._failed = False
+		# text of pure commands run through Command.command(), it
+		# is emptied by every write (see changed)
+		self.memo = {}
+		# see beginTransaction
+		self._transaction = None
+		# something was written, and committed (see commit), so the
+		# snapshot has to be exported (see rocks.db.snapshot)
+		self._written = False
+		self._export = False
+		self._snapshotEngine = None
+		self._snapshotFile = None
+		self._noGeneration = False
+		self._generation = None
 
 
 	def setDBPasswd(self, passwd):
@@ -192,22 +245,35 @@ class Database(object):
 		self.verbose = verbose
 
 
-	def connect(self):
+	def connect(self, lazy=False):
 		"""
 		It start the connection to the DB and create all the internal
-		data structure
+		data structure.
+
+		If lazy the connection is only made when it is first needed,
+		and if it cannot be made (no database yet, no MySQLdb) the
+		connection is None, as for the command line in the
+		installation environment.
 		"""
 
+		self._wanted = True
+		self._failed = False
+		if not lazy:
+			self._createEngine()
+			start = time.time()
+			self._thread.conn = self._engine.connect()
+			rocks.trace.timed('db connect', time.time() - start)
+
+
+	def _createEngine(self):
 		if os.environ.has_key('ROCKSDEBUG'):
 			self.setVerbose(True)
 
-		mysql_socket = '/var/opt/rocks/mysql/mysql.sock'
-
 		url = 'mysql+mysqldb://' + self.getDBUsername() + ':' + self.getDBPasswd() \
 			 + '@' + self.getDBHostname() + '/' + self.getDBName()
-		if os.path.exists(mysql_socket):
+		if os.path.exists(SOCKET):
 			# we can use a unix socket
-			url += "?unix_socket=" + mysql_socket
+			url += "?unix_socket=" + SOCKET
 
 		if self.verbose:
 			import logging
@@ -218,9 +284,106 @@ class Database(object):
 			# TODO move this to the logger
 			print "Database connection URL: ", url
 
-		self.engine = create_engine(url, pool_recycle=3600)
-		# TODO: do not keep a connection active here it not needed
-		self.conn = self.engine.connect()
+		# A command uses one connection, plugins running in threads
+		# take overflow connections that are closed when done.
+		self._engine = create_engine(url, pool_recycle=3600,
+			pool_size=1, max_overflow=16)
+
+		# ROCKS_QUERY_AUDIT, see rocks.db.audit
+		rocks.db.audit.install(self._engine)
+
+
+	def _getEngine(self):
+		if not self._engine and self._wanted and not self._failed:
+			try:
+				self._createEngine()
+			except ImportError:
+				self._failed = True
+		return self._engine
+
+	def _setEngine(self, engine):
+		self._engine = engine
+
+	engine = property(_getEngine, _setEngine)
+
+
+	def _getThread(self):
+		"""
+		The ThreadState of this thread, or the shared one in a
+		plugin thread, which then holds the database until
+		:meth:`release`.
+		"""
+		if self._shared is not None and \
+			threading.current_thread() is not self._owner:
+			if not getattr(self._holding, 'held', False):
+				self._lock.acquire()
+				self._holding.held = True
+			return self._shared
+		state = getattr(self._local, 'state', None)
+		if state is None:
+			state = self._local.state = ThreadState()
+		return state
+
+	_thread = property(_getThread)
+
+	def share(self):
+		"""
+		Lets the threads that run the plugins of a command use the
+		connection, session and transaction of this thread, so the
+		plugins see each other's writes and the command still
+		commits once.  A plugin thread takes the database when it
+		first uses it and gives it back with :meth:`release`, so the
+		plugins that use the database run one at a time.
+		"""
+		self._shared = self._thread
+		self._owner  = threading.current_thread()
+
+	def unshare(self):
+		"""Ends :meth:`share`."""
+		self._shared = None
+		self._owner  = None
+
+	def sharing(self):
+		"""Returns whether plugin threads share the database."""
+		return self._shared is not None
+
+	def release(self):
+		"""
+		Gives the database back when a plugin is done, see
+		:meth:`share`.
+		"""
+		if getattr(self._holding, 'held', False):
+			self._holding.held = False
+			self._lock.release()
+
+	def _getConn(self):
+		thread = self._thread
+		if thread.readonly:
+			return thread.snapshot
+		if not thread.conn and self._wanted and not self._failed \
+			and self.engine:
+			start = time.time()
+			try:
+				thread.conn = self.engine.connect()
+			except sqlalchemy.exc.OperationalError:
+				self._failed = True
+			rocks.trace.timed('db connect', time.time() - start)
+		if thread.scoped and not thread.transaction and thread.conn:
+			thread.transaction = thread.conn.begin()
+		return thread.conn
+
+	def _setConn(self, conn):
+		self._thread.conn = conn
+
+	conn = property(_getConn, _setConn)
+
+	def _getResults(self):
+		return self._thread.results
+
+	def _setResults(self, results):
+		self._thread.results = results
+
+	results = property(_getResults, _setResults)
 
 
 	def reconnect(self):
@@ -236,18 +399,23 @@ class Database(object):
 		"""
                 Return the current session. If it does not exist it creates one.
 		The session is a singleton, you can call this method many time it 
-		returns always the same object
-
-		TODO: this should be changed, 
+		returns always the same object.  It uses the connection of
+		this thread (see :attr:`conn`), and moves with it from the
+		snapshot to MySQL, so that the session and :meth:`execute`
+		always read the same database.
 		"""
 
-		session = getattr(threadlocal, "session", None)
+		session = self._thread.session
 		if session:
 			return session
-		elif self.engine:
-			Session = sqlalchemy.orm.sessionmaker(bind=self.engine)
+		elif self.conn:
+			Session = sqlalchemy.orm.sessionmaker(bind=self.conn)
 			session = Session()
-			setattr(threadlocal, "session", session)
+			sqlalchemy.event.listen(session, 'before_flush',
+				self.flushing)
+			sqlalchemy.event.listen(session, 'after_flush',
+				self.flushed)
+			self._thread.session = session
 			return session
 		else:
 			return None
@@ -257,53 +425,234 @@ class Database(object):
 		It closes the session and release all its resources. This
 		does not close or release the connection (see :meth:`close`)
 		"""
-		session = getattr(threadlocal, "session", None)
+		session = self._thread.session
 		if session:
 			session.close()
-			setattr(threadlocal, "session", None)
-			return
-		return
+			self._thread.session = None
 
 
 	def commit(self):
 		"""
-		Commit the current session if it existsi. *It does not touch the
-		connection.*
+		Commit the current session, if it exists, and the transaction
+		of the connection (see :meth:`begin`) unless it is held by
+		:meth:`beginTransaction`.
 		"""
-		session = self.getSession()
+		session = self._thread.session
+		thread = self._thread
+		if not thread.hold:
+			if session:
+				session.flush()
+			# with the change, see rocks.db.snapshot
+			if self._written:
+				self._countGeneration()
 		if session:
 			session.commit()
+		if thread.transaction and not thread.hold:
+			# the next statement starts the next transaction
+			transaction = thread.transaction
+			thread.transaction = None
+			# a session used across a commit may have started
+			# the transaction itself, then it is committed
+			if thread.conn.in_transaction():
+				transaction.commit()
+		if self._written and not thread.hold:
+			self._written = False
+			self._export = True
+			self._stamp()
+			if not thread.scoped:
+				self.exportSnapshot(wait=False)
+
+	def flush(self):
+		"""
+		Writes what is pending in the session to the connection,
+		without committing it, so that SQL statements see it.
+		"""
+		session = self._thread.session
+		if session:
+			session.flush()
+
+	def rollback(self):
+		"""
+		Throws away what is in the session and on the connection
+		and not committed yet, unless the transaction is held by
+		:meth:`beginTransaction`.
+		"""
+		session = self._thread.session
+		if session:
+			session.rollback()
+		thread = self._thread
+		if thread.transaction and not thread.hold:
+			transaction = thread.transaction
+			thread.transaction = None
+			if thread.conn.in_transaction():
+				transaction.rollback()
+		if not thread.hold:
+			self._written = False
+			self._generation = None
+		self.changed()
+
+	def begin(self, readonly=False):
+		"""
+		Starts the transaction of a command: from the first statement
+		on the connection until :meth:`commit` everything is one
+		transaction, reads see one snapshot of the database and the
+		writes are committed once.  Returns False if a transaction
+		was already begun, then :meth:`end` must not be called.
+
+		A readonly command reads the local snapshot of the database
+		if there is one (see :mod:`rocks.db.snapshot`), until it runs
+		a statement the snapshot cannot answer.
+
+		Usage Example::
+
+		  if db.begin():
+			try:
+				...
+				db.commit()
+			finally:
+				db.end()
+		"""
+		thread = self._thread
+		if thread.scoped:
+			return False
+		thread.scoped = True
+		if readonly:
+			thread.snapshot = self._connectSnapshot()
+			thread.readonly = thread.snapshot is not None
+		return True
+
+	def end(self):
+		"""
+		Ends the transaction of :meth:`begin`, what was not committed
+		is rolled back.
+		"""
+		thread = self._thread
+		try:
+			if thread.snapshot:
+				self._closeSnapshot()
+			if thread.transaction or \
+				(thread.conn and thread.conn.in_transaction()):
+				self.rollback()
+		finally:
+			thread.scoped = False
+		if self._export:
+			self.exportSnapshot(wait=False)
+
+	def beginTransaction(self):
+		"""
+		Holds the transaction, so that what the SQL statements and
+		the session write stays uncommitted until
+		:meth:`endTransaction`.  :meth:`commit` does not end it.
+		"""
+		self.commit()
+		thread = self._thread
+		if self.conn and not thread.transaction:
+			thread.transaction = self.conn.begin()
+		thread.hold = True
+
+	def endTransaction(self, commit=True):
+		"""
+		Commits or rolls back the transaction of
+		:meth:`beginTransaction`.
+		"""
+		thread = self._thread
+		if not thread.hold:
+			return
+		thread.hold = False
+		if commit:
+			self.commit()
 		else:
-			# no need to manually commit with sqlalchemy if using execute
-			# http://docs.sqlalchemy.org/en/rel_0_9/core/connections.html#understanding-autocommit
-			pass
+			self.rollback()
+
+	def inTransaction(self):
+		"""
+		Returns whether the transaction is held by
+		:meth:`beginTransaction`.
+		"""
+		return self._thread.hold
 
-	def execute(self, command):
+	def execute(self, command, params=None):
 		"""
 		Given a SQL string it run the query and returns the rowcount.
 		To get the result use :meth:`fetchone` or :meth:`fetchall`.
 
 		:type command: string
-		:param command: if verbose should be set to True
+		:param command: the SQL statement, with a %s for each of
+				the params if there are any
+
+		:type params: tuple
+		:param params: the values for the %s in command, they are
+			       quoted by the driver (a literal % in command
+			       has to be %% then)
 
 		:rtype: int
 		:return: the rowconunt of the query or None if there is not
                          connection
+
+		Usage Example::
+
+		  db.execute('select id from nodes where name=%s', (host, ))
 		"""
+		verb = command.split(None, 1)[:1]
+		read = verb and verb[0].lower() in READS
+
+		if self._thread.readonly:
+			if read:
+				lite = rocks.db.snapshot.statement(command,
+					params)
+			else:
+				lite = None
+			if lite:
+				(sql, args) = lite
+				try:
+					self.results = rocks.db.snapshot.Rows(
+						self.conn.execute(sql, *args))
+					return self.results.rowcount
+				except sqlalchemy.exc.DBAPIError:
+					pass
+			self.leaveSnapshot()
+
 		if self.conn:
-			if '%' in command:
-				command = string.replace(command, '%', '%%')
+			if not read:
+				self._written = True
+				self.changed()
+			if params is None:
+				if '%' in command:
+					command = string.replace(command, '%', '%%')
+				args = ()
+			else:
+				args = (tuple(params), )
 			try:
-				self.results = self.conn.execute(command)
+				self.results = self.conn.execute(command, *args)
 			except sqlalchemy.exc.OperationalError as e:
 				# the database disconnected us, let's try to reconnect once
 				self.renewConnection()
-				self.results = self.conn.execute(command)
+				self.results = self.conn.execute(command, *args)
 			# rowcont should not be used it is not portable
 			# http://docs.sqlalchemy.org/en/rel_0_9/core/connections.html#sqlalchemy.engine.ResultProxy.rowcount
 			return self.results.rowcount
 		else:
 			return None
+
+	def executemany(self, command, paramsList):
+		"""
+		Runs command once for every tuple in paramsList, in one round
+		trip where the driver can (an insert becomes a single
+		multi-row insert).  Returns the rowcount.
+
+		Usage Example::
+
+		  db.executemany('insert into aliases (node, name) '
+			'values (%s, %s)', [ (1, 'www'), (1, 'mail') ])
+		"""
+		paramsList = [ tuple(params) for params in paramsList ]
+		self.leaveSnapshot()
+		if not self.conn or not paramsList:
+			return None
+		self._written = True
+		self.changed()
+		self.results = self.conn.execute(command, paramsList)
+		return self.results.rowcount
 	
 	def fetchone(self):
 		"""
@@ -338,14 +687,166 @@ class Database(object):
 		if self.results:
 			self.results.close()
 			self.results = None
-		if self.conn:
-			self.conn.close()
+		self._thread.transaction = None
+		if self._thread.conn:
+			self._thread.conn.close()
+
+	def reset(self):
+		"""
+		Forgets everything about the last command but keeps the
+		connection, for processes that run many commands (rocksd).
+		Uncommitted changes in the session are discarded.
+		"""
+		if self.results:
+			self.results.close()
+			self.results = None
+		self.endTransaction(commit=False)
+		if self._thread.scoped:
+			self.end()
+		self.closeSession()
+		self._failed = False
+		self.memo.clear()
+
+	def leaveSnapshot(self):
+		"""
+		The rest of the command runs on MySQL, both the SQL
+		statements and the session.
+		"""
+		thread = self._thread
+		if not thread.readonly:
+			return
+		thread.readonly = False
+		if thread.session:
+			thread.session.bind = self.conn
+
+	def flushing(self, session, *args):
+		"""Called before the session writes to the database."""
+		if session.new or session.dirty or session.deleted:
+			self.leaveSnapshot()
+
+	def flushed(self, *args):
+		"""Called after the session wrote to the database."""
+		self._written = True
+		self.changed()
+
+	def changed(self, *args):
+		"""
+		Called for every write to the database, either a SQL
+		statement that is not a query or a flush of the session.
+		It forgets the memoized command results.
+		"""
+		self.memo.clear()
+
+	def isLocal(self):
+		"""
+		Returns whether this is the cluster database and mysqld runs
+		on this host.
+		"""
+		return self.getDBName() == 'cluster' and os.path.exists(SOCKET)
+
+	def _connectSnapshot(self):
+		"""
+		Returns a connection to the snapshot, or None if there is
+		none or it misses a change (see rocks.db.snapshot.fresh).
+		MySQL is not asked, the check is local.
+		"""
+		file = rocks.db.snapshot.path()
+		if not file or not os.path.exists(file) or \
+			self.getDBName() != 'cluster':
+			return None
+		if not self._snapshotEngine or self._snapshotFile != file:
+			self._snapshotFile = file
+			self._snapshotEngine = create_engine('sqlite:///' + file)
+			sqlalchemy.event.listen(self._snapshotEngine, 'connect',
+				rocks.db.snapshot.connected)
+			rocks.db.audit.install(self._snapshotEngine)
+		try:
+			snapshot = self._snapshotEngine.connect()
+		except sqlalchemy.exc.DBAPIError:
+			return None
+		if not rocks.db.snapshot.fresh(snapshot, file):
+			snapshot.close()
+			return None
+		return snapshot
+
+	def _countGeneration(self):
+		"""
+		Counts up the generation of the database in the transaction
+		of the change, so the snapshot is not used until it has it.
+		"""
+		if self._noGeneration or self.getDBName() != 'cluster' or \
+			not self.conn:
+			return
+		try:
+			self.conn.execute('update snapshot '
+				'set Generation = Generation + 1')
+			self._generation = \
+				rocks.db.snapshot.generation(self.conn)
+		except sqlalchemy.exc.DBAPIError:
+			# a database made before the table, see rocks
+			# migrate schema
+			self._noGeneration = True
+
+	def _stamp(self):
+		"""
+		Writes the generation of the committed change into the
+		stamp next to the snapshot, from then on the commands do not
+		read the snapshot until it has the change.
+		"""
+		file = rocks.db.snapshot.path()
+		if file and self.isLocal() and self._generation is not None:
+			rocks.db.snapshot.mark(file, self._generation)
+		self._generation = None
+
+	def _closeSnapshot(self):
+		thread = self._thread
+		# the session may be bound to the snapshot
+		self.closeSession()
+		thread.readonly = False
+		thread.snapshot.close()
+		thread.snapshot = None
+
+	def exportSnapshot(self, force=False, wait=True):
+		"""
+		Writes the snapshot of the database (see
+		:mod:`rocks.db.snapshot`).  Done after a command committed a
+		change, nothing is done if the snapshot is at the generation
+		of the database already, unless force is set, or if this
+		user cannot write it (the commands then read MySQL until
+		the snapshot is written again).  If writing fails the old
+		snapshot is removed, so that it is not used anymore.
+
+		Unless wait is set the snapshot is written by a process of
+		its own (see rocks.db.snapshot.detach), the commands read
+		MySQL until it is done.
+		"""
+		self._export = False
+		file = rocks.db.snapshot.path()
+		if not file or not self.isLocal() or not self.conn or \
+			not rocks.db.snapshot.writable(file):
+			return
+		start = time.time()
+		if not wait:
+			rocks.db.snapshot.detach()
+			rocks.trace.timed('snapshot', time.time() - start)
+			return
+		try:
+			rocks.db.snapshot.export(self.conn, file, force)
+		except Exception, e:
+			sys.stderr.write('warning - cannot write %s: %s\n' %
+				(file, e))
+			try:
+				os.unlink(file)
+			except OSError:
+				pass
+		rocks.trace.timed('snapshot', time.time() - start)
 
 	def renewConnection(self):
 		"""
 		It renews the connection, if inactive for few hours mysql
 		closes down the connection, so you might need to renew it.
 		"""
+		self.closeSession()
 		self.close()
 		self.conn = self.engine.connect()
 
@@ -65,6 +65,12 @@ import string
 from rocks.db.mappings.base import *
 from sqlalchemy import or_, and_
 
+try:
+	# native attribute resolver from librocks
+	import _librocks
+except ImportError:
+	_librocks = None
+
 
 attr_postfix = "_old"
 
@@ -91,6 +97,28 @@ class DatabaseHelper(rocks.db.database.Database):
 		self._frontend = None
 		# dictionary to cache attributes
 		self._cacheAttrs = {}
+		# native attribute resolver, see _getAttrResolver
+		self._attrResolver = None
+
+
+	def changed(self, *args):
+		# any write may change the attribute tables
+		self._attrResolver = None
+		super(DatabaseHelper, self).changed(*args)
+
+
+	def commit(self):
+		self._attrResolver = None
+		super(DatabaseHelper, self).commit()
+
+
+	def reset(self):
+		self._appliances_list = None
+		self._attribute = None
+		self._frontend = None
+		self._cacheAttrs = {}
+		self._attrResolver = None
+		super(DatabaseHelper, self).reset()
 
 
 	def getListHostnames(self):
@@ -162,10 +190,11 @@ class DatabaseHelper(rocks.db.database.Database):
 			# If we're looking for managed nodes only, filter out
 			# the unmanaged ones using host attributes
 			if managed_only:
+				attrs = self.getHostsAttrs(list)
 				managed_list = []
 				for hostname in list:
-					if self.getHostAttr(hostname,
-						'managed') == 'true':
+					if attrs[hostname.name].get('managed') \
+						== 'true':
 						managed_list.append(hostname)
 				return managed_list
 			return list
@@ -305,7 +334,7 @@ class DatabaseHelper(rocks.db.database.Database):
 
 		if hostname:
 			rows = self.execute("""select * from nodes where
-				name='%s'""" % hostname)
+				name=%s""", (hostname, ))
 			if rows:
 				return hostname
 
@@ -348,7 +377,7 @@ class DatabaseHelper(rocks.db.database.Database):
 
 		if not addr and self.conn:
 			self.execute("""select name from nodes
-				where name="%s" """ % hostname)
+				where name=%s""", (hostname, ))
 			if self.fetchone():
 				return hostname
 
@@ -358,7 +387,7 @@ class DatabaseHelper(rocks.db.database.Database):
 			row = self.execute("""select n.name
 					from nodes n, aliases ali
 					where n.id = ali.node
-					and ali.name='%s'""" % hostname)
+					and ali.name=%s""", (hostname, ))
 
 			if row == 1:
 				(hostname, ) = self.fetchone()
@@ -370,7 +399,7 @@ class DatabaseHelper(rocks.db.database.Database):
 			self.execute("""select nodes.name from
 				networks,nodes where
 				nodes.id = networks.node and
-				networks.mac = '%s' """ % (hostname))
+				networks.mac = %s""", (hostname, ))
 			try:
 				hostname, = self.fetchone()
 				return hostname
@@ -389,11 +418,10 @@ class DatabaseHelper(rocks.db.database.Database):
 					'networks nt, subnets s where '	+\
 					'nt.subnet=s.id and '		+\
 					'nt.node=n.id and '		+\
-					's.dnszone="%s" and ' % (domain)+\
-					'(nt.name="%s" or n.name="%s")'  \
-					% (name, name)
+					's.dnszone=%s and '		+\
+					'(nt.name=%s or n.name=%s)'
 
-				self.execute(cmd)
+				self.execute(cmd, (domain, name, name))
 			try:
 				hostname, = self.fetchone()
 				return hostname
@@ -460,12 +488,12 @@ class DatabaseHelper(rocks.db.database.Database):
 		if self.conn:
 			rows = self.execute('select nodes.name from '
 				'networks,nodes where '
-				'nodes.id=networks.node and ip="%s"' % (addr))
+				'nodes.id=networks.node and ip=%s', (addr, ))
 			if not rows:
 				rows = self.execute('select nodes.name ' 
 					'from networks,nodes where '
 					'nodes.id=networks.node and '
-					'networks.name="%s"' % (hostname))
+					'networks.name=%s', (hostname, ))
 				if not rows:
 					raise rocks.util.HostnotfoundException(\
 						'host "%s" is not in cluster' % hostname)
@@ -768,27 +796,144 @@ class DatabaseHelper(rocks.db.database.Database):
 		else:
 			assert False, "hostname must be either a string with a hostname or a Node"
 
+		resolver = self._getAttrResolver()
+		if resolver:
+			resolved = resolver.resolve([(hostname, node.os, appliance)],
+				showsource)[0]
+		else:
+			resolved = {}
+			for (attr, value, type) in self.conn.execute(\
+					text(sql_attribute_query), host=hostname):
+				if showsource:
+					resolved[attr] = (value, type)
+				else:
+					resolved[attr] = value
+
+		return self._hostAttrs(hostname, node.rack, node.rank, appliance,
+			membership, resolved, showsource)
+
+
+	def getHostsAttrs(self, hosts=None, showsource=False):
+		"""
+		like :meth:`getHostAttrs` but it resolves the attributes of
+		many hosts at once. With the native resolver from librocks the
+		attribute tables are read only once for all the hosts.
+
+		:type hosts: list
+		:param hosts: a list of hostnames or of
+			      :class:`rocks.db.mappings.base.Node`, if None
+			      all the hosts in the cluster are used
+
+		:type showsource: bool
+		:param showsource: see :meth:`getHostAttrs`
+
+		:rtype: dict
+		:return: a dictionary with the hostname as key and the
+			 attribute dictionary of the host as value
+		"""
+
+		if hosts is not None and not hosts:
+			return {}
+
+		resolver = self._getAttrResolver()
+		if not resolver:
+			result = {}
+			if hosts is None:
+				hosts = self.getListHostnames()
+			for host in hosts:
+				attrs = self.getHostAttrs(host, showsource)
+				if showsource:
+					result[attrs['hostname'][0]] = attrs
+				else:
+					result[attrs['hostname']] = attrs
+			return result
+
+		query = self.getSession().query(Node.name, Node.os, Node.rack,
+				Node.rank, Appliance.name, Membership.name)\
+				.join(Node.membership)\
+				.join(Membership.appliance)
+		if hosts:
+			names = [isinstance(h, Node) and h.name or h for h in hosts]
+			query = query.filter(Node.name.in_(names))
+		rows = query.all()
+
+		resolved = resolver.resolve([(name, os, appliance) \
+			for (name, os, rack, rank, appliance, membership) in rows],
+			showsource)
+
+		result = {}
+		for i in range(0, len(rows)):
+			(name, os, rack, rank, appliance, membership) = rows[i]
+			result[name] = self._hostAttrs(name, rack, rank, appliance,
+				membership, resolved[i], showsource)
+		return result
+
+
+	def iterHostsAttrs(self, hosts, showsource=False, chunk=500):
+		"""
+		like :meth:`getHostsAttrs` but yields (hostname, attributes)
+		in the order of hosts, resolving chunk hosts at a time so
+		only the attributes of those are kept in memory.
+
+		:type hosts: list
+		:param hosts: a list of hostnames or of
+			      :class:`rocks.db.mappings.base.Node`
+		"""
+
+		for i in range(0, len(hosts), chunk):
+			part = hosts[i:i + chunk]
+			attrs = self.getHostsAttrs(part, showsource)
+			for host in part:
+				name = isinstance(host, Node) and host.name or host
+				yield (name, attrs[name])
+
+
+	def _getAttrResolver(self):
+		"""
+		Returns a :class:`_librocks.AttrResolver` loaded with the
+		current attribute tables, or None if librocks is not available.
+		The tables are read once and the resolver is kept until the
+		next commit or write (see :meth:`changed`).
+		"""
+		if not _librocks or not self.conn:
+			return None
+		if self._attrResolver:
+			return self._attrResolver
+
+		tables = []
+		for query in [ 'select ID, Name from categories',
+				'select Category, Precedence from resolvechain',
+				'select ID, Category, Name from catindex',
+				'select Attr, Value, Category, Catindex from attributes' ]:
+			self.execute(query)
+			tables.append(self.fetchall())
+		self._attrResolver = _librocks.AttrResolver(*tables)
+		return self._attrResolver
+
+
+	def _hostAttrs(self, hostname, rack, rank, appliance, membership,
+			resolved, showsource):
+		"""
+		Builds the attribute dictionary of a host from its resolved
+		attributes, adding the intrinsic ones.
+		"""
+
 		attrs = {}
 		if showsource:
 			attrs['hostname']	= (hostname, 'I')
-			attrs['rack']		= (str(node.rack), 'I')
-			attrs['rank']		= (str(node.rank), 'I')
+			attrs['rack']		= (str(rack), 'I')
+			attrs['rank']		= (str(rank), 'I')
 			attrs['appliance']	= (appliance, 'I')
 			attrs['membership']	= (membership, 'I')
 
 		else:
 			attrs['hostname']	= hostname
-			attrs['rack']		= str(node.rack)
-			attrs['rank']		= str(node.rank)
+			attrs['rack']		= str(rack)
+			attrs['rank']		= str(rank)
 			attrs['appliance']	= appliance
 			attrs['membership']	= membership
 
-		for (attr, value, type) in self.conn.execute(text(sql_attribute_query),\
-				host=hostname):
-			if showsource:
-				attrs[attr]     = (value, type)
-			else:
-				attrs[attr]     = value
+		attrs.update(resolved)
 
 		# TODO cache attributes tables for speed
 		# self._cacheAttrs[node.name] = attrs
@@ -834,6 +979,9 @@ class DatabaseHelper(rocks.db.database.Database):
 #
 # this query should be substituted with the tuple
 # (host, host)
+#
+# Between categories of the same precedence the last row wins, the one
+# with the higher category ID (the native resolver does the same).
 sql_attribute_query = """
 select a.attr, a.value, UPPER(SUBSTRING(c.Name, 1, 1)) as category
 from attributes a, resolvechain r, categories c, hostselections hs,
@@ -845,5 +993,6 @@ from attributes a, resolvechain r, categories c, hostselections hs,
 where a.attr = sub.attr and a.category = r.category
  and sub.maxprec = r.precedence and a.category = hs.category 
  and a.catindex = hs.selection and c.id = hs.category
- and hs.host = :host;
+ and hs.host = :host
+order by r.precedence, a.category;
 """
@@ -0,0 +1,536 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+The local snapshot of the cluster database.
+
+After a command has committed a change to the database the tables are
+copied into an SQLite file (:data:`PATH`) by a process of its own (see
+:func:`detach`), and the read-only commands (list, report, dump) read
+that file instead of talking to MySQL.  They do not connect to mysqld
+unless the snapshot cannot answer a query, and they still work when it
+is down.
+
+Only the tables every user can read are copied (not the secure
+attributes, see rocks-db-perms.py), so the file is readable by
+everyone.  A query the snapshot cannot answer (a MySQL extension, a
+table that is not in it) or would answer differently (a division) is
+run on MySQL instead, see :meth:`rocks.db.database.Database.execute`.
+
+Every commit that changes the database counts up the generation in the
+snapshot table, the snapshot has the generation it was copied at.  The
+committing command also writes its generation into the stamp next to
+the file, which the GROUP can write too, so a change made by a user
+that cannot write the snapshot (apache, for instance) is never missed.
+A command only reads the snapshot if it has the generation of the
+stamp, it checks that without asking MySQL.  Only one process writes
+the snapshot at a time, a writer that finds the file locked leaves the
+work to the one holding it, which copies the database again if the
+generation went up meanwhile.
+
+ROCKS_SNAPSHOT in the environment is either another path for the file
+or "no" to not use the snapshot at all.  Changes made outside the rocks
+commands on this host (the mysql client, scripts using Database without
+begin()) do not write the stamp, they show up in the snapshot after the
+next write command or after "rocks sync snapshot".
+"""
+
+import os
+import re
+import sys
+import grp
+import stat
+import fcntl
+import errno
+import sqlite3
+import tempfile
+import subprocess
+import sqlalchemy.exc
+
+PATH = '/var/opt/rocks/snapshot/cluster.db'
+
+# tables only root can read, they are not in the snapshot
+SECURE = re.compile('sec_[a-zA-Z]*_attributes')
+
+# the users besides root that can change the database (see
+# rocks-db-perms.py), they write the stamp
+GROUP = 'apache'
+
+
+def path():
+	"""Returns the path of the snapshot, or None if it is turned off."""
+	value = os.environ.get('ROCKS_SNAPSHOT')
+	if value is None:
+		return PATH
+	if value.lower() in [ '', 'no', 'off', 'false', '0' ]:
+		return None
+	return value
+
+
+def affinity(type):
+	"""The SQLite type of a column of the MySQL type."""
+	type = type.lower().split('(')[0].strip()
+	if type.endswith('int'):
+		return 'integer'
+	if type in [ 'float', 'double', 'decimal', 'real' ]:
+		return 'real'
+	if type.endswith('blob') or type.endswith('binary'):
+		return 'blob'
+	# compare the strings as MySQL does, see collate()
+	return 'text collate mysql'
+
+
+def value(v):
+	if v is None or isinstance(v, (int, long, float, basestring)):
+		return v
+	return str(v)
+
+
+def generation(conn):
+	"""
+	Returns the generation of the database conn (MySQL or the
+	snapshot), or None if it does not count them.
+	"""
+	try:
+		row = conn.execute('select max(Generation) from snapshot'
+			).fetchone()
+	except sqlalchemy.exc.DBAPIError:
+		return None
+	if not row or row[0] is None:
+		return None
+	return long(row[0])
+
+
+def fileGeneration(file):
+	"""Returns the generation of the snapshot file, or None."""
+	if not os.path.exists(file):
+		return None
+	try:
+		lite = sqlite3.connect(file)
+		try:
+			row = lite.execute('select max(Generation) '
+				'from snapshot').fetchone()
+		finally:
+			lite.close()
+	except sqlite3.Error:
+		return None
+	if not row or row[0] is None:
+		return None
+	return long(row[0])
+
+
+def writable(file):
+	"""Returns whether this process can write the snapshot file."""
+	dir = os.path.dirname(file)
+	while dir and not os.path.exists(dir):
+		dir = os.path.dirname(dir)
+	return os.access(dir or os.curdir, os.W_OK)
+
+
+def stampPath(file):
+	"""The stamp of the snapshot file, next to it."""
+	return os.path.join(os.path.dirname(file), 'stamp')
+
+
+def stamp(file):
+	"""
+	Returns the generation of the database the last change was
+	committed at, as written in the stamp, or None.
+	"""
+	try:
+		f = open(stampPath(file))
+		try:
+			text = f.read().strip()
+		finally:
+			f.close()
+		return long(text)
+	except (IOError, ValueError):
+		return None
+
+
+def mark(file, generation, create=False):
+	"""
+	Writes the generation of a committed change into the stamp,
+	unless it has a later one already.  The stamp can be written
+	by the GROUP, so a change by a user that cannot write the
+	snapshot file is still seen.  Only the writer of the snapshot
+	creates it (create).
+	"""
+	if generation is None:
+		return
+	name = stampPath(file)
+	try:
+		if create:
+			fd = os.open(name, os.O_RDWR | os.O_CREAT, 0664)
+		else:
+			fd = os.open(name, os.O_RDWR)
+	except OSError:
+		return
+	try:
+		fcntl.flock(fd, fcntl.LOCK_EX)
+		if create and os.geteuid() == 0:
+			try:
+				os.fchown(fd, 0, grp.getgrnam(GROUP).gr_gid)
+			except KeyError:
+				pass
+			os.fchmod(fd, 0664)
+		try:
+			current = long(os.read(fd, 64).strip())
+		except ValueError:
+			current = None
+		if current is None or current < generation:
+			os.lseek(fd, 0, os.SEEK_SET)
+			os.ftruncate(fd, 0)
+			os.write(fd, '%d\n' % generation)
+	finally:
+		os.close(fd)
+
+
+def fresh(snapshot, file):
+	"""
+	Returns whether the snapshot (a connection to file) has the
+	changes of the last commit, as far as the stamp knows.
+	"""
+	have   = generation(snapshot)
+	wanted = stamp(file)
+	if have is None or wanted is None:
+		# a database that does not count, or never written
+		return have is None and wanted is None
+	return have >= wanted
+
+
+def export(conn, file=None, force=False):
+	"""
+	Copies the tables of the database conn (a connection to MySQL)
+	into the snapshot file, unless it is at the generation of the
+	database already (force copies anyway).  The file is replaced at
+	once, a command reading the old one keeps reading it.  Returns
+	without waiting if another process is writing the snapshot.
+	"""
+	if not file:
+		file = path()
+	if not file:
+		return
+
+	dir = os.path.dirname(file)
+	if not os.path.exists(dir):
+		os.makedirs(dir, 0755)
+
+	while True:
+		lock = open(os.path.join(dir, '.lock'), 'a')
+		try:
+			try:
+				fcntl.flock(lock, fcntl.LOCK_EX | fcntl.LOCK_NB)
+			except IOError, e:
+				if e.errno not in [ errno.EAGAIN,
+					errno.EACCES ]:
+					raise
+				# the one writing it looks again when done
+				return
+			done = write(conn, file, force)
+			mark(file, done, create=True)
+		finally:
+			lock.close()
+
+		# a commit while the file was locked found it locked
+		wanted = generation(conn)
+		if done is None or wanted is None or wanted <= done:
+			return
+		force = False
+
+
+def detach():
+	"""
+	Runs the export in a process of its own, so the command that
+	committed the change does not wait for the copy.  The process is
+	not a child of the command (nor of rocksd), nobody waits for it.
+	"""
+	pid = os.fork()
+	if pid:
+		os.waitpid(pid, 0)
+		return
+	try:
+		os.setsid()
+		null = open(os.devnull, 'r+')
+		subprocess.Popen([ sys.executable, '-m', 'rocks.db.snapshot' ],
+			stdin=null, stdout=null, stderr=null, close_fds=True,
+			cwd='/')
+	finally:
+		os._exit(0)
+
+
+def write(conn, file, force):
+	"""
+	Writes the snapshot file while holding the lock, returns the
+	generation it has now.
+	"""
+	current = fileGeneration(file)
+	wanted  = generation(conn)
+	if not force and wanted is not None and current == wanted:
+		return current
+
+	(fd, tmp) = tempfile.mkstemp(prefix='.cluster',
+		dir=os.path.dirname(file))
+	os.close(fd)
+
+	try:
+		lite = sqlite3.connect(tmp)
+		lite.text_factory = str
+		lite.create_collation('mysql', collate)
+		lite.execute('pragma journal_mode = off')
+		lite.execute('pragma synchronous = off')
+
+		# one read transaction, so the tables agree with each other
+		# and with the generation
+		transaction = conn.begin()
+		try:
+			wanted = generation(conn)
+			tables = conn.execute('show full tables').fetchall()
+			for (table, kind) in tables:
+				if not SECURE.match(table):
+					copy(conn, lite, table, kind)
+		finally:
+			transaction.rollback()
+
+		lite.commit()
+		lite.close()
+
+		# never go back to an older generation
+		current = fileGeneration(file)
+		if current is not None and wanted is not None and \
+			current > wanted:
+			os.unlink(tmp)
+			return current
+
+		os.chmod(tmp, stat.S_IRUSR | stat.S_IWUSR |
+			stat.S_IRGRP | stat.S_IROTH)
+		os.rename(tmp, file)
+	except:
+		if os.path.exists(tmp):
+			os.unlink(tmp)
+		raise
+	return wanted
+
+
+def copy(conn, lite, table, kind):
+	"""Copies table, its columns, rows and indexes."""
+
+	columns = []
+	for row in conn.execute('show columns from `%s`' % table):
+		columns.append((row[0], row[1]))
+	lite.execute('create table "%s" (%s)' % (table,
+		', '.join([ '"%s" %s' % (name, affinity(type))
+			for (name, type) in columns ])))
+
+	marks = ', '.join([ '?' ] * len(columns))
+	insert = 'insert into "%s" values (%s)' % (table, marks)
+	result = conn.execute('select * from `%s`' % table)
+	while True:
+		rows = result.fetchmany(1000)
+		if not rows:
+			break
+		lite.executemany(insert, [ [ value(v) for v in row ]
+			for row in rows ])
+
+	if kind.upper() != 'BASE TABLE':
+		return
+	indexes = {}
+	for row in conn.execute('show index from `%s`' % table):
+		(name, seq, column) = (row[2], row[3], row[4])
+		indexes.setdefault(name, []).append((seq, column))
+	for (name, keys) in indexes.items():
+		keys.sort()
+		lite.execute('create index "%s_%s" on "%s" (%s)' %
+			(table, name, table,
+			', '.join([ '"%s"' % column
+				for (seq, column) in keys ])))
+
+
+# the string literals of MySQL (in single or double quotes, with
+# backslash escapes) and what MySQLdb fills in the params for
+_token = re.compile('|'.join([
+	r"'(?:[^'\\]|\\.|'')*'",
+	r'"(?:[^"\\]|\\.|"")*"',
+	r'%%|%s',
+	r'/' ]), re.S)
+
+_escapes = { '0': '\0', 'b': '\b', 'n': '\n', 'r': '\r', 't': '\t',
+	'Z': '\x1a' }
+
+
+def literal(text, params):
+	"""
+	Returns the MySQL string literal text as an SQLite one, or None if
+	it cannot be written there.
+	"""
+	(quote, body) = (text[0], text[1:-1])
+	if params is not None:
+		body = body.replace('%%', '%')
+	# MySQL keeps the backslash of \% and \_, for LIKE
+	if '\\%' in body or '\\_' in body:
+		return None
+	body = re.sub(r'\\(.)|' + quote * 2, lambda m: m.group(1) is None
+		and quote or _escapes.get(m.group(1), m.group(1)), body)
+	return "'%s'" % body.replace("'", "''")
+
+
+def statement(command, params):
+	"""
+	Returns the (command, args) for running a statement written for
+	MySQLdb on SQLite, or None if SQLite would not answer it as MySQL
+	does.  The %s of the params are ? there and %% is just %, strings
+	are in single quotes without backslash escapes.  A division gives
+	a decimal in MySQL but an integer in SQLite, so those statements
+	are left to MySQL.
+	"""
+	pieces = []
+	end = 0
+	for match in _token.finditer(command):
+		pieces.append(command[end:match.start()])
+		end = match.end()
+		token = match.group()
+		if token == '/':
+			return None
+		if token in [ '%%', '%s' ]:
+			if params is not None:
+				token = { '%%': '%', '%s': '?' }[token]
+		else:
+			token = literal(token, params)
+			if token is None:
+				return None
+		pieces.append(token)
+	pieces.append(command[end:])
+	command = ''.join(pieces)
+
+	if params is None:
+		return (command, ())
+	return (command, (tuple(params), ))
+
+
+class Rows:
+	"""
+	The rows of a query on the snapshot.  SQLite does not count the
+	rows of a select, the rocks code uses the rowcount as MySQLdb
+	sets it.
+	"""
+
+	def __init__(self, result):
+		if result.returns_rows:
+			self.rows = result.fetchall()
+		else:
+			self.rows = []
+		result.close()
+		self.rowcount = len(self.rows)
+		self.next = 0
+
+	def fetchone(self):
+		if self.next < len(self.rows):
+			self.next += 1
+			return self.rows[self.next - 1]
+		return None
+
+	def fetchall(self):
+		rows = self.rows[self.next:]
+		self.close()
+		return rows
+
+	def close(self):
+		self.rows = []
+		self.next = 0
+
+	def __iter__(self):
+		return iter(self.fetchall())
+
+
+def substring(s, pos, length=None):
+	if s is None:
+		return None
+	if length is None:
+		return s[pos - 1:]
+	return s[pos - 1:pos - 1 + length]
+
+def concat(*args):
+	if None in args:
+		return None
+	return ''.join([ str(a) for a in args ])
+
+
+def collate(a, b):
+	"""
+	Compares the strings as the default collation of MySQL does:
+	without case and without the spaces at the end.
+	"""
+	return cmp(a.rstrip(' ').lower(), b.rstrip(' ').lower())
+
+
+def connected(conn, record):
+	"""
+	Strings come back as str, as from MySQLdb, and compare as there,
+	and the MySQL functions the rocks queries use are there.
+	"""
+	conn.text_factory = str
+	conn.create_collation('mysql', collate)
+	conn.create_function('substring', 3, substring)
+	conn.create_function('substring', 2, substring)
+	conn.create_function('concat', -1, concat)
+
+
+if __name__ == '__main__':
+	# the export of detach()
+	import rocks.db.database
+	database = rocks.db.database.Database()
+	database.connect()
+	database.exportSnapshot()
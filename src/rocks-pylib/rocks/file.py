@@ -336,6 +336,57 @@ import shutil
 import rocks.util
 import xml.sax
 
+try:
+	import _librocks
+except ImportError:
+	_librocks = None
+
+
+# Header tags getRPMHeader() returns when it has to ask rpm for them.
+
+rpmQueryTags = [ 'name', 'version', 'release', 'epoch', 'arch',
+	'buildhost', 'buildtime', 'sigmd5' ]
+
+def getRPMHeader(path):
+	"""Returns the header tags of the RPM at path as a dictionary
+	(name, version, release, prefixes, buildhost, sigmd5, ...), or
+	None if it cannot be read.  The header is read in process when
+	librocks is installed, otherwise this runs rpm."""
+
+	if _librocks:
+		try:
+			return _librocks.rpmheader(path)
+		except OSError:
+			return None
+
+	qf = string.join(map(lambda x: '%%{%s}' % x, rpmQueryTags), '\\n')
+	qf = qf + '\\n[%{PREFIXES}\\n]'
+	f = os.popen("rpm -qp --qf '%s' %s 2> /dev/null" % (qf, path))
+	lines = f.read().split('\n')
+	if f.close() or len(lines) <= len(rpmQueryTags):
+		return None
+
+	header = {}
+	for tag in rpmQueryTags:
+		value = lines.pop(0)
+		if value == '(none)':
+			value = None
+		elif tag in [ 'epoch', 'buildtime' ]:
+			value = int(value)
+		header[tag] = value
+	header['prefixes'] = filter(None, lines)
+	return header
+
+def readRPMHeaders(rpms):
+	"""Reads the headers of a list of RPMFiles in one pass, so later
+	getHeader() calls do not touch the files."""
+
+	if not _librocks:
+		return
+	paths = map(lambda x: x.getFullName(), rpms)
+	for (rpm, header) in zip(rpms, _librocks.rpmheaders(paths)):
+		rpm.header = header
+
 
 class File:
     
@@ -452,8 +503,17 @@ class File:
 
 class RPMBaseFile(File):
 
-	def __init__(self, file, timestamp=None, size=None, ext=1):
+	def __init__(self, file, timestamp=None, size=None, ext=1,
+		parsed=None):
 		File.__init__(self, file, timestamp, size)
+		self.header	= None
+
+		# The native tree scanner already split the name
+
+		if parsed:
+			(self.list, self.version, self.release) = parsed
+			return
+
 		self.list	= []
 
 		# Remove ext count extensions, the default is 1, but for
@@ -514,13 +574,24 @@ class RPMBaseFile(File):
                 # just name w/ arch string appended
 		return '%s-%s' % (self.list[0], self.list[3])
 
+	def getHeader(self):
+		if not self.header:
+			self.header = getRPMHeader(self.getFullName())
+		return self.header
+
+	def getBuildTime(self):
+		header = self.getHeader()
+		if header and header['buildtime'] is not None:
+			return float(header['buildtime'])
+		return self.timestamp
+
 	
 
 
 class RPMFile(RPMBaseFile):
 
-	def __init__(self, file, timestamp=None, size=None):
-		RPMBaseFile.__init__(self, file, timestamp, size)
+	def __init__(self, file, timestamp=None, size=None, parsed=None):
+		RPMBaseFile.__init__(self, file, timestamp, size, 1, parsed)
 	
 	def __cmp__(self, file):
 		if self.getPackageArch() != file.getPackageArch():
@@ -532,12 +603,8 @@ class RPMFile(RPMBaseFile):
 
 		 	if abs(int(self.timestamp) - int(file.timestamp)) < 120 :
 				# print "CMP %s:%s" % (self.getFullName(), file.getFullName())
-				f1=os.popen("rpm -qp --qf '%%{BUILDTIME}' %s" % self.getFullName())
-				self.timestamp=float(f1.readline())
-				f1.close()
-				f2=os.popen("rpm -qp --qf '%%{BUILDTIME}' %s" % file.getFullName())
-				file.timestamp=float(f2.readline())
-				f2.close()
+				self.timestamp = self.getBuildTime()
+				file.timestamp = file.getBuildTime()
 
 			rc = File.__cmp__(self, file)
 
@@ -599,8 +666,8 @@ class RPMFile(RPMBaseFile):
 
 class RollFile(RPMBaseFile):
 
-	def __init__(self, file, timestamp=None, size=None):
-		RPMBaseFile.__init__(self, file, timestamp, size, 2)
+	def __init__(self, file, timestamp=None, size=None, parsed=None):
+		RPMBaseFile.__init__(self, file, timestamp, size, 2, parsed)
 		self.diskID = int(string.split(file, '.')[-2][4:])
 	
 	def __cmp__(self, file):
@@ -761,6 +828,10 @@ class Tree:
 		if not os.path.isdir(path):
 		    return
 
+		if _librocks:
+			self.buildNative(dir)
+			return
+
 		# Handle the case where we don't have permission to traverse
 		# into a tree by pruning off the protected sub-tree.
 		try:
@@ -783,6 +854,38 @@ class Tree:
 					v.append(File(filepath))
 		self.tree[dir] = v
 
+	def buildNative(self, dir):
+		# Same tree as build() but the directories are read, and the
+		# files stat'ed, by a pool of threads in librocks.  Distros
+		# and roll trees have tens of thousands of RPMs.
+
+		path = os.path.join(self.root, dir)
+		try:
+			scan = _librocks.scantree(path)
+		except OSError:
+			return
+
+		for (subdir, entries) in scan:
+			if subdir:
+				key = os.path.join(dir, subdir)
+			else:
+				key = dir
+			dirpath = os.path.join(path, subdir)
+
+			v = []
+			for (f, kind, timestamp, size, parsed) in entries:
+				filepath = os.path.join(dirpath, f)
+				if kind == 1:
+					v.append(RPMFile(filepath, timestamp,
+						size, parsed))
+				elif kind == 2:
+					v.append(RollFile(filepath, timestamp,
+						size, parsed))
+				else:
+					v.append(File(filepath, timestamp,
+						size))
+			self.tree[key] = v
+
 	def dumpDirNames(self):
 		for key in self.tree.keys():
 		    print key
@@ -0,0 +1,277 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+The profile=yes parameter of every rocks command.  While a command
+runs it counts the SQL statements and the time spent in the database,
+the programs started (subprocess, os.system, os.popen) and the time
+they took, and the commands it runs through Command.command().  When
+it is done the profile is printed on stderr as a table, or as JSON
+with profile-format=json, and with profile-file=FILE also appended to
+FILE as one line of JSON.
+
+Only the outermost profiled command keeps a profile, nested commands
+show up in its list.
+"""
+
+import os
+import sys
+import time
+import json
+import threading
+import subprocess
+import sqlalchemy
+import sqlalchemy.event
+import sqlalchemy.engine
+
+_profile   = None	# the running Profile
+_installed = False	# the hooks below are in place
+
+
+def active():
+	"""Returns the running Profile or None."""
+	return _profile
+
+
+def install():
+	"""
+	Puts the hooks in place, once per process.  They cost one test
+	when no profile is running.
+	"""
+	global _installed
+
+	if _installed:
+		return
+	_installed = True
+
+	def before(conn, cursor, statement, parameters, context, many):
+		if _profile:
+			conn.info.setdefault('rocks.perf', []).append(time.time())
+
+	def after(conn, cursor, statement, parameters, context, many):
+		starts = conn.info.get('rocks.perf')
+		if _profile and starts:
+			_profile.sql(time.time() - starts.pop())
+
+	sqlalchemy.event.listen(sqlalchemy.engine.Engine,
+		'before_cursor_execute', before)
+	sqlalchemy.event.listen(sqlalchemy.engine.Engine,
+		'after_cursor_execute', after)
+
+	wait = subprocess.Popen.wait
+	init = subprocess.Popen.__init__
+
+	def popenInit(self, *args, **kwargs):
+		self._rocksStart = time.time()
+		init(self, *args, **kwargs)
+
+	def popenWait(self, *args, **kwargs):
+		running = self.returncode is None
+		code = wait(self, *args, **kwargs)
+		start = getattr(self, '_rocksStart', None)
+		if _profile and running and start:
+			_profile.program(time.time() - start)
+		return code
+
+	subprocess.Popen.__init__ = popenInit
+	subprocess.Popen.wait = popenWait
+
+	system = os.system
+	popen  = os.popen
+
+	def timedSystem(command):
+		t = time.time()
+		code = system(command)
+		if _profile:
+			_profile.program(time.time() - t)
+		return code
+
+	def countedPopen(*args):
+		if _profile:
+			_profile.program(0.0)
+		return popen(*args)
+
+	os.system = timedSystem
+	os.popen  = countedPopen
+
+
+class Profile:
+	"""
+	What one command (and everything it runs) spent its time on.
+	"""
+
+	def __init__(self, name):
+		self.name	= name
+		self.lock	= threading.Lock()
+		self.sqlCount	= 0
+		self.sqlTime	= 0.0
+		self.progCount	= 0
+		self.progTime	= 0.0
+		self.commands	= []	# [ depth, name, seconds, memoized ]
+		self.depth	= 0
+		self.wall	= 0.0
+		self.cpu	= 0.0
+		self.childCpu	= 0.0
+
+	def start(self):
+		global _profile
+
+		install()
+		self.begin = time.time()
+		self.times = os.times()
+		_profile = self
+
+	def stop(self):
+		global _profile
+
+		_profile = None
+		times = os.times()
+		self.wall     = time.time() - self.begin
+		self.cpu      = max(times[0] + times[1] -
+				self.times[0] - self.times[1], 0.0)
+		self.childCpu = max(times[2] + times[3] -
+				self.times[2] - self.times[3], 0.0)
+
+	def sql(self, seconds):
+		self.lock.acquire()
+		self.sqlCount += 1
+		self.sqlTime  += seconds
+		self.lock.release()
+
+	def program(self, seconds):
+		self.lock.acquire()
+		self.progCount += 1
+		self.progTime  += seconds
+		self.lock.release()
+
+	def enter(self, name):
+		"""
+		Called when a nested command starts, returns its entry in
+		the list of commands to give to leave().
+		"""
+		self.lock.acquire()
+		self.depth += 1
+		entry = [ self.depth, name, time.time(), False ]
+		self.commands.append(entry)
+		self.lock.release()
+		return entry
+
+	def leave(self, entry, memoized=False):
+		self.lock.acquire()
+		self.depth -= 1
+		entry[2] = time.time() - entry[2]
+		entry[3] = memoized
+		self.lock.release()
+
+	def dict(self):
+		d = {}
+		d['command']		= self.name
+		d['time']		= time.time()
+		d['wall']		= self.wall
+		d['cpu']		= self.cpu
+		d['children_cpu']	= self.childCpu
+		d['sql_count']		= self.sqlCount
+		d['sql_time']		= self.sqlTime
+		d['programs']		= self.progCount
+		d['program_time']	= self.progTime
+		d['commands']		= []
+		for (depth, name, seconds, memoized) in self.commands:
+			d['commands'].append({ 'depth': depth,
+				'command': name, 'wall': seconds,
+				'memoized': memoized })
+		return d
+
+	def table(self):
+		ms = lambda s: '%10.1f ms' % (s * 1000)
+		lines = []
+		lines.append('profile of "%s":' % self.name)
+		lines.append('\t%-24s %s' % ('wall', ms(self.wall)))
+		lines.append('\t%-24s %s' % ('cpu', ms(self.cpu)))
+		lines.append('\t%-24s %s' % ('children cpu',
+			ms(self.childCpu)))
+		lines.append('\t%-24s %s  %d statements' % ('sql',
+			ms(self.sqlTime), self.sqlCount))
+		lines.append('\t%-24s %s  %d started' % ('programs',
+			ms(self.progTime), self.progCount))
+		if self.commands:
+			lines.append('\tcommands:')
+		for (depth, name, seconds, memoized) in self.commands:
+			if memoized:
+				name += ' (memoized)'
+			lines.append('\t%s%-*s %s' % ('  ' * depth,
+				max(24 - 2 * depth, 1), name, ms(seconds)))
+		return '\n'.join(lines) + '\n'
+
+	def report(self, format='table', file=None):
+		"""
+		Prints the profile on stderr and appends it to file (a
+		path) if given.
+		"""
+		if format == 'json':
+			sys.stderr.write('%s\n' % json.dumps(self.dict(),
+				indent=4))
+		else:
+			sys.stderr.write(self.table())
+		sys.stderr.flush()
+
+		if file:
+			try:
+				f = open(file, 'a')
+				f.write('%s\n' % json.dumps(self.dict(),
+					separators=(',', ':')))
+				f.close()
+			except IOError, e:
+				sys.stderr.write('profile-file: %s\n' % e)
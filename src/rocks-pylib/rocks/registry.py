@@ -0,0 +1,317 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+The command registry maps every rocks command (the tuple of its words)
+to its module, so the command line finds a command with one dictionary
+lookup instead of trying to import every prefix of the command line,
+and "rocks list help" does not have to import every command to print
+their usage.
+
+The registry is built when rocks-pylib is installed ("python -m
+rocks.registry") and kept in rocks/commands.registry.  Rolls install
+their own commands later, so nothing in it is trusted blindly: a
+command is only used if its __init__.py has not changed since it was
+registered, and :func:`commands` brings the whole registry up to date
+(importing only what changed) before it is listed.
+
+Next to it rocks/commands.plugins keeps the order the plugins of each
+command run in, with the mtimes of the plugin files it was worked out
+from.
+"""
+
+import os
+import sys
+import stat
+import string
+import marshal
+import rocks
+
+VERSION	= 1
+FILE	= 'commands.registry'
+PLUGINS	= 'commands.plugins'
+
+_registry = None
+_plugins  = None
+
+
+def commandsDir():
+	return os.path.join(os.path.dirname(os.path.abspath(rocks.__file__)),
+		'commands')
+
+
+def mtime(path):
+	try:
+		return os.stat(os.path.join(path, '__init__.py'))[stat.ST_MTIME]
+	except OSError:
+		return None
+
+
+def scan(base=None):
+	"""
+	Returns the {words: mtime} of every command package under base.
+	"""
+	if not base:
+		base = commandsDir()
+	dirs = {}
+	for (path, subdirs, files) in os.walk(base):
+		if '__init__.py' not in files:
+			subdirs[:] = []
+			continue
+		if path != base:
+			words = tuple(path[len(base) + 1:].split(os.sep))
+			dirs[words] = mtime(path)
+	return dirs
+
+
+def describe(words, mtime):
+	"""
+	Imports the command and returns its registry entry.  The entry of
+	a module that does not import has a command of None, it is
+	described again next time.
+	"""
+	name  = 'rocks.commands.%s' % string.join(words, '.')
+	entry = { 'module': name, 'mtime': mtime, 'command': None,
+		'root': None, 'roll': None, 'usage': None }
+	try:
+		__import__(name)
+		module = sys.modules[name]
+	except Exception:
+		return entry
+
+	cls = getattr(module, 'Command', None)
+	entry['command'] = cls is not None
+	entry['roll']	 = getattr(module, 'RollName', None)
+	if cls:
+		entry['root']  = cls.MustBeRoot
+		try:
+			entry['usage'] = cls(None).usage()
+		except Exception:
+			entry['usage'] = '-- invalid doc string --'
+	return entry
+
+
+def build(base=None, old={}):
+	"""
+	Returns the registry of the commands under base, reusing the
+	entries of old for the commands that did not change.
+	"""
+	registry = {}
+	for (words, mtime) in scan(base).items():
+		entry = old.get(words)
+		if not entry or entry['mtime'] != mtime or \
+			entry['command'] is None:
+			entry = describe(words, mtime)
+		registry[words] = entry
+	return registry
+
+
+def load(base=None):
+	"""
+	Returns the saved registry, or None if there is none we can use.
+	"""
+	global _registry
+
+	if _registry is None:
+		if not base:
+			base = commandsDir()
+		_registry = read(os.path.join(os.path.dirname(base), FILE))
+	return _registry
+
+
+def save(registry, base=None):
+	global _registry
+
+	if not base:
+		base = commandsDir()
+	write(os.path.join(os.path.dirname(base), FILE), registry)
+	_registry = registry
+
+
+def write(path, data):
+	tmp  = '%s.%d' % (path, os.getpid())
+	file = open(tmp, 'wb')
+	try:
+		marshal.dump((VERSION, data), file)
+	finally:
+		file.close()
+	os.rename(tmp, path)
+
+
+def read(path):
+	"""
+	Returns the data saved in path by :func:`write`, or None.
+	"""
+	try:
+		file = open(path, 'rb')
+		try:
+			(version, data) = marshal.load(file)
+		finally:
+			file.close()
+	except (IOError, EOFError, ValueError, TypeError):
+		return None
+	if version != VERSION:
+		return None
+	return data
+
+
+def lookup(args, base=None):
+	"""
+	Returns (module, i) for the command in args, where args[i:] are its
+	arguments, or None if the registry does not know (for sure).
+
+	A command found in the registry is only used if it has not changed
+	and args[:i + 1] is not a command package the registry does not know
+	about (a command a roll added later), otherwise the caller has to
+	look for the command itself.
+	"""
+	registry = load(base)
+	if not registry:
+		return None
+	if not base:
+		base = commandsDir()
+
+	words = tuple(args[0].split())
+	if len(words) > 1 and registry.has_key(words):
+		i = 1
+	else:
+		for i in range(len(args), 0, -1):
+			words = tuple(args[:i])
+			if registry.has_key(words):
+				break
+		else:
+			return None
+
+	entry = registry[words]
+	path  = os.path.join(base, *words)
+	if entry['mtime'] != mtime(path):
+		return None
+	if i < len(args) and i == len(words) and \
+		os.path.exists(os.path.join(path, args[i], '__init__.py')):
+		return None
+	return (entry['module'], i)
+
+
+def commands(base=None):
+	"""
+	Returns the registry brought up to date with the commands installed
+	now, and saves it if it changed (and we can).
+	"""
+	old	 = load(base) or {}
+	registry = build(base, old)
+	if registry != old:
+		try:
+			save(registry, base)
+		except (IOError, OSError):
+			pass
+	return registry
+
+
+def pluginFiles(dir):
+	"""
+	Returns the {file: mtime} of the plugin_*.py files in dir.
+	"""
+	files = {}
+	for file in os.listdir(dir):
+		if file.split('_')[0] != 'plugin':
+			continue
+		if os.path.splitext(file)[1] != '.py':
+			continue
+		try:
+			files[file] = os.stat(os.path.join(dir, file))[stat.ST_MTIME]
+		except OSError:
+			pass
+	return files
+
+
+def pluginOrder(module, files):
+	"""
+	Returns the plugin modules of the command module in the order they
+	run, or None if it is not known for these files.
+	"""
+	global _plugins
+
+	if _plugins is None:
+		path = os.path.join(os.path.dirname(commandsDir()), PLUGINS)
+		_plugins = read(path) or {}
+	entry = _plugins.get(module)
+	if not entry or entry[0] != files:
+		return None
+	return entry[1]
+
+
+def savePluginOrder(module, files, order):
+	"""
+	Remembers the order of the plugin modules of the command module,
+	in this process and (if we can) in the plugin manifest.
+	"""
+	if pluginOrder(module, files) == order:
+		return
+	_plugins[module] = (files, order)
+	try:
+		write(os.path.join(os.path.dirname(commandsDir()), PLUGINS),
+			_plugins)
+	except (IOError, OSError):
+		pass
+
+
+if __name__ == "__main__":
+	# python -m rocks.registry [rocks/commands directory]
+	if len(sys.argv) > 1:
+		base = os.path.abspath(sys.argv[1])
+	else:
+		base = commandsDir()
+	save(build(base), base)
@@ -0,0 +1,577 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+rocksd runs rocks commands for the rocks client, so a "rocks ..." does
+not have to start python, import sqlalchemy and the command modules and
+connect to the database every time.
+
+The master listens on a unix socket and hands every connection to a
+worker running as the user on the other end (SO_PEERCRED), so commands
+see the same uid, database account and root/apache checks they would
+see without the daemon.  Workers are forked from the master with the
+modules already imported, keep their database connection between
+commands, and exit when they have been idle for a while.  When a package
+changes the modules underneath them the master lets the busy workers
+finish and starts over (rocks-pylib and librocks also restart the
+service from their scriptlets).
+
+The wire protocol is described in librocks/include/rocksd.h.  Commands
+the daemon does not want to run (because they need sudo, or because all
+the workers are busy) are passed back to the client, which then runs
+them the classic way.
+"""
+
+import os
+import sys
+import pwd
+import grp
+import errno
+import fcntl
+import select
+import signal
+import socket
+import struct
+import syslog
+import time
+import threading
+import traceback
+import rocks.cli
+import rocks.trace
+
+try:
+	import _librocks
+except ImportError:
+	_librocks = None
+
+SOCKET	 = '/var/run/rocksd.sock'
+WORKERS	 = 8		# at most this many commands at once
+IDLE	 = 300		# seconds before an idle worker exits
+REQUESTS = 1000		# commands a worker runs before it exits
+CHECK	 = 10		# seconds between looks for upgraded modules
+
+MAGIC	= 'RKD1'
+STATUS	= 'RKDX'
+RUNIT	= 'RKDF'
+HEADER	= 8
+
+# not in the socket module of python 2
+SO_PEERCRED = getattr(socket, 'SO_PEERCRED', 17)
+
+
+def preload():
+	"""
+	Imports every command module, so the workers forked later have
+	them all loaded.  Modules that do not import are left for the
+	command line to complain about.
+	"""
+	try:
+		import sqlalchemy
+		import rocks.db.helper
+	except ImportError:
+		pass
+
+	import rocks.commands
+	base = os.path.dirname(rocks.commands.__file__)
+	watch = [ os.path.dirname(base) ]
+	if _librocks:
+		watch.append(os.path.dirname(_librocks.__file__))
+	for (path, dirs, files) in os.walk(base):
+		dirs.sort()
+		if '__init__.py' not in files:
+			dirs[:] = []
+			continue
+		watch.append(path)
+		name = path[len(base):].replace(os.sep, '.')
+		try:
+			__import__('rocks.commands' + name)
+		except Exception:
+			pass
+	return watch
+
+
+def stamp(dirs):
+	"""
+	The newest mtime of dirs.  Installing a package renames its files
+	into place, which changes the mtime of the directories they are in.
+	"""
+	newest = 0
+	for path in dirs:
+		try:
+			newest = max(newest, os.stat(path).st_mtime)
+		except OSError:
+			newest = -1
+	return newest
+
+
+def recvall(sock, n):
+	data = ''
+	while len(data) < n:
+		chunk = sock.recv(n - len(data))
+		if not chunk:
+			break
+		data += chunk
+	return data
+
+
+class Worker:
+	"""
+	Runs the commands handed to it on ctl by the master, as uid/gid.
+	"""
+
+	def __init__(self, ctl, uid, gid, idle=IDLE, requests=REQUESTS):
+		self.ctl	= ctl
+		self.uid	= uid
+		self.gid	= gid
+		self.idle	= idle
+		self.requests	= requests
+		self.database	= None
+		self.running	= False
+		self.interrupted = False
+
+
+	def become(self):
+		"""
+		Detaches from the master and becomes the user we work for.
+		A session of our own lets ^C reach the command and what it
+		runs, and nothing else.
+		"""
+		os.setsid()
+		if os.getuid() == self.uid:
+			return
+		try:
+			name = pwd.getpwuid(self.uid)[0]
+			os.setgid(self.gid)
+			os.initgroups(name, self.gid)
+		except KeyError:
+			os.setgid(self.gid)
+			os.setgroups([ self.gid ])
+		os.setuid(self.uid)
+
+
+	def serve(self):
+		self.become()
+		signal.signal(signal.SIGTERM, signal.SIG_DFL)
+		signal.signal(signal.SIGCHLD, signal.SIG_DFL)
+		signal.signal(signal.SIGINT, self.interrupt)
+		syslog.openlog('rockscommand', syslog.LOG_PID, syslog.LOG_LOCAL0)
+
+		for i in range(0, self.requests):
+			(r, w, x) = select.select([ self.ctl ], [], [], self.idle)
+			if not r or not self.next():
+				break
+			self.ctl.sendall('D')
+			if self.interrupted:
+				break
+
+		# Tell the master we are leaving, then run whatever it sent
+		# us before it noticed.
+		try:
+			self.ctl.shutdown(socket.SHUT_WR)
+		except socket.error:
+			pass
+		while self.next():
+			pass
+		syslog.closelog()
+
+
+	def next(self):
+		"""
+		Runs the next connection the master sends us, returns False
+		when it has no more.
+		"""
+		(data, fds) = _librocks.recvfds(self.ctl.fileno(), 1)
+		if not data:
+			return False
+		if fds:
+			conn = socket.fromfd(fds[0], socket.AF_UNIX,
+				socket.SOCK_STREAM)
+			os.close(fds[0])
+			try:
+				self.request(conn)
+			finally:
+				conn.close()
+		return True
+
+
+	def interrupt(self, signum, frame):
+		if self.running:
+			raise KeyboardInterrupt
+
+
+	def request(self, conn):
+		"""
+		Reads a request from conn, runs it and sends back the exit
+		status.
+		"""
+		(head, fds) = _librocks.recvfds(conn.fileno(), HEADER)
+		head += recvall(conn, HEADER - len(head))
+		if len(head) < HEADER or head[:4] != MAGIC or len(fds) != 3:
+			for fd in fds:
+				os.close(fd)
+			return
+		(length, ) = struct.unpack('<I', head[4:])
+		body = recvall(conn, length)
+		fields = body.split('\0')[:-1]
+		try:
+			cwd   = fields[0]
+			mask  = int(fields[1], 8)
+			argc  = int(fields[2])
+			argv  = fields[3:3 + argc]
+			env   = fields[3 + argc:]
+		except (IndexError, ValueError):
+			fields = None
+		if len(body) < length or not fields or len(argv) < argc:
+			for fd in fds:
+				os.close(fd)
+			return
+
+		status = self.run(conn, fds, cwd, mask, argv, env)
+		if status is rocks.cli.FALLBACK:
+			reply = RUNIT + struct.pack('<I', 0)
+		else:
+			reply = STATUS + struct.pack('<I', status & 0xffffffff)
+		try:
+			conn.sendall(reply)
+		except socket.error:
+			pass
+
+
+	def run(self, conn, fds, cwd, mask, argv, env):
+		"""
+		Runs argv as the client would have: with its stdin, stdout,
+		stderr, directory, umask and environment.
+		"""
+		sys.stdout.flush()
+		sys.stderr.flush()
+		saved = [ os.dup(0), os.dup(1), os.dup(2) ]
+		for i in range(0, 3):
+			os.dup2(fds[i], i)
+			os.close(fds[i])
+		stdio	= (sys.stdin, sys.stdout, sys.stderr)
+		environ = os.environ.copy()
+		sysargv = sys.argv
+
+		os.environ.clear()
+		for var in env:
+			(key, sep, value) = var.partition('=')
+			if sep:
+				os.environ[key] = value
+		try:
+			os.chdir(cwd)
+		except OSError:
+			os.chdir('/')
+		os.umask(mask)
+		sys.argv  = [ 'rocks' ] + argv
+		sys.stdin = os.fdopen(os.dup(0), 'r')
+
+		(stop, wake) = os.pipe()
+		watcher = threading.Thread(target=self.watch, args=(conn, stop))
+		watcher.start()
+
+		try:
+			try:
+				rocks.trace.start()
+				if not self.database:
+					self.database = rocks.cli.connect()
+				self.running = True
+				try:
+					status = rocks.cli.run(self.database,
+						argv, daemon=True)
+				finally:
+					self.running = False
+				rocks.trace.report()
+			except SystemExit, e:
+				if e.code is None:
+					status = 0
+				elif isinstance(e.code, int):
+					status = e.code
+				else:
+					print >> sys.stderr, e.code
+					status = 1
+			except:
+				traceback.print_exc()
+				status = 1
+			try:
+				sys.stdout.flush()
+				sys.stderr.flush()
+			except IOError:
+				pass
+		finally:
+			os.write(wake, 'x')
+			watcher.join()
+			os.close(stop)
+			os.close(wake)
+
+			sys.stdin.close()
+			(sys.stdin, sys.stdout, sys.stderr) = stdio
+			sys.argv  = sysargv
+			os.environ.clear()
+			os.environ.update(environ)
+			os.chdir('/')
+			for i in range(0, 3):
+				os.dup2(saved[i], i)
+				os.close(saved[i])
+			if self.database:
+				self.database.reset()
+		return status
+
+
+	def watch(self, conn, stop):
+		"""
+		Interrupts the command if the client got a signal (it sends
+		us the number) or went away.
+		"""
+		while True:
+			try:
+				(r, w, x) = select.select([ conn, stop ], [], [])
+				break
+			except select.error, e:
+				if e.args[0] != errno.EINTR:
+					return
+		if conn in r:
+			self.interrupted = True
+			os.killpg(0, signal.SIGINT)
+
+
+class Master:
+	"""
+	Listens on path and hands the connections to the workers, at most
+	workers of them at once.
+	"""
+
+	def __init__(self, path=SOCKET, workers=WORKERS, idle=IDLE,
+			requests=REQUESTS):
+		self.path	= path
+		self.workers	= workers
+		self.idle	= idle
+		self.requests	= requests
+		self.pool	= {}	# ctl socket -> [ pid, (uid, gid), busy ]
+		self.listener	= None
+		self.watch	= []
+		self.stamp	= 0
+		self.checked	= 0
+		self.restart	= False
+
+
+	def listen(self):
+		if os.path.exists(self.path):
+			os.unlink(self.path)
+		self.listener = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+		fcntl.fcntl(self.listener.fileno(), fcntl.F_SETFD,
+			fcntl.FD_CLOEXEC)
+		self.listener.bind(self.path)
+		os.chmod(self.path, 0666)
+		self.listener.listen(128)
+
+
+	def serve(self):
+		signal.signal(signal.SIGTERM, self.terminate)
+		signal.signal(signal.SIGPIPE, signal.SIG_IGN)
+		self.watch   = preload()
+		self.stamp   = stamp(self.watch)
+		self.checked = time.time()
+		self.listen()
+		syslog.syslog(syslog.LOG_INFO, 'rocksd listening on %s' %
+			self.path)
+		try:
+			while not self.restart or self.pool:
+				self.upgraded()
+				try:
+					(r, w, x) = select.select(
+						[ self.listener ] +
+						self.pool.keys(), [], [], CHECK)
+				except select.error, e:
+					if e.args[0] == errno.EINTR:
+						continue
+					raise
+				for sock in r:
+					if sock is self.listener:
+						self.accept()
+					else:
+						self.done(sock)
+		finally:
+			self.shutdown()
+
+		# everything is new again: modules, workers and the socket
+		syslog.syslog(syslog.LOG_INFO, 'rocksd restarting for upgraded '
+			'modules')
+		os.execv(sys.executable, [ sys.executable ] + sys.argv)
+
+
+	def upgraded(self):
+		"""
+		Notices packages that changed the command tree or the python
+		modules (rolls with new commands included).  From then on
+		commands go back to the client, idle workers are stopped and
+		the master starts over once the busy ones are done.
+		"""
+		if self.restart or time.time() - self.checked < CHECK:
+			return
+		self.checked = time.time()
+		if stamp(self.watch) == self.stamp:
+			return
+		self.restart = True
+		for (sock, (pid, key, busy)) in self.pool.items():
+			if not busy:
+				self.retire(sock)
+
+
+	def terminate(self, signum, frame):
+		sys.exit(0)
+
+
+	def shutdown(self):
+		self.listener.close()
+		if os.path.exists(self.path):
+			os.unlink(self.path)
+		for (sock, (pid, key, busy)) in self.pool.items():
+			sock.close()
+			try:
+				os.kill(pid, signal.SIGTERM)
+				os.waitpid(pid, 0)
+			except OSError:
+				pass
+		self.pool = {}
+
+
+	def accept(self):
+		try:
+			(conn, addr) = self.listener.accept()
+		except socket.error:
+			return
+		try:
+			creds = conn.getsockopt(socket.SOL_SOCKET, SO_PEERCRED,
+				struct.calcsize('3i'))
+			(pid, uid, gid) = struct.unpack('3i', creds)
+			sock = None
+			if not self.restart:
+				sock = self.worker((uid, gid))
+			if sock:
+				_librocks.sendfds(sock.fileno(), 'C',
+					[ conn.fileno() ])
+				self.pool[sock][2] = True
+			else:
+				conn.sendall(RUNIT + struct.pack('<I', 0))
+		except (socket.error, OSError):
+			pass
+		conn.close()
+
+
+	def worker(self, key):
+		"""
+		Returns the control socket of an idle worker for key, a new
+		one if there is room for it, otherwise None.  Commands that
+		call rocks commands never wait for a worker this way.
+		"""
+		for (sock, (pid, owner, busy)) in self.pool.items():
+			if owner == key and not busy:
+				return sock
+		if len(self.pool) >= self.workers:
+			return None
+		if os.getuid() != 0 and key[0] != os.getuid():
+			return None
+
+		(sock, child) = socket.socketpair(socket.AF_UNIX,
+			socket.SOCK_STREAM)
+		pid = os.fork()
+		if pid == 0:
+			status = 0
+			try:
+				try:
+					sock.close()
+					self.listener.close()
+					for s in self.pool.keys():
+						s.close()
+					Worker(child, key[0], key[1], self.idle,
+						self.requests).serve()
+				except:
+					traceback.print_exc()
+					status = 1
+			finally:
+				os._exit(status)
+		child.close()
+		self.pool[sock] = [ pid, key, False ]
+		return sock
+
+
+	def done(self, sock):
+		"""
+		A worker finished a command, or exited.
+		"""
+		try:
+			data = sock.recv(64)
+		except socket.error:
+			data = ''
+		if data:
+			self.pool[sock][2] = False
+			if self.restart:
+				self.retire(sock)
+			return
+		self.retire(sock)
+
+
+	def retire(self, sock):
+		"""
+		Closes the control socket of a worker that is not running
+		anything, which makes it exit, and waits for it.
+		"""
+		(pid, key, busy) = self.pool.pop(sock)
+		sock.close()
+		try:
+			os.waitpid(pid, 0)
+		except OSError:
+			pass
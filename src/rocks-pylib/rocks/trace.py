@@ -0,0 +1,158 @@
+#
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+#
+
+"""
+Startup tracing for the rocks command line.  With ROCKS_STARTUP_TRACE
+set in the environment, the time a command spends in each phase
+(starting python, imports, finding the command, connecting to the
+database, running it and printing the output) is printed on stderr when
+it is done.  This module is imported before everything else, keep it
+small.
+"""
+
+import os
+import sys
+import time
+
+_phases	 = []		# [ name, seconds ] in the order they happened
+_last	 = None
+_nested	 = 0.0		# timed() since the last mark
+_enabled = False
+
+
+def processStart():
+	"""
+	Returns when this process was started (clock tick resolution),
+	or None if we cannot tell.
+	"""
+	try:
+		stat   = open('/proc/self/stat').read()
+		ticks  = float(stat[stat.rindex(')') + 2:].split()[19])
+		uptime = float(open('/proc/uptime').read().split()[0])
+		return time.time() - (uptime - ticks / os.sysconf('SC_CLK_TCK'))
+	except (IOError, OSError, ValueError, IndexError):
+		return None
+
+
+def start(process=False):
+	"""
+	Starts tracing if ROCKS_STARTUP_TRACE is set.  With process the
+	time python took to start this process is the first phase.
+	"""
+	global _phases, _last, _nested, _enabled
+
+	_enabled = os.environ.has_key('ROCKS_STARTUP_TRACE')
+	_phases	 = []
+	_nested	 = 0.0
+	_last	 = time.time()
+	if _enabled and process:
+		begin = processStart()
+		if begin is not None:
+			_phases.append([ 'interpreter', max(_last - begin, 0.0) ])
+
+
+def enabled():
+	return _enabled
+
+
+def mark(name):
+	"""
+	Ends the phase called name: the time since the last mark, less what
+	was already timed() inside it.
+	"""
+	global _last, _nested
+
+	if not _enabled:
+		return
+	now = time.time()
+	add(name, now - _last - _nested)
+	_last	= now
+	_nested = 0.0
+
+
+def timed(name, seconds):
+	"""
+	Adds seconds to the phase called name, for work (a database
+	connection) that happens somewhere inside another phase.
+	"""
+	global _nested
+
+	if not _enabled:
+		return
+	add(name, seconds)
+	_nested += seconds
+
+
+def add(name, seconds):
+	for phase in _phases:
+		if phase[0] == name:
+			phase[1] += seconds
+			return
+	_phases.append([ name, seconds ])
+
+
+def report(file=None):
+	if not _enabled:
+		return
+	if not file:
+		file = sys.stderr
+	total = 0.0
+	file.write('rocks startup trace:\n')
+	for (name, seconds) in _phases:
+		file.write('\t%-12s %9.1f ms\n' % (name, seconds * 1000))
+		total += seconds
+	file.write('\t%-12s %9.1f ms\n' % ('total', total * 1000))
+	file.flush()
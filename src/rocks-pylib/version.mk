@@ -1,4 +1,5 @@
 NAME = rocks-pylib
 RELEASE = 7
 RPM.ARCH	= noarch
-RPM.FILES = "/opt/rocks/bin/*\\n/opt/rocks/lib/python2*/site-packages/rocks\\n/opt/rocks/lib/python2*/site-packages/rocks_pylib*"
+RPM.FILES = "/opt/rocks/bin/*\\n/opt/rocks/lib/python2*/site-packages/rocks\\n/opt/rocks/lib/python2*/site-packages/rocks_pylib*\\n/etc/systemd/system/rocksd.service"
+RPM.SCRIPTLETS.FILE = scriptlets
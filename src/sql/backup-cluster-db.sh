@@ -1,7 +1,9 @@
 #!/bin/bash
 #
-# Script to backup the mysql Cluster database, and 
-# check in changes to RCS.
+# Script to backup the mysql Cluster database: a full dump once a week
+# and the binary logs (the changes to the rows) since the last backup
+# every other day, compressed.  restore-cluster-db restores a full
+# backup and replays the binary logs up to any point in time.
 # 
 # @Copyright@
 # 
@@ -117,12 +119,106 @@
 #
 
 export HOME=/root
-cd /var/db
+set -o pipefail
 
-/opt/rocks/mysql/bin/mysqldump --defaults-extra-file=/root/.rocks.my.cnf -u root --opt cluster > mysql-backup-cluster
+MYSQL=/opt/rocks/mysql/bin/mysql
+MYSQLDUMP=/opt/rocks/mysql/bin/mysqldump
+MYSQLOPTS="--defaults-extra-file=/root/.rocks.my.cnf -u root"
 
-# To check in multiple versions, you need to have a lock on the
-# file. RCS will automatically ignore checkins for unchanged files.
-ci -l -t-'Rocks Cluster Database' -m`date +"%Y-%m-%d"` mysql-backup-cluster > /dev/null 2>&1
+BACKUP=${BACKUP:-/var/db/cluster-backup}
+FULLDAYS=7	# days between full backups
+KEEP=4		# full backups kept, with the binary logs after them
 
-/bin/chmod -R go-rwx mysql-backup-cluster RCS
+# zstd if it is there, gzip otherwise (restore-cluster-db reads both)
+if type -p zstd > /dev/null; then
+	COMPRESS="zstd -q -c"
+	EXT=zst
+else
+	COMPRESS="gzip -c"
+	EXT=gz
+fi
+
+umask 077
+mkdir -p $BACKUP
+cd $BACKUP || exit 1
+
+sql() {
+	$MYSQL $MYSQLOPTS -B -N -e "$1"
+}
+
+#
+# Dumps the database, with the binary log position the dump is at
+# in a .pos file next to it (mysqldump --master-data).  The binary
+# logs from there on are what the following backups copy.
+#
+full() {
+	name=full-`date +%Y%m%d-%H%M%S`
+	opts="--opt --single-transaction --routines"
+	if [ "$LOGBIN" = 1 ]; then
+		opts="$opts --flush-logs --master-data=2"
+	fi
+
+	$MYSQLDUMP $MYSQLOPTS $opts cluster | $COMPRESS > .$name.sql.$EXT ||
+		{ rm -f .$name.sql.$EXT; exit 1; }
+	mv .$name.sql.$EXT $name.sql.$EXT
+
+	rm -f next-binlog
+	if [ "$LOGBIN" = 1 ]; then
+		$COMPRESS -d $name.sql.$EXT 2> /dev/null | head -100 | sed -n \
+		"s/.*MASTER_LOG_FILE='\([^']*\)', MASTER_LOG_POS=\([0-9]*\).*/\1 \2/p" \
+			> $name.pos
+		awk '{print $1}' $name.pos > next-binlog
+	fi
+
+	# the oldest full backups go, and the binary logs before the
+	# oldest one left
+	ls -1 full-*.sql.* | sort -r | tail -n +$((KEEP + 1)) | \
+	while read old; do
+		rm -f $old ${old%.sql.*}.pos
+	done
+	oldest=`ls -1 full-*.pos 2> /dev/null | sort | head -1`
+	if [ -n "$oldest" ]; then
+		first=`awk '{print $1}' $oldest`
+		for log in binlog.*; do
+			[ -f "$log" ] || continue
+			[[ "${log%.*}" < "$first" ]] && rm -f $log
+		done
+	fi
+}
+
+#
+# Copies the binary logs written since the last backup.  The one
+# mysqld writes is closed first, so it is complete.
+#
+incremental() {
+	sql "flush binary logs" || exit 1
+	dir=`dirname \`sql "select @@log_bin_basename"\``
+	active=`sql "show master status" | awk '{print $1}'`
+	next=`cat next-binlog`
+
+	copy=no
+	for log in `sql "show binary logs" | awk '{print $1}'`; do
+		[ "$log" = "$active" ] && break
+		[ "$log" = "$next" ] && copy=yes
+		[ $copy = yes ] || continue
+		$COMPRESS $dir/$log > .$log.$EXT || { rm -f .$log.$EXT; exit 1; }
+		mv .$log.$EXT $log.$EXT
+	done
+	echo $active > next-binlog
+}
+
+LOGBIN=`sql "select @@log_bin"` || exit 1
+
+#
+# A full backup when asked for ("full" argument), when mysqld has no
+# binary log, when the last full one is too old, or when the binary
+# log the last backup stopped at is gone (expire_logs_days).
+#
+if [ "$1" = full -o "$LOGBIN" != 1 -o ! -s next-binlog ] || \
+	[ -z "`find . -maxdepth 1 -name 'full-*' -mtime -$FULLDAYS`" ] || \
+	! sql "show binary logs" | awk '{print $1}' | \
+		grep -qx "`cat next-binlog`"; then
+	full
+else
+	incremental
+fi
@@ -0,0 +1,172 @@
+#!/bin/bash
+#
+# $Id$
+#
+# Restores the mysql Cluster database from the backups of
+# backup-cluster-db: a full backup and the binary logs after it, up to
+# a point in time.
+# 
+# @Copyright@
+# 
+# 				Rocks(r)
+# 		         www.rocksclusters.org
+# 		         version 6.2 (SideWinder)
+# 		         version 7.0 (Manzanita)
+# 
+# Copyright (c) 2000 - 2017 The Regents of the University of California.
+# All rights reserved.	
+# 
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are
+# met:
+# 
+# 1. Redistributions of source code must retain the above copyright
+# notice, this list of conditions and the following disclaimer.
+# 
+# 2. Redistributions in binary form must reproduce the above copyright
+# notice unmodified and in its entirety, this list of conditions and the
+# following disclaimer in the documentation and/or other materials provided 
+# with the distribution.
+# 
+# 3. All advertising and press materials, printed or electronic, mentioning
+# features or use of this software must display the following acknowledgement: 
+# 
+# 	"This product includes software developed by the Rocks(r)
+# 	Cluster Group at the San Diego Supercomputer Center at the
+# 	University of California, San Diego and its contributors."
+# 
+# 4. Except as permitted for the purposes of acknowledgment in paragraph 3,
+# neither the name or logo of this software nor the names of its
+# authors may be used to endorse or promote products derived from this
+# software without specific prior written permission.  The name of the
+# software includes the following terms, and any derivatives thereof:
+# "Rocks", "Rocks Clusters", and "Avalanche Installer".  For licensing of 
+# the associated name, interested parties should contact Technology 
+# Transfer & Intellectual Property Services, University of California, 
+# San Diego, 9500 Gilman Drive, Mail Code 0910, La Jolla, CA 92093-0910, 
+# Ph: (858) 534-5815, FAX: (858) 534-7345, E-MAIL:invent@ucsd.edu
+# 
+# THIS SOFTWARE IS PROVIDED BY THE REGENTS AND CONTRIBUTORS ``AS IS''
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+# THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR
+# PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE REGENTS OR CONTRIBUTORS
+# BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+# CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+# SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR
+# BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+# WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE
+# OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN
+# IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+# 
+# @Copyright@
+#
+
+usage() {
+	echo "usage: restore-cluster-db [-n] [-d dir] [-t 'YYYY-MM-DD HH:MM:SS'] [full-backup]"
+	echo
+	echo "  -d dir   where the backups are (default /var/db/cluster-backup)"
+	echo "  -t time  restore the database as it was at time (default: the"
+	echo "           last change in the backups)"
+	echo "  -n       only show what would be done"
+	echo
+	echo "  Without full-backup the last full backup before time is used."
+	exit 1
+}
+
+export HOME=/root
+set -o pipefail
+
+MYSQL=/opt/rocks/mysql/bin/mysql
+MYSQLBINLOG=/opt/rocks/mysql/bin/mysqlbinlog
+MYSQLOPTS="--defaults-extra-file=/root/.rocks.my.cnf -u root"
+
+BACKUP=${BACKUP:-/var/db/cluster-backup}
+UNTIL=
+DRYRUN=
+
+while getopts "nd:t:" opt; do
+	case $opt in
+	n)	DRYRUN=echo ;;
+	d)	BACKUP=$OPTARG ;;
+	t)	UNTIL=$OPTARG ;;
+	*)	usage ;;
+	esac
+done
+shift $((OPTIND - 1))
+[ $# -gt 1 ] && usage
+
+cd $BACKUP || exit 1
+
+decompress() {
+	case $1 in
+	*.zst)	zstd -q -d -c $1 ;;
+	*.gz)	gzip -d -c $1 ;;
+	*)	cat $1 ;;
+	esac
+}
+
+#
+# The full backup: the one given, or the last one taken before UNTIL
+# (the time is in the name, full-YYYYMMDD-HHMMSS.sql).
+#
+if [ -n "$1" ]; then
+	full=`basename $1`
+else
+	limit=full-99999999-999999
+	if [ -n "$UNTIL" ]; then
+		limit=full-`date -d "$UNTIL" +%Y%m%d-%H%M%S` || exit 1
+	fi
+	full=`ls -1 full-*.sql.* 2> /dev/null | sort | \
+		awk -v limit="$limit" '{ split($0, n, "."); if (n[1] <= limit) print }' | \
+		tail -1`
+fi
+if [ ! -f "$full" ]; then
+	echo "error - no full backup in $BACKUP" >&2
+	exit 1
+fi
+
+#
+# The binary logs to replay: from the position of the full backup on.
+#
+pos=${full%.sql.*}.pos
+logs=
+if [ -s $pos ]; then
+	read first start < $pos
+	for log in `ls -1 binlog.* 2> /dev/null | sort`; do
+		[[ "${log%.*}" < "$first" ]] || logs="$logs $log"
+	done
+fi
+
+echo "restoring $full"
+for log in $logs; do
+	echo "replaying $log"
+done
+[ -n "$UNTIL" ] && echo "stopping at $UNTIL"
+[ -n "$DRYRUN" ] && exit 0
+
+# what is restored does not go in the binary log, so the next backup
+# has to be a full one
+(echo "set sql_log_bin = 0;"; decompress $full) | \
+	$MYSQL $MYSQLOPTS cluster || exit 1
+rm -f next-binlog
+
+if [ -n "$logs" ]; then
+	tmp=`mktemp -d` || exit 1
+	trap "rm -rf $tmp" EXIT
+	for log in $logs; do
+		decompress $log > $tmp/${log%.*} || exit 1
+	done
+
+	# one mysqlbinlog for all of them, a temporary table can span
+	# two logs.  --start-position is for the first one only.
+	opts="--database=cluster --disable-log-bin --start-position=$start"
+	if [ -n "$UNTIL" ]; then
+		$MYSQLBINLOG $opts --stop-datetime="$UNTIL" $tmp/* | \
+			$MYSQL $MYSQLOPTS || exit 1
+	else
+		$MYSQLBINLOG $opts $tmp/* | $MYSQL $MYSQLOPTS || exit 1
+	fi
+fi
+
+# the local snapshot the list and report commands read
+/opt/rocks/bin/rocks sync snapshot
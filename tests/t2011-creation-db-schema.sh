@@ -6,7 +6,8 @@
 test_description='Test creation of the database schema
 
 Test the generation of a rocks database with the schema contained in 
-node/database-schema.sh'
+node/database-schema.sh, with the binary log on as in my.cnf, where
+MySQL only takes functions that declare what they do with the data.'
 
 pushd `dirname $0` > /dev/null
 export TEST_DIRECTORY=`pwd`
@@ -18,6 +19,11 @@ NODES_DIR=$TEST_DIRECTORY/../nodes
 
 attrs="{'os':'linux'}"
 
+mysql_root(){
+	/opt/rocks/mysql/bin/mysql --defaults-extra-file=/root/.rocks.my.cnf \
+		--user=root --batch --skip-column-names "$@"
+}
+
 # need to hack the database-schema to create the tables 
 # in our tempdb instead of the standard cluster db
 test_expect_success 'test create db - setup' '
@@ -29,6 +35,10 @@ test_expect_success 'test create db - setup' '
 		bash
 '
 
+test_expect_success 'test create db - binary log is on' '
+	test "`mysql_root -e "select @@log_bin, @@log_bin_trust_function_creators"`" = "1	0"
+'
+
 test_expect_success 'test create db - test schema' '
 	echo entering /tmp/tables.sql &&
 	/opt/rocks/mysql/bin/mysql --defaults-extra-file=/root/.rocks.my.cnf \
@@ -39,6 +49,18 @@ test_expect_success 'test create db - test schema' '
 
 '
 
+test_expect_success 'test create db - functions' '
+	global=`mysql_root tempdb -e "select ID from categories
+		where Name=\"global\""` &&
+	test -n "$global" &&
+	out=`mysql_root tempdb -e "select mapCategory(\"global\")"` &&
+	test "$out" = "$global" &&
+	linux=`mysql_root tempdb -e "select ci.ID from catindex ci, categories c
+		where ci.Category=c.ID and c.Name=\"os\" and ci.Name=\"linux\""` &&
+	test -n "$linux" &&
+	out=`mysql_root tempdb -e "select mapCategoryIndex(\"os\", \"linux\")"` &&
+	test "$out" = "$linux"
+'
 
 test_expect_success 'test create db - tear down' '
 	/opt/rocks/mysql/bin/mysqladmin --defaults-extra-file=/root/.rocks.my.cnf --user=root -f drop tempdb
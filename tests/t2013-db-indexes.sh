@@ -0,0 +1,101 @@
+#!/bin/bash
+#
+# Test the indexes of the hot lookup queries
+#
+
+test_description='Test the indexes of the database
+
+rocks migrate schema adds the indexes the host lookups need, and
+running it again changes nothing.  EXPLAIN of the hot queries must
+show an index that can be used for each table, not a full scan.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+node_name="index-node"
+
+mysql_cluster(){
+	/opt/rocks/mysql/bin/mysql --defaults-extra-file=/root/.rocks.my.cnf \
+		--user=root --batch --skip-column-names cluster -e "$1"
+}
+
+# fails unless the query reads table through an index: the key MySQL
+# chose is set and the join type is not a full scan
+# (EXPLAIN columns: id, select_type, table, type, possible_keys, key, ...)
+test_uses_index(){
+	mysql_cluster "explain $2" > explain &&
+	cat explain &&
+	grep -q "	$1	" explain &&
+	! awk -F'\t' -v t="$1" '$3 == t && ($6 == "NULL" || $4 == "ALL")' \
+		explain | grep -q .
+}
+
+
+test_expect_success 'test indexes - set up tests' '
+	rocks add host $node_name cpus=1 membership=compute \
+		os=linux rack=10 rank=10 &&
+	rocks add host interface $node_name eth0 \
+		ip=`rocks report nextip private` \
+		subnet=private mac=66:77:cc:cc:cc:cc name=$node_name
+'
+
+test_expect_success 'test indexes - migrate schema' '
+	rocks migrate schema &&
+	rocks migrate schema dryrun=yes > migrate &&
+	cat migrate &&
+	! grep -q "missing" migrate
+'
+
+test_expect_success 'test indexes - migrate schema twice' '
+	rocks migrate schema > migrate &&
+	! grep -q "added" migrate
+'
+
+test_expect_success 'test indexes - nodes.name' '
+	test_uses_index nodes \
+		"select * from nodes where name=\"$node_name\""
+'
+
+test_expect_success 'test indexes - networks.mac' '
+	test_uses_index networks \
+		"select nodes.name from networks, nodes where
+		nodes.id = networks.node and networks.mac = \"66:77:cc:cc:cc:cc\""
+'
+
+test_expect_success 'test indexes - networks.ip' '
+	test_uses_index networks \
+		"select nodes.name from networks, nodes where
+		nodes.id = networks.node and ip = \"10.1.1.1\""
+'
+
+test_expect_success 'test indexes - networks.name' '
+	test_uses_index networks \
+		"select nodes.name from networks, nodes where
+		nodes.id = networks.node and networks.name = \"$node_name\""
+'
+
+test_expect_success 'test indexes - aliases.name' '
+	test_uses_index ali \
+		"select n.name from nodes n, aliases ali where
+		n.id = ali.node and ali.name = \"$node_name\""
+'
+
+test_expect_success 'test indexes - subnets.name' '
+	test_uses_index subnets \
+		"select * from subnets where name = \"private\""
+'
+
+test_expect_success 'test indexes - attributes' '
+	test_uses_index a \
+		"select a.attr, a.value from attributes a
+		where a.category = 1 and a.catindex = 1"
+'
+
+test_expect_success 'test indexes - tear down' '
+	rocks remove host $node_name
+'
+
+test_done
@@ -0,0 +1,139 @@
+#!/bin/bash
+#
+# Test the local snapshot of the database
+#
+
+test_description='Test the local snapshot of the database
+
+A command that changes the database writes the snapshot, the list and
+report commands read it and give the same output as from mysql, also
+when mysql is turned off.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+node_name="snapshot-node"
+snapshot=/var/opt/rocks/snapshot/cluster.db
+stamp=/var/opt/rocks/snapshot/stamp
+
+# the environment variables have to reach the command
+export ROCKS_NODAEMON=1
+
+snapshot_tables(){
+	/opt/rocks/bin/python -c "
+import sqlite3
+c = sqlite3.connect('$snapshot')
+for (t, ) in c.execute('select name from sqlite_master where type=\"table\"'):
+	print t
+"
+}
+
+# the snapshot is written in the background, wait until it has the
+# generation of the stamp
+wait_snapshot(){
+	for i in `seq 30`; do
+		/opt/rocks/bin/python -c "
+import sys, rocks.db.snapshot
+have = rocks.db.snapshot.fileGeneration('$snapshot')
+wanted = rocks.db.snapshot.stamp('$snapshot')
+sys.exit(have is None or wanted is None or have < wanted)
+" && return 0
+		sleep 1
+	done
+	return 1
+}
+
+# the output of a command from the snapshot and from mysql
+same_output(){
+	rocks "$@" > snapshot.out &&
+	ROCKS_SNAPSHOT=no rocks "$@" > mysql.out &&
+	diff mysql.out snapshot.out
+}
+
+
+test_expect_success 'test snapshot - set up tests' '
+	rm -f $snapshot &&
+	rocks add host $node_name cpus=1 membership=compute \
+		os=linux rack=10 rank=10 &&
+	wait_snapshot &&
+	test_path_is_file $snapshot &&
+	rocks add host interface $node_name eth0 \
+		ip=`rocks report nextip private` \
+		subnet=private mac=66:77:dd:dd:dd:dd name=$node_name &&
+	wait_snapshot
+'
+
+test_expect_success 'test snapshot - written by a change' '
+	rocks list host $node_name > list_host &&
+	grep "^$node_name:" list_host &&
+	rocks list host interface $node_name > list_interface &&
+	grep "66:77:dd:dd:dd:dd" list_interface
+'
+
+test_expect_success 'test snapshot - no secure attributes' '
+	snapshot_tables > tables &&
+	grep "^nodes$" tables &&
+	! grep "^sec_" tables &&
+	test `stat -c %a $snapshot` = 644
+'
+
+test_expect_success 'test snapshot - same output as mysql' '
+	same_output list host &&
+	same_output list host interface &&
+	same_output list host attr &&
+	same_output list network &&
+	same_output report host dhcpd &&
+	same_output dump host
+'
+
+test_expect_success 'test snapshot - same output for a name' '
+	same_output list host $node_name &&
+	same_output list host interface $node_name &&
+	same_output list host attr $node_name &&
+	same_output list host membership $node_name &&
+	same_output list network private &&
+	same_output report host interface $node_name &&
+	same_output report host network $node_name &&
+	same_output dump host interface $node_name
+'
+
+test_expect_success 'test snapshot - sync snapshot' '
+	rm -f $snapshot &&
+	rocks sync snapshot &&
+	test_path_is_file $snapshot
+'
+
+test_expect_success 'test snapshot - change by a user that cannot write it' '
+	rocks set host boot $node_name action=os &&
+	wait_snapshot &&
+	test `stat -c %a:%G $stamp` = 664:apache &&
+	ls -i $snapshot > inode &&
+	su apache -s /bin/bash -c \
+		"/opt/rocks/bin/rocks set host boot $node_name action=install" &&
+	ls -i $snapshot | diff inode - &&
+	rocks list host boot $node_name | grep install &&
+	same_output list host boot &&
+	rocks sync snapshot &&
+	! ls -i $snapshot | diff inode - > /dev/null &&
+	rocks list host boot $node_name | grep install
+'
+
+test_expect_success 'test snapshot - report host dhcpd without mysql' '
+	rocks report host dhcpd localhost > mysql.out &&
+	/etc/init.d/foundation-mysql stop &&
+	rocks report host dhcpd localhost > snapshot.out ;
+	status=$? ;
+	/etc/init.d/foundation-mysql start &&
+	test $status = 0 &&
+	diff mysql.out snapshot.out
+'
+
+test_expect_success 'test snapshot - tear down' '
+	rocks remove host $node_name &&
+	! rocks list host | grep "^$node_name:"
+'
+
+test_done
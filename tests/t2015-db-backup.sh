@@ -0,0 +1,67 @@
+#!/bin/bash
+#
+# Test the database backups
+#
+
+test_description='Test the backup and restore of the database
+
+A full backup, the binary logs after it, and restoring the database
+as it was at a point in time between two changes.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+node_before="backup-node-1"
+node_after="backup-node-2"
+
+export BACKUP=`pwd`/cluster-backup
+
+has_host(){
+	rocks list host | grep "^$1:"
+}
+
+
+test_expect_success 'test backup - full backup' '
+	/etc/cron.daily/backup-cluster-db full &&
+	ls $BACKUP/full-*.sql.* &&
+	test -s $BACKUP/next-binlog
+'
+
+test_expect_success 'test backup - incremental backup' '
+	rocks add host $node_before cpus=1 membership=compute \
+		os=linux rack=11 rank=1 &&
+	/etc/cron.daily/backup-cluster-db &&
+	test `ls $BACKUP/full-*.sql.* | wc -l` = 1 &&
+	ls $BACKUP/binlog.*
+'
+
+test_expect_success 'test backup - second change' '
+	sleep 2 &&
+	date "+%Y-%m-%d %H:%M:%S" > point &&
+	sleep 2 &&
+	rocks add host $node_after cpus=1 membership=compute \
+		os=linux rack=11 rank=2 &&
+	/etc/cron.daily/backup-cluster-db
+'
+
+test_expect_success 'test backup - restore to a point in time' '
+	/opt/rocks/sbin/restore-cluster-db -t "`cat point`" &&
+	has_host $node_before &&
+	! has_host $node_after
+'
+
+test_expect_success 'test backup - restore everything' '
+	/opt/rocks/sbin/restore-cluster-db &&
+	has_host $node_before &&
+	has_host $node_after
+'
+
+test_expect_success 'test backup - tear down' '
+	rocks remove host $node_before &&
+	rocks remove host $node_after
+'
+
+test_done
@@ -0,0 +1,105 @@
+#!/bin/bash
+#
+# Test the conversion of the database to the rocks8 schema
+#
+
+test_description='Test the conversion to the rocks8 schema
+
+The database is converted from MySQL to a rocks8 database, and every
+host resolves to the same attributes on both.  The secure attributes go
+to a database of their own, so the snapshot, which has none, is refused.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+rocks8db=$TEST_DIRECTORY/../rocks8db
+node_name="rocks8-node"
+attr_name="rocks8-attr"
+
+command -v python3 > /dev/null && test_set_prereq PYTHON3
+python3 -c "import sqlalchemy, MySQLdb" 2> /dev/null && test_set_prereq MYSQL3
+
+
+test_expect_success 'test rocks8 - set up tests' '
+	rocks add host $node_name cpus=1 membership=compute \
+		os=linux rack=12 rank=1 &&
+	rocks add attr $attr_name global &&
+	rocks add appliance attr compute $attr_name appliance &&
+	rocks add host attr $node_name $attr_name host &&
+	rocks set host sec_attr $node_name attr=$attr_name value=secret \
+		crypted=true &&
+	rocks sync snapshot
+'
+
+test_expect_success PYTHON3 'test rocks8 - snapshot is refused' '
+	test_must_fail $rocks8db/migrate7.py \
+		--source /var/opt/rocks/snapshot/cluster.db snapshot8.db &&
+	test_path_is_missing snapshot8.db
+'
+
+test_expect_success MYSQL3 'test rocks8 - convert and verify' '
+	$rocks8db/migrate7.py --verify rocks8.db &&
+	test -s rocks8.db &&
+	test `stat -c %a rocks8-sec.db` = 600 &&
+	echo secret > expected &&
+	python3 -c "
+import sqlite3
+c = sqlite3.connect(\"rocks8-sec.db\")
+print(c.execute(\"select value from secattrs where reskey = ? and attr = ?\",
+	(\"$node_name\", \"$attr_name\")).fetchone()[0])
+" > actual &&
+	diff expected actual
+'
+
+test_expect_success MYSQL3 'test rocks8 - resolve a host' '
+	echo host > expected &&
+	PYTHONPATH=$rocks8db/rocks-pylib python3 -c "
+import sqlite3
+from rocks.db.resolver import AttrResolver
+r = AttrResolver(sqlite3.connect(\"rocks8.db\"))
+print(r.resolve([\"$node_name\"])[\"$node_name\"][\"$attr_name\"])
+" > actual &&
+	diff expected actual
+'
+
+# rocks, rocks.util and the mappings come from the 7.x build, the
+# helper only needs these from them
+test_expect_success MYSQL3 'test rocks8 - helper getHostAttrs' '
+	echo "host 12 compute" > expected &&
+	PYTHONPATH=$rocks8db/rocks-pylib python3 -c "
+import sys, types
+import rocks
+rocks.release = rocks.version = rocks.version_major = \"8\"
+util = types.ModuleType(\"rocks.util\")
+util.getNativeArch = lambda: \"x86_64\"
+util.HostnotfoundException = LookupError
+util.CommandError = Exception
+sys.modules[\"rocks.util\"] = rocks.util = util
+for name in [ \"rocks.db.mappings\", \"rocks.db.mappings.base\" ]:
+	sys.modules[name] = types.ModuleType(name)
+import rocks.db.helper
+db = rocks.db.helper.DatabaseHelper()
+db.setDBName(\"rocks8.db\")
+db.connect()
+attrs = db.getHostAttrs(\"$node_name\")
+print(attrs[\"$attr_name\"], attrs[\"rack\"], attrs[\"appliance\"])
+" > actual &&
+	diff expected actual
+'
+
+test_expect_success MYSQL3 'test rocks8 - no overwrite' '
+	test_must_fail $rocks8db/migrate7.py rocks8.db &&
+	$rocks8db/migrate7.py -f rocks8.db
+'
+
+test_expect_success 'test rocks8 - tear down' '
+	rocks remove host sec_attr $node_name $attr_name &&
+	rocks remove host $node_name &&
+	rocks remove appliance attr compute $attr_name &&
+	rocks remove attr $attr_name
+'
+
+test_done
@@ -0,0 +1,54 @@
+#!/bin/bash
+#
+# Test plugins running in threads
+#
+
+test_description='Test the plugins of a command in threads
+
+With ROCKS_PLUGIN_THREADS the plugins of remove host run concurrently,
+but the host plugin (requires TAIL) still runs after all the others and
+the command commits once, so nothing of the host is left behind.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+node_name="plugin-node"
+
+mysql_cluster(){
+	/opt/rocks/mysql/bin/mysql --defaults-extra-file=/root/.rocks.my.cnf \
+		--user=root --batch --skip-column-names cluster -e "$1"
+}
+
+# rows whose node is gone
+orphans(){
+	mysql_cluster "select count(*) from networks where node not in
+		(select id from nodes);
+		select count(*) from aliases where node not in
+		(select id from nodes);
+		select count(*) from node_rolls where node not in
+		(select id from nodes);
+		select count(*) from attributes a, catindex c where
+		a.catindex = c.id and c.category = mapCategory('host') and
+		c.name = '$node_name'" | sort -u
+}
+
+test_expect_success 'test plugin threads - set up tests' '
+	rocks add host $node_name cpus=1 membership=compute \
+		os=linux rack=10 rank=10 &&
+	rocks add host interface $node_name eth0 \
+		ip=`rocks report nextip private` \
+		subnet=private mac=66:77:dd:dd:dd:dd name=$node_name &&
+	rocks add host alias $node_name $node_name-alias &&
+	rocks set host attr $node_name plugin-attr yes
+'
+
+test_expect_success 'test plugin threads - remove host' '
+	ROCKS_PLUGIN_THREADS=8 rocks remove host $node_name &&
+	test -z "`rocks list host | grep $node_name`" &&
+	test "`orphans`" = "0"
+'
+
+test_done
@@ -0,0 +1,61 @@
+#!/bin/bash
+#
+# Test rocks run batch with the output of rocks dump
+#
+
+test_description='Test rocks run batch replaying rocks dump
+
+The dump of a host key spans several lines in double quotes and a
+multi-line attribute value is dumped with backslash-newlines, run batch
+must read both back as one command each.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+node_name="batch-node"
+dump_file=/tmp/rocks-batch-dump.$$
+
+dump_node(){
+	rocks dump host key $node_name
+	rocks dump host attr $node_name
+}
+
+test_expect_success 'test run batch - set up tests' '
+	rocks add host $node_name cpus=1 membership=compute \
+		os=linux rack=10 rank=10 &&
+	openssl genrsa 2048 2> /dev/null | openssl rsa -pubout \
+		> $dump_file.pem 2> /dev/null &&
+	rocks add host key $node_name key=$dump_file.pem &&
+	rocks set host attr $node_name batch-attr "`printf "one\ntwo 2"`" &&
+	dump_node > $dump_file &&
+	test `grep -c BEGIN $dump_file` = 1
+'
+
+test_expect_success 'test run batch - replay the dump' '
+	rocks remove host key $node_name \
+		id=`rocks list host key $node_name output-col=id output-header=no | head -1 | tr -d " "` &&
+	rocks remove host attr $node_name batch-attr &&
+	test -z "`rocks list host key $node_name`" &&
+	rocks run batch $dump_file &&
+	dump_node > $dump_file.new &&
+	test_cmp $dump_file $dump_file.new &&
+	test "`rocks report host attr $node_name attr=batch-attr`" = \
+		"`printf "one\ntwo 2"`"
+'
+
+test_expect_success 'test run batch - open quote is reported' '
+	printf "rocks list host\nrocks list host \"%s\n" $node_name \
+		> $dump_file.bad &&
+	test_must_fail rocks run batch $dump_file.bad 2> $dump_file.err &&
+	grep -q "^$dump_file.bad:2: No closing quotation" $dump_file.err
+'
+
+test_expect_success 'test run batch - tear down' '
+	rocks remove host $node_name &&
+	rm -f $dump_file $dump_file.*
+'
+
+test_done
@@ -0,0 +1,68 @@
+#!/bin/bash
+#
+# Test the query audit with and without rocksd
+#
+
+test_description='Test ROCKS_QUERY_AUDIT
+
+The statements repeated by a command are reported on the stderr of the
+client when the command is done, also when rocksd runs it, and only for
+the clients that set ROCKS_QUERY_AUDIT.'
+
+pushd `dirname $0` > /dev/null
+export TEST_DIRECTORY=`pwd`
+popd > /dev/null
+. $TEST_DIRECTORY/test-lib.sh
+
+
+audit_dir=/tmp/rocks-audit.$$
+socket=$audit_dir/rocksd.sock
+
+# the same statements twice, run batch runs both in one process
+repeat_twice(){
+	printf "rocks list host\nrocks list host\n" \
+		> $audit_dir/batch &&
+	rocks run batch $audit_dir/batch > /dev/null
+}
+
+test_expect_success 'test query audit - set up tests' '
+	mkdir -p $audit_dir &&
+	( /opt/rocks/bin/rocksd --socket $socket --workers 1 \
+		> $audit_dir/rocksd.log 2>&1 & echo $! > $audit_dir/pid ) &&
+	for i in 1 2 3 4 5 6 7 8 9 10; do
+		test -S $socket && break
+		sleep 1
+	done &&
+	test -S $socket
+'
+
+test_expect_success 'test query audit - without rocksd' '
+	ROCKS_NODAEMON=1 ROCKS_QUERY_AUDIT=1 repeat_twice 2> $audit_dir/err &&
+	grep -q "^query audit:" $audit_dir/err &&
+	grep -q "x  list host" $audit_dir/err
+'
+
+test_expect_success 'test query audit - with rocksd' '
+	ROCKSD_SOCKET=$socket ROCKS_QUERY_AUDIT=1 repeat_twice \
+		2> $audit_dir/err &&
+	grep -q "^query audit:" $audit_dir/err &&
+	grep -q "x  list host" $audit_dir/err
+'
+
+test_expect_success 'test query audit - rocksd, not asked for' '
+	ROCKSD_SOCKET=$socket repeat_twice 2> $audit_dir/err &&
+	! grep -q "query audit" $audit_dir/err
+'
+
+test_expect_success 'test query audit - rocksd, to a file' '
+	ROCKSD_SOCKET=$socket ROCKS_QUERY_AUDIT=$audit_dir/report \
+		repeat_twice &&
+	grep -q "\"command\":\"list host\"" $audit_dir/report
+'
+
+test_expect_success 'test query audit - tear down' '
+	kill `cat $audit_dir/pid` &&
+	rm -rf $audit_dir
+'
+
+test_done